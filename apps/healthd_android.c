@@ -196,13 +196,14 @@ static void notif_java_associated(ContextId conn_cid, char *xml)
  * @param xml Data in xml format
  * @return success status
  */
-static void notif_java_measurementdata(ContextId conn_cid, char *xml)
+static int notif_java_measurementdata(ContextId conn_cid, char *xml)
 {
 	JNIEnv *env = java_get_env();
 	jstring jxml = (*env)->NewStringUTF(env, xml);
 	(*env)->CallVoidMethod(env, bridge_obj,
 				jni_up_measurementdata,
 				context_to_handle(conn_cid), jxml);
+	return 1;
 }
 
 /**
@@ -247,13 +248,14 @@ static void notif_java_segmentdataresponse(ContextId conn_cid,
  * @param xml PM-Segment instance data in XML format
  * @return success status
  */
-static void notif_java_segmentdata(ContextId conn_cid, unsigned int handle,
+static int notif_java_segmentdata(ContextId conn_cid, unsigned int handle,
 					unsigned int instnumber, char *xml)
 {
 	// JNIEnv *env = java_get_env();:q
 
 	// (*env)->CallVoidMethod(env, bridge_obj, jni_up_segmentdata(conn_handle, handle, instnumber, jxml);
 	// FIXME
+	return 1;
 }
 
 
@@ -39,18 +39,456 @@
 #include <string.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <time.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <ieee11073.h>
 #include "src/util/log.h"
 #include "src/util/linkedlist.h"
+#include "src/util/journal.h"
 #include "src/communication/service.h"
+#include "src/dim/mds.h"
 #include "src/dim/pmstore_req.h"
 #include "healthd_ipc.h"
 #include "healthd_service.h"
 
 extern healthd_ipc ipc;
 
+/**
+ * Journal record types
+ */
+enum {
+	HEALTHD_JOURNAL_MEASUREMENT = 1,
+	HEALTHD_JOURNAL_SEGMENT_DATA = 2
+};
+
+/**
+ * Maximum length of a device address kept in journal records
+ */
+#define HEALTHD_ADDR_LEN 48
+
+/**
+ * Identity of a device, so journal records go to the right device even
+ * after it reconnects or healthd restarts. System id is used when
+ * known; otherwise the transport address, if it tells devices apart;
+ * otherwise the connection, which does not outlive healthd.
+ */
+typedef struct {
+	intu8 system_id[8];
+	char low_addr[HEALTHD_ADDR_LEN];
+	unsigned long long run;
+	unsigned long long serial;
+} device_identity;
+
+/**
+ * Device currently connected
+ */
+typedef struct {
+	ContextId id;
+	device_identity identity;
+} healthd_device;
+
+/**
+ * Header of journal records, followed by NUL-terminated XML
+ */
+typedef struct {
+	device_identity identity;
+	unsigned long long timestamp;
+	unsigned int handle;
+	unsigned int instnumber;
+} journal_header;
+
+/**
+ * Records of a device that does not come back are dropped after this
+ * many seconds
+ */
+static const unsigned long long JOURNAL_MAX_AGE = 7 * 24 * 3600;
+
+/**
+ * Transport addresses shared by all devices of a transport
+ */
+static const char *generic_addrs[] = {"tcp", "loopback", NULL};
+
+/**
+ * Connected devices, to resolve journal records to current contexts
+ */
+static LinkedList *_healthd_devices = NULL;
+
+/**
+ * Identifies this run of healthd, connections do not survive it
+ */
+static unsigned long long journal_run = 0;
+
+/**
+ * Serial number of last connection
+ */
+static unsigned long long device_serial = 0;
+
+/**
+ * Appended records between journal syncs
+ */
+static const int JOURNAL_SYNC_BATCH = 32;
+
+/**
+ * Journal of data on its way to IPC consumer, or NULL if disabled
+ */
+static Journal *journal = NULL;
+
+/**
+ * Journal cursor of IPC consumer
+ */
+static int journal_consumer = -1;
+
+/**
+ * Non-zero while a resume is scheduled
+ */
+static int journal_resume_pending = 0;
+
+/**
+ * Opens the journal that keeps measurements and PM-Segment data until
+ * the IPC consumer takes them, so they survive consumer outages and
+ * healthd restarts.
+ *
+ * @param dir journal directory
+ * @param consumer name of IPC consumer, one cursor per name
+ * @return 1 if successful, 0 otherwise
+ */
+int healthd_journal_open(const char *dir, const char *consumer)
+{
+	journal_run = ((unsigned long long) time(NULL) << 32) | getpid();
+	journal = journal_open(dir, 0, 0);
+
+	if (!journal) {
+		return 0;
+	}
+
+	journal_consumer = journal_add_consumer(journal, consumer);
+
+	if (journal_consumer < 0) {
+		journal_close(journal);
+		journal = NULL;
+		return 0;
+	}
+
+	journal_set_sync_batch(journal, JOURNAL_SYNC_BATCH);
+
+	DEBUG("journal: %llu records pending for %s",
+	      journal_pending(journal, journal_consumer),
+	      consumer);
+
+	return 1;
+}
+
+static LinkedList *healthd_devices()
+{
+	if (!_healthd_devices) {
+		_healthd_devices = llist_new();
+	}
+
+	return _healthd_devices;
+}
+
+static int cmp_device_by_id(void *arg, void *element)
+{
+	ContextId *id = arg;
+	healthd_device *device = element;
+
+	return device->id.plugin == id->plugin
+		&& device->id.connid == id->connid;
+}
+
+static int cmp_device_by_system_id(void *arg, void *element)
+{
+	healthd_device *device = element;
+
+	return memcmp(device->identity.system_id, arg,
+		      sizeof(device->identity.system_id)) == 0;
+}
+
+static int cmp_device_by_addr(void *arg, void *element)
+{
+	healthd_device *device = element;
+
+	return strcmp(device->identity.low_addr, arg) == 0;
+}
+
+static int cmp_device_by_serial(void *arg, void *element)
+{
+	healthd_device *device = element;
+
+	return device->identity.serial == *((unsigned long long *) arg);
+}
+
+/**
+ * Tells whether a transport address tells a device apart
+ *
+ * @param low_addr transport address
+ * @return 1 if so, 0 if it is empty or shared by devices of transport
+ */
+static int healthd_addr_identifies(const char *low_addr)
+{
+	int i;
+
+	if (!low_addr || !low_addr[0]) {
+		return 0;
+	}
+
+	for (i = 0; generic_addrs[i]; ++i) {
+		if (strcmp(low_addr, generic_addrs[i]) == 0) {
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+/**
+ * Gets identity of a connected device
+ *
+ * @param id context id
+ * @param identity filled with device identity, zeroed if unknown
+ */
+static void healthd_device_identity(ContextId id, device_identity *identity)
+{
+	healthd_device *device;
+
+	device = llist_search_first(healthd_devices(), &id, cmp_device_by_id);
+
+	if (device) {
+		*identity = device->identity;
+	} else {
+		memset(identity, 0, sizeof(*identity));
+	}
+}
+
+/**
+ * Finds the current context of the device a journal record came from.
+ * Each record is matched by the strongest identity it has, and by that
+ * one only, so it never goes to another device.
+ *
+ * @param identity device identity in record
+ * @param id filled with current context id
+ * @return 1 if found, 0 if device is not connected now, -1 if device
+ * cannot come back
+ */
+static int journal_resolve(const device_identity *identity, ContextId *id)
+{
+	static const intu8 no_system_id[8];
+	healthd_device *device;
+
+	if (memcmp(identity->system_id, no_system_id,
+		   sizeof(no_system_id)) != 0) {
+		device = llist_search_first(healthd_devices(),
+					    (void *) identity->system_id,
+					    cmp_device_by_system_id);
+	} else if (healthd_addr_identifies(identity->low_addr)) {
+		device = llist_search_first(healthd_devices(),
+					    (void *) identity->low_addr,
+					    cmp_device_by_addr);
+	} else if (identity->run == journal_run) {
+		device = llist_search_first(healthd_devices(),
+					    (void *) &identity->serial,
+					    cmp_device_by_serial);
+
+		if (!device) {
+			return -1;
+		}
+	} else {
+		return -1;
+	}
+
+	if (!device) {
+		return 0;
+	}
+
+	*id = device->id;
+
+	return 1;
+}
+
+/**
+ * Hands a journal record to IPC. Records of devices not connected now
+ * are deferred, so they do not hold records of other devices.
+ *
+ * @return JOURNAL_DELIVERED, JOURNAL_STOP if consumer cannot take it
+ * now, JOURNAL_DEFER if device cannot
+ */
+static int journal_deliver(intu16 type, unsigned long long seq,
+			   const intu8 *data, intu32 length, void *arg)
+{
+	journal_header header;
+	ContextId id;
+	char *xml;
+	int resolved;
+
+	if (ipc.consumer_ready && !ipc.consumer_ready()) {
+		return JOURNAL_STOP;
+	}
+
+	if (length <= sizeof(journal_header)
+	    || data[length - 1] != '\0') {
+		ERROR("journal: bad record %llu", seq);
+		return JOURNAL_DELIVERED;
+	}
+
+	memcpy(&header, data, sizeof(header));
+	header.identity.low_addr[HEALTHD_ADDR_LEN - 1] = '\0';
+	resolved = journal_resolve(&header.identity, &id);
+
+	if (resolved < 0) {
+		ERROR("journal: record %llu of unknown device dropped", seq);
+		return JOURNAL_DELIVERED;
+	} else if (!resolved) {
+		if ((unsigned long long) time(NULL)
+		    > header.timestamp + JOURNAL_MAX_AGE) {
+			ERROR("journal: record %llu expired, device did "
+			      "not come back", seq);
+			return JOURNAL_DELIVERED;
+		}
+
+		return JOURNAL_DEFER;
+	}
+
+	xml = (char *) (data + sizeof(journal_header));
+
+	if (type == HEALTHD_JOURNAL_MEASUREMENT) {
+		if (!ipc.call_agent_measurementdata(id, xml)) {
+			return JOURNAL_STOP;
+		}
+	} else if (type == HEALTHD_JOURNAL_SEGMENT_DATA) {
+		if (!ipc.call_agent_segmentdata(id, header.handle,
+						header.instnumber, xml)) {
+			return JOURNAL_STOP;
+		}
+	}
+
+	return JOURNAL_DELIVERED;
+}
+
+/**
+ * Delivers data to IPC consumer, through journal if enabled. Data stays
+ * in journal while consumer is not ready.
+ *
+ * @param type journal record type
+ * @param id context id
+ * @param identity device identity
+ * @param handle PM-Store handle, for PM-Segment data
+ * @param instnumber PM-Segment instance number
+ * @param xml data in XML format
+ */
+static void healthd_deliver(int type, ContextId id,
+			    const device_identity *identity,
+			    unsigned int handle, unsigned int instnumber,
+			    char *xml)
+{
+	journal_header header;
+	intu32 length = strlen(xml) + 1;
+	intu8 *record;
+	int ok;
+
+	if (journal) {
+		memset(&header, 0, sizeof(header));
+		header.identity = *identity;
+		header.timestamp = time(NULL);
+		header.handle = handle;
+		header.instnumber = instnumber;
+
+		record = malloc(sizeof(header) + length);
+		memcpy(record, &header, sizeof(header));
+		memcpy(record + sizeof(header), xml, length);
+
+		ok = journal_append(journal, type, record,
+				    sizeof(header) + length, NULL);
+		free(record);
+
+		if (ok) {
+			journal_replay(journal, journal_consumer,
+				       journal_deliver, NULL);
+			return;
+		}
+
+		ERROR("journal: append failed, delivering directly");
+	}
+
+	if (type == HEALTHD_JOURNAL_MEASUREMENT) {
+		ipc.call_agent_measurementdata(id, xml);
+	} else {
+		ipc.call_agent_segmentdata(id, handle, instnumber, xml);
+	}
+}
+
+/**
+ * Retries delivery of records deferred because their device was away.
+ * Called when a device may have come back, before its new data is
+ * delivered, so it gets data in order.
+ */
+static void healthd_journal_retry()
+{
+	if (journal) {
+		int count = journal_retry_deferred(journal, journal_consumer,
+						   journal_deliver, NULL);
+
+		if (count > 0) {
+			DEBUG("journal: delivered %d deferred records", count);
+		}
+	}
+}
+
+/**
+ * Delayed journal replay
+ *
+ * @param data unused
+ */
+static void healthd_journal_resume_phase2(void *data)
+{
+	journal_resume_pending = 0;
+
+	if (journal) {
+		healthd_journal_retry();
+
+		int count = journal_replay(journal, journal_consumer,
+					   journal_deliver, NULL);
+
+		if (count > 0) {
+			DEBUG("journal: replayed %d records", count);
+		}
+	}
+}
+
+/**
+ * Replays journal to IPC consumer, when it has (re)connected or can
+ * take more data. Replay is done in idle loop, not by caller.
+ */
+void healthd_journal_resume()
+{
+	if (journal && !journal_resume_pending) {
+		journal_resume_pending = 1;
+		healthd_idle_add(healthd_journal_resume_phase2, NULL);
+	}
+}
+
+/**
+ * Flushes journal to disk, and retries delivery of pending records.
+ * Called periodically.
+ */
+void healthd_journal_sync()
+{
+	if (journal) {
+		journal_sync(journal);
+		healthd_journal_resume();
+	}
+}
+
+/**
+ * Closes journal, undelivered records are kept for next run
+ */
+void healthd_journal_close()
+{
+	journal_close(journal);
+	journal = NULL;
+	journal_consumer = -1;
+}
+
 /**
  * Callback for when new data has been received.
  *
@@ -61,16 +499,20 @@ void new_data_received(Context *ctx, DataList *list)
 {
 	DEBUG("Medical Device System Data");
 
+	device_identity identity;
 	char *data = xml_encode_data_list(list);
 
 	if (data) {
-		ipc.call_agent_measurementdata(ctx->id, data);
+		healthd_device_identity(ctx->id, &identity);
+		healthd_deliver(HEALTHD_JOURNAL_MEASUREMENT, ctx->id, &identity,
+				0, 0, data);
 		free(data);
 	}
 }
 
 typedef struct {
 	ContextId id;
+	device_identity identity;
 	int handle;
 	int instnumber;
 	DataList *list;
@@ -91,7 +533,9 @@ static void segment_data_received_phase2(void *revt)
 	char *data = xml_encode_data_list(evt->list);
 
 	if (data) {
-		ipc.call_agent_segmentdata(evt->id, evt->handle, evt->instnumber, data);
+		healthd_deliver(HEALTHD_JOURNAL_SEGMENT_DATA, evt->id,
+				&evt->identity, evt->handle, evt->instnumber,
+				data);
 		free(data);
 	}
 
@@ -123,6 +567,8 @@ void segment_data_received(Context *ctx, int handle, int instnumber, DataList *l
 	// least, delayed until there are no pending events.
 
 	evt->id = ctx->id;
+	// device may be gone when data is delivered
+	healthd_device_identity(ctx->id, &evt->identity);
 	evt->handle = handle;
 	evt->instnumber = instnumber;
 	evt->list = list;
@@ -141,12 +587,34 @@ void device_associated(Context *ctx, DataList *list)
 {
 	DEBUG("Device associated");
 
-	char *data = xml_encode_data_list(list);
+	healthd_device *device;
+	char *data;
+
+	device = llist_search_first(healthd_devices(), &ctx->id,
+				    cmp_device_by_id);
+
+	if (device && ctx->mds && ctx->mds->system_id.value) {
+		int len = ctx->mds->system_id.length;
+
+		if (len > (int) sizeof(device->identity.system_id)) {
+			len = sizeof(device->identity.system_id);
+		}
+
+		memset(device->identity.system_id, 0,
+		       sizeof(device->identity.system_id));
+		memcpy(device->identity.system_id,
+		       ctx->mds->system_id.value, len);
+	}
+
+	data = xml_encode_data_list(list);
 
 	if (data) {
 		ipc.call_agent_associated(ctx->id, data);
 		free(data);
 	}
+
+	// deferred records of this device can go now
+	healthd_journal_resume();
 }
 
 /**
@@ -158,7 +626,22 @@ void device_associated(Context *ctx, DataList *list)
 int device_connected(Context *ctx, const char *low_addr)
 {
 	DEBUG("Device connected");
+
+	healthd_device *device = calloc(1, sizeof(healthd_device));
+
+	device->id = ctx->id;
+	device->identity.run = journal_run;
+	device->identity.serial = ++device_serial;
+
+	if (healthd_addr_identifies(low_addr)) {
+		strncpy(device->identity.low_addr, low_addr,
+			HEALTHD_ADDR_LEN - 1);
+	}
+
+	llist_add(healthd_devices(), device);
+
 	ipc.call_agent_connected(ctx->id, low_addr);
+	healthd_journal_resume();
 	return 1;
 }
 
@@ -171,6 +654,17 @@ int device_connected(Context *ctx, const char *low_addr)
 int device_disconnected(Context *ctx, const char *low_addr)
 {
 	DEBUG("Device disconnected");
+
+	healthd_device *device;
+
+	device = llist_search_first(healthd_devices(), &ctx->id,
+				    cmp_device_by_id);
+
+	if (device) {
+		llist_remove(healthd_devices(), device);
+		free(device);
+	}
+
 	ipc.call_agent_disconnected(ctx->id, low_addr);
 	return 1;
 }
@@ -195,15 +689,12 @@ static void device_reqmdsattr_callback(Context *ctx, Request *r, DATA_apdu *resp
 {
 	DEBUG("Medical Device Attributes");
 
-	DataList *list = manager_get_mds_attributes(ctx->id);
+	// XML is encoded by the manager only when attributes have changed
+	char *data = manager_get_mds_attributes_xml(ctx->id);
 
-	if (list) {
-		char *data = xml_encode_data_list(list);
-		if (data) {
-			ipc.call_agent_deviceattributes(ctx->id, data);
-			free(data);
-		}
-		data_list_del(list);
+	if (data) {
+		ipc.call_agent_deviceattributes(ctx->id, data);
+		free(data);
 	}
 }
 
@@ -226,15 +717,11 @@ void device_reqmdsattr(ContextId ctx)
  */
 void device_getconfig(ContextId ctx, char** xml_out)
 {
-	DataList *list;
-
 	DEBUG("device_getconfig");
-	list = manager_get_configuration(ctx);
+	// XML is encoded by the manager only when configuration has changed
+	*xml_out = manager_get_configuration_xml(ctx);
 
-	if (list) {
-		*xml_out = xml_encode_data_list(list);
-		data_list_del(list);
-	} else {
+	if (!*xml_out) {
 		*xml_out = strdup("");
 	}
 }
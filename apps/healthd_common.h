@@ -25,5 +25,9 @@ void device_get_segmdata(ContextId ctx, int handle, int instnumber,
 void device_clearsegmdata(ContextId ctx, int handle, int instnumber,
 				int *ret);
 void device_clearallsegmdata(ContextId ctx, int handle, int *ret);
+int healthd_journal_open(const char *dir, const char *consumer);
+void healthd_journal_resume();
+void healthd_journal_sync();
+void healthd_journal_close();
 
 #endif
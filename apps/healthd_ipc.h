@@ -2,17 +2,20 @@
 #define HEALTHD_IPC_
 
 typedef struct {
-	void (*call_agent_measurementdata)(ContextId, char *);
+	// 1 if data was handed to consumer, 0 otherwise
+	int (*call_agent_measurementdata)(ContextId, char *);
 	void (*call_agent_connected)(ContextId, const char *);
 	void (*call_agent_disconnected)(ContextId, const char *);
 	void (*call_agent_associated)(ContextId, char *);
 	void (*call_agent_disassociated)(ContextId);
 	void (*call_agent_segmentinfo)(ContextId, unsigned int, char *);
 	void (*call_agent_segmentdataresponse)(ContextId, unsigned int, unsigned int, unsigned int);
-	void (*call_agent_segmentdata)(ContextId, unsigned int, unsigned int, char *);
+	int (*call_agent_segmentdata)(ContextId, unsigned int, unsigned int, char *);
 	void (*call_agent_segmentcleared)(ContextId, unsigned int, unsigned int, unsigned int);
 	void (*call_agent_pmstoredata)(ContextId, unsigned int, char *);
 	void (*call_agent_deviceattributes)(ContextId, char *xml);
+	// optional, non-zero if consumer can take more data now
+	int (*consumer_ready)();
 	void (*start)();
 	void (*stop)();
 } healthd_ipc;
@@ -101,10 +101,11 @@ static void call_agent_associated(ContextId ctx, char *xml)
  * @param xml Data in xml format
  * @return success status
  */
-static void call_agent_measurementdata(ContextId ctx, char *xml)
+static int call_agent_measurementdata(ContextId ctx, char *xml)
 {
 	DEBUG("call_agent_measurementdata");
 	announce("MEASUREMENT", ctx, xml);
+	return 1;
 }
 
 /**
@@ -161,17 +162,18 @@ static void call_agent_segmentdataresponse(ContextId ctx,
  * @param xml PM-Segment instance data in XML format
  * @return success status
  */
-static void call_agent_segmentdata(ContextId ctx, unsigned int handle,
+static int call_agent_segmentdata(ContextId ctx, unsigned int handle,
 					unsigned int instnumber, char *xml)
 {
 	DEBUG("call_agent_segmentdata");
 
 	char *params;
 	if (asprintf(&params, "%d %d %s", handle, instnumber, xml) < 0) {
-		return; // FALSE;
+		return 0;
 	}
 	announce("SEGMENTDATA", ctx, params);
 	free(params);
+	return 1;
 }
 
 
@@ -254,6 +254,9 @@ gboolean srv_configurepassive(Serv *obj, gchar *agent,
 
 	g_free(hdp_data_types);
 
+	// replay data kept while no client was there
+	healthd_journal_resume();
+
 	return TRUE;
 }
 
@@ -449,6 +452,16 @@ static void get_agent_proxy()
 }
 
 
+/**
+ * Tells whether a D-Bus client is there to take data
+ *
+ * @return non-zero if ready
+ */
+static int consumer_ready()
+{
+	return agent_proxy != NULL;
+}
+
 /************* Agent method call proxies ***************/
 
 /**
@@ -555,8 +568,9 @@ static void call_agent_associated(ContextId conn_handle, char *xml)
  *
  * @param conn_handle device handle
  * @param xml Data in xml format
+ * @return 1 if agent was called, 0 otherwise
  */
-static void call_agent_measurementdata(ContextId conn_handle, char *xml)
+static int call_agent_measurementdata(ContextId conn_handle, char *xml)
 {
 	/* Called back by new_data_received() */
 
@@ -569,11 +583,11 @@ static void call_agent_measurementdata(ContextId conn_handle, char *xml)
 
 	if (!device_path) {
 		DEBUG("No device associated with handle!");
-		return; // FALSE;
+		return 0;
 	}
 
 	if (!agent_proxy) {
-		return; // FALSE;
+		return 0;
 	}
 
 	call = dbus_g_proxy_begin_call(agent_proxy, "MeasurementData",
@@ -584,10 +598,10 @@ static void call_agent_measurementdata(ContextId conn_handle, char *xml)
 
 	if (!call) {
 		DEBUG("error calling agent");
-		return; // FALSE;
+		return 0;
 	}
 
-	// return TRUE;
+	return 1;
 }
 
 /**
@@ -682,8 +696,9 @@ static void call_agent_segmentdataresponse(ContextId conn_handle,
  * @param handle PM-Store handle
  * @param instnumber PM-Segment instance number
  * @param xml PM-Segment instance data in XML format
+ * @return 1 if agent was called, 0 otherwise
  */
-static void call_agent_segmentdata(ContextId conn_handle, unsigned int handle,
+static int call_agent_segmentdata(ContextId conn_handle, unsigned int handle,
 					unsigned int instnumber, char *xml)
 {
 	DBusGProxyCall *call;
@@ -695,11 +710,11 @@ static void call_agent_segmentdata(ContextId conn_handle, unsigned int handle,
 
 	if (!device_path) {
 		DEBUG("No device associated with handle!");
-		return; // FALSE;
+		return 0;
 	}
 
 	if (!agent_proxy) {
-		return; // FALSE;
+		return 0;
 	}
 
 	call = dbus_g_proxy_begin_call(agent_proxy, "SegmentData",
@@ -712,10 +727,10 @@ static void call_agent_segmentdata(ContextId conn_handle, unsigned int handle,
 
 	if (!call) {
 		DEBUG("error calling agent");
-		return; // FALSE;
+		return 0;
 	}
 
-	// return TRUE;
+	return 1;
 }
 
 
@@ -1229,6 +1244,7 @@ void healthd_ipc_dbus_init(healthd_ipc *ipc)
 	ipc->call_agent_segmentcleared = &call_agent_segmentcleared;
 	ipc->call_agent_pmstoredata = &call_agent_pmstoredata;
 	ipc->call_agent_deviceattributes = &call_agent_deviceattributes;
+	ipc->consumer_ready = &consumer_ready;
 	ipc->start = &start;
 	ipc->stop = &stop;
 }
@@ -53,9 +53,13 @@
 typedef struct {
 	int fd;
 	char *buf;
+	size_t len;
 } tcp_client;
 
 static const unsigned int PORT = 9005;
+// clients with more unsent bytes than this get no journaled data
+static const size_t TCP_BACKLOG_LIMIT = 1024 * 1024;
+static unsigned int worker_index = 0;
 static LinkedList *_tcp_clients = NULL;
 static int server_fd = -1;
 
@@ -83,7 +87,7 @@ static void tcp_close(tcp_client *client)
 static gboolean tcp_write(GIOChannel *src, GIOCondition cond, gpointer data)
 {
 	tcp_client *client = (tcp_client*) data;
-	gsize len = strlen(client->buf);
+	gsize len = client->len;
 	gsize written;
 	char *newbuf;
 	gboolean more;
@@ -108,6 +112,7 @@ static gboolean tcp_write(GIOChannel *src, GIOCondition cond, gpointer data)
 	if (written <= 0) {
 		free(client->buf);
 		client->buf = strdup("");
+		client->len = 0;
 		g_io_channel_unref(src);
 		return FALSE;
 	}
@@ -116,9 +121,13 @@ static gboolean tcp_write(GIOChannel *src, GIOCondition cond, gpointer data)
 		newbuf = strdup("");
 		g_io_channel_unref(src);
 		more = FALSE;
+		client->len = 0;
+		// client caught up, it may take journaled data again
+		healthd_journal_resume();
 	} else {
 		newbuf = strdup(client->buf + written);
 		more = TRUE;
+		client->len -= written;
 	}
 	free(client->buf);
 	client->buf = newbuf;
@@ -153,21 +162,24 @@ static gboolean tcp_read(GIOChannel *src, GIOCondition cond, gpointer data)
 	return TRUE;
 }
 
-static void tcp_send(tcp_client *client, const char *msg)
+static int tcp_send(tcp_client *client, const char *msg)
 {
 	char *newbuf;
 
 	DEBUG("TCP: scheduling write %p", client);
 
 	if (asprintf(&newbuf, "%s%s", client->buf, msg) < 0) {
-		return;
+		return 0;
 	}
 
 	free(client->buf);
 	client->buf = newbuf;
+	client->len += strlen(msg);
 
 	GIOChannel *channel = g_io_channel_unix_new(client->fd);
 	g_io_add_watch(channel, G_IO_OUT, tcp_write, client);
+
+	return 1;
 }
 
 static gboolean tcp_accept(GIOChannel *src, GIOCondition cond, gpointer data)
@@ -198,6 +210,9 @@ static gboolean tcp_accept(GIOChannel *src, GIOCondition cond, gpointer data)
 
 	llist_add(tcp_clients(), new_client);
 
+	// replay data kept while no client was there
+	healthd_journal_resume();
+
 	return TRUE;
 }
 
@@ -212,7 +227,7 @@ static void tcp_listen()
 	bzero(&addr, sizeof(addr));
 	addr.sin_family = AF_INET;
 	addr.sin_addr.s_addr = INADDR_ANY;
-	addr.sin_port = htons(PORT);
+	addr.sin_port = htons(PORT + worker_index);
 	bind(server_fd, (struct sockaddr *) &addr, sizeof(addr));
 	listen(server_fd, 5);
 
@@ -222,11 +237,17 @@ static void tcp_listen()
 	DEBUG("TCP: listening");
 }
 
-static void tcp_announce(const char *command, ContextId ctx, const char *arg)
+/**
+ * Sends a message to all TCP clients
+ *
+ * @return 1 if some client got the message, 0 otherwise
+ */
+static int tcp_announce(const char *command, ContextId ctx, const char *arg)
 {
 	char *msg;
 	char *j;
 	char *arg2 = strdup(arg);
+	int sent = 0;
 
 	for (j = arg2; *j; ++j)
 		if ((*j == '\t') || (*j == '\n'))
@@ -234,7 +255,7 @@ static void tcp_announce(const char *command, ContextId ctx, const char *arg)
 
 	if (asprintf(&msg, "%s\t%d:%llu\t%s\n", command, ctx.plugin, ctx.connid, arg2) < 0) {
 		free(arg2);
-		return;
+		return 0;
 	}
 
 	printf("%s\n", msg);
@@ -242,12 +263,39 @@ static void tcp_announce(const char *command, ContextId ctx, const char *arg)
 	LinkedNode *i = tcp_clients()->first;
 
 	while (i) {
-		tcp_send(i->element, msg);
+		sent |= tcp_send(i->element, msg);
 		i = i->next;
 	}
 
 	free(arg2);
 	free(msg);
+
+	return sent;
+}
+
+/**
+ * Tells whether TCP clients can take more data now: there is some
+ * client, and none is too far behind.
+ *
+ * @return non-zero if ready
+ */
+static int consumer_ready()
+{
+	LinkedNode *i = tcp_clients()->first;
+
+	if (!i) {
+		return 0;
+	}
+
+	for (; i; i = i->next) {
+		tcp_client *client = i->element;
+
+		if (client->len >= TCP_BACKLOG_LIMIT) {
+			return 0;
+		}
+	}
+
+	return 1;
 }
 
 static void self_configure()
@@ -288,12 +336,12 @@ static void call_agent_associated(ContextId ctx, char *xml)
  *
  * @param ctx device handle
  * @param xml Data in xml format
- * @return success status
+ * @return 1 if some client got data
  */
-static void call_agent_measurementdata(ContextId ctx, char *xml)
+static int call_agent_measurementdata(ContextId ctx, char *xml)
 {
 	DEBUG("call_agent_measurementdata");
-	tcp_announce("MEASUREMENT", ctx, xml);
+	return tcp_announce("MEASUREMENT", ctx, xml);
 }
 
 /**
@@ -348,18 +396,23 @@ static void call_agent_segmentdataresponse(ContextId ctx,
  * @param handle PM-Store handle
  * @param instnumber PM-Segment instance number
  * @param xml PM-Segment instance data in XML format
+ * @return 1 if some client got data
  */
-static void call_agent_segmentdata(ContextId ctx, unsigned int handle,
+static int call_agent_segmentdata(ContextId ctx, unsigned int handle,
 					unsigned int instnumber, char *xml)
 {
 	DEBUG("call_agent_segmentdata");
 
 	char *params;
+	int sent;
+
 	if (asprintf(&params, "%d %d %s", handle, instnumber, xml) < 0) {
-		return; // FALSE;
+		return 0;
 	}
-	tcp_announce("SEGMENTDATA", ctx, params);
+	sent = tcp_announce("SEGMENTDATA", ctx, params);
 	free(params);
+
+	return sent;
 }
 
 
@@ -460,8 +513,20 @@ void healthd_ipc_tcp_init(healthd_ipc *ipc)
 	ipc->call_agent_segmentcleared = &call_agent_segmentcleared;
 	ipc->call_agent_pmstoredata = &call_agent_pmstoredata;
 	ipc->call_agent_deviceattributes = &call_agent_deviceattributes;
+	ipc->consumer_ready = &consumer_ready;
 	ipc->start = &start;
 	ipc->stop = &stop;
 }
 
+/**
+ * Sets the index of this healthd worker process. Each worker has
+ * its own devices, so it listens for IPC clients on port 9005 + worker.
+ *
+ * @param worker worker index, 0 for the first (or only) process
+ */
+void healthd_ipc_tcp_set_worker(int worker)
+{
+	worker_index = worker;
+}
+
 /** @} */
@@ -4,5 +4,6 @@
 #include "healthd_ipc.h"
 
 void healthd_ipc_tcp_init(healthd_ipc *ipc);
+void healthd_ipc_tcp_set_worker(int worker);
 
 #endif
@@ -39,20 +39,31 @@
 #include <string.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <errno.h>
+#include <poll.h>
 #include <sys/socket.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <sys/un.h>
 #include <netinet/in.h>
 #include <glib.h>
 #include <gio/gio.h>
+#if GLIB_CHECK_VERSION(2, 30, 0)
+#include <glib-unix.h>
+#endif
 #include <ieee11073.h>
 #include "src/communication/plugin/bluez/plugin_bluez.h"
 #include "src/communication/plugin/trans/plugin_trans.h"
 #include "src/trans/plugin/example_oximeter.h"
 #include "src/communication/plugin/usb/plugin_usb.h"
 #include "src/communication/plugin/bluez/plugin_glib_socket.h"
+#include "src/communication/plugin/plugin_tcp_uring.h"
 #include "src/trans/trans.h"
 #include "src/util/log.h"
 #include "src/util/linkedlist.h"
 #include "src/communication/service.h"
+#include "src/communication/apdu_capture.h"
+#include "src/communication/stats.h"
 #include "src/dim/pmstore_req.h"
 #include "healthd_service.h"
 #include "healthd_common.h"
@@ -131,16 +142,247 @@ void healthd_idle_add(void *f, void *param)
 	g_idle_add(&healthd_idle_cb, data);
 }
 
+/**
+ * Whether BlueZ HDP is served by this process
+ */
+static int bluez_enabled = 0;
+
 /**
  * Configures HDP data types
  */
 void hdp_types_configure(uint16_t hdp_data_types[])
 {
+	if (!bluez_enabled) {
+		return;
+	}
+
 	plugin_bluez_update_data_types(TRUE, hdp_data_types); // TRUE=sink
 }
 
 static GMainLoop *mainloop = NULL;
 
+/**
+ * File where communication counters are exported, or NULL
+ */
+static const char *stats_path = NULL;
+
+/**
+ * Interval of counters export, in seconds
+ */
+static const int STATS_EXPORT_INTERVAL = 10;
+
+/**
+ * Interval of journal sync and delivery retry, in seconds
+ */
+static const int JOURNAL_SYNC_INTERVAL = 1;
+
+/**
+ * Flushes measurement journal and retries delivery to IPC consumer
+ *
+ * @param data unused
+ * @return TRUE (to keep the timer)
+ */
+static gboolean journal_tick(gpointer data)
+{
+	healthd_journal_sync();
+	return TRUE;
+}
+
+/**
+ * Reaps io_uring TCP plugin completions when its ring is signalled
+ *
+ * @param source ring fd channel
+ * @param cond condition
+ * @param data unused
+ * @return TRUE (to keep the watch)
+ */
+static gboolean tcp_uring_ready(GIOChannel *source, GIOCondition cond,
+				gpointer data)
+{
+	plugin_tcp_uring_process(0);
+	return TRUE;
+}
+
+/**
+ * Unix socket where a newer healthd asks for the TCP agents, or NULL
+ */
+static const char *handoff_path = NULL;
+
+/**
+ * Socket of the healthd that took our agents over, closed on exit
+ */
+static int handoff_peer = -1;
+
+/**
+ * Connects to the handoff socket of a running healthd
+ *
+ * @return connected socket, or -1 if no healthd is running
+ */
+static int handoff_connect()
+{
+	struct sockaddr_un addr;
+	int sk = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, handoff_path, sizeof(addr.sun_path) - 1);
+
+	if (connect(sk, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+		close(sk);
+		return -1;
+	}
+
+	return sk;
+}
+
+/**
+ * Waits for the previous healthd to exit (and release IPC resources)
+ *
+ * @param sk handoff socket
+ */
+static void handoff_wait_peer(int sk)
+{
+	struct pollfd pfd = {sk, POLLIN, 0};
+	char c;
+
+	while (poll(&pfd, 1, 10000) > 0 && read(sk, &c, 1) > 0)
+		;
+
+	close(sk);
+}
+
+/**
+ * Hands TCP agents over to a newer healthd, and quits
+ *
+ * @param source handoff socket channel
+ * @param cond condition
+ * @param data unused
+ * @return FALSE once agents were handed over
+ */
+static gboolean handoff_request(GIOChannel *source, GIOCondition cond,
+				gpointer data)
+{
+	int sk = accept(g_io_channel_unix_get_fd(source), NULL, NULL);
+
+	if (sk < 0) {
+		return TRUE;
+	}
+
+	DEBUG("Handing TCP agents over to new healthd");
+
+	if (plugin_tcp_uring_handoff(sk) != NETWORK_ERROR_NONE) {
+		close(sk);
+		return TRUE;
+	}
+
+	handoff_peer = sk;
+	g_main_loop_quit(mainloop);
+
+	return FALSE;
+}
+
+/**
+ * Listens on the handoff socket for a newer healthd
+ */
+static void handoff_listen()
+{
+	struct sockaddr_un addr;
+	int sk = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, handoff_path, sizeof(addr.sun_path) - 1);
+	unlink(handoff_path);
+
+	if (bind(sk, (struct sockaddr *) &addr, sizeof(addr)) < 0
+	    || listen(sk, 1) < 0) {
+		ERROR("Cannot listen on %s: %d", handoff_path, errno);
+		close(sk);
+		return;
+	}
+
+	GIOChannel *channel = g_io_channel_unix_new(sk);
+	g_io_add_watch(channel, G_IO_IN, handoff_request, NULL);
+	g_io_channel_unref(channel);
+}
+
+/**
+ * Writes communication counters and latency histograms
+ *
+ * @param f output file
+ */
+static void stats_write(FILE *f)
+{
+	CommunicationStats stats;
+	LatencyHistogram latency[STATS_OP_TYPES];
+	int op;
+
+	manager_get_stats(&stats);
+	stats_print(f, "antidote_", &stats);
+
+	for (op = 0; op < STATS_OP_TYPES; ++op) {
+		manager_get_latency(op, &latency[op]);
+	}
+
+	stats_print_latency(f, "antidote_", latency);
+}
+
+/**
+ * Writes communication counters to stats_path. File is replaced
+ * atomically, so readers never see a partial export.
+ *
+ * @param data unused
+ * @return TRUE (to keep the timer)
+ */
+static gboolean stats_export(gpointer data)
+{
+	char *tmp_path;
+	FILE *f;
+
+	if (asprintf(&tmp_path, "%s.tmp", stats_path) < 0) {
+		return TRUE;
+	}
+
+	f = fopen(tmp_path, "w");
+
+	if (!f) {
+		ERROR("Cannot write counters to %s", tmp_path);
+		free(tmp_path);
+		return TRUE;
+	}
+
+	stats_write(f);
+	fclose(f);
+
+	if (rename(tmp_path, stats_path) != 0) {
+		ERROR("Cannot replace %s", stats_path);
+	}
+
+	free(tmp_path);
+	return TRUE;
+}
+
+#if GLIB_CHECK_VERSION(2, 30, 0)
+/**
+ * Dumps counters on demand (SIGUSR1) to standard output, and to
+ * stats file if one was given
+ *
+ * @param data unused
+ * @return TRUE (to keep the handler)
+ */
+static gboolean stats_dump(gpointer data)
+{
+	stats_write(stdout);
+	fflush(stdout);
+
+	if (stats_path) {
+		stats_export(NULL);
+	}
+
+	return TRUE;
+}
+#endif
+
 /**
  * App clean-up in termination phase
  */
@@ -161,6 +403,110 @@ static void app_finalize(int sig)
 	g_main_loop_quit(mainloop);
 }
 
+/**
+ * Exit status of application
+ */
+static int exit_status = 0;
+
+/**
+ * Reaps a worker that has exited. Its agent port share, IPC port and
+ * journal would be gone, so the whole healthd is stopped with failure
+ * status (workers die with it) and may be restarted by its supervisor.
+ *
+ * @param pid process id of worker
+ * @param status wait status of worker
+ * @param data worker index
+ */
+static void worker_exited(GPid pid, gint status, gpointer data)
+{
+	int worker = GPOINTER_TO_INT(data);
+
+	if (WIFSIGNALED(status)) {
+		ERROR("Worker %d (pid %d) killed by signal %d", worker,
+		      (int) pid, WTERMSIG(status));
+	} else {
+		ERROR("Worker %d (pid %d) exited with status %d", worker,
+		      (int) pid, WEXITSTATUS(status));
+	}
+
+	g_spawn_close_pid(pid);
+	exit_status = 1;
+
+	if (mainloop) {
+		g_main_loop_quit(mainloop);
+	}
+}
+
+/**
+ * Forks worker processes that share the TCP agent port. Every worker runs
+ * a manager of its own, so workers scale across cores and do not share
+ * contexts, configurations or the stack lock; the kernel spreads incoming
+ * agent connections among them (SO_REUSEPORT). Workers die together
+ * with the first process, and the first process stops if a worker exits.
+ *
+ * @param count total number of processes, including the caller
+ * @return worker index of the calling process (0 for the first one)
+ */
+static int spawn_workers(int count)
+{
+	pid_t *pids = calloc(count, sizeof(pid_t));
+	int worker;
+
+	for (worker = 1; worker < count; ++worker) {
+		pid_t pid = fork();
+
+		if (pid < 0) {
+			ERROR("Cannot fork worker %d", worker);
+			break;
+		}
+
+		if (pid == 0) {
+			prctl(PR_SET_PDEATHSIG, SIGTERM);
+			free(pids);
+			return worker;
+		}
+
+		if (pids) {
+			pids[worker] = pid;
+		}
+	}
+
+	// watched once all are forked, GLib may start a thread for it
+	for (worker = 1; pids && worker < count; ++worker) {
+		if (pids[worker] > 0) {
+			g_child_watch_add(pids[worker], worker_exited,
+					  GINT_TO_POINTER(worker));
+		}
+	}
+
+	free(pids);
+
+	return 0;
+}
+
+/**
+ * Gives a worker a file of its own, suffixing path with worker index
+ *
+ * @param path path given in command line, or NULL
+ * @param worker worker index
+ * @return newly allocated path, or NULL if path is NULL
+ */
+static char *worker_path(const char *path, int worker)
+{
+	char *wpath;
+
+	if (!path) {
+		return NULL;
+	}
+
+	if (asprintf(&wpath, "%s.%d", path, worker) < 0) {
+		ERROR("Cannot allocate path for worker %d", worker);
+		return NULL;
+	}
+
+	return wpath;
+}
+
 /**
  * Sets up application signal handlers, linking them to app finalization
  */
@@ -188,12 +534,22 @@ int main(int argc, char *argv[])
 	CommunicationPlugin trans_plugin;
 	CommunicationPlugin tcp_plugin;
 
-	CommunicationPlugin *plugins[] = {0, 0, 0, 0};
+	CommunicationPlugin *plugins[] = {0, 0, 0, 0, 0};
 	int plugin_count = 0;
 
 	int trans_support = 0;
 	int usb_support = 0;
 	int tcpp_support = 0;
+	int tcpu_support = 0;
+	const char *capture_path = NULL;
+	const char *journal_dir = NULL;
+	int prewarm = 0;
+	int workers = 1;
+	int worker = 0;
+	char *worker_stats = NULL;
+	char *worker_capture = NULL;
+	char *worker_journal = NULL;
+	int takeover = -1;
 
 	int i;
 
@@ -217,7 +573,39 @@ int main(int argc, char *argv[])
 			usb_support = 1;
 		} else if (strcmp(argv[i], "--tcpp") == 0) {
 			tcpp_support = 1;
+		} else if (strcmp(argv[i], "--tcpu") == 0) {
+			tcpu_support = 1;
+		} else if (strncmp(argv[i], "--capture=", 10) == 0) {
+			capture_path = argv[i] + 10;
+		} else if (strncmp(argv[i], "--stats=", 8) == 0) {
+			stats_path = argv[i] + 8;
+		} else if (strncmp(argv[i], "--prewarm=", 10) == 0) {
+			prewarm = atoi(argv[i] + 10);
+		} else if (strncmp(argv[i], "--workers=", 10) == 0) {
+			workers = atoi(argv[i] + 10);
+		} else if (strncmp(argv[i], "--handoff=", 10) == 0) {
+			handoff_path = argv[i] + 10;
+		} else if (strncmp(argv[i], "--journal=", 10) == 0) {
+			journal_dir = argv[i] + 10;
+		}
+	}
+
+	if (workers > 1) {
+		if (!tcpu_support || opmode == DBUS_SERVER) {
+			fprintf(stderr, "--workers needs --tcpu and --tcp or --auto\n");
+			return 1;
 		}
+
+		worker = spawn_workers(workers);
+		healthd_ipc_tcp_set_worker(worker);
+
+		// workers have devices of their own, hence files too
+		worker_stats = worker_path(stats_path, worker);
+		worker_capture = worker_path(capture_path, worker);
+		worker_journal = worker_path(journal_dir, worker);
+		stats_path = worker_stats;
+		capture_path = worker_capture;
+		journal_dir = worker_journal;
 	}
 
 	if (opmode == DBUS_SERVER) {
@@ -233,26 +621,49 @@ int main(int argc, char *argv[])
 	usb_plugin = communication_plugin();
 	tcp_plugin = communication_plugin();
 
-	plugin_bluez_setup(&bt_plugin);
-	bt_plugin.timer_count_timeout = timer_count_timeout;
-	bt_plugin.timer_reset_timeout = timer_reset_timeout;
-	plugins[plugin_count++] = &bt_plugin;
+	// local devices are claimed by the first worker only
+	if (worker == 0) {
+		plugin_bluez_setup(&bt_plugin);
+		bt_plugin.timer_count_timeout = timer_count_timeout;
+		bt_plugin.timer_reset_timeout = timer_reset_timeout;
+		plugins[plugin_count++] = &bt_plugin;
+		bluez_enabled = 1;
+	}
 
-	if (usb_support) {
+	if (usb_support && worker == 0) {
 		plugin_usb_setup(&usb_plugin);
 		usb_plugin.timer_count_timeout = timer_count_timeout;
 		usb_plugin.timer_reset_timeout = timer_reset_timeout;
 		plugins[plugin_count++] = &usb_plugin;
 	}
 
-	if (trans_support) {
+	if (trans_support && worker == 0) {
 		plugin_trans_setup(&trans_plugin);
 		trans_plugin.timer_count_timeout = timer_count_timeout;
 		trans_plugin.timer_reset_timeout = timer_reset_timeout;
 		plugins[plugin_count++] = &trans_plugin;
 	}
 
-	if (tcpp_support) {
+	if (tcpu_support && plugin_tcp_uring_setup(&tcp_plugin, 6024, 0)
+	    == NETWORK_ERROR_NONE) {
+		plugin_tcp_uring_set_reuseport(workers > 1);
+
+		if (handoff_path && workers <= 1) {
+			// live upgrade: take agents over from running healthd
+			takeover = handoff_connect();
+
+			if (takeover >= 0) {
+				plugin_tcp_uring_set_takeover(dup(takeover));
+			}
+		}
+
+		tcp_plugin.timer_count_timeout = timer_count_timeout;
+		tcp_plugin.timer_reset_timeout = timer_reset_timeout;
+		plugins[plugin_count++] = &tcp_plugin;
+	} else if (workers > 1) {
+		ERROR("Worker %d: io_uring TCP plugin not available", worker);
+		return 1;
+	} else if (tcpp_support || tcpu_support) {
 		plugin_glib_socket_setup(&tcp_plugin, 1, 6024);
 		tcp_plugin.timer_count_timeout = timer_count_timeout;
 		tcp_plugin.timer_reset_timeout = timer_reset_timeout;
@@ -261,6 +672,14 @@ int main(int argc, char *argv[])
 
 	manager_init(plugins);
 
+	if (prewarm > 0) {
+		manager_reserve_contexts(prewarm);
+	}
+
+	if (capture_path) {
+		apdu_capture_start(capture_path, 0, APDU_CAPTURE_DEFAULT_FILES);
+	}
+
 	ManagerListener listener = MANAGER_LISTENER_EMPTY;
 	listener.measurement_data_updated = &new_data_received;
 	listener.segment_data_received = &segment_data_received;
@@ -272,21 +691,74 @@ int main(int argc, char *argv[])
 	manager_add_listener(listener);
 	manager_start();
 
-	if (trans_support) {
+	if (takeover >= 0) {
+		handoff_wait_peer(takeover);
+	}
+
+	// opened once previous healthd has closed it, if taking over; data
+	// received before goes straight to IPC
+	if (journal_dir) {
+		const char *consumers[] = {"dbus", "tcp", "auto"};
+
+		if (!healthd_journal_open(journal_dir, consumers[opmode])) {
+			ERROR("Cannot open journal %s", journal_dir);
+		}
+	}
+
+	if (handoff_path && workers <= 1 && plugin_tcp_uring_fd() >= 0) {
+		handoff_listen();
+	}
+
+	if (plugin_tcp_uring_fd() >= 0) {
+		GIOChannel *channel = g_io_channel_unix_new(plugin_tcp_uring_fd());
+		g_io_add_watch(channel, G_IO_IN, tcp_uring_ready, NULL);
+		g_io_channel_unref(channel);
+	}
+
+	if (trans_support && worker == 0) {
 		trans_plugin_oximeter_register();
 	}
 
 	ipc.start();
 
+	if (stats_path) {
+		g_timeout_add_seconds(STATS_EXPORT_INTERVAL, stats_export, NULL);
+	}
+
+	if (journal_dir) {
+		g_timeout_add_seconds(JOURNAL_SYNC_INTERVAL, journal_tick, NULL);
+		healthd_journal_resume();
+	}
+
+#if GLIB_CHECK_VERSION(2, 30, 0)
+	g_unix_signal_add(SIGUSR1, stats_dump, NULL);
+#endif
+
 	mainloop = g_main_loop_new(NULL, FALSE);
 	g_main_loop_ref(mainloop);
 	g_main_loop_run(mainloop);
 	DEBUG("Main loop stopped");
+
+	if (stats_path) {
+		stats_export(NULL);
+	}
+
 	manager_finalize();
+	healthd_journal_close();
 	app_clean_up();
+
+	if (handoff_peer >= 0) {
+		// new healthd may take IPC over now
+		close(handoff_peer);
+	}
+
+	free(worker_stats);
+	free(worker_capture);
+	free(worker_journal);
+
 	DEBUG("Stopped.");
 
-	return 0;
+	return exit_status;
 }
 
 /** @} */
@@ -0,0 +1,809 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+/**
+ * \file apdu_replay.c
+ * \brief Replays APDU captures against a manager.
+ *
+ * Copyright (C) 2010 Signove Tecnologia Corporation.
+ * All rights reserved.
+ * Contact: Signove Tecnologia Corporation (contact@signove.com)
+ *
+ * $LICENSE_TEXT:BEGIN$
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation and appearing
+ * in the file LICENSE included in the packaging of this file; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ * $LICENSE_TEXT:END$
+ *
+ * \date Oct 18, 2026
+ */
+
+/*
+ * Plays the agent side of captured conversations over many connections
+ * at once, either over TCP against a running manager or over the
+ * loopback plugin against a manager in this same process.
+ *
+ * APDUs captured as sent by manager are expected back: the connection
+ * waits for an APDU of the same type before moving on. Manager APDUs
+ * not in capture are counted as extra; if the expected type does not
+ * show up before timeout, a different APDU counts as a mismatch and no
+ * APDU at all as a timeout. Invoke ids of agent responses are rewritten
+ * to match the latest manager request, so a capture may be replayed
+ * many times.
+ *
+ * Latency is measured from each APDU sent to the first APDU received
+ * from manager after it.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include <errno.h>
+#include <getopt.h>
+#include <poll.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include <ieee11073.h>
+#include "communication/plugin/plugin_loopback.h"
+#include "latency_stats.h"
+#include "replay_tape.h"
+
+/**
+ * Size of APDU header (choice + length)
+ */
+#define APDU_HEADER_SIZE 4
+
+/**
+ * Largest encoded APDU
+ */
+#define APDU_MAX_SIZE (65535 + APDU_HEADER_SIZE)
+
+/**
+ * Manager APDUs kept while connection is not expecting them yet
+ */
+#define EARLY_APDUS 16
+
+/**
+ * Pacing of APDUs sent by agent
+ */
+typedef enum {
+	TIMING_FAST = 0,
+	TIMING_ORIGINAL,
+	TIMING_SCALED
+} ReplayTiming;
+
+/**
+ * Type of an APDU: choice plus, for PRST, data choice
+ */
+typedef struct ApduKind {
+	intu16 choice;
+	intu16 data_choice;
+} ApduKind;
+
+/**
+ * Replayed connection; loopback pair is the same as id
+ */
+typedef struct ReplayConn {
+	unsigned int id;
+	int fd;
+	int started;
+	int active;
+	int closed_early;
+	unsigned int pos;
+	unsigned int loop;
+	double start_at;
+	double tape_start;
+	double last_send;
+	double wait_since;
+	int waiting;
+	int reply_pending;
+	intu8 invoke_id[2];
+	int has_invoke_id;
+	ApduKind early[EARLY_APDUS];
+	unsigned int early_count;
+	intu8 *rx;
+	intu32 rx_len;
+	unsigned long long sent;
+	unsigned long long received;
+	unsigned long long mismatches;
+	unsigned long long timeouts;
+	unsigned long long extra;
+	LatencyStats latency;
+} ReplayConn;
+
+static ReplayTape *tape = NULL;
+static ReplayConn *conns = NULL;
+static unsigned int conn_count = 1;
+static ReplayTiming timing = TIMING_ORIGINAL;
+static double scale = 1.0;
+static double interval = 1.0;
+static double ramp = 0;
+static double timeout = 3.0;
+static unsigned int loops = 1;
+static char *tcp_host = NULL;
+static char *tcp_port = NULL;
+static int has_context = 0;
+static unsigned int context_plugin = 0;
+static unsigned long long context_connid = 0;
+static int print_only = 0;
+
+static CommunicationPlugin manager_plugin;
+static unsigned long long associations = 0;
+static unsigned long long measurements = 0;
+
+static intu8 scratch[APDU_MAX_SIZE];
+
+static ApduKind kind_of(const intu8 *apdu, intu32 size)
+{
+	ApduKind k = {apdu[0] << 8 | apdu[1], 0};
+
+	if (k.choice == 0xE700 && size >= 10) {
+		k.data_choice = apdu[8] << 8 | apdu[9];
+	}
+
+	return k;
+}
+
+/**
+ * Time when record is due, relative to start of tape
+ */
+static double due_offset(ReplayRecord *r)
+{
+	double offset = r->offset - tape->records[0].offset;
+
+	switch (timing) {
+	case TIMING_FAST:
+		return 0;
+	case TIMING_SCALED:
+		return offset * scale;
+	default:
+		return offset;
+	}
+}
+
+static int conn_connect(ReplayConn *c)
+{
+	if (!tcp_host) {
+		return plugin_loopback_peer_connect(c->id) == NETWORK_ERROR_NONE;
+	}
+
+	struct addrinfo hints;
+	struct addrinfo *res;
+	int one = 1;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+
+	if (getaddrinfo(tcp_host, tcp_port, &hints, &res) != 0) {
+		fprintf(stderr, "cannot resolve %s\n", tcp_host);
+		return 0;
+	}
+
+	c->fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+
+	if (c->fd < 0 || connect(c->fd, res->ai_addr, res->ai_addrlen) < 0) {
+		fprintf(stderr, "connection %u: %s\n", c->id, strerror(errno));
+
+		if (c->fd >= 0) {
+			close(c->fd);
+			c->fd = -1;
+		}
+
+		freeaddrinfo(res);
+		return 0;
+	}
+
+	freeaddrinfo(res);
+	setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+	if (c->rx == NULL) {
+		c->rx = malloc(APDU_MAX_SIZE);
+	}
+
+	c->rx_len = 0;
+
+	return c->rx != NULL;
+}
+
+static void conn_disconnect(ReplayConn *c)
+{
+	if (!tcp_host) {
+		plugin_loopback_peer_disconnect(c->id);
+	} else if (c->fd >= 0) {
+		close(c->fd);
+		c->fd = -1;
+	}
+
+	c->active = 0;
+}
+
+static int conn_send(ReplayConn *c, const intu8 *apdu, intu32 size)
+{
+	if (!tcp_host) {
+		return plugin_loopback_peer_send(c->id, apdu, size)
+			== NETWORK_ERROR_NONE;
+	}
+
+	while (size > 0) {
+		ssize_t n = send(c->fd, apdu, size, MSG_NOSIGNAL);
+
+		if (n < 0 && errno == EINTR) {
+			continue;
+		} else if (n <= 0) {
+			return 0;
+		}
+
+		apdu += n;
+		size -= n;
+	}
+
+	return 1;
+}
+
+/**
+ * Gets next APDU sent by manager, if any
+ *
+ * @return APDU length, 0 if none, -1 if connection is gone
+ */
+static int conn_recv(ReplayConn *c, intu8 *buffer)
+{
+	if (!tcp_host) {
+		int n = plugin_loopback_peer_recv(c->id, buffer, APDU_MAX_SIZE);
+
+		if (n == 0 && !plugin_loopback_is_connected(c->id)) {
+			return -1;
+		}
+
+		return n;
+	}
+
+	while (1) {
+		if (c->rx_len >= APDU_HEADER_SIZE) {
+			intu32 size = (c->rx[2] << 8 | c->rx[3]) + APDU_HEADER_SIZE;
+
+			if (c->rx_len >= size) {
+				memcpy(buffer, c->rx, size);
+				memmove(c->rx, c->rx + size, c->rx_len - size);
+				c->rx_len -= size;
+				return size;
+			}
+		}
+
+		ssize_t n = recv(c->fd, c->rx + c->rx_len,
+				 APDU_MAX_SIZE - c->rx_len, MSG_DONTWAIT);
+
+		if (n == 0) {
+			return -1;
+		} else if (n < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK
+			    || errno == EINTR) {
+				return 0;
+			}
+
+			return -1;
+		}
+
+		c->rx_len += n;
+	}
+}
+
+static void finish_loop(ReplayConn *c, double t)
+{
+	++c->loop;
+
+	if (c->loop >= loops) {
+		conn_disconnect(c);
+		return;
+	}
+
+	c->pos = 0;
+	c->tape_start = t;
+	c->extra += c->early_count;
+	c->early_count = 0;
+}
+
+/**
+ * Consumes the current expected record if a manager APDU of the same
+ * type is at hand. Manager APDUs found before it are skipped as extra.
+ * After timeout, any manager APDU is taken as a mismatching one.
+ *
+ * @return 1 if record was consumed
+ */
+static int match_expected(ReplayConn *c, ReplayRecord *r, int timed_out)
+{
+	unsigned int i = 0;
+
+	if (c->early_count == 0) {
+		return 0;
+	}
+
+	if (r->data != NULL) {
+		ApduKind want = kind_of(r->data, r->size);
+
+		for (i = 0; i < c->early_count; ++i) {
+			if (c->early[i].choice == want.choice
+			    && c->early[i].data_choice == want.data_choice) {
+				break;
+			}
+		}
+
+		if (i >= c->early_count) {
+			if (!timed_out) {
+				return 0;
+			}
+
+			++c->mismatches;
+			i = 0;
+		}
+
+		c->extra += i;
+	}
+
+	c->early_count -= i + 1;
+	memmove(c->early, c->early + i + 1,
+		c->early_count * sizeof(ApduKind));
+
+	return 1;
+}
+
+static void handle_incoming(ReplayConn *c, double t)
+{
+	intu8 apdu[APDU_MAX_SIZE];
+	int n;
+
+	while ((n = conn_recv(c, apdu)) != 0) {
+		if (n < 0) {
+			if (c->pos < tape->count) {
+				c->closed_early = 1;
+			}
+
+			conn_disconnect(c);
+			return;
+		}
+
+		++c->received;
+
+		if (c->reply_pending) {
+			latency_add(&c->latency, t - c->last_send);
+			c->reply_pending = 0;
+		}
+
+		ApduKind k = kind_of(apdu, n);
+
+		if (k.choice == 0xE700 && (k.data_choice >> 8) == 0x01) {
+			// remote invoke; agent answer must carry its id
+			c->invoke_id[0] = apdu[6];
+			c->invoke_id[1] = apdu[7];
+			c->has_invoke_id = 1;
+		}
+
+		if (c->early_count >= EARLY_APDUS) {
+			// nobody is expecting the oldest one
+			++c->extra;
+			--c->early_count;
+			memmove(c->early, c->early + 1,
+				c->early_count * sizeof(ApduKind));
+		}
+
+		c->early[c->early_count++] = k;
+	}
+}
+
+/**
+ * Moves connection along the tape as far as timing and expected
+ * manager APDUs allow
+ */
+static void advance(ReplayConn *c, double t)
+{
+	while (c->active && c->pos < tape->count) {
+		ReplayRecord *r = &tape->records[c->pos];
+
+		if (!r->from_agent) {
+			int timed_out = c->waiting && t - c->wait_since > timeout;
+
+			if (match_expected(c, r, timed_out)) {
+				c->waiting = 0;
+				++c->pos;
+				continue;
+			}
+
+			if (timed_out) {
+				++c->timeouts;
+				c->waiting = 0;
+				++c->pos;
+				continue;
+			}
+
+			if (!c->waiting) {
+				c->waiting = 1;
+				c->wait_since = t;
+			}
+
+			return;
+		}
+
+		if (t < c->tape_start + due_offset(r)) {
+			return;
+		}
+
+		const intu8 *data = r->data;
+		ApduKind k = kind_of(r->data, r->size);
+
+		if (k.choice == 0xE700 && (k.data_choice >> 8) >= 0x02
+		    && c->has_invoke_id) {
+			// RORS, ROER, RORJ
+			memcpy(scratch, r->data, r->size);
+			scratch[6] = c->invoke_id[0];
+			scratch[7] = c->invoke_id[1];
+			data = scratch;
+		}
+
+		if (!conn_send(c, data, r->size)) {
+			c->closed_early = 1;
+			conn_disconnect(c);
+			return;
+		}
+
+		++c->sent;
+		c->last_send = t;
+		c->reply_pending = 1;
+		++c->pos;
+	}
+
+	if (c->active && c->pos >= tape->count) {
+		finish_loop(c, t);
+	}
+}
+
+static void manager_available(Context *ctx, DataList *list)
+{
+	++associations;
+}
+
+static void manager_measurement(Context *ctx, DataList *list)
+{
+	++measurements;
+}
+
+static void print_report(double elapsed)
+{
+	LatencyStats all;
+	unsigned long long sent = 0, received = 0, mismatches = 0;
+	unsigned long long timeouts = 0, extra = 0, closed = 0;
+	unsigned int i;
+
+	latency_reset(&all);
+
+	printf("%-6s %8s %8s %8s %8s %8s %10s %10s %10s\n", "conn", "sent",
+	       "recv", "mismatch", "timeout", "extra", "avg(us)", "p99(us)",
+	       "max(us)");
+
+	for (i = 0; i < conn_count; ++i) {
+		ReplayConn *c = &conns[i];
+		LatencyStats *l = &c->latency;
+
+		printf("%-6u %8llu %8llu %8llu %8llu %8llu %10.0f %10.0f %10.0f%s\n",
+		       c->id, c->sent, c->received, c->mismatches, c->timeouts,
+		       c->extra,
+		       l->count ? l->sum / l->count * 1e6 : 0,
+		       latency_percentile(l, 99), l->max * 1e6,
+		       c->closed_early ? " closed" : "");
+
+		latency_merge(&all, l);
+		sent += c->sent;
+		received += c->received;
+		mismatches += c->mismatches;
+		timeouts += c->timeouts;
+		extra += c->extra;
+		closed += c->closed_early;
+	}
+
+	printf("\nConnections: %u, elapsed: %.2fs\n", conn_count, elapsed);
+	printf("APDUs sent: %llu (%.0f/s), received: %llu (%.0f/s)\n",
+	       sent, sent / elapsed, received, received / elapsed);
+	printf("Mismatches: %llu, timeouts: %llu, extra: %llu, "
+	       "closed early: %llu\n", mismatches, timeouts, extra, closed);
+
+	if (!tcp_host) {
+		printf("Manager associations: %llu, measurements: %llu\n",
+		       associations, measurements);
+	}
+
+	latency_print("latency", &all);
+}
+
+static void print_tape()
+{
+	unsigned int i, j;
+
+	if (tape->has_context) {
+		printf("context %u:%llu\n", tape->plugin, tape->connid);
+	}
+
+	for (i = 0; i < tape->count; ++i) {
+		ReplayRecord *r = &tape->records[i];
+
+		printf("%10.6f %s", r->offset, r->from_agent ? "agent  " : "manager");
+
+		if (r->data == NULL) {
+			printf(" (any)");
+		}
+
+		for (j = 0; j < r->size; ++j) {
+			printf(" %02x", r->data[j]);
+		}
+
+		printf("\n");
+	}
+}
+
+static void print_help()
+{
+	printf("Usage: apdu_replay [OPTIONS] CAPTURE...\n\n"
+	       "Replays agent side of APDU captures against a manager.\n"
+	       "Captures are apdu_capture files, APDU_DUMP files or raw APDU\n"
+	       "files (as in tests/resources/apdu); several files are played\n"
+	       "in sequence.\n\n"
+	       "  --tcp HOST:PORT      replay over TCP to a running manager\n"
+	       "  --loopback           replay against an in-process manager\n"
+	       "                       (default)\n"
+	       "  --connections N      simultaneous connections (default 1)\n"
+	       "  --timing MODE        fast, original or scaled (default\n"
+	       "                       original)\n"
+	       "  --scale F            multiply gaps by F (implies scaled)\n"
+	       "  --context P:C        context (plugin:connid) taken from\n"
+	       "                       apdu_capture files (default: first)\n"
+	       "  --print              print tape and exit\n"
+	       "  --interval S         gap between APDUs of captures without\n"
+	       "                       timestamps (default 1)\n"
+	       "  --loops K            plays tape K times per connection\n"
+	       "                       (default 1)\n"
+	       "  --ramp S             seconds to open all connections\n"
+	       "                       (default 0)\n"
+	       "  --timeout S          wait for expected APDUs (default 3)\n"
+	       "  --help               this message\n\n"
+	       "Stack logging goes to stderr; redirect it to /dev/null.\n");
+}
+
+static int parse_args(int argc, char **argv)
+{
+	static struct option options[] = {
+		{"tcp", required_argument, 0, 't'},
+		{"loopback", no_argument, 0, 'l'},
+		{"connections", required_argument, 0, 'c'},
+		{"timing", required_argument, 0, 'm'},
+		{"scale", required_argument, 0, 's'},
+		{"interval", required_argument, 0, 'i'},
+		{"loops", required_argument, 0, 'k'},
+		{"ramp", required_argument, 0, 'r'},
+		{"timeout", required_argument, 0, 'o'},
+		{"context", required_argument, 0, 'x'},
+		{"print", no_argument, 0, 'n'},
+		{"help", no_argument, 0, 'h'},
+		{0, 0, 0, 0}
+	};
+	int c;
+	char *colon;
+
+	while ((c = getopt_long(argc, argv, "", options, NULL)) != -1) {
+		switch (c) {
+		case 't':
+			colon = strrchr(optarg, ':');
+
+			if (colon == NULL) {
+				return 0;
+			}
+
+			*colon = '\0';
+			tcp_host = optarg;
+			tcp_port = colon + 1;
+			break;
+		case 'l':
+			tcp_host = NULL;
+			break;
+		case 'c':
+			conn_count = strtoul(optarg, NULL, 10);
+			break;
+		case 'm':
+			if (strcmp(optarg, "fast") == 0) {
+				timing = TIMING_FAST;
+			} else if (strcmp(optarg, "original") == 0) {
+				timing = TIMING_ORIGINAL;
+			} else if (strcmp(optarg, "scaled") == 0) {
+				timing = TIMING_SCALED;
+			} else {
+				return 0;
+			}
+			break;
+		case 's':
+			scale = atof(optarg);
+			timing = TIMING_SCALED;
+			break;
+		case 'i':
+			interval = atof(optarg);
+			break;
+		case 'k':
+			loops = strtoul(optarg, NULL, 10);
+			break;
+		case 'r':
+			ramp = atof(optarg);
+			break;
+		case 'o':
+			timeout = atof(optarg);
+			break;
+		case 'x':
+			if (sscanf(optarg, "%u:%llu", &context_plugin,
+				   &context_connid) != 2) {
+				return 0;
+			}
+
+			has_context = 1;
+			break;
+		case 'n':
+			print_only = 1;
+			break;
+		case 'h':
+			print_help();
+			exit(0);
+		default:
+			return 0;
+		}
+	}
+
+	if (conn_count < 1 || loops < 1 || scale < 0 || interval < 0
+	    || ramp < 0 || timeout <= 0 || optind >= argc) {
+		return 0;
+	}
+
+	return 1;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int i;
+	int k;
+
+	if (!parse_args(argc, argv)) {
+		fprintf(stderr, "ERROR: invalid options\n");
+		fprintf(stderr, "Try `apdu_replay --help'"
+			" for more information.\n");
+		exit(1);
+	}
+
+	tape = replay_tape_new();
+	tape->has_context = has_context;
+	tape->plugin = context_plugin;
+	tape->connid = context_connid;
+
+	for (k = optind; k < argc; ++k) {
+		if (!replay_tape_load(tape, argv[k], interval)) {
+			exit(1);
+		}
+	}
+
+	if (print_only) {
+		print_tape();
+		exit(0);
+	}
+
+	if (replay_tape_agent_apdus(tape) == 0) {
+		fprintf(stderr, "ERROR: nothing to replay\n");
+		exit(1);
+	}
+
+	conns = calloc(conn_count, sizeof(ReplayConn));
+
+	if (conns == NULL) {
+		fprintf(stderr, "ERROR: cannot allocate %u connections\n",
+			conn_count);
+		exit(1);
+	}
+
+	if (!tcp_host) {
+		manager_plugin = communication_plugin();
+
+		if (plugin_loopback_setup(&manager_plugin, NULL, conn_count, 0)
+		    != NETWORK_ERROR_NONE) {
+			exit(1);
+		}
+
+		CommunicationPlugin *plugins[] = {&manager_plugin, 0};
+		manager_init(plugins);
+
+		ManagerListener listener = MANAGER_LISTENER_EMPTY;
+		listener.device_available = &manager_available;
+		listener.measurement_data_updated = &manager_measurement;
+		manager_add_listener(listener);
+
+		manager_start();
+	}
+
+	double start = latency_now();
+	unsigned int remaining = conn_count;
+	struct pollfd *fds = tcp_host ? calloc(conn_count, sizeof(struct pollfd))
+				      : NULL;
+
+	for (i = 0; i < conn_count; ++i) {
+		conns[i].id = i + 1;
+		conns[i].fd = -1;
+		conns[i].start_at = start + ramp * i / conn_count;
+	}
+
+	while (remaining > 0) {
+		double t = latency_now();
+		int busy = 0;
+
+		remaining = 0;
+
+		for (i = 0; i < conn_count; ++i) {
+			ReplayConn *c = &conns[i];
+
+			if (!c->started && t >= c->start_at) {
+				c->started = 1;
+				c->active = conn_connect(c);
+				c->closed_early = !c->active;
+				c->tape_start = t;
+			}
+
+			if (c->active) {
+				unsigned long long before = c->sent + c->received;
+				handle_incoming(c, t);
+				advance(c, t);
+				busy |= (c->sent + c->received) != before;
+			}
+
+			remaining += c->active || !c->started;
+		}
+
+		if (!tcp_host) {
+			busy |= plugin_loopback_process(MANAGER_CONTEXT) > 0;
+
+			if (!busy) {
+				struct timespec pause = {0, 100000};
+				nanosleep(&pause, NULL);
+			}
+		} else if (!busy) {
+			for (i = 0; i < conn_count; ++i) {
+				fds[i].fd = conns[i].active ? conns[i].fd : -1;
+				fds[i].events = POLLIN;
+			}
+
+			poll(fds, conn_count, 1);
+		}
+	}
+
+	print_report(latency_now() - start);
+
+	if (!tcp_host) {
+		// lets manager see the last disconnections
+		while (plugin_loopback_process(MANAGER_CONTEXT) > 0)
+			;
+
+		manager_finalize();
+	}
+
+	for (i = 0; i < conn_count; ++i) {
+		free(conns[i].rx);
+	}
+
+	free(fds);
+	free(conns);
+	replay_tape_del(tape);
+
+	return 0;
+}
@@ -0,0 +1,142 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+/**
+ * \file latency_stats.c
+ * \brief Latency histogram shared by sdk tools.
+ *
+ * Copyright (C) 2010 Signove Tecnologia Corporation.
+ * All rights reserved.
+ * Contact: Signove Tecnologia Corporation (contact@signove.com)
+ *
+ * $LICENSE_TEXT:BEGIN$
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation and appearing
+ * in the file LICENSE included in the packaging of this file; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ * $LICENSE_TEXT:END$
+ *
+ * \date Oct 18, 2026
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "latency_stats.h"
+
+/**
+ * Monotonic clock in seconds
+ */
+double latency_now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void latency_reset(LatencyStats *s)
+{
+	memset(s, 0, sizeof(LatencyStats));
+}
+
+void latency_add(LatencyStats *s, double seconds)
+{
+	double usec = seconds * 1e6;
+	int b = 0;
+
+	while (b < LATENCY_BUCKETS - 1 && usec >= (double) (2ULL << b)) {
+		++b;
+	}
+
+	if (s->count == 0 || seconds < s->min) {
+		s->min = seconds;
+	}
+
+	if (seconds > s->max) {
+		s->max = seconds;
+	}
+
+	++s->count;
+	s->sum += seconds;
+	++s->bucket[b];
+}
+
+/**
+ * Adds samples of one accumulator to another
+ */
+void latency_merge(LatencyStats *to, LatencyStats *from)
+{
+	int b;
+
+	if (from->count == 0) {
+		return;
+	}
+
+	if (to->count == 0 || from->min < to->min) {
+		to->min = from->min;
+	}
+
+	if (from->max > to->max) {
+		to->max = from->max;
+	}
+
+	to->count += from->count;
+	to->sum += from->sum;
+
+	for (b = 0; b < LATENCY_BUCKETS; ++b) {
+		to->bucket[b] += from->bucket[b];
+	}
+}
+
+/**
+ * Estimates a percentile as the upper bound of its bucket, in usec
+ */
+double latency_percentile(LatencyStats *s, double pct)
+{
+	unsigned long long target = (unsigned long long) (s->count * pct / 100.0);
+	unsigned long long seen = 0;
+	int b;
+
+	if (s->count == 0) {
+		return 0;
+	}
+
+	for (b = 0; b < LATENCY_BUCKETS; ++b) {
+		seen += s->bucket[b];
+
+		if (seen > target) {
+			break;
+		}
+	}
+
+	if (b >= LATENCY_BUCKETS) {
+		b = LATENCY_BUCKETS - 1;
+	}
+
+	if ((double) (2ULL << b) > s->max * 1e6) {
+		return s->max * 1e6;
+	}
+
+	return (double) (2ULL << b);
+}
+
+void latency_print(const char *label, LatencyStats *s)
+{
+	if (s->count == 0) {
+		printf("%-12s no samples\n", label);
+		return;
+	}
+
+	printf("%-12s n=%llu min=%.0fus avg=%.0fus p50<=%.0fus p99<=%.0fus "
+	       "max=%.0fus\n", label, s->count, s->min * 1e6,
+	       s->sum / s->count * 1e6, latency_percentile(s, 50),
+	       latency_percentile(s, 99), s->max * 1e6);
+}
@@ -0,0 +1,62 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+/**
+ * \file latency_stats.h
+ * \brief Latency histogram shared by sdk tools header.
+ *
+ * Copyright (C) 2010 Signove Tecnologia Corporation.
+ * All rights reserved.
+ * Contact: Signove Tecnologia Corporation (contact@signove.com)
+ *
+ * $LICENSE_TEXT:BEGIN$
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation and appearing
+ * in the file LICENSE included in the packaging of this file; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ * $LICENSE_TEXT:END$
+ *
+ * \date Oct 18, 2026
+ */
+
+#ifndef LATENCY_STATS_H_
+#define LATENCY_STATS_H_
+
+/**
+ * Number of histogram buckets; bucket N holds samples
+ * from 2^N to 2^(N+1) microseconds
+ */
+#define LATENCY_BUCKETS 32
+
+/**
+ * Latency accumulator with log2 histogram
+ */
+typedef struct LatencyStats {
+	unsigned long long count;
+	double sum;
+	double min;
+	double max;
+	unsigned long long bucket[LATENCY_BUCKETS];
+} LatencyStats;
+
+double latency_now();
+
+void latency_reset(LatencyStats *s);
+
+void latency_add(LatencyStats *s, double seconds);
+
+void latency_merge(LatencyStats *to, LatencyStats *from);
+
+double latency_percentile(LatencyStats *s, double pct);
+
+void latency_print(const char *label, LatencyStats *s);
+
+#endif /* LATENCY_STATS_H_ */
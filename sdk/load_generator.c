@@ -0,0 +1,631 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+/**
+ * \file load_generator.c
+ * \brief Manager load generator with many simulated agents.
+ *
+ * Copyright (C) 2010 Signove Tecnologia Corporation.
+ * All rights reserved.
+ * Contact: Signove Tecnologia Corporation (contact@signove.com)
+ *
+ * $LICENSE_TEXT:BEGIN$
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation and appearing
+ * in the file LICENSE included in the packaging of this file; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ * $LICENSE_TEXT:END$
+ *
+ * \date Oct 18, 2026
+ */
+
+/*
+ * Runs thousands of agents and one manager in a single process, all of
+ * them connected by the loopback plugin, and reports how fast the
+ * manager associates agents and digests their measurements.
+ *
+ * Each simulated agent has its own context and its own specialization,
+ * picked from a weighted mix. Agents send measurements at a fixed rate
+ * and may release and reconnect after a number of measurements, so
+ * association churn is part of the load.
+ *
+ * The stack logs a lot to stderr; run with 2>/dev/null to measure it.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <getopt.h>
+
+#include <ieee11073.h>
+#include "communication/plugin/plugin_loopback.h"
+#include "communication/communication.h"
+#include "communication/context_manager.h"
+#include "communication/apdu_capture.h"
+#include "specializations/pulse_oximeter.h"
+#include "specializations/blood_pressure_monitor.h"
+#include "specializations/weighing_scale.h"
+#include "specializations/glucometer.h"
+#include "agent.h"
+#include "../apps/sample_agent_common.h"
+#include "latency_stats.h"
+
+/**
+ * Specialization that an agent may simulate
+ */
+typedef struct LoadProfile {
+	const char *name;
+	int config;
+	void *(*event_report_cb)();
+	int weight;
+	unsigned long long measurements;
+} LoadProfile;
+
+static LoadProfile profiles[] = {
+	{"oximeter", 0x0190, oximeter_event_report_cb, 1, 0},
+	{"oximeter-ts", 0x0191, oximeter_event_report_cb, 1, 0},
+	{"bpm", 0x02BC, blood_pressure_event_report_cb, 1, 0},
+	{"scale", 0x05DC, weightscale_event_report_cb, 1, 0},
+	{"glucometer", 0x06A4, glucometer_event_report_cb, 1, 0},
+};
+
+#define PROFILE_COUNT (sizeof(profiles) / sizeof(LoadProfile))
+
+/**
+ * Simulated agent life cycle
+ */
+typedef enum {
+	SIM_IDLE = 0,
+	SIM_ASSOCIATING,
+	SIM_OPERATING,
+	SIM_RELEASING,
+	SIM_DISCONNECTING
+} SimState;
+
+/**
+ * Simulated agent; agent N uses loopback pair N + 1
+ */
+typedef struct SimAgent {
+	LoadProfile *profile;
+	SimState state;
+	double next_event;
+	double connect_time;
+	double send_time;
+	int in_flight;
+	unsigned int session_count;
+} SimAgent;
+
+/**
+ * Counters, reset at each periodic report
+ */
+typedef struct LoadCounters {
+	unsigned long long associations;
+	unsigned long long measurements;
+	unsigned long long releases;
+	unsigned long long late;
+} LoadCounters;
+
+static CommunicationPlugin manager_plugin;
+static CommunicationPlugin agent_plugin;
+
+static SimAgent *agents = NULL;
+static unsigned int agent_count = 100;
+static double rate = 1.0;
+static unsigned int session_size = 0;
+static double duration = 10.0;
+static double ramp = 1.0;
+static double report_interval = 1.0;
+static unsigned int queue_size = 2048;
+static unsigned int seed = 1;
+static char *capture_path = NULL;
+
+static LoadCounters total;
+static LoadCounters interval;
+static LatencyStats assoc_latency;
+static LatencyStats meas_latency;
+static LatencyStats interval_latency;
+
+static unsigned long long system_id_seq = 0;
+
+/**
+ * Generates a distinct system id for each association
+ */
+static struct mds_system_data *load_mds_data_cb()
+{
+	struct mds_system_data *data = malloc(sizeof(struct mds_system_data));
+	unsigned long long id = ++system_id_seq;
+	int i;
+
+	memcpy(data->system_id, AGENT_SYSTEM_ID_VALUE, 8);
+
+	for (i = 7; i >= 4; --i) {
+		data->system_id[i] = id & 0xff;
+		id >>= 8;
+	}
+
+	return data;
+}
+
+static SimAgent *agent_of(Context *ctx)
+{
+	if (ctx->id.connid < 1 || ctx->id.connid > agent_count) {
+		return NULL;
+	}
+
+	return &agents[ctx->id.connid - 1];
+}
+
+static ContextId agent_context_id(SimAgent *a)
+{
+	ContextId id = {communication_plugin_id(&agent_plugin),
+			a - agents + 1};
+	return id;
+}
+
+static void agent_connected(Context *ctx, const char *addr)
+{
+	SimAgent *a = agent_of(ctx);
+
+	if (a == NULL) {
+		return;
+	}
+
+	agent_set_context_configuration(ctx->id, a->profile->config,
+					a->profile->event_report_cb,
+					load_mds_data_cb);
+	a->state = SIM_ASSOCIATING;
+	agent_associate(ctx->id);
+}
+
+static void agent_associated(Context *ctx)
+{
+	SimAgent *a = agent_of(ctx);
+
+	if (a != NULL) {
+		a->state = SIM_OPERATING;
+		a->session_count = 0;
+		a->in_flight = 0;
+		a->next_event = latency_now();
+	}
+}
+
+static void agent_unavailable(Context *ctx)
+{
+	SimAgent *a = agent_of(ctx);
+
+	if (a != NULL && a->state == SIM_OPERATING) {
+		// aborted by manager; wait for unassociated and reconnect
+		a->state = SIM_RELEASING;
+		a->in_flight = 0;
+	}
+}
+
+static void agent_disconnected(Context *ctx, const char *addr)
+{
+	SimAgent *a = agent_of(ctx);
+
+	if (a != NULL) {
+		a->state = SIM_IDLE;
+		a->next_event = latency_now();
+	}
+}
+
+static void manager_available(Context *ctx, DataList *list)
+{
+	SimAgent *a = agent_of(ctx);
+
+	if (a != NULL) {
+		latency_add(&assoc_latency, latency_now() - a->connect_time);
+	}
+
+	++total.associations;
+	++interval.associations;
+}
+
+static void manager_measurement(Context *ctx, DataList *list)
+{
+	SimAgent *a = agent_of(ctx);
+
+	if (a != NULL && a->in_flight) {
+		double latency = latency_now() - a->send_time;
+		latency_add(&meas_latency, latency);
+		latency_add(&interval_latency, latency);
+		a->in_flight = 0;
+		++a->session_count;
+		++a->profile->measurements;
+	}
+
+	++total.measurements;
+	++interval.measurements;
+}
+
+/**
+ * Advances one agent; at most one measurement is in flight per agent,
+ * so a manager that cannot keep up shows as late measurements
+ */
+static void step_agent(SimAgent *a, double t)
+{
+	ContextId id = agent_context_id(a);
+	Context *ctx;
+
+	switch (a->state) {
+	case SIM_IDLE:
+		if (t >= a->next_event) {
+			a->connect_time = t;
+
+			if (plugin_loopback_connect(id.connid) != NETWORK_ERROR_NONE) {
+				// previous link not fully torn down yet
+				a->next_event = t + 0.001;
+			}
+		}
+		break;
+	case SIM_OPERATING:
+		if (t < a->next_event) {
+			break;
+		}
+
+		if (a->in_flight) {
+			++total.late;
+			++interval.late;
+			a->next_event += 1.0 / rate;
+			break;
+		}
+
+		if (session_size && a->session_count >= session_size) {
+			a->state = SIM_RELEASING;
+			++total.releases;
+			++interval.releases;
+			agent_request_association_release(id);
+			break;
+		}
+
+		a->send_time = t;
+		a->in_flight = 1;
+		a->next_event += 1.0 / rate;
+
+		if (a->next_event < t) {
+			a->next_event = t;
+		}
+
+		agent_send_data(id);
+		break;
+	case SIM_RELEASING:
+		ctx = context_get_and_lock(id);
+
+		if (ctx == NULL) {
+			a->state = SIM_IDLE;
+			break;
+		}
+
+		if (communication_get_state(ctx) == fsm_state_unassociated) {
+			a->state = SIM_DISCONNECTING;
+			communication_force_disconnect(ctx);
+		}
+
+		context_unlock(ctx);
+		break;
+	default:
+		break;
+	}
+}
+
+static void print_report(double elapsed, double span)
+{
+	unsigned int i;
+	unsigned int operating = 0;
+
+	for (i = 0; i < agent_count; ++i) {
+		if (agents[i].state == SIM_OPERATING) {
+			++operating;
+		}
+	}
+
+	printf("%7.1fs operating=%u assoc/s=%.0f meas/s=%.0f rel/s=%.0f "
+	       "late=%llu p50<=%.0fus p99<=%.0fus\n", elapsed, operating,
+	       interval.associations / span, interval.measurements / span,
+	       interval.releases / span, interval.late,
+	       latency_percentile(&interval_latency, 50),
+	       latency_percentile(&interval_latency, 99));
+	fflush(stdout);
+
+	memset(&interval, 0, sizeof(LoadCounters));
+	latency_reset(&interval_latency);
+}
+
+static void print_summary(double elapsed)
+{
+	unsigned int i;
+
+	printf("\nAgents: %u, elapsed: %.2fs\n", agent_count, elapsed);
+	printf("Associations: %llu (%.0f/s)\n", total.associations,
+	       total.associations / elapsed);
+	printf("Measurements: %llu (%.0f/s)\n", total.measurements,
+	       total.measurements / elapsed);
+	printf("Releases: %llu, late sends: %llu, dropped APDUs: %llu\n",
+	       total.releases, total.late, plugin_loopback_dropped_apdus());
+
+	for (i = 0; i < PROFILE_COUNT; ++i) {
+		if (profiles[i].weight) {
+			printf("  %-12s 0x%04X measurements=%llu\n", profiles[i].name,
+			       profiles[i].config, profiles[i].measurements);
+		}
+	}
+
+	latency_print("association", &assoc_latency);
+	latency_print("measurement", &meas_latency);
+}
+
+/**
+ * Parses a mix like "oximeter:3,bpm:1"; omitted profiles get weight 0
+ */
+static int parse_mix(char *mix)
+{
+	unsigned int i;
+	char *saveptr = NULL;
+	char *item;
+	int sum = 0;
+
+	for (i = 0; i < PROFILE_COUNT; ++i) {
+		profiles[i].weight = 0;
+	}
+
+	for (item = strtok_r(mix, ",", &saveptr); item;
+	     item = strtok_r(NULL, ",", &saveptr)) {
+		char *colon = strchr(item, ':');
+		int weight = 1;
+
+		if (colon) {
+			*colon = '\0';
+			weight = atoi(colon + 1);
+		}
+
+		for (i = 0; i < PROFILE_COUNT; ++i) {
+			if (strcmp(item, profiles[i].name) == 0) {
+				break;
+			}
+		}
+
+		if (i >= PROFILE_COUNT || weight < 0) {
+			fprintf(stderr, "ERROR: invalid mix entry: %s\n", item);
+			return 0;
+		}
+
+		profiles[i].weight = weight;
+		sum += weight;
+	}
+
+	return sum > 0;
+}
+
+/**
+ * Picks profiles so that the mix is spread evenly over agent numbers
+ */
+static void assign_profiles()
+{
+	unsigned int i, p;
+	int total_weight = 0;
+
+	for (p = 0; p < PROFILE_COUNT; ++p) {
+		total_weight += profiles[p].weight;
+	}
+
+	for (i = 0; i < agent_count; ++i) {
+		int slot = i % total_weight;
+
+		for (p = 0; p < PROFILE_COUNT; ++p) {
+			slot -= profiles[p].weight;
+
+			if (slot < 0) {
+				break;
+			}
+		}
+
+		agents[i].profile = &profiles[p];
+	}
+}
+
+static void print_help()
+{
+	printf("Usage: load_generator [OPTIONS]\n\n"
+	       "Runs many simulated agents against an in-process manager.\n\n"
+	       "  --agents N           number of agents (default 100)\n"
+	       "  --mix LIST           specializations and weights, e.g.\n"
+	       "                       oximeter:2,bpm:1 (default: all, evenly)\n"
+	       "                       names: oximeter (0x0190), oximeter-ts\n"
+	       "                       (0x0191), bpm (0x02BC), scale (0x05DC),\n"
+	       "                       glucometer (0x06A4)\n"
+	       "  --rate R             measurements per second per agent\n"
+	       "                       (default 1)\n"
+	       "  --session M          release and reconnect after M\n"
+	       "                       measurements (default 0, never)\n"
+	       "  --duration S         seconds to run (default 10)\n"
+	       "  --ramp S             seconds to connect all agents (default 1)\n"
+	       "  --report-interval S  seconds between reports (default 1)\n"
+	       "  --queue BYTES        loopback queue size per direction\n"
+	       "                       (default 2048)\n"
+	       "  --seed N             seed of measurement values (default 1)\n"
+	       "  --capture FILE       capture APDUs of all contexts\n"
+	       "  --help               this message\n\n"
+	       "Stack logging goes to stderr; redirect it to /dev/null.\n");
+}
+
+static int parse_args(int argc, char **argv)
+{
+	static struct option options[] = {
+		{"agents", required_argument, 0, 'a'},
+		{"mix", required_argument, 0, 'm'},
+		{"rate", required_argument, 0, 'r'},
+		{"session", required_argument, 0, 's'},
+		{"duration", required_argument, 0, 'd'},
+		{"ramp", required_argument, 0, 'p'},
+		{"report-interval", required_argument, 0, 'i'},
+		{"queue", required_argument, 0, 'q'},
+		{"seed", required_argument, 0, 'e'},
+		{"capture", required_argument, 0, 'c'},
+		{"help", no_argument, 0, 'h'},
+		{0, 0, 0, 0}
+	};
+	int c;
+
+	while ((c = getopt_long(argc, argv, "", options, NULL)) != -1) {
+		switch (c) {
+		case 'a':
+			agent_count = strtoul(optarg, NULL, 10);
+			break;
+		case 'm':
+			if (!parse_mix(optarg)) {
+				return 0;
+			}
+			break;
+		case 'r':
+			rate = atof(optarg);
+			break;
+		case 's':
+			session_size = strtoul(optarg, NULL, 10);
+			break;
+		case 'd':
+			duration = atof(optarg);
+			break;
+		case 'p':
+			ramp = atof(optarg);
+			break;
+		case 'i':
+			report_interval = atof(optarg);
+			break;
+		case 'q':
+			queue_size = strtoul(optarg, NULL, 10);
+			break;
+		case 'e':
+			seed = strtoul(optarg, NULL, 10);
+			break;
+		case 'c':
+			capture_path = optarg;
+			break;
+		case 'h':
+			print_help();
+			exit(0);
+		default:
+			return 0;
+		}
+	}
+
+	if (agent_count < 1 || rate <= 0 || duration <= 0
+	    || report_interval <= 0 || ramp < 0 || optind < argc) {
+		fprintf(stderr, "ERROR: invalid options\n");
+		return 0;
+	}
+
+	return 1;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int i;
+
+	if (!parse_args(argc, argv)) {
+		fprintf(stderr, "Try `load_generator --help'"
+			" for more information.\n");
+		exit(1);
+	}
+
+	srandom(seed);
+
+	agents = calloc(agent_count, sizeof(SimAgent));
+
+	if (agents == NULL) {
+		fprintf(stderr, "ERROR: cannot allocate %u agents\n", agent_count);
+		exit(1);
+	}
+
+	assign_profiles();
+
+	manager_plugin = communication_plugin();
+	agent_plugin = communication_plugin();
+
+	if (plugin_loopback_setup(&manager_plugin, &agent_plugin, agent_count,
+				  queue_size) != NETWORK_ERROR_NONE) {
+		fprintf(stderr, "ERROR: cannot set up %u loopback pairs\n",
+			agent_count);
+		exit(1);
+	}
+
+	CommunicationPlugin *mplugins[] = {&manager_plugin, 0};
+	CommunicationPlugin *aplugins[] = {&agent_plugin, 0};
+
+	manager_init(mplugins);
+	agent_init(aplugins, 0x0190, oximeter_event_report_cb, load_mds_data_cb);
+
+	ManagerListener mlistener = MANAGER_LISTENER_EMPTY;
+	mlistener.device_available = &manager_available;
+	mlistener.measurement_data_updated = &manager_measurement;
+	manager_add_listener(mlistener);
+
+	AgentListener alistener = AGENT_LISTENER_EMPTY;
+	alistener.device_connected = &agent_connected;
+	alistener.device_associated = &agent_associated;
+	alistener.device_unavailable = &agent_unavailable;
+	alistener.device_disconnected = &agent_disconnected;
+	agent_add_listener(alistener);
+
+	// starts the network of both sides; agent_start() would restart it
+	manager_start();
+
+	if (capture_path && !apdu_capture_start(capture_path, 0,
+						APDU_CAPTURE_DEFAULT_FILES)) {
+		fprintf(stderr, "ERROR: cannot capture to %s\n", capture_path);
+		exit(1);
+	}
+
+	double start = latency_now();
+	double last_report = start;
+
+	for (i = 0; i < agent_count; ++i) {
+		agents[i].next_event = start + ramp * i / agent_count;
+	}
+
+	while (1) {
+		double t = latency_now();
+
+		if (t - start >= duration) {
+			break;
+		}
+
+		for (i = 0; i < agent_count; ++i) {
+			step_agent(&agents[i], t);
+		}
+
+		int delivered = plugin_loopback_process(MANAGER_CONTEXT
+							| AGENT_CONTEXT);
+
+		if (t - last_report >= report_interval) {
+			print_report(t - start, t - last_report);
+			last_report = t;
+		}
+
+		if (delivered == 0) {
+			// nothing in flight; avoid spinning until next event
+			struct timespec pause = {0, 100000};
+			nanosleep(&pause, NULL);
+		}
+	}
+
+	while (plugin_loopback_process(MANAGER_CONTEXT | AGENT_CONTEXT) > 0)
+		;
+
+	print_summary(latency_now() - start);
+
+	agent_finalize();
+	manager_finalize();
+	free(agents);
+
+	return 0;
+}
@@ -1,7 +1,8 @@
 #!/usr/bin/env python
 
-# This script takes a dump generated by uncommenting APDU_DUMP in
-# src/communication/communication.c, and replays it against a TCP/IP manager,
+# This script takes a dump generated by the APDU_DUMP switch of older
+# versions of src/communication/communication.c (now replaced by
+# apdu_capture.c, see sdk/apdu_replay), and replays it against a TCP/IP manager,
 # playing the Agent role.
 #
 # It accepts two dump formats, they can even be intermixed in the same
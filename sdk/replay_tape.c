@@ -0,0 +1,428 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+/**
+ * \file replay_tape.c
+ * \brief APDU capture loader for replay.
+ *
+ * Copyright (C) 2010 Signove Tecnologia Corporation.
+ * All rights reserved.
+ * Contact: Signove Tecnologia Corporation (contact@signove.com)
+ *
+ * $LICENSE_TEXT:BEGIN$
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation and appearing
+ * in the file LICENSE included in the packaging of this file; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ * $LICENSE_TEXT:END$
+ *
+ * \date Oct 18, 2026
+ */
+
+/*
+ * Capture files written by apdu_capture.c carry a monotonic timestamp
+ * and context id in each record. Only the records of one context are
+ * loaded: the one chosen by caller or else the first one found. Side
+ * that took the capture (manager or agent) is recorded, so agent APDUs
+ * are told apart either way.
+ *
+ * Older formats are understood too, and may be mixed in one file:
+ *
+ * APDU_DUMP (former communication.c switch): each APDU is prefixed by "send " or
+ * "recv " and followed by a newline; "sendh " and "recvh " prefix a
+ * line of hex digits instead of binary data. Captures are taken on
+ * manager, so "recv" APDUs are the ones to replay.
+ *
+ * Raw: APDUs back to back with no prefix, as in tests/resources/apdu.
+ * All of them are replayed; an APDU that requires an answer (AARQ,
+ * RLRQ, confirmed invoke) is followed by an expectation of any APDU.
+ *
+ * Neither of them records time, so records are spaced by a fixed
+ * interval given by caller.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include "src/util/ioutil.h"
+#include "src/communication/apdu_capture.h"
+#include "replay_tape.h"
+
+/**
+ * Size of APDU header (choice + length)
+ */
+#define APDU_HEADER_SIZE 4
+
+/**
+ * Creates an empty tape
+ *
+ * @return new tape
+ */
+ReplayTape *replay_tape_new()
+{
+	return calloc(1, sizeof(ReplayTape));
+}
+
+/**
+ * Destroys a tape and its records
+ *
+ * @param tape tape
+ */
+void replay_tape_del(ReplayTape *tape)
+{
+	unsigned int i;
+
+	if (tape == NULL) {
+		return;
+	}
+
+	for (i = 0; i < tape->count; ++i) {
+		free(tape->records[i].data);
+	}
+
+	free(tape->records);
+	free(tape);
+}
+
+/**
+ * Appends a record, taking ownership of data
+ */
+static int append(ReplayTape *tape, int from_agent, double offset,
+		  intu8 *data, intu32 size)
+{
+	if (tape->count >= tape->capacity) {
+		unsigned int capacity = tape->capacity ? tape->capacity * 2 : 64;
+		ReplayRecord *records = realloc(tape->records,
+						capacity * sizeof(ReplayRecord));
+
+		if (records == NULL) {
+			free(data);
+			return 0;
+		}
+
+		tape->records = records;
+		tape->capacity = capacity;
+	}
+
+	ReplayRecord *r = &tape->records[tape->count++];
+	r->from_agent = from_agent;
+	r->offset = offset;
+	r->data = data;
+	r->size = size;
+
+	return 1;
+}
+
+/**
+ * Tells whether manager must answer an APDU sent by agent
+ */
+static int awaits_reply(const intu8 *apdu, intu32 size)
+{
+	if (apdu[0] == 0xE2 || apdu[0] == 0xE4) {
+		// AARQ, RLRQ
+		return 1;
+	}
+
+	if (apdu[0] == 0xE7 && size >= 10 && apdu[8] == 0x01) {
+		// confirmed event report, get, set, action
+		return apdu[9] & 0x01;
+	}
+
+	return 0;
+}
+
+/**
+ * Length of an APDU as told by its header
+ */
+static intu32 apdu_length(const intu8 *header)
+{
+	return (header[2] << 8 | header[3]) + APDU_HEADER_SIZE;
+}
+
+static intu8 *copy_of(const intu8 *data, intu32 size)
+{
+	intu8 *copy = malloc(size);
+
+	if (copy) {
+		memcpy(copy, data, size);
+	}
+
+	return copy;
+}
+
+/**
+ * Decodes a line of hex digits, spaces allowed
+ *
+ * @param s text
+ * @param len text length
+ * @param size decoded length (out)
+ * @return decoded data or NULL if malformed
+ */
+static intu8 *decode_hex(const char *s, unsigned long len, intu32 *size)
+{
+	intu8 *data = malloc(len / 2 + 1);
+	unsigned long i;
+	int nibble = -1;
+
+	*size = 0;
+
+	for (i = 0; i < len && data; ++i) {
+		int v;
+
+		if (isspace((unsigned char) s[i])) {
+			continue;
+		} else if (!isxdigit((unsigned char) s[i])) {
+			free(data);
+			return NULL;
+		}
+
+		v = isdigit((unsigned char) s[i]) ? s[i] - '0'
+			: tolower((unsigned char) s[i]) - 'a' + 10;
+
+		if (nibble < 0) {
+			nibble = v;
+		} else {
+			data[(*size)++] = nibble << 4 | v;
+			nibble = -1;
+		}
+	}
+
+	if (nibble >= 0) {
+		fprintf(stderr, "odd number of hex digits\n");
+		free(data);
+		return NULL;
+	}
+
+	return data;
+}
+
+static int parse_dump(ReplayTape *tape, const intu8 *buf,
+		      unsigned long len, double interval, double *offset)
+{
+	unsigned long i = 0;
+
+	while (i + 5 <= len) {
+		int from_agent;
+		int hex = 0;
+		intu8 *data;
+		intu32 size;
+
+		if (memcmp(buf + i, "recv", 4) == 0) {
+			from_agent = 1;
+		} else if (memcmp(buf + i, "send", 4) == 0) {
+			from_agent = 0;
+		} else {
+			fprintf(stderr, "bad record header at %lu\n", i);
+			return 0;
+		}
+
+		if (buf[i + 4] == 'h') {
+			hex = 1;
+		} else if (buf[i + 4] != ' ') {
+			fprintf(stderr, "bad record header at %lu\n", i);
+			return 0;
+		}
+
+		i += 5;
+
+		if (hex) {
+			unsigned long j = i;
+
+			while (j < len && buf[j] != '\n') {
+				++j;
+			}
+
+			data = decode_hex((const char *) buf + i, j - i, &size);
+			i = j + 1;
+
+			if (data == NULL || size < APDU_HEADER_SIZE
+			    || apdu_length(data) > size) {
+				fprintf(stderr, "bad hex APDU before %lu\n", i);
+				free(data);
+				return 0;
+			}
+
+			size = apdu_length(data);
+		} else {
+			if (i + APDU_HEADER_SIZE > len
+			    || i + apdu_length(buf + i) > len) {
+				fprintf(stderr, "truncated APDU at %lu\n", i);
+				return 0;
+			}
+
+			size = apdu_length(buf + i);
+			data = copy_of(buf + i, size);
+			i += size + 1; // skips \n
+		}
+
+		if (from_agent) {
+			*offset += interval;
+		}
+
+		if (!append(tape, from_agent, *offset, data, size)) {
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+static int parse_raw(ReplayTape *tape, const intu8 *buf,
+		     unsigned long len, double interval, double *offset)
+{
+	unsigned long i = 0;
+
+	while (i + APDU_HEADER_SIZE <= len) {
+		intu32 size = apdu_length(buf + i);
+
+		if (i + size > len) {
+			fprintf(stderr, "truncated APDU at %lu\n", i);
+			return 0;
+		}
+
+		*offset += interval;
+
+		if (!append(tape, 1, *offset, copy_of(buf + i, size), size)) {
+			return 0;
+		}
+
+		if (awaits_reply(buf + i, size)
+		    && !append(tape, 0, *offset, NULL, 0)) {
+			return 0;
+		}
+
+		i += size;
+	}
+
+	return 1;
+}
+
+static unsigned long long get_be(const intu8 *p, int bytes)
+{
+	unsigned long long v = 0;
+
+	while (bytes-- > 0) {
+		v = v << 8 | *p++;
+	}
+
+	return v;
+}
+
+static int parse_capture(ReplayTape *tape, const intu8 *buf,
+			 unsigned long len, double *offset)
+{
+	unsigned long i = APDU_CAPTURE_FILE_HEADER_SIZE;
+	unsigned long long first = 0;
+	double base = *offset;
+	int seen = 0;
+
+	while (i + APDU_CAPTURE_RECORD_HEADER_SIZE <= len) {
+		const intu8 *h = buf + i;
+		unsigned long long timestamp = get_be(h, 8);
+		unsigned long long connid = get_be(h + 8, 8);
+		unsigned int plugin = get_be(h + 16, 4);
+		intu32 size = get_be(h + 20, 4);
+		int sent = h[24] & APDU_CAPTURE_SENT;
+		int manager = h[24] & APDU_CAPTURE_MANAGER;
+
+		i += APDU_CAPTURE_RECORD_HEADER_SIZE;
+
+		if (i + size > len || size < APDU_HEADER_SIZE) {
+			fprintf(stderr, "truncated record at %lu\n", i);
+			return 0;
+		}
+
+		if (!tape->has_context) {
+			tape->has_context = 1;
+			tape->plugin = plugin;
+			tape->connid = connid;
+		}
+
+		if (plugin == tape->plugin && connid == tape->connid) {
+			if (!seen) {
+				seen = 1;
+				first = timestamp;
+			}
+
+			*offset = base + (timestamp - first) / 1e9;
+
+			if (!append(tape, manager ? !sent : sent, *offset,
+				    copy_of(buf + i, size), size)) {
+				return 0;
+			}
+		}
+
+		i += size;
+	}
+
+	return 1;
+}
+
+/**
+ * Appends the APDUs of a capture file to tape
+ *
+ * @param tape tape
+ * @param path capture file, APDU_DUMP or raw format
+ * @param interval seconds between APDUs sent by agent, for formats
+ *        without timestamps
+ * @return 1 if loaded, 0 if file is unreadable or malformed
+ */
+int replay_tape_load(ReplayTape *tape, const char *path, double interval)
+{
+	unsigned long len = 0;
+	intu8 *buf = ioutil_buffer_from_file(path, &len);
+	double offset = 0;
+	int ok;
+
+	if (buf == NULL) {
+		return 0;
+	}
+
+	if (tape->count > 0) {
+		offset = tape->records[tape->count - 1].offset;
+	}
+
+	if (len >= APDU_CAPTURE_FILE_HEADER_SIZE
+	    && memcmp(buf, APDU_CAPTURE_MAGIC, 8) == 0) {
+		ok = parse_capture(tape, buf, len, &offset);
+	} else if (len >= 5 && (memcmp(buf, "recv", 4) == 0
+			 || memcmp(buf, "send", 4) == 0)) {
+		ok = parse_dump(tape, buf, len, interval, &offset);
+	} else {
+		ok = parse_raw(tape, buf, len, interval, &offset);
+	}
+
+	if (!ok) {
+		fprintf(stderr, "cannot parse %s\n", path);
+	}
+
+	free(buf);
+
+	return ok;
+}
+
+/**
+ * Counts APDUs to be sent
+ *
+ * @param tape tape
+ * @return number of agent APDUs
+ */
+unsigned int replay_tape_agent_apdus(ReplayTape *tape)
+{
+	unsigned int i, n = 0;
+
+	for (i = 0; i < tape->count; ++i) {
+		n += tape->records[i].from_agent;
+	}
+
+	return n;
+}
@@ -0,0 +1,87 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+/**
+ * \file replay_tape.h
+ * \brief APDU capture loader for replay header.
+ *
+ * Copyright (C) 2010 Signove Tecnologia Corporation.
+ * All rights reserved.
+ * Contact: Signove Tecnologia Corporation (contact@signove.com)
+ *
+ * $LICENSE_TEXT:BEGIN$
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation and appearing
+ * in the file LICENSE included in the packaging of this file; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ * $LICENSE_TEXT:END$
+ *
+ * \date Oct 18, 2026
+ */
+
+#ifndef REPLAY_TAPE_H_
+#define REPLAY_TAPE_H_
+
+#include <asn1/phd_types.h>
+
+/**
+ * One captured APDU
+ */
+typedef struct ReplayRecord {
+	/**
+	 * 1 if APDU was sent by agent (to be replayed), 0 if it was sent
+	 * by manager (to be expected)
+	 */
+	int from_agent;
+
+	/**
+	 * Seconds since beginning of capture
+	 */
+	double offset;
+
+	/**
+	 * Encoded APDU, header included; NULL in an expected record
+	 * means that any APDU is accepted
+	 */
+	intu8 *data;
+
+	/**
+	 * APDU length
+	 */
+	intu32 size;
+} ReplayRecord;
+
+/**
+ * Sequence of captured APDUs of one connection
+ */
+typedef struct ReplayTape {
+	ReplayRecord *records;
+	unsigned int count;
+	unsigned int capacity;
+
+	/**
+	 * Context whose records are taken from capture files; set by
+	 * caller or else by first record loaded
+	 */
+	int has_context;
+	unsigned int plugin;
+	unsigned long long connid;
+} ReplayTape;
+
+ReplayTape *replay_tape_new();
+
+void replay_tape_del(ReplayTape *tape);
+
+int replay_tape_load(ReplayTape *tape, const char *path, double interval);
+
+unsigned int replay_tape_agent_apdus(ReplayTape *tape);
+
+#endif /* REPLAY_TAPE_H_ */
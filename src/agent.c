@@ -51,12 +51,15 @@
 #include "src/communication/plugin/plugin.h"
 #include "src/communication/communication.h"
 #include "src/communication/configuring.h"
+#include "src/communication/agent_batch.h"
+#include "src/communication/stats.h"
 #include "src/communication/stdconfigurations.h"
 #include "src/specializations/blood_pressure_monitor.h"
 #include "src/specializations/pulse_oximeter.h"
 #include "src/specializations/weighing_scale.h"
 #include "src/specializations/glucometer.h"
 #include "src/dim/mds.h"
+#include "src/dim/mds_template.h"
 #include "src/util/log.h"
 
 
@@ -75,8 +78,35 @@ static int agent_listener_count = 0;
  */
 static AgentConfiguration configuration;
 
-AgentConfiguration *agent_configuration()
+/**
+ * Queued readings are flushed when their scan report reaches
+ * this size, in bytes
+ */
+#define AGENT_BATCH_MAX_SIZE 4096
+
+/**
+ * Readings queued before a batch is flushed, 0 if not batching
+ */
+static int batch_max_readings = 0;
+
+/**
+ * Time, in milliseconds, readings may wait in queue
+ */
+static int batch_window = 0;
+
+/**
+ * Returns the agent configuration in effect for a context
+ *
+ * @param ctx the context, may be NULL
+ * @return configuration set by agent_set_context_configuration()
+ * or the default one given to agent_init()
+ */
+AgentConfiguration *agent_configuration(Context *ctx)
 {
+	if (ctx != NULL && ctx->agent_configuration != NULL) {
+		return ctx->agent_configuration;
+	}
+
 	return &configuration;
 }
 
@@ -144,9 +174,15 @@ void agent_init(CommunicationPlugin **plugins, int config,
 
 	// Listen to all communication state transitions
 	communication_add_state_transition_listener(fsm_state_size, &agent_handle_transition_evt);
-	communication_set_connection_listeners(&agent_notify_evt_device_connected,
+	communication_set_connection_listeners(AGENT_CONTEXT,
+						&agent_notify_evt_device_connected,
 						&agent_notify_evt_device_disconnected);
 
+	// Standard configurations are shared with manager, if any
+	if (communication_role_ref() > 1) {
+		return;
+	}
+
 	// Register standard configurations for each specialization.
 	std_configurations_register_conf(
 		blood_pressure_monitor_create_std_config_ID02BC());
@@ -171,6 +207,14 @@ void agent_finalize()
 	DEBUG("Agent Finalization");
 
 	agent_remove_all_listeners();
+	communication_set_connection_listeners(AGENT_CONTEXT, NULL, NULL);
+
+	// shared state is torn down by the last role
+	if (communication_role_unref() > 0) {
+		return;
+	}
+
+	mds_template_clear();
 	std_configurations_destroy();
 	communication_finalize();
 }
@@ -440,6 +484,11 @@ void agent_request_association_abort(ContextId id)
  */
 void agent_handle_transition_evt(Context *ctx, fsm_states previous, fsm_states next)
 {
+	if (!(ctx->type & AGENT_CONTEXT)) {
+		// manager running in the same process
+		return;
+	}
+
 	DEBUG("agent: handling transition event");
 
 	if (previous == fsm_state_operating && next != previous) {
@@ -458,6 +507,46 @@ void agent_handle_transition_evt(Context *ctx, fsm_states previous, fsm_states n
 	}
 }
 
+/**
+ * Overrides, for one connection, the configuration given to agent_init().
+ * Lets a single process act as many agents of different specializations.
+ * Must be called before association, normally from device_connected
+ * listener, since a new context is created for each connection.
+ *
+ * @param id context Id
+ * @param config Configuration ID of the agent
+ * @param event_report_cb The event report callback
+ * @param mds_data_cb Data callback
+ * @return 1 if operation succeeds, 0 if not.
+ */
+int agent_set_context_configuration(ContextId id, int config,
+				    void *(*event_report_cb)(),
+				    struct mds_system_data *(*mds_data_cb)())
+{
+	Context *ctx = context_get_and_lock(id);
+
+	if (!ctx) {
+		return 0;
+	}
+
+	if (ctx->agent_configuration == NULL) {
+		ctx->agent_configuration = calloc(1, sizeof(AgentConfiguration));
+	}
+
+	if (ctx->agent_configuration == NULL) {
+		context_unlock(ctx);
+		return 0;
+	}
+
+	ctx->agent_configuration->config = config;
+	ctx->agent_configuration->event_report_cb = event_report_cb;
+	ctx->agent_configuration->mds_data_cb = mds_data_cb;
+
+	context_unlock(ctx);
+
+	return 1;
+}
+
 /**
  * Provoke agent to initiate association
  *
@@ -505,4 +594,195 @@ void agent_send_data(ContextId id)
 	}
 }
 
+/**
+ * Sets how readings queued by agent_queue_data() are batched. A batch
+ * is sent as a single event report when it holds max_readings
+ * readings, when its report reaches 4 KB, or when its first reading
+ * is window milliseconds old. The window is checked when readings
+ * are queued and by agent_poll_data().
+ *
+ * @param max_readings readings in a batch, 0 or 1 to send each one
+ * at once
+ * @param window time readings may wait in queue, in milliseconds
+ */
+void agent_set_batching(int max_readings, int window)
+{
+	batch_max_readings = max_readings;
+	batch_window = window;
+}
+
+/**
+ * Sends queued readings of a context, if it is operating
+ *
+ * @param ctx context, locked
+ * @return 1 if readings were sent, 0 otherwise
+ */
+static int agent_flush_batch(Context *ctx)
+{
+	FSMEventData data;
+
+	if (agent_batch_count(ctx) == 0
+	    || communication_get_state(ctx) != fsm_state_operating) {
+		return 0;
+	}
+
+	data.choice = FSM_EVT_DATA_EVENT_REPORT;
+	data.u.event_report = agent_batch_report(ctx);
+	communication_fire_evt(ctx, fsm_evt_req_send_event, &data);
+
+	return 1;
+}
+
+/**
+ * Gets time, in milliseconds, until queued readings of a context
+ * must be sent
+ *
+ * @param ctx context, locked
+ * @return remaining time, 0 if due, -1 if nothing is queued
+ */
+static int agent_batch_due(Context *ctx)
+{
+	unsigned long long first_at = agent_batch_first_at(ctx);
+	long long age;
+
+	if (agent_batch_count(ctx) == 0) {
+		return -1;
+	}
+
+	age = (stats_time() - first_at) / 1000;
+
+	return age >= batch_window ? 0 : batch_window - age;
+}
+
+/**
+ * Queues a reading, taken from the event report callback. Readings
+ * are refused while the context is not operating, so the queue cannot
+ * grow without bound.
+ *
+ * @param id context id
+ * @param person_id person id, or AGENT_BATCH_NO_PERSON
+ * @return 1 if reading was queued, 0 otherwise
+ */
+static int agent_queue_reading(ContextId id, int person_id)
+{
+	Context *ctx = context_get_and_lock(id);
+
+	if (!ctx) {
+		return 0;
+	}
+
+	if (communication_get_state(ctx) != fsm_state_operating) {
+		DEBUG("Context not operating, reading dropped");
+		context_unlock(ctx);
+		return 0;
+	}
+
+	ConfigId spec = agent_configuration(ctx)->config;
+	struct StdConfiguration *cfg =
+		std_configurations_get_supported_standard(spec);
+
+	if (!cfg) {
+		DEBUG("No std configuration for %d, bailing out", spec);
+		context_unlock(ctx);
+		return 0;
+	}
+
+	int person_mode = person_id != AGENT_BATCH_NO_PERSON;
+
+	// a batch goes in a single report, of one person mode
+	if (agent_batch_person_mode(ctx) == !person_mode
+	    && !agent_flush_batch(ctx)) {
+		DEBUG("Batch not sent, reading dropped");
+		context_unlock(ctx);
+		return 0;
+	}
+
+	void *evtreport = agent_configuration(ctx)->event_report_cb();
+	agent_batch_add(ctx, cfg, evtreport, person_id);
+	free(evtreport);
+
+	if (agent_batch_count(ctx) >= batch_max_readings
+	    || agent_batch_size(ctx) >= AGENT_BATCH_MAX_SIZE
+	    || agent_batch_due(ctx) == 0) {
+		agent_flush_batch(ctx);
+	}
+
+	context_unlock(ctx);
+
+	return 1;
+}
+
+/**
+ * Queues a reading to be sent in a batch (see agent_set_batching()).
+ * Readings of a batch go in a single fixed scan report.
+ *
+ * @param id context id
+ * @return 1 if reading was queued, 0 if context is not operating
+ */
+int agent_queue_data(ContextId id)
+{
+	return agent_queue_reading(id, AGENT_BATCH_NO_PERSON);
+}
+
+/**
+ * Queues a reading of a person to be sent in a batch (see
+ * agent_set_batching()). Readings of a batch go in a single
+ * multiple-person fixed scan report.
+ *
+ * @param id context id
+ * @param person_id person id
+ * @return 1 if reading was queued, 0 if context is not operating
+ */
+int agent_queue_person_data(ContextId id, intu16 person_id)
+{
+	return agent_queue_reading(id, person_id);
+}
+
+/**
+ * Sends readings queued by a context now
+ *
+ * @param id context id
+ * @return 1 if readings were sent, 0 if nothing was queued or
+ * context is not operating
+ */
+int agent_flush_data(ContextId id)
+{
+	Context *ctx = context_get_and_lock(id);
+	int ret = 0;
+
+	if (ctx) {
+		ret = agent_flush_batch(ctx);
+		context_unlock(ctx);
+	}
+
+	return ret;
+}
+
+/**
+ * Sends readings queued by a context if their window has elapsed.
+ * Applications that batch readings should call this from their main
+ * loop, in the time returned at most.
+ *
+ * @param id context id
+ * @return time until queued readings are due, in milliseconds, or
+ * -1 if nothing is queued
+ */
+int agent_poll_data(ContextId id)
+{
+	Context *ctx = context_get_and_lock(id);
+	int ret = -1;
+
+	if (ctx) {
+		ret = agent_batch_due(ctx);
+
+		if (ret == 0 && agent_flush_batch(ctx)) {
+			ret = -1;
+		}
+
+		context_unlock(ctx);
+	}
+
+	return ret;
+}
+
 /** @} */
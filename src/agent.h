@@ -95,4 +95,18 @@ void agent_disconnect(ContextId id);
 
 void agent_send_data(ContextId id);
 
+void agent_set_batching(int max_readings, int window);
+
+int agent_queue_data(ContextId id);
+
+int agent_queue_person_data(ContextId id, intu16 person_id);
+
+int agent_flush_data(ContextId id);
+
+int agent_poll_data(ContextId id);
+
+int agent_set_context_configuration(ContextId id, int config,
+				    void *(*event_report_cb)(),
+				    struct mds_system_data *(*mds_data_cb)());
+
 #endif /* AGENT_H_ */
@@ -78,6 +78,6 @@ typedef struct AgentConfiguration {
 	struct mds_system_data *(*mds_data_cb)();
 } AgentConfiguration;
 
-AgentConfiguration *agent_configuration();
+AgentConfiguration *agent_configuration(Context *ctx);
 
 #endif /* AGENT_P_H_ */
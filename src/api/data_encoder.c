@@ -1224,6 +1224,94 @@ void data_entry_del(DataEntry *pointer)
 	}
 }
 
+/**
+ * Copies a string that may be NULL.
+ *
+ * @param str the string to be copied.
+ * @return a new copy of \b str, or NULL.
+ */
+static char *data_strcp_null(const char *str)
+{
+	return str ? data_strcp(str) : NULL;
+}
+
+/**
+ * Deep copies a data entry, including meta data and child entries.
+ *
+ * @param dest the entry to be filled, previous contents are not deleted.
+ * @param src the entry to be copied.
+ */
+void data_entry_clone(DataEntry *dest, const DataEntry *src)
+{
+	int i;
+
+	memset(dest, 0, sizeof(DataEntry));
+
+	if (src == NULL)
+		return;
+
+	dest->choice = src->choice;
+
+	if (src->meta_data.size > 0 && src->meta_data.values != NULL) {
+		dest->meta_data.values = calloc(src->meta_data.size,
+						sizeof(MetaAtt));
+		dest->meta_data.size = src->meta_data.size;
+
+		for (i = 0; i < src->meta_data.size; i++) {
+			MetaAtt *meta = &src->meta_data.values[i];
+			dest->meta_data.values[i].name = data_strcp_null(meta->name);
+			dest->meta_data.values[i].value = data_strcp_null(meta->value);
+		}
+	}
+
+	if (src->choice == SIMPLE_DATA_ENTRY) {
+		dest->u.simple.name = data_strcp_null(src->u.simple.name);
+		// type points to one of the APIDEF_TYPE_* constants
+		dest->u.simple.type = src->u.simple.type;
+		dest->u.simple.value = data_strcp_null(src->u.simple.value);
+	} else if (src->choice == COMPOUND_DATA_ENTRY) {
+		const CompoundDataEntry *compound = &src->u.compound;
+
+		dest->u.compound.name = data_strcp_null(compound->name);
+
+		// empty entries array is kept, encoders tell it from NULL
+		if (compound->entries != NULL) {
+			dest->u.compound.entries = calloc(compound->entries_count,
+							  sizeof(DataEntry));
+			dest->u.compound.entries_count = compound->entries_count;
+
+			for (i = 0; i < compound->entries_count; i++) {
+				data_entry_clone(&dest->u.compound.entries[i],
+						 &compound->entries[i]);
+			}
+		}
+	}
+}
+
+/**
+ * Deep copies a list of elements.
+ *
+ * @param src the list to be copied.
+ * @return a new list, to be deleted with data_list_del(); NULL if
+ * \b src is NULL.
+ */
+DataList *data_list_clone(const DataList *src)
+{
+	DataList *list;
+	int i;
+
+	if (src == NULL)
+		return NULL;
+
+	list = data_list_new(src->size);
+
+	for (i = 0; i < src->size; i++) {
+		data_entry_clone(&list->values[i], &src->values[i]);
+	}
+
+	return list;
+}
+
 /**
  * Creates a new empty list of elements with a given size.
  *
@@ -35,5 +35,7 @@
 void data_entry_del(DataEntry *pointer);
 DataList *data_list_new(int size);
 void data_list_del(DataList *pointer);
+void data_entry_clone(DataEntry *dest, const DataEntry *src);
+DataList *data_list_clone(const DataList *src);
 
 #endif /* DATA_LIST_H_ */
@@ -6,6 +6,7 @@ LOCAL_CFLAGS:= -Wall
 LOCAL_C_INCLUDES := $(LOCAL_PATH) $(LOCAL_PATH)/.. $(LOCAL_PATH)/../..
 
 LOCAL_SRC_FILES = \
+		   apdu_capture.c \
 		   association.c \
                    communication.c \
                    configuring.c \
@@ -13,10 +14,15 @@ LOCAL_SRC_FILES = \
 		   agent_ops.c \
                    extconfigurations.c \
                    fsm.c \
+                   handoff.c \
                    service.c \
                    operating.c \
+                   stats.c \
                    stdconfigurations.c \
-                   context_manager.c
+                   context_manager.c \
+                   event_template.c \
+                   agent_batch.c \
+                   manager_batch.c
 
 LOCAL_MODULE:= libantidotecomm
 LOCAL_MODULE_TAGS := debug eng
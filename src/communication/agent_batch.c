@@ -0,0 +1,438 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+/**
+ * \file agent_batch.c
+ * \brief Agent readings batched into a single scan report.
+ *
+ *
+ * Copyright (C) 2010 Signove Tecnologia Corporation.
+ * All rights reserved.
+ * Contact: Signove Tecnologia Corporation (contact@signove.com)
+ *
+ * $LICENSE_TEXT:BEGIN$
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation and appearing
+ * in the file LICENSE included in the packaging of this file; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ * $LICENSE_TEXT:END$
+ *
+ * \date Oct 18, 2026
+ */
+
+/**
+ * \addtogroup Communication
+ *
+ * An agent that bridges many sensors, or takes readings often, may
+ * queue them instead of sending one event report each. Observations
+ * of queued readings are taken from the report built by the
+ * specialization, and sent together as a single scan report: a fixed
+ * scan report with many observations, or a multiple-person fixed
+ * scan report when readings are tagged with a person id.
+ *
+ * This module only keeps the queue of a context; the policy of when
+ * a batch is flushed belongs to the agent (see agent_queue_data()).
+ *
+ * @{
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "src/communication/agent_batch.h"
+#include "src/communication/parser/encoder_ASN1.h"
+#include "src/communication/parser/decoder_ASN1.h"
+#include "src/communication/parser/struct_cleaner.h"
+#include "src/communication/stats.h"
+#include "src/dim/nomenclature.h"
+#include "src/util/log.h"
+
+/**
+ * Queued observation
+ */
+typedef struct AgentBatchEntry {
+	/**
+	 * Person id, or AGENT_BATCH_NO_PERSON
+	 */
+	int person_id;
+	/**
+	 * Observation, value owned by the batch
+	 */
+	ObservationScanFixed obs;
+} AgentBatchEntry;
+
+/**
+ * Readings queued by a context
+ */
+struct AgentBatch {
+	/**
+	 * Queued observations
+	 */
+	AgentBatchEntry *entries;
+	/**
+	 * Number of queued observations
+	 */
+	int count;
+	/**
+	 * Allocated entries
+	 */
+	int capacity;
+	/**
+	 * Number of queued readings
+	 */
+	int readings;
+	/**
+	 * Encoded size of queued observations
+	 */
+	int size;
+	/**
+	 * 1 if readings carry person id
+	 */
+	int person_mode;
+	/**
+	 * 1 if specialization sends confirmed event reports
+	 */
+	int confirmed;
+	/**
+	 * Scan report number of next report
+	 */
+	intu16 scan_report_no;
+	/**
+	 * When the first queued reading was taken (microseconds)
+	 */
+	unsigned long long first_at;
+};
+
+/**
+ * Gets the batch of context, creating it if needed
+ */
+static struct AgentBatch *batch_get(Context *ctx)
+{
+	if (ctx->agent_batch == NULL) {
+		ctx->agent_batch = calloc(1, sizeof(struct AgentBatch));
+	}
+
+	return ctx->agent_batch;
+}
+
+/**
+ * Appends an observation, taking ownership of its value
+ */
+static void batch_append(struct AgentBatch *batch, int person_id,
+			 ObservationScanFixed *obs)
+{
+	if (batch->count >= batch->capacity) {
+		batch->capacity = batch->capacity ? batch->capacity * 2 : 8;
+		batch->entries = realloc(batch->entries,
+					 batch->capacity * sizeof(AgentBatchEntry));
+	}
+
+	batch->entries[batch->count].person_id = person_id;
+	batch->entries[batch->count].obs = *obs;
+	batch->size += 4 + obs->obs_val_data.length;
+	++batch->count;
+}
+
+/**
+ * Queues the observations of a reading. The reading must produce a
+ * fixed scan report, and must be tagged with a person id if and
+ * only if readings already queued are.
+ *
+ * @param ctx context
+ * @param cfg standard configuration of agent
+ * @param evtdata event report data given by application, still
+ * owned by caller
+ * @param person_id person id, or AGENT_BATCH_NO_PERSON
+ * @return 1 if reading was queued, 0 otherwise
+ */
+int agent_batch_add(Context *ctx, struct StdConfiguration *cfg,
+		    void *evtdata, int person_id)
+{
+	struct AgentBatch *batch = batch_get(ctx);
+	int person_mode = person_id != AGENT_BATCH_NO_PERSON;
+	ScanReportInfoFixed info;
+	EventReportArgumentSimple *evt;
+	DATA_apdu *data;
+	int error = 0;
+	int i;
+
+	if (batch->readings > 0 && batch->person_mode != person_mode) {
+		ERROR("Readings with and without person id in one batch");
+		return 0;
+	}
+
+	data = cfg->event_report(evtdata);
+	evt = &data->message.u.roiv_cmipEventReport;
+
+	if (evt->event_type != MDC_NOTI_SCAN_REPORT_FIXED) {
+		ERROR("Only fixed scan reports can be batched");
+		del_data_apdu(data);
+		free(data);
+		return 0;
+	}
+
+	ByteStreamReader *stream = byte_stream_reader_instance(
+					   evt->event_info.value,
+					   evt->event_info.length);
+	memset(&info, 0, sizeof(info));
+	decode_scanreportinfofixed(stream, &info, &error);
+	free(stream);
+
+	if (!error) {
+		if (batch->readings == 0) {
+			batch->first_at = stats_time();
+			batch->person_mode = person_mode;
+			batch->confirmed = data->message.choice ==
+					   ROIV_CMIP_CONFIRMED_EVENT_REPORT_CHOSEN;
+		}
+
+		for (i = 0; i < info.obs_scan_fixed.count; ++i) {
+			batch_append(batch, person_id,
+				     &info.obs_scan_fixed.value[i]);
+			// value is owned by batch now
+			info.obs_scan_fixed.value[i].obs_val_data.value = NULL;
+		}
+
+		++batch->readings;
+	}
+
+	del_scanreportinfofixed(&info);
+	del_data_apdu(data);
+	free(data);
+
+	return !error;
+}
+
+/**
+ * Returns the number of readings queued by context
+ *
+ * @param ctx context
+ * @return number of readings
+ */
+int agent_batch_count(Context *ctx)
+{
+	return ctx->agent_batch ? ctx->agent_batch->readings : 0;
+}
+
+/**
+ * Returns the encoded size of the scan report of queued readings
+ *
+ * @param ctx context
+ * @return size in bytes, 0 if nothing is queued
+ */
+int agent_batch_size(Context *ctx)
+{
+	struct AgentBatch *batch = ctx->agent_batch;
+
+	if (batch == NULL || batch->readings == 0) {
+		return 0;
+	}
+
+	// data req id, scan report no, list count and length, plus
+	// person id, list count and length of each observation at most
+	return 8 + batch->size + (batch->person_mode ? 6 * batch->count : 0);
+}
+
+/**
+ * Tells whether queued readings carry person id
+ *
+ * @param ctx context
+ * @return 1 if they do, 0 if they do not, -1 if nothing is queued
+ */
+int agent_batch_person_mode(Context *ctx)
+{
+	if (agent_batch_count(ctx) == 0) {
+		return -1;
+	}
+
+	return ctx->agent_batch->person_mode;
+}
+
+/**
+ * Returns when the oldest queued reading was taken
+ *
+ * @param ctx context
+ * @return time in microseconds (see stats_time()), 0 if nothing is queued
+ */
+unsigned long long agent_batch_first_at(Context *ctx)
+{
+	return agent_batch_count(ctx) ? ctx->agent_batch->first_at : 0;
+}
+
+/**
+ * Encodes queued observations as event information
+ */
+static int batch_encode_fixed(struct AgentBatch *batch,
+			      ByteStreamWriter *stream)
+{
+	ScanReportInfoFixed info;
+	int ret;
+	int i;
+
+	info.data_req_id = 0xF000;
+	info.scan_report_no = batch->scan_report_no;
+	info.obs_scan_fixed.count = batch->count;
+	info.obs_scan_fixed.length = batch->size;
+	info.obs_scan_fixed.value = calloc(batch->count,
+					   sizeof(ObservationScanFixed));
+
+	for (i = 0; i < batch->count; ++i) {
+		info.obs_scan_fixed.value[i] = batch->entries[i].obs;
+	}
+
+	ret = encode_scanreportinfofixed(stream, &info);
+	free(info.obs_scan_fixed.value);
+
+	return ret;
+}
+
+/**
+ * Encodes queued observations, grouped by person, as event information
+ */
+static int batch_encode_mp_fixed(struct AgentBatch *batch,
+				 ByteStreamWriter *stream)
+{
+	ScanReportInfoMPFixed info;
+	ScanReportPerFixed *person;
+	int *done = calloc(batch->count, sizeof(int));
+	int ret;
+	int i;
+	int j;
+
+	info.data_req_id = 0xF000;
+	info.scan_report_no = batch->scan_report_no;
+	info.scan_per_fixed.count = 0;
+	info.scan_per_fixed.length = 0;
+	info.scan_per_fixed.value = calloc(batch->count,
+					   sizeof(ScanReportPerFixed));
+
+	for (i = 0; i < batch->count; ++i) {
+		if (done[i]) {
+			continue;
+		}
+
+		person = &info.scan_per_fixed.value[info.scan_per_fixed.count++];
+		person->person_id = batch->entries[i].person_id;
+		person->obs_scan_fix.count = 0;
+		person->obs_scan_fix.length = 0;
+		person->obs_scan_fix.value = calloc(batch->count - i,
+						    sizeof(ObservationScanFixed));
+
+		for (j = i; j < batch->count; ++j) {
+			if (!done[j] && batch->entries[j].person_id
+			    == batch->entries[i].person_id) {
+				ObservationScanFixed *obs = &batch->entries[j].obs;
+				person->obs_scan_fix.value[person->obs_scan_fix.count++] = *obs;
+				person->obs_scan_fix.length += 4 + obs->obs_val_data.length;
+				done[j] = 1;
+			}
+		}
+
+		info.scan_per_fixed.length += 6 + person->obs_scan_fix.length;
+	}
+
+	ret = encode_scanreportinfompfixed(stream, &info);
+
+	for (i = 0; i < info.scan_per_fixed.count; ++i) {
+		free(info.scan_per_fixed.value[i].obs_scan_fix.value);
+	}
+
+	free(info.scan_per_fixed.value);
+	free(done);
+
+	return ret;
+}
+
+/**
+ * Empties the queue of a batch
+ */
+static void batch_clear(struct AgentBatch *batch)
+{
+	int i;
+
+	for (i = 0; i < batch->count; ++i) {
+		del_octet_string(&batch->entries[i].obs.obs_val_data);
+	}
+
+	batch->count = 0;
+	batch->readings = 0;
+	batch->size = 0;
+	batch->first_at = 0;
+}
+
+/**
+ * Builds the event report of queued readings, and empties the queue.
+ *
+ * @param ctx context
+ * @return event report, to be sent by communication_agent_send_event_tx(),
+ * or NULL if nothing is queued
+ */
+DATA_apdu *agent_batch_report(Context *ctx)
+{
+	struct AgentBatch *batch = ctx->agent_batch;
+	EventReportArgumentSimple *evt;
+	ByteStreamWriter *stream;
+	DATA_apdu *data;
+
+	if (agent_batch_count(ctx) == 0) {
+		return NULL;
+	}
+
+	stream = byte_stream_writer_instance(agent_batch_size(ctx));
+
+	if (batch->person_mode) {
+		batch_encode_mp_fixed(batch, stream);
+	} else {
+		batch_encode_fixed(batch, stream);
+	}
+
+	data = calloc(1, sizeof(DATA_apdu));
+
+	// will be filled afterwards by service_* function
+	data->invoke_id = 0xffff;
+	data->message.choice = batch->confirmed
+			       ? ROIV_CMIP_CONFIRMED_EVENT_REPORT_CHOSEN
+			       : ROIV_CMIP_EVENT_REPORT_CHOSEN;
+
+	evt = &data->message.u.roiv_cmipEventReport;
+	evt->obj_handle = 0;
+	evt->event_time = 0xFFFFFFFF;
+	evt->event_type = batch->person_mode ? MDC_NOTI_SCAN_REPORT_MP_FIXED
+			  : MDC_NOTI_SCAN_REPORT_FIXED;
+	evt->event_info.length = stream->size;
+	evt->event_info.value = stream->buffer;
+	data->message.length = 10 + evt->event_info.length;
+
+	del_byte_stream_writer(stream, 0);
+
+	DEBUG("Batch of %d readings (%d observations) in one report",
+	      batch->readings, batch->count);
+
+	++batch->scan_report_no;
+	batch_clear(batch);
+
+	return data;
+}
+
+/**
+ * Frees the batch of a context, dropping queued readings
+ *
+ * @param batch batch, may be NULL
+ */
+void agent_batch_destroy(struct AgentBatch *batch)
+{
+	if (batch != NULL) {
+		batch_clear(batch);
+		free(batch->entries);
+		free(batch);
+	}
+}
+
+/** @} */
@@ -0,0 +1,64 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+/**
+ * \file agent_batch.h
+ * \brief Agent readings batched into a single scan report header.
+ *
+ *
+ * Copyright (C) 2010 Signove Tecnologia Corporation.
+ * All rights reserved.
+ * Contact: Signove Tecnologia Corporation (contact@signove.com)
+ *
+ * $LICENSE_TEXT:BEGIN$
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation and appearing
+ * in the file LICENSE included in the packaging of this file; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ * $LICENSE_TEXT:END$
+ *
+ * \date Oct 18, 2026
+ */
+
+#ifndef AGENT_BATCH_H_
+#define AGENT_BATCH_H_
+
+#include <communication/context.h>
+#include <communication/stdconfigurations.h>
+
+/**
+ * \ingroup Communication
+ * @{
+ */
+
+/**
+ * Person id of readings queued without one
+ */
+#define AGENT_BATCH_NO_PERSON -1
+
+int agent_batch_add(Context *ctx, struct StdConfiguration *cfg,
+		    void *evtdata, int person_id);
+
+int agent_batch_count(Context *ctx);
+
+int agent_batch_size(Context *ctx);
+
+int agent_batch_person_mode(Context *ctx);
+
+unsigned long long agent_batch_first_at(Context *ctx);
+
+DATA_apdu *agent_batch_report(Context *ctx);
+
+void agent_batch_destroy(struct AgentBatch *batch);
+
+/** @} */
+
+#endif /* AGENT_BATCH_H_ */
@@ -33,6 +33,7 @@
 #include "communication.h"
 #include "communication/service.h"
 #include "communication/stdconfigurations.h"
+#include "communication/event_template.h"
 #include "communication/parser/encoder_ASN1.h"
 #include "src/communication/parser/struct_cleaner.h"
 #include "src/dim/mds.h"
@@ -149,31 +150,45 @@ void communication_agent_roiv_action_respond_tx(FSMContext *ctx, fsm_events evt,
 }
 
 /**
- * React to "Send Event" request to state machine (Agent)
+ * React to "Send Event" request to state machine (Agent). The event
+ * report is built from application data, unless it is given in event
+ * data (e.g. a batch of readings, see agent_batch.c).
  *
  * @param ctx state machine context
  * @param evt state machine event
- * @param evtdata state machine event data
+ * @param evtdata state machine event data, event report is taken over
  */
 void communication_agent_send_event_tx(FSMContext *ctx, fsm_events evt, FSMEventData *evtdata)
 {
-	APDU *apdu = calloc(sizeof(APDU), 1);
+	APDU *apdu;
 	PRST_apdu prst;
 	DATA_apdu *data;
 
-	ConfigId spec = agent_configuration()->config;
-	struct StdConfiguration *cfg =
-		std_configurations_get_supported_standard(spec);
-	// TODO support extended configurations too for agent
+	if (evtdata != NULL && evtdata->choice == FSM_EVT_DATA_EVENT_REPORT) {
+		data = evtdata->u.event_report;
+	} else {
+		ConfigId spec = agent_configuration(ctx)->config;
+		struct StdConfiguration *cfg =
+			std_configurations_get_supported_standard(spec);
+		// TODO support extended configurations too for agent
 
-	if (!cfg) {
-		DEBUG("No std configuration for %d, bailing out", spec);
-		return;
+		if (!cfg) {
+			DEBUG("No std configuration for %d, bailing out", spec);
+			return;
+		}
+
+		void *evtreport = agent_configuration(ctx)->event_report_cb();
+
+		if (event_template_send(ctx, cfg, evtreport)) {
+			free(evtreport);
+			return;
+		}
+
+		data = cfg->event_report(evtreport);
+		free(evtreport);
 	}
 
-	void *evtreport = agent_configuration()->event_report_cb();
-	data = cfg->event_report(evtreport);
-	free(evtreport);
+	apdu = calloc(sizeof(APDU), 1);
 
 	// prst = length + DATA_apdu
 	// take into account data's invoke id and choice
@@ -209,15 +224,15 @@ void association_agent_mds(FSMContext *ctx, fsm_events evt, FSMEventData *data)
 		mds_destroy(ctx->mds);
 	}
 
-	ConfigId spec = agent_configuration()->config;
+	ConfigId spec = agent_configuration(ctx)->config;
 	ConfigObjectList *cfg = std_configurations_get_configuration_attributes(spec);
 
 	MDS *mds = mds_create();
 	ctx->mds = mds;
 
-	struct mds_system_data *mds_data = agent_configuration()->mds_data_cb();
+	struct mds_system_data *mds_data = agent_configuration(ctx)->mds_data_cb();
 
-	mds->dev_configuration_id = agent_configuration()->config;
+	mds->dev_configuration_id = agent_configuration(ctx)->config;
 	mds->data_req_mode_capab.data_req_mode_flags = DATA_REQ_SUPP_INIT_AGENT;
 	// max number of simultaneous sessions
 	mds->data_req_mode_capab.data_req_init_agent_count = 1;
@@ -229,7 +244,6 @@ void association_agent_mds(FSMContext *ctx, fsm_events evt, FSMEventData *data)
 	mds_configure_operating(ctx, cfg, 0);
 
 	free(mds_data);
-	free(cfg);
 }
 
 /**
@@ -266,7 +280,10 @@ void communication_agent_roiv_get_mds_tx(FSMContext *ctx, fsm_events evt, FSMEve
 
 	attrs.count = 0;
 	attrs.length = 0;
-	attrs.value = mds_get_attributes(ctx->mds, &attrs.count, &attrs.length);
+	// encoded once per attributes version, owned by MDS
+	attrs.value = (AVA_Type *) mds_get_cached_attributes(ctx->mds,
+							     &attrs.count,
+							     &attrs.length);
 	
 	DEBUG("send RORS with MDS: %d attributes, length %d", attrs.count, attrs.length);
 
@@ -285,8 +302,10 @@ void communication_agent_roiv_get_mds_tx(FSMContext *ctx, fsm_events evt, FSMEve
 	encode_set_data_apdu(&apdu.u.prst, data_apdu);
 	communication_send_apdu(ctx, &apdu);
 
-	// deletes information that came from mds_get_attributes()
-	// and data_apdu
+	// attributes belong to MDS cache, detach them before
+	// deleting data_apdu
+	data_apdu->message.u.rors_cmipGet.attribute_list.count = 0;
+	data_apdu->message.u.rors_cmipGet.attribute_list.value = NULL;
 	del_apdu(&apdu);
 }
 
@@ -0,0 +1,409 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+/**
+ * \file apdu_capture.c
+ * \brief Binary APDU capture.
+ *
+ * Copyright (C) 2010 Signove Tecnologia Corporation.
+ * All rights reserved.
+ * Contact: Signove Tecnologia Corporation (contact@signove.com)
+ *
+ * $LICENSE_TEXT:BEGIN$
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation and appearing
+ * in the file LICENSE included in the packaging of this file; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ * $LICENSE_TEXT:END$
+ *
+ * \date Oct 18, 2026
+ */
+
+/**
+ * \addtogroup Communication
+ *
+ * APDU capture keeps a binary record of every APDU sent or received,
+ * tagged with a monotonic timestamp and the context id, so that
+ * conversations may be inspected or replayed (see sdk/apdu_replay).
+ *
+ * Protocol threads only copy the APDU into a memory buffer; a writer
+ * thread of its own flushes it to disk. If the writer falls behind and
+ * the buffer fills up, records are dropped rather than delaying the
+ * protocol. Files are rotated when they reach a given size: "path"
+ * is renamed to "path.1", "path.1" to "path.2" and so on.
+ *
+ * @{
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "src/communication/apdu_capture.h"
+#include "src/util/log.h"
+
+/**
+ * Size of each of the two in-memory buffers
+ */
+#define CAPTURE_BUFFER_SIZE (256 * 1024)
+
+/**
+ * Protects buffers and writer state
+ */
+static pthread_mutex_t capture_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Wakes writer thread up
+ */
+static pthread_cond_t capture_cond = PTHREAD_COND_INITIALIZER;
+
+/**
+ * Writer thread
+ */
+static pthread_t writer_thread;
+
+/**
+ * Capture is on; read without lock as a fast path
+ */
+static int active = 0;
+
+/**
+ * Writer thread must flush and quit
+ */
+static int stopping = 0;
+
+/**
+ * Buffer being filled by protocol threads and buffer being written
+ */
+static intu8 *buffers[2] = {NULL, NULL};
+
+/**
+ * Index of buffer being filled
+ */
+static int current = 0;
+
+/**
+ * Bytes in buffer being filled
+ */
+static intu32 fill = 0;
+
+/**
+ * Records lost because buffer was full
+ */
+static unsigned long long dropped = 0;
+
+/**
+ * Current file; only touched by writer thread after start
+ */
+static FILE *file = NULL;
+
+/**
+ * Path of current file
+ */
+static char *file_path = NULL;
+
+/**
+ * Bytes written to current file
+ */
+static unsigned long file_size = 0;
+
+/**
+ * Rotation threshold
+ */
+static unsigned long max_size = APDU_CAPTURE_DEFAULT_FILE_SIZE;
+
+/**
+ * Number of rotated files kept
+ */
+static unsigned int max_files = APDU_CAPTURE_DEFAULT_FILES;
+
+static unsigned long long clock_ns(clockid_t clock)
+{
+	struct timespec ts;
+	clock_gettime(clock, &ts);
+	return (unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void put_be(intu8 *p, unsigned long long v, int bytes)
+{
+	while (bytes-- > 0) {
+		p[bytes] = v & 0xff;
+		v >>= 8;
+	}
+}
+
+/**
+ * Opens a new file at file_path and writes its header
+ *
+ * @return 1 if operation succeeds, 0 if not.
+ */
+static int open_file()
+{
+	intu8 header[APDU_CAPTURE_FILE_HEADER_SIZE];
+
+	file = fopen(file_path, "wb");
+
+	if (!file) {
+		ERROR("capture: unable to open %s", file_path);
+		return 0;
+	}
+
+	memcpy(header, APDU_CAPTURE_MAGIC, 8);
+	put_be(header + 8, clock_ns(CLOCK_REALTIME), 8);
+	put_be(header + 16, clock_ns(CLOCK_MONOTONIC), 8);
+
+	fwrite(header, 1, sizeof(header), file);
+	file_size = sizeof(header);
+
+	return 1;
+}
+
+/**
+ * Shifts old files and starts a new one
+ */
+static void rotate()
+{
+	size_t len = strlen(file_path) + 16;
+	char *from = malloc(len);
+	char *to = malloc(len);
+	unsigned int i;
+
+	fclose(file);
+	file = NULL;
+
+	if (max_files == 0) {
+		remove(file_path);
+	} else {
+		for (i = max_files - 1; i >= 1; --i) {
+			snprintf(from, len, "%s.%u", file_path, i);
+			snprintf(to, len, "%s.%u", file_path, i + 1);
+			rename(from, to);
+		}
+
+		snprintf(to, len, "%s.1", file_path);
+		rename(file_path, to);
+	}
+
+	free(from);
+	free(to);
+
+	open_file();
+}
+
+/**
+ * Writes a chunk of whole records, rotating file first if needed
+ */
+static void write_chunk(intu8 *data, intu32 len)
+{
+	if (file_size > APDU_CAPTURE_FILE_HEADER_SIZE
+	    && file_size + len > max_size) {
+		rotate();
+	}
+
+	if (!file) {
+		return;
+	}
+
+	fwrite(data, 1, len, file);
+	fflush(file);
+	file_size += len;
+}
+
+/**
+ * Writer thread: swaps buffers and writes the filled one
+ */
+static void *writer_loop(void *arg)
+{
+	while (1) {
+		pthread_mutex_lock(&capture_mutex);
+
+		while (fill == 0 && !stopping) {
+			pthread_cond_wait(&capture_cond, &capture_mutex);
+		}
+
+		if (fill == 0) {
+			pthread_mutex_unlock(&capture_mutex);
+			break;
+		}
+
+		intu8 *data = buffers[current];
+		intu32 len = fill;
+
+		current = 1 - current;
+		fill = 0;
+
+		pthread_mutex_unlock(&capture_mutex);
+
+		write_chunk(data, len);
+	}
+
+	return NULL;
+}
+
+/**
+ * Starts capturing APDUs of all contexts to a file
+ *
+ * @param path capture file; replaced if it exists
+ * @param max_file_size rotation threshold in bytes (0 = default)
+ * @param max_files_kept rotated files to keep
+ * @return 1 if operation succeeds, 0 if not.
+ */
+int apdu_capture_start(const char *path, unsigned long max_file_size,
+		       unsigned int max_files_kept)
+{
+	if (apdu_capture_is_active()) {
+		ERROR("capture: already active");
+		return 0;
+	}
+
+	free(file_path);
+	file_path = strdup(path);
+	max_size = max_file_size ? max_file_size : APDU_CAPTURE_DEFAULT_FILE_SIZE;
+	max_files = max_files_kept;
+
+	if (!file_path || !open_file()) {
+		return 0;
+	}
+
+	buffers[0] = malloc(CAPTURE_BUFFER_SIZE);
+	buffers[1] = malloc(CAPTURE_BUFFER_SIZE);
+	current = 0;
+	fill = 0;
+	stopping = 0;
+	dropped = 0;
+
+	if (!buffers[0] || !buffers[1]
+	    || pthread_create(&writer_thread, NULL, writer_loop, NULL) != 0) {
+		ERROR("capture: cannot start writer");
+		free(buffers[0]);
+		free(buffers[1]);
+		buffers[0] = buffers[1] = NULL;
+		fclose(file);
+		file = NULL;
+		return 0;
+	}
+
+	DEBUG("capture: writing to %s", file_path);
+	__atomic_store_n(&active, 1, __ATOMIC_RELEASE);
+
+	return 1;
+}
+
+/**
+ * Stops capture; pending records are flushed to file
+ */
+void apdu_capture_stop()
+{
+	pthread_mutex_lock(&capture_mutex);
+
+	if (!active) {
+		pthread_mutex_unlock(&capture_mutex);
+		return;
+	}
+
+	__atomic_store_n(&active, 0, __ATOMIC_RELEASE);
+	stopping = 1;
+	pthread_cond_signal(&capture_cond);
+	pthread_mutex_unlock(&capture_mutex);
+
+	pthread_join(writer_thread, NULL);
+
+	if (dropped) {
+		ERROR("capture: %llu records dropped", dropped);
+	}
+
+	if (file) {
+		fclose(file);
+		file = NULL;
+	}
+
+	free(buffers[0]);
+	free(buffers[1]);
+	buffers[0] = buffers[1] = NULL;
+}
+
+/**
+ * Tells whether capture is on
+ *
+ * @return 1 if active
+ */
+int apdu_capture_is_active()
+{
+	return __atomic_load_n(&active, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * Records an APDU. Does not block on disk; record is dropped if
+ * writer thread is behind.
+ *
+ * @param ctx context that sent or received the APDU
+ * @param sent 1 if APDU was sent, 0 if received
+ * @param apdu encoded APDU
+ * @param len APDU length
+ */
+void apdu_capture_record(Context *ctx, int sent, const intu8 *apdu,
+			 intu32 len)
+{
+	intu32 size = APDU_CAPTURE_RECORD_HEADER_SIZE + len;
+	unsigned long long timestamp;
+	intu8 flags;
+
+	if (!apdu_capture_is_active()) {
+		return;
+	}
+
+	timestamp = clock_ns(CLOCK_MONOTONIC);
+	flags = (sent ? APDU_CAPTURE_SENT : 0)
+		| ((ctx->type & MANAGER_CONTEXT) ? APDU_CAPTURE_MANAGER : 0);
+
+	pthread_mutex_lock(&capture_mutex);
+
+	if (!active || fill + size > CAPTURE_BUFFER_SIZE) {
+		if (active) {
+			++dropped;
+		}
+
+		pthread_mutex_unlock(&capture_mutex);
+		return;
+	}
+
+	intu8 *p = buffers[current] + fill;
+
+	put_be(p, timestamp, 8);
+	put_be(p + 8, ctx->id.connid, 8);
+	put_be(p + 16, ctx->id.plugin, 4);
+	put_be(p + 20, len, 4);
+	p[24] = flags;
+	p[25] = p[26] = p[27] = 0;
+	memcpy(p + APDU_CAPTURE_RECORD_HEADER_SIZE, apdu, len);
+
+	if (fill == 0) {
+		pthread_cond_signal(&capture_cond);
+	}
+
+	fill += size;
+
+	pthread_mutex_unlock(&capture_mutex);
+}
+
+/**
+ * Returns number of records lost because writer was behind, since
+ * capture started
+ *
+ * @return record count
+ */
+unsigned long long apdu_capture_dropped_records()
+{
+	return dropped;
+}
+
+/** @} */
@@ -0,0 +1,85 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+/**
+ * \file apdu_capture.h
+ * \brief Binary APDU capture header.
+ *
+ * Copyright (C) 2010 Signove Tecnologia Corporation.
+ * All rights reserved.
+ * Contact: Signove Tecnologia Corporation (contact@signove.com)
+ *
+ * $LICENSE_TEXT:BEGIN$
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation and appearing
+ * in the file LICENSE included in the packaging of this file; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ * $LICENSE_TEXT:END$
+ *
+ * \date Oct 18, 2026
+ */
+
+#ifndef APDU_CAPTURE_H_
+#define APDU_CAPTURE_H_
+
+#include <asn1/phd_types.h>
+#include <communication/context.h>
+
+/**
+ * Magic at the beginning of each capture file
+ */
+#define APDU_CAPTURE_MAGIC "A11073C1"
+
+/**
+ * File header: magic, realtime clock and monotonic clock at the
+ * moment file was opened (nanoseconds, big endian)
+ */
+#define APDU_CAPTURE_FILE_HEADER_SIZE 24
+
+/**
+ * Record header: monotonic timestamp in ns (8), connid (8),
+ * plugin (4), APDU length (4), flags (1), padding (3); big endian
+ */
+#define APDU_CAPTURE_RECORD_HEADER_SIZE 28
+
+/**
+ * Record flag: APDU was sent by this side (received otherwise)
+ */
+#define APDU_CAPTURE_SENT 0x01
+
+/**
+ * Record flag: context is a manager context
+ */
+#define APDU_CAPTURE_MANAGER 0x02
+
+/**
+ * Default size of capture file before rotation
+ */
+#define APDU_CAPTURE_DEFAULT_FILE_SIZE (16 * 1024 * 1024)
+
+/**
+ * Default number of rotated files kept besides the current one
+ */
+#define APDU_CAPTURE_DEFAULT_FILES 4
+
+int apdu_capture_start(const char *path, unsigned long max_file_size,
+		       unsigned int max_files_kept);
+
+void apdu_capture_stop();
+
+int apdu_capture_is_active();
+
+void apdu_capture_record(Context *ctx, int sent, const intu8 *apdu,
+			 intu32 len);
+
+unsigned long long apdu_capture_dropped_records();
+
+#endif /* APDU_CAPTURE_H_ */
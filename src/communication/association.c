@@ -285,11 +285,12 @@ int association_accept_data_protocol_20601_in(Context *ctx,
 		// Configuration known
 		ConfigId id = agent_assoc_information.dev_config_id;
 		ConfigObjectList *config;
+		int standard = std_configurations_is_supported_standard(id);
 
-		if (std_configurations_is_supported_standard(id)) {
+		if (standard) {
 			config = std_configurations_get_configuration_attributes(id);
 		} else {
-			config = ext_configurations_get_configuration_attributes(
+			config = ext_configurations_acquire_configuration_attributes(
 					 &agent_assoc_information.system_id, id);
 		}
 
@@ -304,7 +305,10 @@ int association_accept_data_protocol_20601_in(Context *ctx,
 			// MDS attributes and the request must go after
 			// "configuration accepted" packet.
 			mds_configure_operating(ctx, config, 1);
-			free(config);
+
+			if (!standard) {
+				ext_configurations_release_configuration_attributes(config);
+			}
 
 			return 2;
 		}
@@ -487,8 +491,9 @@ static void populate_aare(APDU *apdu, PhdAssociationInformation *response_info)
 	response_info->optionList.length = 0;
 }
 
-static void populate_aarq(APDU *apdu, PhdAssociationInformation *config_info,
-				DataProto *proto);
+static void populate_aarq(Context *ctx, APDU *apdu,
+			  PhdAssociationInformation *config_info,
+			  DataProto *proto);
 
 /**
  * Send apdu association request (normally, Agent does this)
@@ -505,7 +510,7 @@ void association_aarq_tx(FSMContext *ctx, fsm_events evt, FSMEventData *data)
 	DataProto proto;
 
 	memset(&config_info, 0, sizeof(PhdAssociationInformation));
-	populate_aarq(&config_apdu, &config_info, &proto);
+	populate_aarq(ctx, &config_apdu, &config_info, &proto);
 
 	// Encode APDU
 	ByteStreamWriter *encoded_value =
@@ -523,14 +528,16 @@ void association_aarq_tx(FSMContext *ctx, fsm_events evt, FSMEventData *data)
 /**
  * Populate AARQ APDU (Normally, Agent uses this)
  *
+ * @param ctx connection context
  * @param apdu APDU structure
  * @param config_info Configuration to send
  * @param proto Data protocol to send
  */
-static void populate_aarq(APDU *apdu, PhdAssociationInformation *config_info,
-				DataProto *proto)
+static void populate_aarq(Context *ctx, APDU *apdu,
+			  PhdAssociationInformation *config_info,
+			  DataProto *proto)
 {
-	struct mds_system_data *mds_data = agent_configuration()->mds_data_cb();
+	struct mds_system_data *mds_data = agent_configuration(ctx)->mds_data_cb();
 
 	apdu->choice = AARQ_CHOSEN;
 	apdu->length = 50;
@@ -555,7 +562,7 @@ static void populate_aarq(APDU *apdu, PhdAssociationInformation *config_info,
 	memcpy(config_info->system_id.value, mds_data->system_id,
 					config_info->system_id.length);
 
-	config_info->dev_config_id = agent_configuration()->config;
+	config_info->dev_config_id = agent_configuration(ctx)->config;
 
 	config_info->data_req_mode_capab.data_req_mode_flags = DATA_REQ_SUPP_INIT_AGENT;
 	// max number of simultaneous sessions
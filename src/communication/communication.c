@@ -52,14 +52,10 @@
 #include "src/communication/parser/encoder_ASN1.h"
 #include "src/communication/parser/decoder_ASN1.h"
 #include "src/communication/parser/struct_cleaner.h"
+#include "src/communication/apdu_capture.h"
+#include "src/communication/stats.h"
 #include "src/util/log.h"
 
-// #define APDU_DUMP
-
-#ifdef APDU_DUMP
-#include <util/ioutil.h>
-#endif
-
 /**
  * Represents the network layer status
  */
@@ -80,6 +76,11 @@ static communication_network_status network_status;
 static unsigned int plugin_count = 0;
 static CommunicationPlugin **comm_plugins = NULL;
 
+/**
+ * Number of roles (agent, manager) initialized in this process
+ */
+static int role_count = 0;
+
 // TODO use LinkedList
 
 /**
@@ -139,14 +140,20 @@ static StateTransitionListener *state_transition_listener_list = NULL;
 static int state_transition_listener_size = 0;
 
 /**
- * Connection listener
+ * Connection listeners, one for manager and one for agent contexts,
+ * so both roles may live in the same process
+ */
+static comm_conn_cb connection_listener[2] = {NULL, NULL};
+
+/**
+ * Disconnection listeners, one for manager and one for agent contexts
  */
-static comm_conn_cb connection_listener = NULL;
+static comm_disconn_cb disconnection_listener[2] = {NULL, NULL};
 
 /**
- * Disconnection listener
+ * Index of connection listener slot for a context type
  */
-static comm_disconn_cb disconnection_listener = NULL;
+#define LISTENER_SLOT(type) (((type) & AGENT_CONTEXT) ? 1 : 0)
 
 static int communication_fire_transport_disconnect_evt(Context *ctx);
 
@@ -247,6 +254,60 @@ int communication_force_disconnect(Context *ctx)
 	return 1;
 }
 
+/**
+ * Pre-allocates per-connection structures of count connections,
+ * including the multithreading ones of plugins.
+ *
+ * @param count number of connections to keep ready for
+ * @return 1 if successful, 0 otherwise
+ */
+int communication_reserve_contexts(int count)
+{
+	unsigned int i;
+
+	if (!context_pool_reserve(count)) {
+		return 0;
+	}
+
+	for (i = 1; i <= plugin_count; ++i) {
+		CommunicationPlugin *comm_plugin = comm_plugins[i];
+
+		if (comm_plugin->thread_reserve
+		    && !comm_plugin->thread_reserve(count)) {
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+/**
+ * Takes a reference to the state shared by agent and manager roles
+ * (communication layer, standard configurations, MDS templates).
+ *
+ * @return number of roles, 1 if caller is the first one and must
+ * set up shared state
+ */
+int communication_role_ref()
+{
+	return ++role_count;
+}
+
+/**
+ * Drops a reference taken by communication_role_ref()
+ *
+ * @return number of remaining roles, 0 if caller is the last one and
+ * must tear shared state down
+ */
+int communication_role_unref()
+{
+	if (role_count > 0) {
+		--role_count;
+	}
+
+	return role_count;
+}
+
 /**
  * Finalizes the communication layer and free memory.
  * This method locks the communication layer thread.
@@ -278,9 +339,16 @@ void communication_finalize()
 	communication_remove_all_state_transition_listeners();
 	communication_remove_connection_listeners();
 	context_remove_all();
+	context_pool_trim();
+	apdu_capture_stop();
 
 	for (i = 1; i <= plugin_count; ++i) {
 		CommunicationPlugin *comm_plugin = comm_plugins[i];
+
+		if (comm_plugin->thread_trim) {
+			comm_plugin->thread_trim();
+		}
+
 		communication_plugin_clear(comm_plugin);
 		comm_plugins[i] = NULL;
 	}
@@ -348,15 +416,27 @@ void communication_remove_all_state_transition_listeners()
 }
 
 
-void communication_set_connection_listeners(comm_conn_cb cf, comm_disconn_cb df)
+/**
+ * Sets connection and disconnection listeners of a context type
+ *
+ * @param type MANAGER_CONTEXT or AGENT_CONTEXT
+ * @param cf connection listener
+ * @param df disconnection listener
+ */
+void communication_set_connection_listeners(int type, comm_conn_cb cf,
+						comm_disconn_cb df)
 {
-	connection_listener = cf;
-	disconnection_listener = df;
+	connection_listener[LISTENER_SLOT(type)] = cf;
+	disconnection_listener[LISTENER_SLOT(type)] = df;
 }
 
+/**
+ * Removes all connection and disconnection listeners
+ */
 void communication_remove_connection_listeners()
 {
-	connection_listener = disconnection_listener = NULL;
+	connection_listener[0] = connection_listener[1] = NULL;
+	disconnection_listener[0] = disconnection_listener[1] = NULL;
 }
 
 /**
@@ -467,8 +547,8 @@ Context *communication_transport_connect_indication(ContextId id, const char *ad
 				       NULL);
 	}
 
-	if (connection_listener)
-		connection_listener(ctx, addr);
+	if (ctx && connection_listener[LISTENER_SLOT(ctx->type)])
+		connection_listener[LISTENER_SLOT(ctx->type)](ctx, addr);
 
 	communication_unlock(ctx);
 	// thread-safe block - end
@@ -493,8 +573,8 @@ void communication_transport_disconnect_indication(ContextId id, const char *add
 
 	communication_fire_transport_disconnect_evt(ctx);
 
-	if (disconnection_listener)
-		disconnection_listener(ctx, addr);
+	if (disconnection_listener[LISTENER_SLOT(ctx->type)])
+		disconnection_listener[LISTENER_SLOT(ctx->type)](ctx, addr);
 
 	context_unlock(ctx);
 
@@ -607,17 +687,15 @@ void communication_process_input_data(Context *ctx, ByteStreamReader *stream)
 			return;
 		}
 
-#ifdef APDU_DUMP
-		ioutil_buffer_to_file("apdu_dump", 5, (unsigned char *) "recv ", 1);
-		ioutil_buffer_to_file("apdu_dump", stream->unread_bytes, stream->buffer, 1);
-		ioutil_buffer_to_file("apdu_dump", 1, (unsigned char *) "\n", 1);
-#endif
+		apdu_capture_record(ctx, 0, stream->buffer_cur, stream->unread_bytes);
+		stats_apdu_received(ctx, stream->buffer_cur, stream->unread_bytes);
 
 		// Decode the APDU
 		APDU apdu;
 		decode_apdu(stream, &apdu, &error);
 		if (error) {
 			DEBUG("Invalid APDU, firing abort");
+			stats_decode_error(ctx);
 			communication_fire_evt(ctx, fsm_evt_req_assoc_abort, NULL);
 			return;
 		}
@@ -672,6 +750,31 @@ void communication_fire_evt(Context *ctx, fsm_events evt, FSMEventData *data)
 	// thread-safe block - end
 }
 
+/**
+ * Puts a context straight into a state, without any transition
+ * actions. Used when a connection is resumed from a state saved by
+ * another process (see handoff.c); listeners are told about the
+ * transition as usual.
+ *
+ * @param ctx connection context
+ * @param state state to be resumed
+ */
+void communication_resume_state(Context *ctx, fsm_states state)
+{
+	// thread-safe block - start
+	communication_lock(ctx);
+
+	fsm_states previous = ctx->fsm->state;
+	ctx->fsm->state = state;
+
+	if (previous != state) {
+		communication_notify_state_transition_evt(ctx, previous, state);
+	}
+
+	communication_unlock(ctx);
+	// thread-safe block - end
+}
+
 static void communication_process_apdu_agent(Context *ctx, APDU *apdu)
 {
 	switch (ctx->fsm->state) {
@@ -772,10 +875,7 @@ void communication_process_apdu(Context *ctx, APDU *apdu)
  */
 int communication_send_apdu(Context *ctx, APDU *apdu)
 {
-	CommunicationPlugin *comm_plugin =
-		communication_get_plugin(ctx->id.plugin);
-
-	if (!comm_plugin)
+	if (!communication_get_plugin(ctx->id.plugin))
 		return 0;
 
 	// thread-safe block - start
@@ -786,18 +886,49 @@ int communication_send_apdu(Context *ctx, APDU *apdu)
 	ByteStreamWriter *encoded_apdu = NULL;
 	encoded_apdu = byte_stream_writer_instance(apdu->length + 4/*apdu header*/);
 
-	encode_apdu(encoded_apdu, apdu);
+	if (!encode_apdu(encoded_apdu, apdu)) {
+		stats_encode_error(ctx);
+	}
+
+	int ret = communication_send_encoded_apdu(ctx, encoded_apdu);
+
+	del_byte_stream_writer(encoded_apdu, 1);
+
+	communication_unlock(ctx);
+	// thread-safe block - end
+
+	return ret;
+}
+
+/**
+ * Send an APDU that is encoded already (e.g. patched from a template).
+ * The stream remains owned by caller.
+ * This method locks the communication layer thread.
+ *
+ * @param ctx context
+ * @param encoded_apdu encoded APDU
+ * @return 1 if operation succeeds, 0 otherwise
+ */
+int communication_send_encoded_apdu(Context *ctx, ByteStreamWriter *encoded_apdu)
+{
+	CommunicationPlugin *comm_plugin =
+		communication_get_plugin(ctx->id.plugin);
+
+	if (!comm_plugin)
+		return 0;
 
-#ifdef APDU_DUMP
-	ioutil_buffer_to_file("apdu_dump", 5, (unsigned char *) "send ", 1);
-	ioutil_buffer_to_file("apdu_dump", encoded_apdu->size, encoded_apdu->buffer, 1);
-	ioutil_buffer_to_file("apdu_dump", 1, (unsigned char *) "\n", 1);
-#endif
+	// thread-safe block - start
+	communication_lock(ctx);
+
+	apdu_capture_record(ctx, 1, encoded_apdu->buffer, encoded_apdu->size);
+	stats_apdu_sent(ctx, encoded_apdu->buffer, encoded_apdu->size);
 
 	// send encoded_apdu bytes
 	int return_val = comm_plugin->network_send_apdu_stream(ctx, encoded_apdu);
 
-	del_byte_stream_writer(encoded_apdu, 1);
+	if (return_val != NETWORK_ERROR_NONE) {
+		stats_send_error(ctx);
+	}
 
 	DEBUG(" communication: APDU sent ");
 	communication_unlock(ctx);
@@ -1059,6 +1190,7 @@ void communication_timeout(Context *ctx)
 	communication_lock(ctx);
 
 	if (ctx != NULL) {
+		stats_timeout(ctx);
 		communication_fire_evt(ctx, fsm_evt_ind_timeout, NULL);
 		if (ctx->type & MANAGER_CONTEXT)
 			manager_notify_evt_timeout(ctx);
@@ -1167,6 +1299,8 @@ static int communication_notify_state_transition_evt(Context *ctx, fsm_states pr
 	int ret_val = 0;
 	int i;
 
+	stats_state_transition(ctx, previous, next);
+
 	for (i = 0; i <  state_transition_listener_size; i++) {
 		StateTransitionListener *l = &state_transition_listener_list[i];
 
@@ -64,11 +64,18 @@ int communication_finalize_thread_context(Context *ctx);
 
 void communication_finalize();
 
+int communication_reserve_contexts(int count);
+
+int communication_role_ref();
+
+int communication_role_unref();
+
 int communication_add_state_transition_listener(
 	fsm_states state,
 	communication_state_transition_handler_function listener_function);
 
-void communication_set_connection_listeners(comm_conn_cb cf, comm_disconn_cb df);
+void communication_set_connection_listeners(int type, comm_conn_cb cf,
+						comm_disconn_cb df);
 
 void communication_remove_connection_listeners();
 
@@ -100,10 +107,14 @@ ByteStreamReader *communication_get_apdu_stream(Context *ctx);
 
 void communication_fire_evt(Context *ctx, fsm_events evt, FSMEventData *data);
 
+void communication_resume_state(Context *ctx, fsm_states state);
+
 void communication_process_apdu(Context *ctx, APDU *apdu);
 
 int communication_send_apdu(Context *ctx, APDU *apdu);
 
+int communication_send_encoded_apdu(Context *ctx, ByteStreamWriter *encoded_apdu);
+
 void communication_abort_undefined_reason_tx(Context *ctx, fsm_events evt,
 		FSMEventData *data);
 
@@ -438,18 +438,17 @@ ConfigResult configuring_perform_configuration_in(Context *ctx,
 			mds_configure_operating(ctx, object_list, 1);
 
 			del_configreport(&config_report);
-			free(object_list);
 
 		} else if (ext_configurations_is_supported_standard(system_id,
 					config_report.config_report_id) &&
-			  (object_list = ext_configurations_get_configuration_attributes(
+			  (object_list = ext_configurations_acquire_configuration_attributes(
 					system_id, config_report.config_report_id))) {
 			DEBUG(" configuring: using previous known extended configuration");
 
 			mds_configure_operating(ctx, object_list, 1);
 
 			del_configreport(&config_report);
-			free(object_list);
+			ext_configurations_release_configuration_attributes(object_list);
 
 		} else {
 			DEBUG(" configuring: using new extended configuration");
@@ -458,7 +457,8 @@ ConfigResult configuring_perform_configuration_in(Context *ctx,
 			ext_configurations_register_conf(system_id,
 				config_report.config_report_id, object_list);
 			mds_configure_operating(ctx, object_list, 1);
-			// do not free config_report, object_list
+			// do not free config_report, only its object_list
+			del_configobjectlist(object_list);
 		}
 
 	} else if (result == STANDARD_CONFIG_UNKNOWN) {
@@ -693,7 +693,7 @@ void configuring_send_config_tx(Context *ctx, fsm_events evt,
 
 	ConfigObjectList *cfg =
 		std_configurations_get_configuration_attributes(
-				      		agent_configuration()->config);
+				      		agent_configuration(ctx)->config);
 
 	data->invoke_id = 0; // filled by service_* call
 	data->message.choice = ROIV_CMIP_CONFIRMED_EVENT_REPORT_CHOSEN;
@@ -703,7 +703,7 @@ void configuring_send_config_tx(Context *ctx, fsm_events evt,
 	evtrep.event_type = MDC_NOTI_CONFIG;
 
 	cfgrep.config_obj_list = *cfg;
-	cfgrep.config_report_id = agent_configuration()->config;
+	cfgrep.config_report_id = agent_configuration(ctx)->config;
 
 	// compensate for config_report
 	evtrep.event_info.length = cfg->length + 6; // 80 + 6 = 86 for oximeter
@@ -730,9 +730,6 @@ void configuring_send_config_tx(Context *ctx, fsm_events evt,
 
 	// takes ownership of apdu and prst.value
 	service_send_remote_operation_request(ctx, apdu, tm, NULL);
-
-	del_configobjectlist(cfg);
-	free(cfg);
 }
 
 /** @} */
@@ -32,6 +32,8 @@
 #ifndef CONTEXT_H_
 #define CONTEXT_H_
 
+#include <communication/stats.h>
+
 /**
  * \ingroup Communication
  * @{
@@ -56,6 +58,9 @@ typedef struct ContextId {
 struct MDS;
 struct Service;
 struct Context;
+struct AgentConfiguration;
+struct ContextLatency;
+struct ManagerBatch;
 
 /**
  * Function prototype to represent callback action
@@ -128,6 +133,33 @@ typedef struct Context {
 	 */
 	timeout_callback timeout_action;
 
+	/**
+	 * Agent configuration used by this context, or NULL if the
+	 * default one given to agent_init() applies
+	 */
+	struct AgentConfiguration *agent_configuration;
+
+	/**
+	 * Readings queued by agent, or NULL if none was ever queued
+	 */
+	struct AgentBatch *agent_batch;
+
+	/**
+	 * Measurement data queued by manager, or NULL if none was
+	 * ever queued
+	 */
+	struct ManagerBatch *manager_batch;
+
+	/**
+	 * Communication counters of this context
+	 */
+	CommunicationStats stats;
+
+	/**
+	 * Latency histograms of this context, allocated on first use
+	 */
+	struct ContextLatency *latency;
+
 	/**
 	 * Reference count
 	 */
@@ -40,12 +40,16 @@
  * @{
  */
 
+#include "src/communication/agent_batch.h"
+#include "src/communication/manager_batch.h"
 #include "src/communication/communication.h"
 #include "src/communication/communication_p.h"
+#include "src/communication/stats.h"
 #include "src/dim/mds.h"
 #include "context_manager.h"
 #include "src/util/log.h"
 #include "src/util/linkedlist.h"
+#include "src/util/pool.h"
 #include <stdlib.h>
 
 /**
@@ -53,6 +57,11 @@
  */
 static LinkedList *context_list = NULL;
 
+/**
+ * Pool of contexts
+ */
+static ObjectPool context_pool = OBJECT_POOL_INITIALIZER(Context, 16);
+
 
 /**
  * @brief Destroys the given context.
@@ -87,7 +96,18 @@ static int destroy_context(Context *context)
 			communication_finalize_thread_context(context);
 		}
 
-		free(context);
+		free(context->agent_configuration);
+		context->agent_configuration = NULL;
+
+		agent_batch_destroy(context->agent_batch);
+		context->agent_batch = NULL;
+
+		manager_batch_destroy(context->manager_batch);
+		context->manager_batch = NULL;
+
+		stats_context_destroyed(context);
+
+		pool_free(&context_pool, context);
 	}
 
 	return 1;
@@ -132,10 +152,10 @@ Context *context_create(ContextId id, int type)
 	// Remove from list if exists any previous
 	context_remove(id);
 
-	Context *context = calloc(1, sizeof(struct Context));
+	Context *context = pool_alloc(&context_pool);
 
 	if (context == NULL) {
-		ERROR("Cannot create context %u:%llu", context->id.plugin, context->id.connid);
+		ERROR("Cannot create context %u:%llu", id.plugin, id.connid);
 		return NULL;
 	}
 
@@ -151,6 +171,8 @@ Context *context_create(ContextId id, int type)
 	context->id = id;
 	context->ref = 1; // reference from list
 
+	stats_context_created(context);
+
 	gil_lock();
 	llist_add(context_list, context);
 	gil_unlock();
@@ -278,4 +300,33 @@ void context_iterate(context_handle function)
 	llist_iterate(context_list, (llist_handle_element) function);
 }
 
+/**
+ * @brief Pre-allocates per-connection structures.
+ *
+ * Contexts, state machines, services and MDS structures come from
+ * pools; reserving them at startup keeps the allocator out of the
+ * path of the first connections.
+ *
+ * @param count number of connections to keep ready for.
+ * @return 1 if successful, 0 otherwise.
+ */
+int context_pool_reserve(int count)
+{
+	return pool_reserve(&context_pool, count)
+		&& fsm_pool_reserve(count)
+		&& service_pool_reserve(count)
+		&& mds_pool_reserve(count);
+}
+
+/**
+ * @brief Releases pooled per-connection structures no longer in use.
+ */
+void context_pool_trim()
+{
+	pool_trim(&context_pool);
+	fsm_pool_trim();
+	service_pool_trim();
+	mds_pool_trim();
+}
+
 /** @} */
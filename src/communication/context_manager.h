@@ -45,5 +45,7 @@ void context_remove_all();
 Context *context_get_and_lock(ContextId id);
 void context_unlock(Context *ctx);
 void context_iterate(context_handle function);
+int context_pool_reserve(int count);
+void context_pool_trim();
 
 #endif /* CONTEXT_MANAGER_H_ */
@@ -0,0 +1,320 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+/**
+ * \file event_template.c
+ * \brief Pre-encoded event report templates, patched with new values.
+ *
+ *
+ * Copyright (C) 2010 Signove Tecnologia Corporation.
+ * All rights reserved.
+ * Contact: Signove Tecnologia Corporation (contact@signove.com)
+ *
+ * $LICENSE_TEXT:BEGIN$
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation and appearing
+ * in the file LICENSE included in the packaging of this file; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ * $LICENSE_TEXT:END$
+ *
+ * \date Oct 18, 2026
+ */
+
+/**
+ * \addtogroup Communication
+ *
+ * Building an event report means allocating a whole DATA_apdu tree
+ * and encoding it, although the scan reports of a standard
+ * configuration always have the same shape. When the specialization
+ * can write just the observed values, the first report is encoded
+ * as usual and kept as template of the configuration; further
+ * reports are a copy of the template with observed values and
+ * invoke id written in place, with no allocation.
+ *
+ * Only fixed scan reports are sent from templates. Confirmed reports
+ * fall back to the regular path when another request is pending.
+ *
+ * @{
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "src/communication/event_template.h"
+#include "src/communication/communication.h"
+#include "src/communication/service.h"
+#include "src/communication/parser/encoder_ASN1.h"
+#include "src/communication/parser/struct_cleaner.h"
+#include "src/dim/nomenclature.h"
+#include "src/util/log.h"
+
+/**
+ * Largest event report kept as template
+ */
+#define EVENT_TEMPLATE_MAX_SIZE 512
+
+/**
+ * Largest number of observations in a template
+ */
+#define EVENT_TEMPLATE_MAX_OBS 32
+
+/**
+ * Offset of the first observation in a fixed scan report APDU
+ */
+#define EVENT_TEMPLATE_OBS_OFFSET 30
+
+/**
+ * Invoke id of unconfirmed event reports
+ */
+#define EVENT_TEMPLATE_UNCONFIRMED_ID 0x1111
+
+/**
+ * Pre-encoded event report of a standard configuration
+ */
+struct EventReportTemplate {
+	/**
+	 * 1 if the template can be used, 0 if the report is not
+	 * a fixed scan report or it is too large
+	 */
+	int usable;
+	/**
+	 * 1 if report is a confirmed event report
+	 */
+	int confirmed;
+	/**
+	 * Number of observations
+	 */
+	int count;
+	/**
+	 * Offset of each observed value in buffer
+	 */
+	intu16 offsets[EVENT_TEMPLATE_MAX_OBS];
+	/**
+	 * Length of each observed value
+	 */
+	intu16 lengths[EVENT_TEMPLATE_MAX_OBS];
+	/**
+	 * Sum of observed value lengths
+	 */
+	intu32 values_size;
+	/**
+	 * Encoded APDU size
+	 */
+	intu32 size;
+	/**
+	 * Encoded APDU
+	 */
+	intu8 buffer[EVENT_TEMPLATE_MAX_SIZE];
+};
+
+/**
+ * Reads an intu16 from encoded buffer
+ */
+static intu16 template_intu16(intu8 *buffer, intu32 offset)
+{
+	return (buffer[offset] << 8) | buffer[offset + 1];
+}
+
+/**
+ * Finds the observed values in encoded fixed scan report
+ *
+ * @param template template with encoded APDU
+ * @return 1 if template is usable, 0 otherwise
+ */
+static int template_locate_values(struct EventReportTemplate *template)
+{
+	intu8 *buffer = template->buffer;
+	intu32 offset = EVENT_TEMPLATE_OBS_OFFSET;
+	intu16 choice;
+	int i;
+
+	if (template->size < EVENT_TEMPLATE_OBS_OFFSET
+	    || template_intu16(buffer, 0) != PRST_CHOSEN) {
+		return 0;
+	}
+
+	choice = template_intu16(buffer, 8);
+
+	if (choice != ROIV_CMIP_EVENT_REPORT_CHOSEN
+	    && choice != ROIV_CMIP_CONFIRMED_EVENT_REPORT_CHOSEN) {
+		return 0;
+	}
+
+	if (template_intu16(buffer, 18) != MDC_NOTI_SCAN_REPORT_FIXED) {
+		return 0;
+	}
+
+	template->confirmed = choice == ROIV_CMIP_CONFIRMED_EVENT_REPORT_CHOSEN;
+	template->count = template_intu16(buffer, 26);
+	template->values_size = 0;
+
+	if (template->count > EVENT_TEMPLATE_MAX_OBS) {
+		return 0;
+	}
+
+	for (i = 0; i < template->count; ++i) {
+		if (offset + 4 > template->size) {
+			return 0;
+		}
+
+		template->lengths[i] = template_intu16(buffer, offset + 2);
+		template->offsets[i] = offset + 4;
+		template->values_size += template->lengths[i];
+		offset += 4 + template->lengths[i];
+	}
+
+	return offset == template->size;
+}
+
+/**
+ * Encodes an event report of the configuration as template
+ *
+ * @param cfg standard configuration
+ * @param evtdata event report data given by application
+ * @return template, not usable if report can not be patched
+ */
+static struct EventReportTemplate *template_build(struct StdConfiguration *cfg,
+						   void *evtdata)
+{
+	struct EventReportTemplate *template;
+	ByteStreamWriter writer;
+	DATA_apdu *data;
+	APDU apdu;
+
+	template = calloc(1, sizeof(struct EventReportTemplate));
+	data = cfg->event_report(evtdata);
+
+	apdu.choice = PRST_CHOSEN;
+	apdu.u.prst.length = data->message.length + 6;
+	apdu.length = apdu.u.prst.length + 2;
+	encode_set_data_apdu(&apdu.u.prst, data);
+
+	writer.size = 0;
+	writer.buffer = template->buffer;
+	writer.buffer_size = sizeof(template->buffer);
+	writer.open = 0;
+
+	if (apdu.length + 4 <= EVENT_TEMPLATE_MAX_SIZE
+	    && encode_apdu(&writer, &apdu)) {
+		template->size = writer.size;
+		template->usable = template_locate_values(template);
+	}
+
+	del_data_apdu(data);
+	free(data);
+
+	DEBUG("Event report template for configuration %d: %s",
+	      cfg->dev_config_id, template->usable ? "usable" : "not usable");
+
+	return template;
+}
+
+/**
+ * Writes an event report from the configuration template, building
+ * the template on first use. Invoke id is left as in the template.
+ *
+ * @param cfg standard configuration of agent
+ * @param evtdata event report data given by application, still
+ * owned by caller
+ * @param stream writer with room for EVENT_TEMPLATE_MAX_SIZE bytes
+ * @return 1 if report was written, 0 if no usable template
+ */
+int event_template_encode(struct StdConfiguration *cfg, void *evtdata,
+			  ByteStreamWriter *stream)
+{
+	struct EventReportTemplate *template;
+	intu8 values[EVENT_TEMPLATE_MAX_SIZE];
+	ByteStreamWriter values_writer;
+	intu32 position = 0;
+	int i;
+
+	if (cfg->event_report_values == NULL) {
+		return 0;
+	}
+
+	gil_lock();
+
+	if (cfg->event_report_template == NULL) {
+		cfg->event_report_template = template_build(cfg, evtdata);
+	}
+
+	template = cfg->event_report_template;
+
+	gil_unlock();
+
+	if (!template->usable
+	    || stream->size + template->size > (intu32) stream->buffer_size) {
+		return 0;
+	}
+
+	values_writer.size = 0;
+	values_writer.buffer = values;
+	values_writer.buffer_size = template->values_size;
+	values_writer.open = 0;
+
+	if (!cfg->event_report_values(evtdata, &values_writer)
+	    || values_writer.size != template->values_size) {
+		ERROR("Event report values do not fit template of %d",
+		      cfg->dev_config_id);
+		return 0;
+	}
+
+	intu8 *buffer = stream->buffer + stream->size;
+	memcpy(buffer, template->buffer, template->size);
+
+	for (i = 0; i < template->count; ++i) {
+		memcpy(buffer + template->offsets[i], values + position,
+		       template->lengths[i]);
+		position += template->lengths[i];
+	}
+
+	stream->size += template->size;
+
+	return 1;
+}
+
+/**
+ * Sends an event report from the configuration template.
+ *
+ * @param ctx context
+ * @param cfg standard configuration of agent
+ * @param evtdata event report data given by application, still
+ * owned by caller
+ * @return 1 if report was sent, 0 if it must be sent the regular way
+ */
+int event_template_send(Context *ctx, struct StdConfiguration *cfg,
+			void *evtdata)
+{
+	intu8 buffer[EVENT_TEMPLATE_MAX_SIZE];
+	ByteStreamWriter writer;
+
+	writer.size = 0;
+	writer.buffer = buffer;
+	writer.buffer_size = sizeof(buffer);
+	writer.open = 0;
+
+	if (!event_template_encode(cfg, evtdata, &writer)) {
+		return 0;
+	}
+
+	if (cfg->event_report_template->confirmed) {
+		timeout_callback tm = {.func = &communication_timeout,
+				       .timeout = 3};
+		return service_send_remote_operation_encoded(ctx, &writer,
+							     tm, NULL) != NULL;
+	}
+
+	buffer[6] = EVENT_TEMPLATE_UNCONFIRMED_ID >> 8;
+	buffer[7] = EVENT_TEMPLATE_UNCONFIRMED_ID & 0xff;
+
+	return communication_send_encoded_apdu(ctx, &writer);
+}
+
+/** @} */
@@ -30,91 +30,275 @@
 
 /**
  * @addtogroup Communication
+ *
+ * Extended configurations are kept in a single file, mapped in memory.
+ * It begins with a checksummed header and a hash table of record
+ * offsets, followed by two kinds of records:
+ *
+ * - content records, holding an encoded object list, stored once
+ *   for all agents that report the same configuration;
+ * - device records, mapping a system id and configuration id to the
+ *   content record.
+ *
+ * Each record has a CRC-32. Content records are hashed by their
+ * encoded bytes and device records by their key, in the same table.
+ *
+ * Registering a configuration appends its records, and only then
+ * points the table slots to them, so a crash never leaves the table
+ * pointing to a partial record. A configuration registered again
+ * leaves its previous device record dead. When the table gets half
+ * full, or dead records take most of the file, live records are
+ * copied to a new file that replaces the old one by rename(); the
+ * store on disk is always either the complete old file or the new
+ * one. Content no longer referenced by any device is dropped then.
+ *
+ * Loading maps the file and checks the header only. A damaged header
+ * makes the store be rebuilt from the records found in the file.
+ * Each record is checked against its CRC when it is read.
+ *
+ * Decoded object lists are shared by all agents with the same
+ * content (see ext_configurations_acquire_configuration_attributes()),
+ * and so are MDS templates, which are keyed by content id.
+ *
+ * Configurations saved by previous versions (an index file plus one
+ * file per configuration) are imported when the store is created.
+ *
  * @{
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stddef.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include "src/util/bytelib.h"
 #include "src/communication/parser/encoder_ASN1.h"
 #include "src/communication/parser/decoder_ASN1.h"
-#include "src/util/bytelib.h"
 #include "src/communication/parser/struct_cleaner.h"
 #include "src/communication/communication.h"
+#include "src/communication/extconfigurations.h"
+#include "src/dim/mds_template.h"
+#include "src/util/checksum.h"
 #include "src/util/ioutil.h"
 #include "src/util/log.h"
 
 /**
- * Index file that lists saved configurations.
- * Internal structure is an encoded array of ExtConfig
+ * Store file name
+ */
+#define EXT_CONFIG_DB_FILE "ext_configs.db"
+
+/**
+ * Index file of previous versions, an encoded array of
+ * config id, system id and object list size
+ */
+#define EXT_CONFIG_LEGACY_FILE "config_list.bin"
+
+/**
+ * Store file magic number ("XCFD")
+ */
+#define EXT_CONFIG_DB_MAGIC 0x44464358
+
+/**
+ * Store file format version
+ */
+#define EXT_CONFIG_DB_VERSION 2
+
+/**
+ * Device record magic number ("XCFK")
+ */
+#define EXT_CONFIG_DEVICE_MAGIC 0x4b464358
+
+/**
+ * Content record magic number ("XCFC")
+ */
+#define EXT_CONFIG_CONTENT_MAGIC 0x43464358
+
+/**
+ * Smallest hash table, in slots (power of two)
+ */
+#define EXT_CONFIG_DB_MIN_BUCKETS 256
+
+/**
+ * Dead records are compacted only above this size, in bytes
+ */
+#define EXT_CONFIG_DB_MIN_DEAD 65536
+
+/**
+ * Decoded object lists kept while not in use
+ */
+#define EXT_CONFIG_SHARED_MAX 64
+
+/**
+ * Store file header. It is followed by the hash table, an array of
+ * bucket_count record offsets (0 for free slots), and by records.
+ */
+typedef struct ExtConfigHeader {
+	/**
+	 * EXT_CONFIG_DB_MAGIC
+	 */
+	intu32 magic;
+	/**
+	 * EXT_CONFIG_DB_VERSION
+	 */
+	intu32 version;
+	/**
+	 * Hash table slots (power of two)
+	 */
+	intu32 bucket_count;
+	/**
+	 * Records in table
+	 */
+	intu32 live_count;
+	/**
+	 * End of last record
+	 */
+	intu32 end;
+	/**
+	 * Bytes taken by records of configurations registered again
+	 */
+	intu32 dead_bytes;
+	/**
+	 * CRC-32 of the fields above
+	 */
+	intu32 checksum;
+	/**
+	 * Keeps table aligned
+	 */
+	intu32 reserved;
+} ExtConfigHeader;
+
+/**
+ * Fields common to all records
  */
-#define EXT_CONFIG_FILE "config_list.bin"
+typedef struct ExtConfigRecord {
+	/**
+	 * EXT_CONFIG_DEVICE_MAGIC or EXT_CONFIG_CONTENT_MAGIC
+	 */
+	intu32 magic;
+	/**
+	 * CRC-32 of the record after this field, up to the end of padding
+	 */
+	intu32 checksum;
+} ExtConfigRecord;
 
 /**
- * Extended configuration structure.
- * The index file is an encoded array of this struct.
+ * Device record. It is followed by the system id and by padding up
+ * to a multiple of 8 bytes.
  */
-struct ExtConfig {
+typedef struct ExtConfigDevice {
 	/**
-	 * System ID of device
+	 * Magic and checksum
 	 */
-	octet_string system_id;
+	ExtConfigRecord record;
 	/**
 	 * Configuration ID (namespace = system id)
 	 */
 	ConfigId config_id;
 	/**
-	 * Configuration object size.
-	 * Every configuration is written in a separate file.
-	 * The index only knows (and checks) the size.
+	 * System ID length
+	 */
+	intu16 system_id_length;
+	/**
+	 * Offset of content record
 	 */
-	intu16 obj_size;
-};
+	intu32 content;
+} ExtConfigDevice;
 
 /**
- * List of extended configurations in memory
- * Loaded from index file at startup
+ * Content record. It is followed by the encoded object list and by
+ * padding up to a multiple of 8 bytes.
  */
-static struct ExtConfig *ext_configuration_list = NULL;
-
-// TODO use a LinkedList
+typedef struct ExtConfigContent {
+	/**
+	 * Magic and checksum
+	 */
+	ExtConfigRecord record;
+	/**
+	 * CRC-32 of encoded object list
+	 */
+	intu32 data_crc;
+	/**
+	 * FNV-1a hash of encoded object list, table key
+	 */
+	intu32 data_hash;
+	/**
+	 * Encoded object list length
+	 */
+	intu32 data_length;
+	/**
+	 * Keeps data aligned
+	 */
+	intu32 reserved;
+} ExtConfigContent;
 
 /**
- * Size of extended configuration list in memory
+ * Decoded object list, shared by agents with the same content
  */
-static int ext_configuration_size = 0;
+typedef struct ExtConfigShared {
+	/**
+	 * Object list, must be the first field
+	 */
+	ConfigObjectList list;
+	/**
+	 * Content id of object list
+	 */
+	intu8 content_id[EXT_CONFIG_CONTENT_ID_SIZE];
+	/**
+	 * Users of object list
+	 */
+	int refs;
+	/**
+	 * Not in cache anymore, freed by last user
+	 */
+	int detached;
+	/**
+	 * Next (less recently used) object list
+	 */
+	struct ExtConfigShared *next;
+} ExtConfigShared;
 
-static char *ext_configurations_get_file_name(octet_string *system_id,
-		ConfigId config_id);
+/**
+ * Store file descriptor, -1 if not loaded
+ */
+static int db_fd = -1;
 
-static void ext_configurations_write_file(octet_string *system_id,
-		ConfigId config_id, ByteStreamWriter *stream, int new);
+/**
+ * Store file mapping, NULL if not loaded
+ */
+static intu8 *db_map = NULL;
 
-static struct ExtConfig *ext_configurations_get_config(
-	octet_string *system_id, ConfigId config_id);
+/**
+ * Size of mapping
+ */
+static intu32 db_map_size = 0;
 
-static void ext_configurations_create_environment();
+/**
+ * Decoded object lists, most recently used first
+ */
+static ExtConfigShared *shared_lists = NULL;
 
 /**
- * Returns fully qualified index file name
- * @return Heap-allocated of file name string
+ * Returns fully qualified name of a file in configuration directory
+ *
+ * @param name file name
+ * @return Heap-allocated file name string
  */
-static char *ext_concat_path_file()
+static char *ext_concat_path_file(const char *name)
 {
 	char *tmp = ioutil_get_tmp();
-	char *path = calloc(strlen(tmp) + strlen(EXT_CONFIG_FILE) + 1,
-			    sizeof(char));
-	sprintf(path, "%s"EXT_CONFIG_FILE, tmp);
+	char *path = calloc(strlen(tmp) + strlen(name) + 1, sizeof(char));
+	sprintf(path, "%s%s", tmp, name);
 	free(tmp);
 	return path;
 }
 
 /**
- * Creates extended configuration environment
+ * Creates extended configuration directory
  */
 static void ext_configurations_create_environment()
 {
@@ -130,258 +314,931 @@ static void ext_configurations_create_environment()
 		if (status != 0) {
 			ERROR("Unable to create configuration directory: %d", \
 			      errno);
-			return;
 		} else {
 			DEBUG("Configuration directory created");
 		}
 	}
 
 	free(config_path);
+}
 
-	char *concat = ext_concat_path_file();
+static ExtConfigHeader *ext_db_header()
+{
+	return (ExtConfigHeader *) db_map;
+}
 
-	if (stat(concat, &st) != 0) {
-		FILE *fd = fopen(concat, "a+");
-		if (fd) {
-			fclose(fd);
-			DEBUG("Configuration file created");
-		} else {
-			DEBUG("Unable to create configuration file: %d", errno);
+static intu32 *ext_db_buckets(intu8 *base)
+{
+	return (intu32 *) (base + sizeof(ExtConfigHeader));
+}
+
+static intu32 ext_db_data_start(intu32 bucket_count)
+{
+	return sizeof(ExtConfigHeader) + bucket_count * sizeof(intu32);
+}
+
+static intu32 ext_db_align(intu32 size)
+{
+	return (size + 7) & ~7U;
+}
+
+static intu32 ext_db_header_checksum(ExtConfigHeader *header)
+{
+	return checksum_crc32(0, header, offsetof(ExtConfigHeader, checksum));
+}
+
+static intu32 ext_db_device_hash(intu8 *system_id, intu16 length,
+				 ConfigId config_id)
+{
+	intu32 hash = checksum_fnv1a(CHECKSUM_FNV1A_INIT, system_id, length);
+	return checksum_fnv1a(hash, &config_id, sizeof(config_id));
+}
+
+static intu8 *ext_db_device_system_id(ExtConfigDevice *device)
+{
+	return (intu8 *) (device + 1);
+}
+
+static intu8 *ext_db_content_data(ExtConfigContent *content)
+{
+	return (intu8 *) (content + 1);
+}
+
+/**
+ * Gets the size of a record, padding included
+ *
+ * @return size, or 0 if record is of unknown kind
+ */
+static intu32 ext_db_record_size(ExtConfigRecord *record)
+{
+	if (record->magic == EXT_CONFIG_DEVICE_MAGIC) {
+		ExtConfigDevice *device = (ExtConfigDevice *) record;
+		return ext_db_align(sizeof(ExtConfigDevice)
+				    + device->system_id_length);
+	} else if (record->magic == EXT_CONFIG_CONTENT_MAGIC) {
+		ExtConfigContent *content = (ExtConfigContent *) record;
+
+		if (content->data_length > 0x7fffffff) {
+			return 0;
 		}
+
+		return ext_db_align(sizeof(ExtConfigContent)
+				    + content->data_length);
 	}
 
-	free(concat);
+	return 0;
+}
+
+static intu32 ext_db_record_checksum(ExtConfigRecord *record, intu32 size)
+{
+	return checksum_crc32(0, record + 1, size - sizeof(ExtConfigRecord));
 }
 
 /**
- * Get the file name related to a system id/config id tuple
- * 
- * @param system_id system id of device
- * @param config_id id of extented configuration
+ * Gets a record, if it is sound
+ *
+ * @param base mapped store, or store image being built
+ * @param offset record offset
+ * @param limit records end at most here
+ * @param magic expected kind of record
+ * @param verify if not 0, record CRC is checked too
+ * @return record, or NULL if it is out of limit, of other kind or damaged
  */
-static char *ext_configurations_get_file_name(octet_string *system_id,
-		ConfigId config_id)
+static ExtConfigRecord *ext_db_record(intu8 *base, intu32 offset, intu32 limit,
+				      intu32 magic, int verify)
 {
-	int length = 0;
-	char *config_path = ioutil_get_tmp();
-	length = length + strlen(config_path);
-	length = length + 2 * system_id->length; // each system_id element is "??"
-	length = length + 9; // "-????.bin"
-	length = length + 1; // "\0"
+	ExtConfigRecord *record;
+	intu32 size;
 
-	char *file_path = calloc(length, sizeof(char));
-	sprintf(file_path, "%s", config_path);
-	int i;
+	if (offset < sizeof(ExtConfigHeader) || (offset & 7)
+	    || offset + sizeof(ExtConfigRecord) > limit) {
+		return NULL;
+	}
 
-	for (i = 0; i < system_id->length; i++) {
-		sprintf(file_path, "%s%.2x", file_path, system_id->value[i]);
+	record = (ExtConfigRecord *) (base + offset);
+
+	if (record->magic != magic) {
+		return NULL;
 	}
 
-	sprintf(file_path, "%s-%.4x.bin", file_path, config_id);
-	free(config_path);
-	return file_path;
+	if (limit - offset < (magic == EXT_CONFIG_DEVICE_MAGIC ?
+			      sizeof(ExtConfigDevice) : sizeof(ExtConfigContent))) {
+		return NULL;
+	}
+
+	size = ext_db_record_size(record);
+
+	if (size == 0 || size > limit - offset) {
+		return NULL;
+	}
+
+	if (verify && record->checksum != ext_db_record_checksum(record, size)) {
+		return NULL;
+	}
+
+	return record;
 }
 
 /**
- * This method destroys the list of available settings but maintains
- * persistent data for later use.
+ * Finds the slot of a device record in a hash table
+ *
+ * @param base mapped store, or store image being built
+ * @param buckets hash table
+ * @param bucket_count table size
+ * @param limit records of the table end at most here
+ * @param system_id system id
+ * @param length system id length
+ * @param config_id configuration id
+ * @return slot holding the device, or the free slot where it
+ * would go; bucket_count if table is full
  */
-void ext_configurations_destroy()
+static intu32 ext_db_device_slot(intu8 *base, intu32 *buckets,
+				 intu32 bucket_count, intu32 limit,
+				 intu8 *system_id, intu16 length,
+				 ConfigId config_id)
 {
-	gil_lock();
-	if (ext_configuration_list != NULL) {
-		int index;
+	intu32 mask = bucket_count - 1;
+	intu32 slot = ext_db_device_hash(system_id, length, config_id) & mask;
+	intu32 probes;
 
-		for (index = 0; index < ext_configuration_size; index++) {
-			del_octet_string(&ext_configuration_list[index].system_id);
+	for (probes = 0; probes < bucket_count; ++probes) {
+		ExtConfigDevice *device;
+
+		if (buckets[slot] == 0) {
+			return slot;
 		}
 
-		free(ext_configuration_list);
-		ext_configuration_list = NULL;
+		device = (ExtConfigDevice *) ext_db_record(base, buckets[slot],
+				limit, EXT_CONFIG_DEVICE_MAGIC, 0);
+
+		if (device && device->config_id == config_id
+		    && device->system_id_length == length
+		    && (length == 0 || memcmp(ext_db_device_system_id(device),
+					      system_id, length) == 0)) {
+			return slot;
+		}
 
-		ext_configuration_size = 0;
+		slot = (slot + 1) & mask;
 	}
-	gil_unlock();
+
+	return bucket_count;
 }
 
 /**
- * Removes all saved configurations from disk
+ * Finds the slot of a content record in a hash table
+ *
+ * @param base mapped store, or store image being built
+ * @param buckets hash table
+ * @param bucket_count table size
+ * @param limit records of the table end at most here
+ * @param data encoded object list
+ * @param length encoded object list length
+ * @param hash FNV-1a hash of data
+ * @return slot holding the content, or the free slot where it
+ * would go; bucket_count if table is full
  */
-void ext_configurations_remove_all_configs()
+static intu32 ext_db_content_slot(intu8 *base, intu32 *buckets,
+				  intu32 bucket_count, intu32 limit,
+				  intu8 *data, intu32 length, intu32 hash)
 {
-	int index;
+	intu32 mask = bucket_count - 1;
+	intu32 slot = hash & mask;
+	intu32 probes;
 
-	gil_lock();
-	for (index = 0; index < ext_configuration_size; index++) {
-		octet_string system_id =
-			ext_configuration_list[index].system_id;
-		ConfigId config_id = ext_configuration_list[index].config_id;
-		char *file_path = ext_configurations_get_file_name(&system_id,
-				  config_id);
-
-		if (remove(file_path) != 0) {
-			ERROR("\n[Error] Unable to remove file %s", file_path);
+	for (probes = 0; probes < bucket_count; ++probes) {
+		ExtConfigContent *content;
+
+		if (buckets[slot] == 0) {
+			return slot;
 		}
 
-		free(file_path);
-		file_path = NULL;
+		content = (ExtConfigContent *) ext_db_record(base, buckets[slot],
+				limit, EXT_CONFIG_CONTENT_MAGIC, 0);
+
+		if (content && content->data_hash == hash
+		    && content->data_length == length
+		    && memcmp(ext_db_content_data(content), data, length) == 0) {
+			return slot;
+		}
+
+		slot = (slot + 1) & mask;
+	}
+
+	return bucket_count;
+}
+
+/**
+ * Writes a whole block to file
+ *
+ * @return 1 if successful, 0 otherwise
+ */
+static int ext_db_write(int fd, const void *buffer, intu32 size, intu32 offset)
+{
+	const intu8 *bytes = buffer;
+
+	while (size > 0) {
+		ssize_t written = pwrite(fd, bytes, size, offset);
+
+		if (written < 0 && errno == EINTR) {
+			continue;
+		} else if (written <= 0) {
+			ERROR("ext config store write: %d", errno);
+			return 0;
+		}
+
+		bytes += written;
+		size -= written;
+		offset += written;
+	}
+
+	return 1;
+}
+
+/**
+ * Maps store file in memory
+ *
+ * @return 1 if successful, 0 otherwise
+ */
+static int ext_db_map()
+{
+	struct stat st;
+	void *map;
+
+	if (fstat(db_fd, &st) != 0 || st.st_size < (off_t) sizeof(ExtConfigHeader)) {
+		return 0;
 	}
-	gil_unlock();
 
-	char *concat = ext_concat_path_file();
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, db_fd, 0);
 
-	if (remove(concat) != 0) {
-		ERROR("\n[Error] Unable to remove file %s", concat);
+	if (map == MAP_FAILED) {
+		ERROR("ext config store mmap: %d", errno);
+		return 0;
 	}
 
-	free(concat);
+	db_map = map;
+	db_map_size = st.st_size;
 
-	ext_configurations_destroy();
+	return 1;
 }
 
 /**
- * This method wipes the ext config index file
+ * Unmaps and closes store file
  */
-static void ext_configurations_wipe()
+static void ext_db_close()
 {
-	ext_configurations_create_environment();
-	ByteStreamWriter *stream = byte_stream_writer_instance(0);
-	char *concat = ext_concat_path_file();
-	ioutil_buffer_to_file(concat, stream->size, stream->buffer, 0);
-	free(concat);
-	del_byte_stream_writer(stream, 1);
-	
-	DEBUG("wiped ext config file");
+	if (db_map != NULL) {
+		munmap(db_map, db_map_size);
+		db_map = NULL;
+		db_map_size = 0;
+	}
+
+	if (db_fd >= 0) {
+		close(db_fd);
+		db_fd = -1;
+	}
 }
 
+/**
+ * Checks header of mapped store
+ *
+ * @return 1 if header is sound, 0 otherwise
+ */
+static int ext_db_header_valid()
+{
+	ExtConfigHeader *header = ext_db_header();
+
+	return header->magic == EXT_CONFIG_DB_MAGIC
+	       && header->version == EXT_CONFIG_DB_VERSION
+	       && header->checksum == ext_db_header_checksum(header)
+	       && header->bucket_count >= EXT_CONFIG_DB_MIN_BUCKETS
+	       && (header->bucket_count & (header->bucket_count - 1)) == 0
+	       && ext_db_data_start(header->bucket_count) <= header->end
+	       && header->end <= db_map_size;
+}
 
 /**
- * This method loads the list of available configurations.
+ * Gets the content record a device record refers to
+ *
+ * @param device device record in mapped store
+ * @param limit records end at most here
+ * @param verify if not 0, record CRC is checked too
+ * @return content record, or NULL if damaged
  */
-void ext_configurations_load_configurations()
+static ExtConfigContent *ext_db_device_content(ExtConfigDevice *device,
+		intu32 limit, int verify)
 {
-	ext_configurations_create_environment();
+	return (ExtConfigContent *) ext_db_record(db_map, device->content, limit,
+			EXT_CONFIG_CONTENT_MAGIC, verify);
+}
 
-	unsigned long buffer_size = 0;
-	ByteStreamReader *stream = 0;
-	char *concat = ext_concat_path_file();
-	unsigned char *buffer = ioutil_buffer_from_file(concat, &buffer_size);
-	free(concat);
+/**
+ * Copies live records of current store to a new file, which replaces
+ * it. Creates an empty store if none is loaded.
+ *
+ * @param scan if 0, live devices are the ones in hash table; otherwise
+ * the file is scanned for sound device records, and the last one of
+ * each configuration is live (used when header is damaged)
+ * @param extra room to be made for this many more records
+ * @return 1 if successful, 0 otherwise
+ */
+static int ext_db_rebuild(int scan, intu32 extra)
+{
+	intu32 bucket_count = EXT_CONFIG_DB_MIN_BUCKETS;
+	intu32 *candidates = NULL;
+	intu32 *devices = NULL;
+	intu32 count = 0;
+	intu32 limit = 0;
+	intu32 offset;
+	intu32 size;
+	intu32 i;
+	ExtConfigHeader *header;
+	intu8 *image;
+	int ok = 0;
+	int fd;
+
+	if (db_map != NULL) {
+		if (scan) {
+			limit = db_map_size;
+			candidates = calloc(limit / 8 + 1, sizeof(intu32));
+
+			for (offset = sizeof(ExtConfigHeader);
+			     offset + sizeof(ExtConfigRecord) <= limit;) {
+				ExtConfigRecord *record = (ExtConfigRecord *) (db_map + offset);
+
+				if (!ext_db_record(db_map, offset, limit,
+						   record->magic, 1)) {
+					offset += 8;
+					continue;
+				}
+
+				if (record->magic == EXT_CONFIG_DEVICE_MAGIC) {
+					candidates[count++] = offset;
+				}
+
+				offset += ext_db_record_size(record);
+			}
+		} else {
+			intu32 *buckets = ext_db_buckets(db_map);
+			limit = ext_db_header()->end;
+			candidates = calloc(ext_db_header()->bucket_count,
+					    sizeof(intu32));
+
+			for (i = 0; i < ext_db_header()->bucket_count; ++i) {
+				if (ext_db_record(db_map, buckets[i], limit,
+						  EXT_CONFIG_DEVICE_MAGIC, 1)) {
+					candidates[count++] = buckets[i];
+				}
+			}
+		}
+	}
 
-	if (!buffer) {
-		DEBUG("No ext config buffer to read");
-		goto exit;
+	// each device may bring its own content
+	while ((2 * count + extra) * 4 > bucket_count) {
+		bucket_count *= 2;
 	}
 
-	stream = byte_stream_reader_instance(buffer, buffer_size);
-	if (!stream) {
-		DEBUG("Zero-sized ext config buffer");
-		goto exit;
+	// table of current devices; later records of a configuration win
+	devices = calloc(bucket_count, sizeof(intu32));
+	size = ext_db_data_start(bucket_count);
+
+	for (i = 0; i < count; ++i) {
+		ExtConfigDevice *device = (ExtConfigDevice *) (db_map + candidates[i]);
+		ExtConfigContent *content = ext_db_device_content(device, limit, 1);
+		intu32 slot;
+
+		if (content == NULL) {
+			continue;
+		}
+
+		slot = ext_db_device_slot(db_map, devices, bucket_count, limit,
+					  ext_db_device_system_id(device),
+					  device->system_id_length,
+					  device->config_id);
+
+		if (devices[slot] == 0) {
+			// content size counted for each device, at most
+			size += ext_db_record_size(&device->record)
+				+ ext_db_record_size(&content->record);
+		}
+
+		devices[slot] = candidates[i];
 	}
 
-	gil_lock();
-	if (ext_configuration_list != NULL) {
-		free(ext_configuration_list);
-		ext_configuration_list = NULL;
-		ext_configuration_size = 0;
+	image = calloc(1, size);
+	header = (ExtConfigHeader *) image;
+	header->magic = EXT_CONFIG_DB_MAGIC;
+	header->version = EXT_CONFIG_DB_VERSION;
+	header->bucket_count = bucket_count;
+	header->end = ext_db_data_start(bucket_count);
+
+	for (i = 0; i < bucket_count; ++i) {
+		ExtConfigDevice *device;
+		ExtConfigContent *content;
+		intu32 *buckets = ext_db_buckets(image);
+		intu32 content_slot;
+		intu32 device_slot;
+		intu32 record_size;
+
+		if (devices[i] == 0) {
+			continue;
+		}
+
+		device = (ExtConfigDevice *) (db_map + devices[i]);
+		content = ext_db_device_content(device, limit, 0);
+
+		content_slot = ext_db_content_slot(image, buckets, bucket_count,
+						   header->end,
+						   ext_db_content_data(content),
+						   content->data_length,
+						   content->data_hash);
+
+		if (buckets[content_slot] == 0) {
+			record_size = ext_db_record_size(&content->record);
+			memcpy(image + header->end, content, record_size);
+			buckets[content_slot] = header->end;
+			header->end += record_size;
+			header->live_count++;
+		}
+
+		device_slot = ext_db_device_slot(image, buckets, bucket_count,
+						 header->end,
+						 ext_db_device_system_id(device),
+						 device->system_id_length,
+						 device->config_id);
+
+		record_size = ext_db_record_size(&device->record);
+		memcpy(image + header->end, device, record_size);
+		device = (ExtConfigDevice *) (image + header->end);
+		device->content = buckets[content_slot];
+		device->record.checksum = ext_db_record_checksum(&device->record,
+					  record_size);
+		buckets[device_slot] = header->end;
+		header->end += record_size;
+		header->live_count++;
 	}
 
-	ext_configuration_list = calloc(0, sizeof(struct ExtConfig));
-	ext_configuration_size = 0;
-	gil_unlock();
+	header->checksum = ext_db_header_checksum(header);
 
-	while (stream->unread_bytes > 0) {
-		int i = ext_configuration_size;
-		int error = 0;
+	char *path = ext_concat_path_file(EXT_CONFIG_DB_FILE);
+	char *tmp_path = ext_concat_path_file(EXT_CONFIG_DB_FILE ".tmp");
 
-		int config_id = read_intu16(stream, &error);
-		if (error) {
-			DEBUG("ext config: err reading config_id %d", i);
-			ext_configurations_wipe();
-			break;
+	fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+	if (fd < 0) {
+		ERROR("Unable to create %s: %d", tmp_path, errno);
+	} else {
+		ok = ext_db_write(fd, image, header->end, 0) && fsync(fd) == 0;
+		close(fd);
+		ok = ok && rename(tmp_path, path) == 0;
+
+		if (!ok) {
+			ERROR("Unable to write ext config store");
+			remove(tmp_path);
 		}
+	}
 
-		DEBUG("Decoding ext config id %x", config_id);
+	if (ok) {
+		ext_db_close();
+		db_fd = open(path, O_RDWR);
+		ok = db_fd >= 0 && ext_db_map();
 
-		octet_string system_id = {0, 0};
-		decode_octet_string(stream, &system_id, &error);
-		if (error) {
-			DEBUG("ext config: err reading system_id %d %d", i, error);
-				ext_configurations_wipe();
-				break;
-			}
+		DEBUG("ext config store rebuilt: %d records, %d slots",
+		      header->live_count, bucket_count);
+	}
 
-		int obj_size = read_intu16(stream, &error);
-		if (error) {
-			DEBUG("ext config: err reading obj_size %d", i);
-			del_octet_string(&system_id);
-			ext_configurations_wipe();
-			break;
+	free(path);
+	free(tmp_path);
+	free(image);
+	free(devices);
+	free(candidates);
+
+	return ok;
+}
+
+/**
+ * Saves a configuration in store. Its content is written only if
+ * no agent has registered the same content before.
+ *
+ * @param system_id System ID (device identification)
+ * @param config_id Extended configuration ID
+ * @param data encoded object list
+ * @param data_length encoded object list length
+ * @return 1 if successful, 0 otherwise
+ */
+static int ext_db_store(octet_string *system_id, ConfigId config_id,
+			intu8 *data, intu32 data_length)
+{
+	ExtConfigHeader header;
+	ExtConfigDevice *device;
+	intu32 hash = checksum_fnv1a(CHECKSUM_FNV1A_INIT, data, data_length);
+	intu32 content_slot;
+	intu32 device_slot;
+	intu32 content_offset;
+	intu32 device_offset;
+	intu32 device_size;
+	intu32 previous;
+	intu8 *records;
+	intu32 records_size = 0;
+	int ok;
+
+	if (db_map == NULL) {
+		return 0;
+	}
+
+	header = *ext_db_header();
+
+	if ((header.live_count + 2) * 2 > header.bucket_count) {
+		if (!ext_db_rebuild(0, 2)) {
+			return 0;
 		}
 
-		gil_lock();
-		ext_configuration_list = realloc(ext_configuration_list,
-			++ext_configuration_size * sizeof(struct ExtConfig));
+		header = *ext_db_header();
+	}
 
-		ext_configuration_list[i].config_id = config_id;
-		ext_configuration_list[i].system_id = system_id;
-		ext_configuration_list[i].obj_size = obj_size;
-		gil_unlock();
+	content_slot = ext_db_content_slot(db_map, ext_db_buckets(db_map),
+					   header.bucket_count, header.end,
+					   data, data_length, hash);
+	device_slot = ext_db_device_slot(db_map, ext_db_buckets(db_map),
+					 header.bucket_count, header.end,
+					 system_id->value, system_id->length,
+					 config_id);
+
+	if (content_slot >= header.bucket_count
+	    || device_slot >= header.bucket_count) {
+		ERROR("ext config store table is full");
+		return 0;
 	}
 
-exit:
-	free(buffer);
-	free(stream);
+	content_offset = ext_db_buckets(db_map)[content_slot];
+	previous = ext_db_buckets(db_map)[device_slot];
+
+	if (content_offset && previous) {
+		device = (ExtConfigDevice *) ext_db_record(db_map, previous,
+				header.end, EXT_CONFIG_DEVICE_MAGIC, 1);
+
+		if (device && device->content == content_offset) {
+			// same configuration registered again
+			return 1;
+		}
+	}
+
+	if (!content_offset && device_slot == content_slot) {
+		// both free; device goes further along its probe sequence
+		do {
+			device_slot = (device_slot + 1) & (header.bucket_count - 1);
+		} while (ext_db_buckets(db_map)[device_slot]);
+	}
+
+	device_size = ext_db_align(sizeof(ExtConfigDevice) + system_id->length);
+	records = calloc(1, device_size + ext_db_align(sizeof(ExtConfigContent)
+			 + data_length));
+
+	if (!content_offset) {
+		ExtConfigContent *content = (ExtConfigContent *) records;
+
+		content->record.magic = EXT_CONFIG_CONTENT_MAGIC;
+		content->data_crc = checksum_crc32(0, data, data_length);
+		content->data_hash = hash;
+		content->data_length = data_length;
+		memcpy(ext_db_content_data(content), data, data_length);
+
+		records_size = ext_db_record_size(&content->record);
+		content->record.checksum = ext_db_record_checksum(
+						   &content->record, records_size);
+		content_offset = header.end;
+	}
+
+	device_offset = header.end + records_size;
+	device = (ExtConfigDevice *) (records + records_size);
+	device->record.magic = EXT_CONFIG_DEVICE_MAGIC;
+	device->config_id = config_id;
+	device->system_id_length = system_id->length;
+	device->content = content_offset;
+
+	if (system_id->length > 0) {
+		memcpy(ext_db_device_system_id(device), system_id->value,
+		       system_id->length);
+	}
+
+	device->record.checksum = ext_db_record_checksum(&device->record,
+				  device_size);
+	records_size += device_size;
+
+	// records must be on disk before the table points to them
+	ok = ext_db_write(db_fd, records, records_size, header.end)
+	     && fdatasync(db_fd) == 0;
+	free(records);
+
+	if (!ok) {
+		return 0;
+	}
+
+	if (content_offset != ext_db_buckets(db_map)[content_slot]) {
+		ok = ext_db_write(db_fd, &content_offset, sizeof(intu32),
+				  ext_db_data_start(content_slot));
+		header.live_count++;
+	}
+
+	if (previous) {
+		header.dead_bytes += device_size;
+	} else {
+		header.live_count++;
+	}
+
+	header.end += records_size;
+	header.checksum = ext_db_header_checksum(&header);
+
+	ok = ok && ext_db_write(db_fd, &device_offset, sizeof(intu32),
+				ext_db_data_start(device_slot))
+	     && ext_db_write(db_fd, &header, sizeof(header), 0)
+	     && fdatasync(db_fd) == 0;
+
+	if (ok && header.end > db_map_size) {
+		munmap(db_map, db_map_size);
+		db_map = NULL;
+		ok = ext_db_map();
+	}
+
+	if (ok && header.dead_bytes > EXT_CONFIG_DB_MIN_DEAD
+	    && header.dead_bytes * 2 > header.end) {
+		ok = ext_db_rebuild(0, 0);
+	}
+
+	return ok;
 }
 
 /**
- * Write extended configuration to disk
+ * Gets the content of a configuration
  *
  * @param system_id System ID (device identification)
  * @param config_id Extended configuration ID
- * @param stream Stream of bytes with encoded configuration
- * @param new If not 0, indicates that config id was unknown
- *        Otherwise, overwrites old saved config with same ID
- */
-static void ext_configurations_write_file(octet_string *system_id,
-		ConfigId config_id, ByteStreamWriter *stream,
-		int new)
-{
-	if (new) {
-		// appends data to index file
-		int size = 2 + sizeof(ConfigId) +
-			sizeof(system_id->length) + system_id->length +
-			2;
-
-		ByteStreamWriter *header_stream = byte_stream_writer_instance(size);
-
-		encode_configid(header_stream, &config_id); // 2
-		encode_octet_string(header_stream, system_id); // 2 + len
-		write_intu16(header_stream, stream->size); // 2 (size of config)
-	
-		char *concat = ext_concat_path_file();
-		int err = ioutil_buffer_to_file(concat, header_stream->size,
-					     header_stream->buffer, 1);
-		free(concat);
-		del_byte_stream_writer(header_stream, 1);
-
-		if (err) {
-			ERROR("error writing ext config index");
-			return;
+ * @return content record in mapped store, or NULL if not found
+ */
+static ExtConfigContent *ext_db_find(octet_string *system_id, ConfigId config_id)
+{
+	ExtConfigHeader *header;
+	ExtConfigDevice *device;
+	ExtConfigContent *content = NULL;
+	intu32 slot;
+
+	if (db_map == NULL) {
+		return NULL;
+	}
+
+	header = ext_db_header();
+	slot = ext_db_device_slot(db_map, ext_db_buckets(db_map),
+				  header->bucket_count, header->end,
+				  system_id->value, system_id->length, config_id);
+
+	if (slot >= header->bucket_count || ext_db_buckets(db_map)[slot] == 0) {
+		return NULL;
+	}
+
+	device = (ExtConfigDevice *) ext_db_record(db_map,
+			ext_db_buckets(db_map)[slot], header->end,
+			EXT_CONFIG_DEVICE_MAGIC, 1);
+
+	if (device != NULL) {
+		content = ext_db_device_content(device, header->end, 1);
+	}
+
+	if (content == NULL) {
+		ERROR("ext config %x: damaged record", config_id);
+	}
+
+	return content;
+}
+
+/**
+ * Fills the content id of a content record
+ */
+static void ext_db_content_id(ExtConfigContent *content,
+			      intu8 content_id[EXT_CONFIG_CONTENT_ID_SIZE])
+{
+	memcpy(content_id, &content->data_crc, sizeof(intu32));
+	memcpy(content_id + 4, &content->data_hash, sizeof(intu32));
+	memcpy(content_id + 8, &content->data_length, sizeof(intu32));
+}
+
+/**
+ * Decodes the object list of a content record
+ *
+ * @param content content record
+ * @param result decoded object list
+ * @return 1 if successful, 0 otherwise
+ */
+static int ext_db_decode(ExtConfigContent *content, ConfigObjectList *result)
+{
+	ByteStreamReader *stream = byte_stream_reader_instance(
+					   ext_db_content_data(content),
+					   content->data_length);
+	int error = 0;
+
+	if (stream == NULL) {
+		return 0;
+	}
+
+	decode_configobjectlist(stream, result, &error);
+	free(stream);
+
+	if (error) {
+		ERROR("ext_config_get: bad configuration data");
+		return 0;
+	}
+
+	return 1;
+}
+
+/**
+ * Frees a shared object list
+ */
+static void ext_shared_destroy(ExtConfigShared *shared)
+{
+	del_configobjectlist(&shared->list);
+	free(shared);
+}
+
+/**
+ * Drops shared object lists from cache. Lists in use are freed when
+ * released.
+ *
+ * @param keep number of unused lists to be kept
+ */
+static void ext_shared_trim(int keep)
+{
+	ExtConfigShared **shared = &shared_lists;
+	int unused = 0;
+
+	while (*shared) {
+		ExtConfigShared *current = *shared;
+
+		if (keep > 0 && (current->refs > 0 || unused++ < keep)) {
+			shared = &current->next;
+			continue;
+		}
+
+		*shared = current->next;
+
+		if (current->refs > 0) {
+			current->detached = 1;
+		} else {
+			ext_shared_destroy(current);
 		}
 	}
+}
+
+/**
+ * Get the file name of a configuration saved by previous versions
+ *
+ * @param system_id system id of device
+ * @param config_id id of extented configuration
+ */
+static char *ext_configurations_get_legacy_file_name(octet_string *system_id,
+		ConfigId config_id)
+{
+	char *config_path = ioutil_get_tmp();
+	int length = strlen(config_path);
+	int i;
+
+	// each system_id element is "??", then "-????.bin" and "\0"
+	char *file_path = calloc(length + 2 * system_id->length + 10,
+				 sizeof(char));
+	strcpy(file_path, config_path);
+
+	for (i = 0; i < system_id->length; i++) {
+		length += sprintf(file_path + length, "%.2x", system_id->value[i]);
+	}
+
+	sprintf(file_path + length, "-%.4x.bin", config_id);
+	free(config_path);
+	return file_path;
+}
+
+/**
+ * Imports configurations saved by previous versions, an index file
+ * plus one file per configuration, and removes those files.
+ */
+static void ext_configurations_import_legacy()
+{
+	unsigned long buffer_size = 0;
+	char *index_path = ext_concat_path_file(EXT_CONFIG_LEGACY_FILE);
+	intu8 *buffer = ioutil_buffer_from_file(index_path, &buffer_size);
+	ByteStreamReader *stream = NULL;
+	int imported = 0;
+
+	if (buffer != NULL) {
+		stream = byte_stream_reader_instance(buffer, buffer_size);
+	}
+
+	while (stream != NULL && stream->unread_bytes > 0) {
+		octet_string system_id = {0, NULL};
+		int error = 0;
+
+		ConfigId config_id = read_intu16(stream, &error);
+
+		if (!error) {
+			decode_octet_string(stream, &system_id, &error);
+		}
+
+		if (!error) {
+			read_intu16(stream, &error); // object list size
+		}
+
+		if (error) {
+			del_octet_string(&system_id);
+			break;
+		}
+
+		unsigned long data_size = 0;
+		char *file_path = ext_configurations_get_legacy_file_name(
+					  &system_id, config_id);
+		intu8 *data = ioutil_buffer_from_file(file_path, &data_size);
+
+		if (data != NULL) {
+			imported += ext_db_store(&system_id, config_id,
+						 data, data_size);
+			free(data);
+		}
 
-	// writes particular config+device file
-	char *file_path =
-		ext_configurations_get_file_name(system_id, config_id);
-	int err = ioutil_buffer_to_file(file_path, stream->size,
-					     stream->buffer, 0);
-	free(file_path);
-	file_path = NULL;
+		remove(file_path);
+		free(file_path);
+		del_octet_string(&system_id);
+	}
 
-	if (err) {
-		ERROR("error writing ext config file");
+	if (buffer != NULL) {
+		remove(index_path);
+		DEBUG("Imported %d ext configs of previous version", imported);
 	}
+
+	free(stream);
+	free(buffer);
+	free(index_path);
+}
+
+/**
+ * This method unmaps the store of configurations but maintains
+ * persistent data for later use.
+ */
+void ext_configurations_destroy()
+{
+	gil_lock();
+	ext_db_close();
+	ext_shared_trim(0);
+	gil_unlock();
+}
+
+/**
+ * Removes all saved configurations from disk
+ */
+void ext_configurations_remove_all_configs()
+{
+	gil_lock();
+
+	ext_db_close();
+	ext_shared_trim(0);
+
+	char *path = ext_concat_path_file(EXT_CONFIG_DB_FILE);
+
+	if (remove(path) != 0 && errno != ENOENT) {
+		ERROR("\n[Error] Unable to remove file %s", path);
+	}
+
+	free(path);
+
+	gil_unlock();
+
+	mds_template_clear();
+}
+
+/**
+ * This method loads (maps) the store of configurations, creating it
+ * if needed.
+ */
+void ext_configurations_load_configurations()
+{
+	ext_configurations_create_environment();
+
+	gil_lock();
+
+	ext_db_close();
+
+	char *path = ext_concat_path_file(EXT_CONFIG_DB_FILE);
+	db_fd = open(path, O_RDWR);
+	free(path);
+
+	if (db_fd < 0) {
+		if (ext_db_rebuild(0, 0)) {
+			ext_configurations_import_legacy();
+		}
+	} else if (!ext_db_map() || !ext_db_header_valid()) {
+		ERROR("ext config store is damaged, recovering records");
+
+		if (!ext_db_rebuild(1, 0)) {
+			ext_db_close();
+		}
+	}
+
+	gil_unlock();
 }
 
 /**
@@ -396,102 +1253,33 @@ static void ext_configurations_write_file(octet_string *system_id,
 void ext_configurations_register_conf(octet_string *system_id,
 				      ConfigId config_id, ConfigObjectList *object_list)
 {
-	int new;
 	int empty;
 
 	gil_lock();
-	empty = (ext_configuration_list == NULL);
+	empty = (db_map == NULL);
 	gil_unlock();
 
 	if (empty) {
 		ext_configurations_load_configurations();
 	}
 
+	// objects built from previous version are no longer valid
+	mds_template_invalidate(config_id, system_id);
+
 	int size = object_list->length + 2 * sizeof(object_list->count);
 	ByteStreamWriter *stream = byte_stream_writer_instance(size);
-	DEBUG("Encoding %x to index", config_id);
+	DEBUG("Encoding %x to store", config_id);
 	encode_configobjectlist(stream, object_list);
 
-	struct ExtConfig *cfg = ext_configurations_get_config(system_id, config_id);
-	if (!cfg) {
-		int error = 0;
-		DEBUG("Adding new ext config %x to index", config_id);
-		new = 1;
-		gil_lock();
-		ext_configuration_size++;
-		ext_configuration_list = realloc(ext_configuration_list,
-					 ext_configuration_size * sizeof(struct ExtConfig));
-		cfg = &(ext_configuration_list[ext_configuration_size - 1]);
-
-		cfg->config_id = config_id;
-
-		size = system_id->length * sizeof(intu8) + sizeof(intu16);
-		ByteStreamWriter *w_stream = byte_stream_writer_instance(size);
-		encode_octet_string(w_stream, system_id);
-
-		ByteStreamReader *r_stream = byte_stream_reader_instance(w_stream->buffer, size);
-		// used just to alloc system_id into cfg; won't fail.
-		decode_octet_string(r_stream, &cfg->system_id, &error);
-
-		del_byte_stream_writer(w_stream, 1);
-		free(r_stream);
-		gil_unlock();
-	} else {
-		DEBUG("Updating ext config");
-		new = 0;
-	}
-
-	ext_configurations_write_file(system_id, config_id, stream, new);
-
-	cfg->obj_size = stream->size;
-
-	if (ext_configuration_list == NULL) {
-		ERROR("ext configuration list is null");
-	}
-
-	del_byte_stream_writer(stream, 1);
-}
-
-/**
- * Get extended configuration for a given system and config id
- *
- * @param system_id System ID (device identification)
- * @param config_id Extended configuration ID
- * @return Extended configuration structure or NULL if not found
- */
-static struct ExtConfig *ext_configurations_get_config(octet_string *system_id,
-		ConfigId config_id) {
-	int index;
-	
 	gil_lock();
 
-	for (index = 0; index < ext_configuration_size; index++) {
-		ConfigId selected_conf_id =
-			ext_configuration_list[index].config_id;
-		octet_string selected_sys_id =
-			ext_configuration_list[index].system_id;
-
-		if (selected_conf_id == config_id && selected_sys_id.length
-		    == system_id->length) {
-			int i = 0;
-			int is_different = 0;
-
-			while (i < selected_sys_id.length && is_different == 0) {
-				is_different |= selected_sys_id.value[i]
-						!= system_id->value[i];
-				i++;
-			}
-
-			if (is_different == 0) {
-				gil_unlock();
-				return &ext_configuration_list[index];
-			}
-		}
+	if (!ext_db_store(system_id, config_id, stream->buffer, stream->size)) {
+		ERROR("error writing ext config %x", config_id);
 	}
 
 	gil_unlock();
 
-	return NULL;
+	del_byte_stream_writer(stream, 1);
 }
 
 /**
@@ -507,7 +1295,13 @@ static struct ExtConfig *ext_configurations_get_config(octet_string *system_id,
 int ext_configurations_is_supported_standard(octet_string *system_id,
 		ConfigId config_id)
 {
-	return ext_configurations_get_config(system_id, config_id) != NULL;
+	int found;
+
+	gil_lock();
+	found = ext_db_find(system_id, config_id) != NULL;
+	gil_unlock();
+
+	return found;
 }
 
 /**
@@ -517,51 +1311,143 @@ int ext_configurations_is_supported_standard(octet_string *system_id,
  * @param config_id Identify the configuration described in the
  *					specialization document;
  *
- * @return The Extended Configuration that was recorded
+ * @return The Extended Configuration that was recorded, a private
+ * copy to be freed by caller
  */
 ConfigObjectList *ext_configurations_get_configuration_attributes(
 	octet_string *system_id, ConfigId config_id)
 {
+	ConfigObjectList *result = NULL;
 
-	struct ExtConfig *config = ext_configurations_get_config(system_id,
-				   config_id);
+	gil_lock();
 
-	if (config != NULL) {
-		ConfigId selected_cfg_id = config->config_id;
-		octet_string selected_sys_id = config->system_id;
-		unsigned long size = config->obj_size;
+	ExtConfigContent *content = ext_db_find(system_id, config_id);
 
-		char *file_path = ext_configurations_get_file_name(
-					  &selected_sys_id, selected_cfg_id);
-		intu8 *buffer = ioutil_buffer_from_file(file_path, &size);
+	if (content != NULL) {
+		result = malloc(sizeof(ConfigObjectList));
 
-		free(file_path);
-		file_path = NULL;
+		if (!ext_db_decode(content, result)) {
+			free(result);
+			result = NULL;
+		}
+	}
 
-		if (buffer == NULL) {
-			ERROR("ext_config_get could not read from file");
-			return NULL;
-		} else if (size != config->obj_size) {
-			ERROR("ext_config_get: bad obj size");
-			free(buffer);
+	gil_unlock();
+
+	return result;
+}
+
+/**
+ * Returns the Extended Configuration that was recorded, shared with
+ * every agent that registered the same configuration. It is decoded
+ * only once, while in use or among the most recently used ones.
+ *
+ * @param system_id Identify the agent;
+ * @param config_id Identify the configuration described in the
+ *					specialization document;
+ *
+ * @return The Extended Configuration, read-only, to be released by
+ * ext_configurations_release_configuration_attributes(); NULL if unknown
+ */
+ConfigObjectList *ext_configurations_acquire_configuration_attributes(
+	octet_string *system_id, ConfigId config_id)
+{
+	ExtConfigShared **previous;
+	ExtConfigShared *shared = NULL;
+	intu8 content_id[EXT_CONFIG_CONTENT_ID_SIZE];
+
+	gil_lock();
+
+	ExtConfigContent *content = ext_db_find(system_id, config_id);
+
+	if (content == NULL) {
+		gil_unlock();
+		return NULL;
+	}
+
+	ext_db_content_id(content, content_id);
+
+	for (previous = &shared_lists; *previous; previous = &(*previous)->next) {
+		if (memcmp((*previous)->content_id, content_id,
+			   EXT_CONFIG_CONTENT_ID_SIZE) == 0) {
+			shared = *previous;
+			*previous = shared->next;
+			break;
+		}
+	}
+
+	if (shared == NULL) {
+		shared = calloc(1, sizeof(ExtConfigShared));
+		memcpy(shared->content_id, content_id, EXT_CONFIG_CONTENT_ID_SIZE);
+
+		if (!ext_db_decode(content, &shared->list)) {
+			free(shared);
+			gil_unlock();
 			return NULL;
-		} else {
-			ConfigObjectList *result = malloc(sizeof(ConfigObjectList));
-			ByteStreamReader *stream = byte_stream_reader_instance(buffer, size);
-			int error = 0;
-			decode_configobjectlist(stream, result, &error);
-			if (error) {
-				ERROR("ext_config_get: bad configuration data");
-				free(result);
-				result = NULL;
-			}
-			free(stream);
-			free(buffer);
-			return result;
 		}
 	}
 
-	return NULL;
+	shared->refs++;
+	shared->next = shared_lists;
+	shared_lists = shared;
+	ext_shared_trim(EXT_CONFIG_SHARED_MAX);
+
+	gil_unlock();
+
+	return &shared->list;
+}
+
+/**
+ * Releases an Extended Configuration acquired by
+ * ext_configurations_acquire_configuration_attributes()
+ *
+ * @param object_list The configuration
+ */
+void ext_configurations_release_configuration_attributes(
+	ConfigObjectList *object_list)
+{
+	ExtConfigShared *shared = (ExtConfigShared *) object_list;
+
+	if (shared == NULL) {
+		return;
+	}
+
+	gil_lock();
+
+	if (--shared->refs == 0 && shared->detached) {
+		ext_shared_destroy(shared);
+	}
+
+	gil_unlock();
+}
+
+/**
+ * Gets the content id of a configuration. Agents that registered the
+ * same configuration have the same content id.
+ *
+ * @param system_id Identify the agent;
+ * @param config_id Identify the configuration described in the
+ *					specialization document;
+ * @param content_id filled with content id
+ *
+ * @return 1 if the configuration is known, 0 otherwise
+ */
+int ext_configurations_get_content_id(octet_string *system_id, ConfigId config_id,
+				      intu8 content_id[EXT_CONFIG_CONTENT_ID_SIZE])
+{
+	ExtConfigContent *content;
+
+	gil_lock();
+
+	content = ext_db_find(system_id, config_id);
+
+	if (content != NULL) {
+		ext_db_content_id(content, content_id);
+	}
+
+	gil_unlock();
+
+	return content != NULL;
 }
 
 /** @} */
@@ -38,6 +38,12 @@
 
 #include "src/asn1/phd_types.h"
 
+/**
+ * Size of a configuration content id: CRC-32, FNV-1a hash and length
+ * of the encoded object list
+ */
+#define EXT_CONFIG_CONTENT_ID_SIZE 12
+
 void ext_configurations_load_configurations();
 
 void ext_configurations_register_conf(octet_string *system_id,
@@ -51,6 +57,14 @@ void ext_configurations_destroy();
 
 ConfigObjectList *ext_configurations_get_configuration_attributes(octet_string *system_id, ConfigId config_id);
 
+ConfigObjectList *ext_configurations_acquire_configuration_attributes(
+	octet_string *system_id, ConfigId config_id);
+
+void ext_configurations_release_configuration_attributes(ConfigObjectList *object_list);
+
+int ext_configurations_get_content_id(octet_string *system_id, ConfigId config_id,
+				      intu8 content_id[EXT_CONFIG_CONTENT_ID_SIZE]);
+
 /** @} */
 
 #endif /* EXTCONFIGURATION_H_ */
@@ -48,6 +48,7 @@
 #include "src/communication/operating.h"
 #include "src/communication/agent_ops.h"
 #include "src/util/log.h"
+#include "src/util/pool.h"
 
 static char *fsm_state_strings[] = {
 	"disconnected",
@@ -341,24 +342,48 @@ static FsmTransitionRule IEEE11073_20601_agent_state_table[] = {
 	};
 
 
+/**
+ * Pool of state machines
+ */
+static ObjectPool fsm_pool = OBJECT_POOL_INITIALIZER(struct FSM, 16);
+
 /**
  * Construct the state machine
  * @return finite state machine
  */
 FSM *fsm_instance()
 {
-	FSM *fsm = malloc(sizeof(struct FSM));
+	FSM *fsm = pool_alloc(&fsm_pool);
 	return fsm;
 }
 
 /**
- * Destroy state machine Deallocate the memory pointed by *fsm
+ * Destroy state machine, giving its memory back to pool
  *
  * @param fsm
  */
 void fsm_destroy(FSM *fsm)
 {
-	free(fsm);
+	pool_free(&fsm_pool, fsm);
+}
+
+/**
+ * Pre-allocates state machines
+ *
+ * @param count number of state machines to keep ready
+ * @return 1 if successful, 0 otherwise
+ */
+int fsm_pool_reserve(int count)
+{
+	return pool_reserve(&fsm_pool, count);
+}
+
+/**
+ * Releases pooled state machines if none is in use
+ */
+void fsm_pool_trim()
+{
+	pool_trim(&fsm_pool);
 }
 
 /**
@@ -137,7 +137,8 @@ typedef enum {
 	FSM_EVT_DATA_CONFIGURATION_RESULT,
 	FSM_EVT_DATA_ERROR_RESULT,
 	FSM_EVT_DATA_REJECT_RESULT,
-	FSM_SVT_PHD_ASSOC_INFORMATION
+	FSM_SVT_PHD_ASSOC_INFORMATION,
+	FSM_EVT_DATA_EVENT_REPORT
 } FSMEventData_choice_values;
 
 /**
@@ -174,6 +175,7 @@ typedef struct FSMEventData {
 		ErrorResult error_result;
 		RejectResult reject_result;
 		PhdAssociationInformation assoc_information;
+		DATA_apdu *event_report;
 	} u;
 } FSMEventData;
 
@@ -226,6 +228,10 @@ FSM *fsm_instance();
 
 void fsm_destroy(FSM *fsm);
 
+int fsm_pool_reserve(int count);
+
+void fsm_pool_trim();
+
 void fsm_set_manager_state_table(FSM *fsm);
 void fsm_set_agent_state_table(FSM *fsm);
 
@@ -0,0 +1,258 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+/**
+ * \file handoff.c
+ * \brief Handoff of live connections and their protocol state between processes.
+ *
+ *
+ * Copyright (C) 2010 Signove Tecnologia Corporation.
+ * All rights reserved.
+ * Contact: Signove Tecnologia Corporation (contact@signove.com)
+ *
+ * $LICENSE_TEXT:BEGIN$
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation and appearing
+ * in the file LICENSE included in the packaging of this file; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ * $LICENSE_TEXT:END$
+ *
+ * \date Oct 18, 2026
+ */
+
+/**
+ * \addtogroup Communication
+ *
+ * A manager process may hand its connections over to another process
+ * (e.g. a newer version of itself) without the agents noticing. The
+ * transport plugin passes the connections themselves; this module
+ * saves and restores the protocol state of their contexts.
+ *
+ * Only contexts at rest can be handed over: unassociated, or operating
+ * with no confirmed request waiting for a response. The saved state
+ * holds the FSM state, the invoke id counters and the MDS attributes;
+ * MDS objects are rebuilt from the configuration, which must be known
+ * by the receiving process (standard, or extended configuration kept
+ * on disk). Stored PM-segments are not carried over.
+ *
+ * @{
+ */
+
+#include <stdlib.h>
+#include "src/communication/handoff.h"
+#include "src/communication/communication.h"
+#include "src/communication/service.h"
+#include "src/communication/stdconfigurations.h"
+#include "src/communication/extconfigurations.h"
+#include "src/communication/parser/encoder_ASN1.h"
+#include "src/communication/parser/decoder_ASN1.h"
+#include "src/communication/parser/struct_cleaner.h"
+#include "src/dim/mds.h"
+#include "src/util/log.h"
+
+/**
+ * Tells whether the state of a context may be handed over now
+ *
+ * @param ctx context, locked by caller
+ * @return 1 if context is at rest, 0 otherwise
+ */
+int handoff_context_is_ready(Context *ctx)
+{
+	fsm_states state = ctx->fsm->state;
+
+	if (!(ctx->type & MANAGER_CONTEXT)) {
+		return 0;
+	}
+
+	if (state == fsm_state_unassociated) {
+		return 1;
+	}
+
+	if (state != fsm_state_operating || ctx->mds == NULL) {
+		return 0;
+	}
+
+	return ctx->service == NULL || (ctx->service->state == READY
+					&& ctx->service->requests_count == 0);
+}
+
+/**
+ * Saves protocol state of a context
+ *
+ * @param ctx context, locked by caller
+ * @return stream with saved state (to be freed by caller with
+ *         del_byte_stream_writer(stream, 1)), or NULL if context
+ *         is not at rest
+ */
+ByteStreamWriter *handoff_export_context(Context *ctx)
+{
+	ByteStreamWriter *stream;
+	fsm_states state = ctx->fsm->state;
+
+	if (!handoff_context_is_ready(ctx)) {
+		return NULL;
+	}
+
+	stream = open_stream_writer(512);
+	write_intu16(stream, HANDOFF_VERSION);
+	write_intu16(stream, state);
+
+	if (state == fsm_state_operating) {
+		AttributeList attrs;
+
+		write_intu16(stream, ctx->service ? ctx->service->last_invoke_id
+			     : 0xF);
+		write_intu16(stream, ctx->service ? ctx->service->current_invoke_id
+			     : 0);
+
+		attrs.count = 0;
+		attrs.length = 0;
+		attrs.value = mds_get_attributes(ctx->mds, &attrs.count,
+						 &attrs.length);
+		encode_attributelist(stream, &attrs);
+		del_attributelist(&attrs);
+	}
+
+	return stream;
+}
+
+/**
+ * Rebuilds MDS of an operating context from saved attributes
+ *
+ * @param ctx context, locked by caller
+ * @param attrs saved MDS attributes
+ * @return 1 if configuration is known, 0 otherwise
+ */
+static int handoff_import_mds(Context *ctx, AttributeList *attrs)
+{
+	ConfigObjectList *config;
+	int standard;
+	int i;
+
+	if (ctx->mds != NULL) {
+		mds_destroy(ctx->mds);
+	}
+
+	ctx->mds = mds_create();
+
+	for (i = 0; i < attrs->count; ++i) {
+		mds_set_attribute(ctx->mds, &attrs->value[i]);
+	}
+
+	standard = std_configurations_is_supported_standard(
+			   ctx->mds->dev_configuration_id);
+
+	if (standard) {
+		config = std_configurations_get_configuration_attributes(
+				 ctx->mds->dev_configuration_id);
+	} else {
+		config = ext_configurations_acquire_configuration_attributes(
+				 &ctx->mds->system_id,
+				 ctx->mds->dev_configuration_id);
+	}
+
+	if (config == NULL) {
+		ERROR("handoff: configuration %d unknown",
+		      ctx->mds->dev_configuration_id);
+		return 0;
+	}
+
+	// MDS is complete before the context is seen operating
+	mds_configure_operating(ctx, config, 1);
+	communication_resume_state(ctx, fsm_state_operating);
+
+	if (!standard) {
+		ext_configurations_release_configuration_attributes(config);
+	}
+
+	return 1;
+}
+
+/**
+ * Creates context of a connection handed over by another process,
+ * restoring the saved protocol state. Listeners are told about the
+ * connection (and the association) as if it had just happened, but
+ * nothing is sent to the agent.
+ *
+ * @param id context id
+ * @param addr transport address (informative)
+ * @param data state saved by handoff_export_context()
+ * @param size size of data
+ * @return 1 if state was restored, 0 otherwise (the transport should
+ *         then be closed, and the context goes away as usual)
+ */
+int handoff_import_context(ContextId id, const char *addr,
+			   intu8 *data, intu32 size)
+{
+	ByteStreamReader *stream = byte_stream_reader_instance(data, size);
+	AttributeList attrs = {0, 0, NULL};
+	InvokeIDType last_invoke_id = 0xF;
+	InvokeIDType current_invoke_id = 0;
+	Context *ctx;
+	int error = 0;
+	int ok = 1;
+
+	intu16 version = read_intu16(stream, &error);
+	fsm_states state = read_intu16(stream, &error);
+
+	if (!error && state == fsm_state_operating) {
+		last_invoke_id = read_intu16(stream, &error);
+		current_invoke_id = read_intu16(stream, &error);
+
+		if (!error) {
+			decode_attributelist(stream, &attrs, &error);
+		}
+	}
+
+	free(stream);
+
+	if (error || version != HANDOFF_VERSION
+	    || (state != fsm_state_unassociated
+		&& state != fsm_state_operating)) {
+		ERROR("handoff: invalid state of context %u:%llu",
+		      id.plugin, id.connid);
+		del_attributelist(&attrs);
+		return 0;
+	}
+
+	if (communication_transport_connect_indication(id, addr) == NULL) {
+		del_attributelist(&attrs);
+		return 0;
+	}
+
+	ctx = context_get_and_lock(id);
+
+	if (ctx == NULL) {
+		del_attributelist(&attrs);
+		return 0;
+	}
+
+	if (state == fsm_state_operating) {
+		ok = handoff_import_mds(ctx, &attrs);
+
+		if (ok) {
+			ctx->service->last_invoke_id = last_invoke_id;
+			ctx->service->current_invoke_id = current_invoke_id;
+		}
+	}
+
+	del_attributelist(&attrs);
+	context_unlock(ctx);
+
+	if (ok) {
+		DEBUG("handoff: context %u:%llu resumed in %s", id.plugin,
+		      id.connid, fsm_state_to_string(state));
+	}
+
+	return ok;
+}
+
+/** @} */
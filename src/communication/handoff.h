@@ -0,0 +1,50 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+/**
+ * \file handoff.h
+ * \brief Handoff of live connections between processes header.
+ *
+ *
+ * Copyright (C) 2010 Signove Tecnologia Corporation.
+ * All rights reserved.
+ * Contact: Signove Tecnologia Corporation (contact@signove.com)
+ *
+ * $LICENSE_TEXT:BEGIN$
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation and appearing
+ * in the file LICENSE included in the packaging of this file; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ * $LICENSE_TEXT:END$
+ *
+ * \date Oct 18, 2026
+ */
+
+#ifndef HANDOFF_H_
+#define HANDOFF_H_
+
+#include <asn1/phd_types.h>
+#include <communication/context.h>
+#include <util/bytelib.h>
+
+/**
+ * Version of the context state format
+ */
+#define HANDOFF_VERSION 1
+
+int handoff_context_is_ready(Context *ctx);
+
+ByteStreamWriter *handoff_export_context(Context *ctx);
+
+int handoff_import_context(ContextId id, const char *addr,
+			   intu8 *data, intu32 size);
+
+#endif /* HANDOFF_H_ */
@@ -0,0 +1,189 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+/**
+ * \file manager_batch.c
+ * \brief Measurement notifications queued by manager.
+ *
+ * Copyright (C) 2010 Signove Tecnologia Corporation.
+ * All rights reserved.
+ * Contact: Signove Tecnologia Corporation (contact@signove.com)
+ *
+ * $LICENSE_TEXT:BEGIN$
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation and appearing
+ * in the file LICENSE included in the packaging of this file; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ * $LICENSE_TEXT:END$
+ *
+ * \date Oct 18, 2026
+ */
+
+/**
+ * \addtogroup Communication
+ *
+ * Agents in continuous mode may send many scan reports per second,
+ * each one turned into a measurement notification to the application.
+ * The manager may instead queue the data of a device and notify it in
+ * one list, which holds the entries of every queued report in order
+ * of arrival; each entry keeps its own attributes, time stamps
+ * included.
+ *
+ * This module only keeps the queue of a context; the policy of when
+ * a batch is notified belongs to the manager (see
+ * manager_set_measurement_batching()).
+ *
+ * @{
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "src/communication/manager_batch.h"
+#include "src/communication/stats.h"
+#include "src/api/data_list.h"
+
+/**
+ * Measurement data queued by a context
+ */
+struct ManagerBatch {
+	/**
+	 * Queued entries
+	 */
+	DataEntry *entries;
+	/**
+	 * Number of queued entries
+	 */
+	int count;
+	/**
+	 * Allocated entries
+	 */
+	int capacity;
+	/**
+	 * Number of queued reports
+	 */
+	int reports;
+	/**
+	 * When the first queued report arrived (microseconds)
+	 */
+	unsigned long long first_at;
+};
+
+/**
+ * Queues the data of a report, taking ownership of the list
+ *
+ * @param ctx context
+ * @param data_list measurement data
+ * @return number of queued reports
+ */
+int manager_batch_add(Context *ctx, DataList *data_list)
+{
+	struct ManagerBatch *batch = ctx->manager_batch;
+
+	if (batch == NULL) {
+		batch = ctx->manager_batch = calloc(1, sizeof(struct ManagerBatch));
+	}
+
+	if (batch->count + data_list->size > batch->capacity) {
+		batch->capacity = (batch->count + data_list->size) * 2;
+		batch->entries = realloc(batch->entries,
+					 batch->capacity * sizeof(DataEntry));
+	}
+
+	if (batch->reports == 0) {
+		batch->first_at = stats_time();
+	}
+
+	// entries are moved, not copied
+	memcpy(batch->entries + batch->count, data_list->values,
+	       data_list->size * sizeof(DataEntry));
+	batch->count += data_list->size;
+	batch->reports++;
+
+	data_list->size = 0;
+	data_list_del(data_list);
+
+	return batch->reports;
+}
+
+/**
+ * Returns number of queued reports
+ *
+ * @param ctx context
+ * @return number of reports
+ */
+int manager_batch_reports(Context *ctx)
+{
+	return ctx->manager_batch ? ctx->manager_batch->reports : 0;
+}
+
+/**
+ * Returns when the oldest queued report arrived
+ *
+ * @param ctx context
+ * @return time in microseconds (see stats_time()), 0 if nothing is
+ * queued
+ */
+unsigned long long manager_batch_first_at(Context *ctx)
+{
+	if (manager_batch_reports(ctx) == 0) {
+		return 0;
+	}
+
+	return ctx->manager_batch->first_at;
+}
+
+/**
+ * Takes the queued data as a single list, emptying the queue
+ *
+ * @param ctx context
+ * @return measurement data, freed by caller; NULL if nothing is queued
+ */
+DataList *manager_batch_take(Context *ctx)
+{
+	struct ManagerBatch *batch = ctx->manager_batch;
+	DataList *data_list;
+
+	if (batch == NULL || batch->reports == 0) {
+		return NULL;
+	}
+
+	data_list = calloc(1, sizeof(DataList));
+	data_list->size = batch->count;
+	data_list->values = batch->entries;
+
+	batch->entries = NULL;
+	batch->count = 0;
+	batch->capacity = 0;
+	batch->reports = 0;
+
+	return data_list;
+}
+
+/**
+ * Frees the batch of a context, dropping queued data
+ *
+ * @param batch batch, may be NULL
+ */
+void manager_batch_destroy(struct ManagerBatch *batch)
+{
+	if (batch != NULL) {
+		int i;
+
+		for (i = 0; i < batch->count; ++i) {
+			data_entry_del(&batch->entries[i]);
+		}
+
+		free(batch->entries);
+		free(batch);
+	}
+}
+
+/** @} */
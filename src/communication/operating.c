@@ -44,6 +44,7 @@
 #include "src/communication/communication.h"
 #include "src/communication/operating.h"
 #include "src/communication/disassociating.h"
+#include "src/communication/stats.h"
 #include "src/communication/parser/struct_cleaner.h"
 #include "src/util/bytelib.h"
 #include "src/communication/parser/decoder_ASN1.h"
@@ -534,7 +535,33 @@ void operating_event_report(Context *ctx, fsm_events evt, FSMEventData *data)
 }
 
 /**
- * Assembles and send event report response.
+ * Encoded confirmed event report response with empty reply info.
+ * Invoke id, object handle, time and event type are patched in.
+ */
+static const intu8 event_report_response_template[] = {
+	0xE7, 0x00, 0x00, 0x12,	// PRST, APDU length
+	0x00, 0x10,		// octet string length
+	0x00, 0x00,		// invoke id
+	0x02, 0x01,		// rors-cmip-confirmed-event-report
+	0x00, 0x0A,		// message length
+	0x00, 0x00,		// object handle
+	0x00, 0x00, 0x00, 0x00,	// current time
+	0x00, 0x00,		// event type
+	0x00, 0x00		// event reply info length
+};
+
+/**
+ * Writes a 16-bit big endian value into encoded APDU
+ */
+static void patch_intu16(intu8 *p, intu16 value)
+{
+	p[0] = value >> 8;
+	p[1] = value & 0xff;
+}
+
+/**
+ * Assembles and send event report response. Responses with empty reply
+ * info, by far the most common, are patched from a pre-encoded template.
  *
  * @param ctx
  * @param invoke_id Response invokeID matching event report request.
@@ -547,6 +574,23 @@ void operating_event_report_response_tx(Context *ctx, InvokeIDType invoke_id, AS
 					RelativeTime currentTime, OID_Type event_type,
 					Any event_reply_info)
 {
+	if (event_reply_info.length == 0) {
+		// most common case, no need to build and encode APDU
+		intu8 buffer[sizeof(event_report_response_template)];
+		ByteStreamWriter stream = {sizeof(buffer), buffer, sizeof(buffer), 0};
+
+		memcpy(buffer, event_report_response_template, sizeof(buffer));
+		patch_intu16(buffer + 6, invoke_id);
+		patch_intu16(buffer + 12, obj_handle);
+		patch_intu16(buffer + 14, currentTime >> 16);
+		patch_intu16(buffer + 16, currentTime & 0xffff);
+		patch_intu16(buffer + 18, event_type);
+
+		communication_send_encoded_apdu(ctx, &stream);
+		stats_event_report_acked(ctx);
+		return;
+	}
+
 	APDU apdu;
 	memset(&apdu, 0, sizeof(APDU));
 	apdu.choice = PRST_CHOSEN;
@@ -578,6 +622,7 @@ void operating_event_report_response_tx(Context *ctx, InvokeIDType invoke_id, AS
 	apdu.length = sizeof(apdu.u.prst.length) + apdu.u.prst.length;
 	encode_set_data_apdu(&apdu.u.prst, &data_apdu);
 	communication_send_apdu(ctx, &apdu);
+	stats_event_report_acked(ctx);
 }
 
 /**
@@ -630,6 +675,7 @@ void operating_segment_data_event_response_tx(Context *ctx, InvokeIDType invoke_
 
 	encode_set_data_apdu(&apdu.u.prst, &data_apdu);
 	communication_send_apdu(ctx, &apdu);
+	stats_event_report_acked(ctx);
 	del_byte_stream_writer(writer, 1);
 }
 
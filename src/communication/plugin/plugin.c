@@ -69,6 +69,20 @@ static void stub_thread_init_ptr(PluginContext *ctx)
 static void stub_thread_finalize_ptr(PluginContext *ctx)
 {
 
+}
+/**
+ * Stub function implementation
+ */
+static int stub_thread_reserve_ptr(int count)
+{
+	return 1;
+}
+/**
+ * Stub function implementation
+ */
+static void stub_thread_trim_ptr()
+{
+
 }
 /**
  * Stub function implementation
@@ -145,6 +159,8 @@ CommunicationPlugin communication_plugin()
 		.thread_unlock = stub_thread_unlock_ptr,
 		.thread_init = stub_thread_init_ptr,
 		.thread_finalize = stub_thread_finalize_ptr,
+		.thread_reserve = stub_thread_reserve_ptr,
+		.thread_trim = stub_thread_trim_ptr,
 		.timer_count_timeout = stub_timer_count_timeout_ptr,
 		.timer_reset_timeout = stub_timer_reset_timeout_ptr,
 		.timer_wait_for_timeout = stub_timer_wait_for_timeout_ptr,
@@ -169,6 +185,8 @@ void communication_plugin_clear(CommunicationPlugin *plugin)
 	plugin->thread_unlock = NULL;
 	plugin->thread_init = NULL;
 	plugin->thread_finalize = NULL;
+	plugin->thread_reserve = NULL;
+	plugin->thread_trim = NULL;
 	plugin->timer_count_timeout = NULL;
 	plugin->timer_reset_timeout = NULL;
 	plugin->timer_wait_for_timeout = NULL;
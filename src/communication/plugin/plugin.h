@@ -59,6 +59,8 @@
 			.network_finalize = NULL,\
 			.thread_init = NULL,\
 			.thread_finalize = NULL,\
+			.thread_reserve = NULL,\
+			.thread_trim = NULL,\
 			.thread_lock = NULL,\
 			.thread_unlock = NULL,\
 			.timer_count_timeout = NULL,\
@@ -88,6 +90,14 @@ typedef void (*thread_init_ptr)(PluginContext *ctx);
  * Function prototype for Multithread support
  */
 typedef void (*thread_finalize_ptr)(PluginContext *ctx);
+/**
+ * Function prototype for Multithread support
+ */
+typedef int (*thread_reserve_ptr)(int count);
+/**
+ * Function prototype for Multithread support
+ */
+typedef void (*thread_trim_ptr)();
 
 /**
  * Function prototype for Network support
@@ -207,6 +217,19 @@ typedef struct CommunicationPlugin {
 	 */
 	thread_finalize_ptr thread_finalize;
 
+	/**
+	 * Pre-allocates multithreading structures of count contexts.
+	 * Optional.
+	 */
+	thread_reserve_ptr thread_reserve;
+
+	/**
+	 * Releases multithreading structures no longer in use, and
+	 * resources shared by them. Called when communication layer
+	 * finalizes, after all contexts are gone. Optional.
+	 */
+	thread_trim_ptr thread_trim;
+
 	/**
 	 * Waits X seconds for timeout and execute callback function.
 	 */
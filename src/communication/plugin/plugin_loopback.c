@@ -0,0 +1,716 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+/**
+ * \file plugin_loopback.c
+ * \brief In-process loopback plugin source.
+ *
+ * Copyright (C) 2010 Signove Tecnologia Corporation.
+ * All rights reserved.
+ * Contact: Signove Tecnologia Corporation (contact@signove.com)
+ *
+ * $LICENSE_TEXT:BEGIN$
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation and appearing
+ * in the file LICENSE included in the packaging of this file; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ * $LICENSE_TEXT:END$
+ *
+ * \date Oct 18, 2026
+ */
+
+/**
+ * @addtogroup LoopbackPlugin
+ * @{
+ *
+ * Connects agent and manager contexts living in the same process, so
+ * the protocol layers can be exercised without sockets or syscalls.
+ *
+ * The plugin fills two CommunicationPlugin structs: one must be passed
+ * to manager_init() and the other to agent_init(). Each pair N is seen
+ * as connection id N by both sides, and owns two lock-free
+ * single-producer single-consumer queues, one per direction.
+ *
+ * Data is delivered by plugin_loopback_process(), which drains the
+ * queues of one side (or both) and feeds the APDUs to the stack. A
+ * program may run both sides in a single thread, or run one thread for
+ * manager side and another for agent side. In the latter case, APDUs of
+ * a given context must be sent from one thread at a time; the context
+ * lock of the pthread plugin is enough to guarantee that.
+ */
+
+#include "src/communication/communication.h"
+#include "src/communication/context_manager.h"
+#include "src/communication/plugin/plugin_loopback.h"
+#include "src/util/ringbuff.h"
+#include "src/util/log.h"
+#include <stdlib.h>
+#include <sched.h>
+
+/**
+ * \cond Undocumented
+ */
+#define LOOPBACK_MANAGER 0
+#define LOOPBACK_AGENT 1
+
+static const int LOOPBACK_ERROR = NETWORK_ERROR;
+static const int LOOPBACK_ERROR_NONE = NETWORK_ERROR_NONE;
+/**
+ * \endcond
+ */
+
+/**
+ * Size of APDU header (choice + length)
+ */
+#define APDU_HEADER_SIZE 4
+
+/**
+ * A connected agent/manager couple
+ */
+typedef struct LoopbackPair {
+	/**
+	 * Incoming queues, indexed by side (queue[LOOPBACK_MANAGER]
+	 * carries APDUs sent by agent to manager)
+	 */
+	RingBuffer *queue[2];
+
+	/**
+	 * Side still has a live context for this pair
+	 */
+	int open[2];
+
+	/**
+	 * Link is up; cleared by either side to disconnect
+	 */
+	int connected;
+} LoopbackPair;
+
+/**
+ * Pair table; pair N is at index N - 1
+ */
+static LoopbackPair *pairs = NULL;
+
+/**
+ * Number of pairs
+ */
+static unsigned int pair_count = 0;
+
+/**
+ * Plugin IDs attributed by stack, indexed by side
+ */
+static unsigned int plugin_ids[2] = {0, 0};
+
+/**
+ * APDUs that did not fit in the destination queue
+ */
+static unsigned long long dropped_apdus = 0;
+
+/**
+ * Returns side that a context belongs to
+ *
+ * @param ctx context
+ * @return LOOPBACK_MANAGER or LOOPBACK_AGENT
+ */
+static int side_of(Context *ctx)
+{
+	return (ctx->type & MANAGER_CONTEXT) ? LOOPBACK_MANAGER : LOOPBACK_AGENT;
+}
+
+/**
+ * Gets pair by connection id
+ *
+ * @param connid connection id
+ * @return pair or NULL if out of range
+ */
+static LoopbackPair *get_pair(unsigned long long connid)
+{
+	if (connid < 1 || connid > pair_count) {
+		return NULL;
+	}
+
+	return &pairs[connid - 1];
+}
+
+/**
+ * Tells whether link is up
+ */
+static int is_connected(LoopbackPair *p)
+{
+	return __atomic_load_n(&p->connected, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * Tells whether side has a live context
+ */
+static int is_open(LoopbackPair *p, int side)
+{
+	return __atomic_load_n(&p->open[side], __ATOMIC_ACQUIRE);
+}
+
+/**
+ * Closes one side of a pair and notifies the stack
+ *
+ * @param p pair
+ * @param side side to close
+ * @param connid connection id of pair
+ */
+static void close_side(LoopbackPair *p, int side, unsigned long long connid)
+{
+	ContextId cid = {plugin_ids[side], connid};
+
+	__atomic_store_n(&p->open[side], 0, __ATOMIC_RELEASE);
+	communication_transport_disconnect_indication(cid, "loopback");
+}
+
+/**
+ * Pops a complete APDU from the incoming queue of a side
+ *
+ * @param p pair
+ * @param side side
+ * @return byte stream or NULL if queue is empty
+ */
+static ByteStreamReader *read_apdu(LoopbackPair *p, int side)
+{
+	RingBuffer *queue = p->queue[side];
+	intu8 header[APDU_HEADER_SIZE];
+
+	// senders push whole APDUs, so a visible header means
+	// the rest of the APDU is visible as well
+	if (!ringbuff_peek(queue, header, APDU_HEADER_SIZE)) {
+		return NULL;
+	}
+
+	intu32 apdu_size = (header[2] << 8 | header[3]) + APDU_HEADER_SIZE;
+	intu8 *buffer = malloc(apdu_size);
+
+	if (buffer == NULL || !ringbuff_read(queue, buffer, apdu_size)) {
+		ERROR("network loopback: cannot pop APDU of %d bytes", apdu_size);
+		free(buffer);
+		return NULL;
+	}
+
+	ByteStreamReader *stream = byte_stream_reader_instance(buffer, apdu_size);
+
+	if (stream == NULL) {
+		free(buffer);
+	}
+
+	return stream;
+}
+
+/**
+ * Initializes manager side
+ *
+ * @param plugin_label the Plugin ID or label attributed by stack to this plugin
+ * @return LOOPBACK_ERROR_NONE
+ */
+static int network_init_manager(unsigned int plugin_label)
+{
+	plugin_ids[LOOPBACK_MANAGER] = plugin_label;
+	return LOOPBACK_ERROR_NONE;
+}
+
+/**
+ * Initializes agent side
+ *
+ * @param plugin_label the Plugin ID or label attributed by stack to this plugin
+ * @return LOOPBACK_ERROR_NONE
+ */
+static int network_init_agent(unsigned int plugin_label)
+{
+	plugin_ids[LOOPBACK_AGENT] = plugin_label;
+	return LOOPBACK_ERROR_NONE;
+}
+
+/**
+ * Brings one side down; all its pairs are disconnected
+ *
+ * @param side side
+ */
+static void finalize_side(int side)
+{
+	unsigned int i;
+
+	for (i = 0; i < pair_count; ++i) {
+		__atomic_store_n(&pairs[i].connected, 0, __ATOMIC_RELEASE);
+		__atomic_store_n(&pairs[i].open[side], 0, __ATOMIC_RELEASE);
+	}
+
+	plugin_ids[side] = 0;
+}
+
+/**
+ * Finalizes manager side
+ *
+ * @return LOOPBACK_ERROR_NONE
+ */
+static int network_finalize_manager()
+{
+	finalize_side(LOOPBACK_MANAGER);
+	return LOOPBACK_ERROR_NONE;
+}
+
+/**
+ * Finalizes agent side
+ *
+ * @return LOOPBACK_ERROR_NONE
+ */
+static int network_finalize_agent()
+{
+	finalize_side(LOOPBACK_AGENT);
+	return LOOPBACK_ERROR_NONE;
+}
+
+/**
+ * Blocks until an APDU is available or the peer disconnects.
+ * Only used when the stack connection loop drives the context;
+ * plugin_loopback_process() does not need it.
+ *
+ * @param ctx current connection context.
+ * @return LOOPBACK_ERROR_NONE if data (or disconnection) is pending
+ */
+static int network_wait_for_data(Context *ctx)
+{
+	LoopbackPair *p = get_pair(ctx->id.connid);
+	int side = side_of(ctx);
+
+	if (p == NULL) {
+		return LOOPBACK_ERROR;
+	}
+
+	while (is_open(p, side) && is_connected(p)
+	       && ringbuff_used(p->queue[side]) < APDU_HEADER_SIZE) {
+		sched_yield();
+	}
+
+	return LOOPBACK_ERROR_NONE;
+}
+
+/**
+ * Reads an APDU from the incoming queue of context
+ *
+ * @param ctx context
+ * @return a byteStream with the read APDU or NULL if none.
+ */
+static ByteStreamReader *network_get_apdu_stream(Context *ctx)
+{
+	LoopbackPair *p = get_pair(ctx->id.connid);
+	int side = side_of(ctx);
+
+	if (p == NULL) {
+		ERROR("network loopback: unknown pair %llu", ctx->id.connid);
+		return NULL;
+	}
+
+	ByteStreamReader *stream = read_apdu(p, side);
+
+	if (stream == NULL && !is_connected(p) && is_open(p, side)) {
+		close_side(p, side, ctx->id.connid);
+	}
+
+	return stream;
+}
+
+/**
+ * Pushes an encoded APDU to the peer queue
+ *
+ * @param ctx context
+ * @param stream the apdu to be sent
+ * @return LOOPBACK_ERROR_NONE if data was queued, LOOPBACK_ERROR otherwise
+ */
+static int network_send_apdu_stream(Context *ctx, ByteStreamWriter *stream)
+{
+	LoopbackPair *p = get_pair(ctx->id.connid);
+	int peer = 1 - side_of(ctx);
+
+	if (p == NULL || !is_connected(p)) {
+		return LOOPBACK_ERROR;
+	}
+
+	if (!ringbuff_write(p->queue[peer], stream->buffer, stream->size)) {
+		__atomic_add_fetch(&dropped_apdus, 1, __ATOMIC_RELAXED);
+		DEBUG("network loopback: queue of pair %llu is full",
+		      ctx->id.connid);
+		return LOOPBACK_ERROR;
+	}
+
+	return LOOPBACK_ERROR_NONE;
+}
+
+/**
+ * Brings pair link down. Each side is notified of disconnection when
+ * it drains its queue.
+ *
+ * @param ctx context
+ * @return LOOPBACK_ERROR_NONE
+ */
+static int network_disconnect(Context *ctx)
+{
+	LoopbackPair *p = get_pair(ctx->id.connid);
+
+	if (p == NULL) {
+		return LOOPBACK_ERROR;
+	}
+
+	__atomic_store_n(&p->connected, 0, __ATOMIC_RELEASE);
+
+	return LOOPBACK_ERROR_NONE;
+}
+
+/**
+ * Releases pair table
+ */
+static void destroy_pairs()
+{
+	unsigned int i;
+
+	for (i = 0; i < pair_count; ++i) {
+		ringbuff_del(pairs[i].queue[LOOPBACK_MANAGER]);
+		ringbuff_del(pairs[i].queue[LOOPBACK_AGENT]);
+	}
+
+	free(pairs);
+	pairs = NULL;
+	pair_count = 0;
+}
+
+/**
+ * Connects a pair: manager side context is created first, as if it
+ * accepted a connection, then the agent side context.
+ *
+ * Pair must be fully disconnected (both sides notified).
+ *
+ * @param pair pair number, from 1 to number of pairs
+ * @return LOOPBACK_ERROR_NONE if connected
+ */
+int plugin_loopback_connect(unsigned int pair)
+{
+	LoopbackPair *p = get_pair(pair);
+
+	if (p == NULL || !plugin_ids[LOOPBACK_MANAGER]
+	    || !plugin_ids[LOOPBACK_AGENT]) {
+		ERROR("network loopback: cannot connect pair %u", pair);
+		return LOOPBACK_ERROR;
+	}
+
+	if (is_connected(p) || is_open(p, LOOPBACK_MANAGER)
+	    || is_open(p, LOOPBACK_AGENT)) {
+		DEBUG("network loopback: pair %u still in use", pair);
+		return LOOPBACK_ERROR;
+	}
+
+	ringbuff_reset(p->queue[LOOPBACK_MANAGER]);
+	ringbuff_reset(p->queue[LOOPBACK_AGENT]);
+
+	__atomic_store_n(&p->open[LOOPBACK_MANAGER], 1, __ATOMIC_RELEASE);
+	__atomic_store_n(&p->open[LOOPBACK_AGENT], 1, __ATOMIC_RELEASE);
+	__atomic_store_n(&p->connected, 1, __ATOMIC_RELEASE);
+
+	ContextId mgr_cid = {plugin_ids[LOOPBACK_MANAGER], pair};
+	communication_transport_connect_indication(mgr_cid, "loopback");
+
+	ContextId agent_cid = {plugin_ids[LOOPBACK_AGENT], pair};
+	communication_transport_connect_indication(agent_cid, "loopback");
+
+	return LOOPBACK_ERROR_NONE;
+}
+
+/**
+ * Connects a pair whose agent side is played directly by the
+ * application, which exchanges encoded APDUs with the manager context
+ * through plugin_loopback_peer_send() and plugin_loopback_peer_recv().
+ *
+ * @param pair pair number, from 1 to number of pairs
+ * @return LOOPBACK_ERROR_NONE if connected
+ */
+int plugin_loopback_peer_connect(unsigned int pair)
+{
+	LoopbackPair *p = get_pair(pair);
+
+	if (p == NULL || !plugin_ids[LOOPBACK_MANAGER]) {
+		ERROR("network loopback: cannot connect pair %u", pair);
+		return LOOPBACK_ERROR;
+	}
+
+	if (is_connected(p) || is_open(p, LOOPBACK_MANAGER)
+	    || is_open(p, LOOPBACK_AGENT)) {
+		DEBUG("network loopback: pair %u still in use", pair);
+		return LOOPBACK_ERROR;
+	}
+
+	ringbuff_reset(p->queue[LOOPBACK_MANAGER]);
+	ringbuff_reset(p->queue[LOOPBACK_AGENT]);
+
+	__atomic_store_n(&p->open[LOOPBACK_MANAGER], 1, __ATOMIC_RELEASE);
+	__atomic_store_n(&p->connected, 1, __ATOMIC_RELEASE);
+
+	ContextId mgr_cid = {plugin_ids[LOOPBACK_MANAGER], pair};
+	communication_transport_connect_indication(mgr_cid, "loopback");
+
+	return LOOPBACK_ERROR_NONE;
+}
+
+/**
+ * Sends an encoded APDU to the manager context of a pair connected by
+ * plugin_loopback_peer_connect()
+ *
+ * @param pair pair number
+ * @param apdu encoded APDU, header included
+ * @param len APDU length
+ * @return LOOPBACK_ERROR_NONE if queued
+ */
+int plugin_loopback_peer_send(unsigned int pair, const intu8 *apdu,
+			      intu32 len)
+{
+	LoopbackPair *p = get_pair(pair);
+
+	if (p == NULL || !is_connected(p)) {
+		return LOOPBACK_ERROR;
+	}
+
+	if (!ringbuff_write(p->queue[LOOPBACK_MANAGER], apdu, len)) {
+		__atomic_add_fetch(&dropped_apdus, 1, __ATOMIC_RELAXED);
+		return LOOPBACK_ERROR;
+	}
+
+	return LOOPBACK_ERROR_NONE;
+}
+
+/**
+ * Pops an encoded APDU sent by the manager context of a pair
+ * connected by plugin_loopback_peer_connect()
+ *
+ * @param pair pair number
+ * @param buffer destination
+ * @param size buffer size
+ * @return APDU length, 0 if there is none, -1 if it does not fit
+ */
+int plugin_loopback_peer_recv(unsigned int pair, intu8 *buffer,
+			      intu32 size)
+{
+	LoopbackPair *p = get_pair(pair);
+	intu8 header[APDU_HEADER_SIZE];
+
+	if (p == NULL || !ringbuff_peek(p->queue[LOOPBACK_AGENT], header,
+					APDU_HEADER_SIZE)) {
+		return 0;
+	}
+
+	intu32 apdu_size = (header[2] << 8 | header[3]) + APDU_HEADER_SIZE;
+
+	if (apdu_size > size) {
+		return -1;
+	}
+
+	ringbuff_read(p->queue[LOOPBACK_AGENT], buffer, apdu_size);
+
+	return apdu_size;
+}
+
+/**
+ * Brings down the link of a pair connected by
+ * plugin_loopback_peer_connect(). Manager is notified when it
+ * drains its queue.
+ *
+ * @param pair pair number
+ */
+void plugin_loopback_peer_disconnect(unsigned int pair)
+{
+	LoopbackPair *p = get_pair(pair);
+
+	if (p != NULL) {
+		__atomic_store_n(&p->connected, 0, __ATOMIC_RELEASE);
+	}
+}
+
+/**
+ * Tells whether a pair has its link up
+ *
+ * @param pair pair number
+ * @return 1 if connected
+ */
+int plugin_loopback_is_connected(unsigned int pair)
+{
+	LoopbackPair *p = get_pair(pair);
+	return p != NULL && is_connected(p);
+}
+
+/**
+ * Drains incoming queues of one side for all pairs
+ *
+ * @param side side
+ * @return number of APDUs delivered to stack
+ */
+static int process_side(int side)
+{
+	unsigned int i;
+	int count = 0;
+
+	if (!plugin_ids[side]) {
+		return 0;
+	}
+
+	for (i = 0; i < pair_count; ++i) {
+		LoopbackPair *p = &pairs[i];
+
+		if (!is_open(p, side)) {
+			continue;
+		}
+
+		if (ringbuff_used(p->queue[side]) >= APDU_HEADER_SIZE) {
+			ContextId cid = {plugin_ids[side], i + 1};
+			Context *ctx = context_get_and_lock(cid);
+			ByteStreamReader *stream;
+
+			if (ctx == NULL) {
+				__atomic_store_n(&p->open[side], 0, __ATOMIC_RELEASE);
+				continue;
+			}
+
+			while (is_open(p, side) && (stream = read_apdu(p, side))) {
+				communication_process_input_data(ctx, stream);
+				++count;
+			}
+
+			context_unlock(ctx);
+		}
+
+		if (!is_connected(p) && is_open(p, side)) {
+			close_side(p, side, i + 1);
+		}
+	}
+
+	return count;
+}
+
+/**
+ * Delivers pending APDUs to the stack. Must be called repeatedly by the
+ * application, e.g. in its main loop, since the plugin has no thread of
+ * its own.
+ *
+ * @param context_type MANAGER_CONTEXT, AGENT_CONTEXT or both (ORed)
+ * @return number of APDUs delivered
+ */
+int plugin_loopback_process(int context_type)
+{
+	int count = 0;
+
+	if (context_type & MANAGER_CONTEXT) {
+		count += process_side(LOOPBACK_MANAGER);
+	}
+
+	if (context_type & AGENT_CONTEXT) {
+		count += process_side(LOOPBACK_AGENT);
+	}
+
+	return count;
+}
+
+/**
+ * Returns number of pairs
+ *
+ * @return pair count
+ */
+unsigned int plugin_loopback_pair_count()
+{
+	return pair_count;
+}
+
+/**
+ * Returns number of APDUs lost because the destination queue was full
+ *
+ * @return APDU count
+ */
+unsigned long long plugin_loopback_dropped_apdus()
+{
+	return __atomic_load_n(&dropped_apdus, __ATOMIC_RELAXED);
+}
+
+/**
+ * Initiates manager and agent CommunicationPlugin structs to use the
+ * in-process loopback transport.
+ *
+ * Either plugin may be NULL; the application may then play that side
+ * itself with plugin_loopback_peer_*() functions, bypassing the stack.
+ *
+ * @param manager_plugin plugin to be passed to manager_init()
+ * @param agent_plugin plugin to be passed to agent_init()
+ * @param npairs number of agent/manager pairs
+ * @param queue_size size of each direction queue, in bytes (0 = default)
+ * @return LOOPBACK_ERROR if error
+ */
+int plugin_loopback_setup(CommunicationPlugin *manager_plugin,
+			  CommunicationPlugin *agent_plugin,
+			  unsigned int npairs, unsigned int queue_size)
+{
+	unsigned int i;
+
+	DEBUG("network loopback: initializing %u pairs", npairs);
+
+	if (pairs) {
+		// plugin was already initialized once
+		destroy_pairs();
+	}
+
+	if (queue_size == 0) {
+		queue_size = LOOPBACK_DEFAULT_QUEUE_SIZE;
+	}
+
+	pairs = calloc(npairs, sizeof(LoopbackPair));
+
+	if (pairs == NULL) {
+		ERROR("network loopback: cannot allocate %u pairs", npairs);
+		return LOOPBACK_ERROR;
+	}
+
+	pair_count = npairs;
+
+	for (i = 0; i < npairs; ++i) {
+		pairs[i].queue[LOOPBACK_MANAGER] = ringbuff_new(queue_size);
+		pairs[i].queue[LOOPBACK_AGENT] = ringbuff_new(queue_size);
+
+		if (!pairs[i].queue[LOOPBACK_MANAGER]
+		    || !pairs[i].queue[LOOPBACK_AGENT]) {
+			ERROR("network loopback: cannot allocate queues");
+			destroy_pairs();
+			return LOOPBACK_ERROR;
+		}
+	}
+
+	dropped_apdus = 0;
+
+	if (manager_plugin) {
+		manager_plugin->network_init = network_init_manager;
+		manager_plugin->network_finalize = network_finalize_manager;
+	}
+
+	if (agent_plugin) {
+		agent_plugin->network_init = network_init_agent;
+		agent_plugin->network_finalize = network_finalize_agent;
+	}
+
+	CommunicationPlugin *plugin[] = {manager_plugin, agent_plugin};
+
+	for (i = 0; i < 2; ++i) {
+		if (!plugin[i]) {
+			continue;
+		}
+
+		plugin[i]->network_wait_for_data = network_wait_for_data;
+		plugin[i]->network_get_apdu_stream = network_get_apdu_stream;
+		plugin[i]->network_send_apdu_stream = network_send_apdu_stream;
+		plugin[i]->network_disconnect = network_disconnect;
+	}
+
+	return LOOPBACK_ERROR_NONE;
+}
+
+/** @} */
@@ -0,0 +1,64 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+/**
+ * \file plugin_loopback.h
+ * \brief In-process loopback plugin header.
+ *
+ * Copyright (C) 2010 Signove Tecnologia Corporation.
+ * All rights reserved.
+ * Contact: Signove Tecnologia Corporation (contact@signove.com)
+ *
+ * $LICENSE_TEXT:BEGIN$
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation and appearing
+ * in the file LICENSE included in the packaging of this file; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ * $LICENSE_TEXT:END$
+ *
+ * \date Oct 18, 2026
+ */
+
+#ifndef PLUGIN_LOOPBACK_H_
+#define PLUGIN_LOOPBACK_H_
+
+#include <communication/plugin/plugin.h>
+
+/**
+ * Default size of each direction queue of a pair
+ */
+#define LOOPBACK_DEFAULT_QUEUE_SIZE 16384
+
+int plugin_loopback_setup(CommunicationPlugin *manager_plugin,
+			  CommunicationPlugin *agent_plugin,
+			  unsigned int pairs, unsigned int queue_size);
+
+unsigned int plugin_loopback_pair_count();
+
+int plugin_loopback_connect(unsigned int pair);
+
+int plugin_loopback_is_connected(unsigned int pair);
+
+int plugin_loopback_process(int context_type);
+
+int plugin_loopback_peer_connect(unsigned int pair);
+
+int plugin_loopback_peer_send(unsigned int pair, const intu8 *apdu,
+			      intu32 len);
+
+int plugin_loopback_peer_recv(unsigned int pair, intu8 *buffer,
+			      intu32 size);
+
+void plugin_loopback_peer_disconnect(unsigned int pair);
+
+unsigned long long plugin_loopback_dropped_apdus();
+
+#endif /* PLUGIN_LOOPBACK_H_ */
@@ -38,6 +38,7 @@
 #include "src/util/log.h"
 #include "src/communication/communication.h"
 #include "src/communication/context_manager.h"
+#include "src/util/pool.h"
 #include <pthread.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -54,6 +55,21 @@ static pthread_mutex_t gil;
  */
 static pthread_mutexattr_t gil_attr;
 
+/**
+ * Attributes of context mutexes, shared by all contexts
+ */
+static pthread_mutexattr_t ctx_mutex_attr;
+
+/**
+ * Non-zero while ctx_mutex_attr is initialized
+ */
+static int ctx_mutex_attr_ready = 0;
+
+/**
+ * Pool of thread contexts
+ */
+static ObjectPool thread_ctx_pool = OBJECT_POOL_INITIALIZER(ThreadContext, 16);
+
 /*
  * Get multithreading control structure of a context
  * @param ctx context
@@ -77,14 +93,37 @@ static void plugin_pthread_ctx_init(Context *ctx)
 	if (!ctx)
 		return;
 
-	ctx->multithread = calloc(1, sizeof(ThreadContext));
+	ctx->multithread = pool_alloc(&thread_ctx_pool);
 	ThreadContext *thread_ctx = (ThreadContext *) ctx->multithread;
 
 	// Initialize communication mutex
-	pthread_mutexattr_init(&thread_ctx->mutex_attr);
-	pthread_mutexattr_settype(&thread_ctx->mutex_attr,
-				  PTHREAD_MUTEX_RECURSIVE_NP);
-	pthread_mutex_init(&thread_ctx->mutex, &thread_ctx->mutex_attr);
+	pthread_mutex_init(&thread_ctx->mutex, &ctx_mutex_attr);
+}
+
+/**
+ * Pre-allocates thread contexts
+ *
+ * @param count number of contexts
+ * @return 1 if successful, 0 otherwise
+ */
+static int plugin_pthread_reserve(int count)
+{
+	return pool_reserve(&thread_ctx_pool, count);
+}
+
+/**
+ * Releases pooled thread contexts and context mutex attributes.
+ * Called once all contexts are finalized; plugin_pthread_setup()
+ * must be called again before contexts are created.
+ */
+static void plugin_pthread_trim()
+{
+	pool_trim(&thread_ctx_pool);
+
+	if (ctx_mutex_attr_ready) {
+		pthread_mutexattr_destroy(&ctx_mutex_attr);
+		ctx_mutex_attr_ready = 0;
+	}
 }
 
 static void timer_reset_timeout(Context *ctx);
@@ -102,10 +141,9 @@ static void plugin_pthread_ctx_finalize(Context *ctx)
 
 	ThreadContext *thread_ctx = get_thread_ctx(ctx);
 
-	pthread_mutexattr_destroy(&thread_ctx->mutex_attr);
 	pthread_mutex_destroy(&thread_ctx->mutex);
 
-	free(ctx->multithread);
+	pool_free(&thread_ctx_pool, ctx->multithread);
 	ctx->multithread = NULL;
 }
 
@@ -264,6 +302,8 @@ void plugin_pthread_setup(CommunicationPlugin *plugin)
 {
 	plugin->thread_init = plugin_pthread_ctx_init;
 	plugin->thread_finalize = plugin_pthread_ctx_finalize;
+	plugin->thread_reserve = plugin_pthread_reserve;
+	plugin->thread_trim = plugin_pthread_trim;
 	plugin->thread_lock = plugin_pthread_ctx_lock;
 	plugin->thread_unlock = plugin_pthread_ctx_unlock;
 	plugin->timer_count_timeout = timer_count_timeout;
@@ -274,6 +314,14 @@ void plugin_pthread_setup(CommunicationPlugin *plugin)
 	pthread_mutexattr_init(&gil_attr);
 	pthread_mutexattr_settype(&gil_attr, PTHREAD_MUTEX_RECURSIVE_NP);
 	pthread_mutex_init(&gil, &gil_attr);
+
+	// shared by plugins, initialized once
+	if (!ctx_mutex_attr_ready) {
+		pthread_mutexattr_init(&ctx_mutex_attr);
+		pthread_mutexattr_settype(&ctx_mutex_attr,
+					  PTHREAD_MUTEX_RECURSIVE_NP);
+		ctx_mutex_attr_ready = 1;
+	}
 }
 
 /** @} */
@@ -47,7 +47,6 @@ void plugin_pthread_setup(CommunicationPlugin *plugin);
  */
 typedef struct ThreadContext {
 	pthread_mutex_t mutex;
-	pthread_mutexattr_t mutex_attr;
 
 	// Timer Thread
 	pthread_t *timeout_thread;
@@ -0,0 +1,2160 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+/**
+ * \file plugin_tcp_uring.c
+ * \brief io_uring TCP plugin source.
+ *
+ * Copyright (C) 2010 Signove Tecnologia Corporation.
+ * All rights reserved.
+ * Contact: Signove Tecnologia Corporation (contact@signove.com)
+ *
+ * $LICENSE_TEXT:BEGIN$
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation and appearing
+ * in the file LICENSE included in the packaging of this file; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ * $LICENSE_TEXT:END$
+ *
+ * \date Oct 18, 2026
+ */
+
+/**
+ * @addtogroup TcpUringPlugin
+ * @{
+ *
+ * TCP transport for managers serving many agents, built on Linux
+ * io_uring. One listening port accepts any number of agents (up to
+ * the limit given to setup), each one getting its own context.
+ *
+ * - A multishot accept stays armed on the listening socket.
+ * - Every connection keeps a multishot receive armed, which takes
+ *   its memory from a ring of provided buffers shared by all
+ *   connections, so idle agents cost no buffer at all.
+ * - Sends are queued as submission entries and reach the kernel
+ *   together with the next io_uring_enter() of the event loop,
+ *   instead of one write() per APDU. All APDUs produced for a
+ *   connection while a batch of completions is handled (e.g. the
+ *   acknowledgements of several event reports) are coalesced into
+ *   a single send. Sends issued by other threads are submitted
+ *   right away.
+ *
+ * The plugin has no thread of its own: the application calls
+ * plugin_tcp_uring_process() from its main loop, optionally after
+ * polling the descriptor returned by plugin_tcp_uring_fd().
+ * Complete APDUs are delivered to communication_process_input_data().
+ *
+ * A running manager may hand its listening socket and connections over
+ * to another process (live upgrade): plugin_tcp_uring_handoff() sends
+ * them, together with the saved context states (see handoff.c) and
+ * bytes of incomplete APDUs, through a Unix socket with SCM_RIGHTS.
+ * The other process calls plugin_tcp_uring_set_takeover() before
+ * manager_start() and resumes the connections instead of binding the
+ * port. Agents do not notice; connections whose context is in the
+ * middle of a transaction are closed instead, and agents reconnect.
+ *
+ * Requires Linux 6.0 or later; setup fails on older kernels (or
+ * when built without io_uring headers) so that applications can
+ * fall back to the plain TCP plugin.
+ */
+
+#include "src/communication/communication.h"
+#include "src/communication/context_manager.h"
+#include "src/communication/handoff.h"
+#include "src/communication/plugin/plugin_tcp_uring.h"
+#include "src/util/log.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#if defined(__linux__)
+#include <linux/io_uring.h>
+#endif
+
+#if defined(IORING_RECV_MULTISHOT) && defined(IORING_ACCEPT_MULTISHOT)
+
+#include <fcntl.h>
+#include <time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+
+/**
+ * \cond Undocumented
+ */
+static const int URING_ERROR = NETWORK_ERROR;
+static const int URING_ERROR_NONE = NETWORK_ERROR_NONE;
+
+#define URING_ENTRIES 256
+#define URING_BACKLOG 128
+#define URING_BUFFER_GROUP 1
+
+#define URING_OP_ACCEPT 1
+#define URING_OP_RECV 2
+#define URING_OP_SEND 3
+
+#define URING_CONN_FREE 0
+#define URING_CONN_OPEN 1
+#define URING_CONN_CLOSING 2
+
+#define URING_COALESCE_MAX 65536
+
+#define URING_HANDOFF_LISTEN 1
+#define URING_HANDOFF_CONN 2
+#define URING_HANDOFF_END 3
+
+/* choice and length of APDU header, then up to 64k of APDU */
+#define URING_HANDOFF_PARTIAL_MAX (4 + 65535)
+/* version, state, invoke ids, then attribute list of MDS */
+#define URING_HANDOFF_STATE_MAX (8 + 4 + 65535)
+/**
+ * \endcond
+ */
+
+/**
+ * Size of APDU header (choice + length)
+ */
+#define APDU_HEADER_SIZE 4
+
+/**
+ * An APDU waiting to be sent
+ */
+typedef struct UringSend {
+	/**
+	 * Next APDU of connection
+	 */
+	struct UringSend *next;
+
+	/**
+	 * Bytes sent so far
+	 */
+	intu32 offset;
+
+	/**
+	 * Bytes to be sent (one or more APDUs)
+	 */
+	intu32 size;
+
+	/**
+	 * Bytes allocated for data
+	 */
+	intu32 capacity;
+
+	/**
+	 * APDU data follows
+	 */
+	intu8 data[];
+} UringSend;
+
+/**
+ * Handoff message header, followed by partial_size bytes of incomplete
+ * APDU and state_size bytes of context state. The descriptor travels
+ * as SCM_RIGHTS ancillary data of the header.
+ */
+typedef struct UringHandoffHeader {
+	/**
+	 * URING_HANDOFF_* message type
+	 */
+	intu32 type;
+
+	/**
+	 * Bytes of incomplete APDU
+	 */
+	intu32 partial_size;
+
+	/**
+	 * Bytes of saved context state
+	 */
+	intu32 state_size;
+} UringHandoffHeader;
+
+/**
+ * Connection slot
+ */
+typedef struct UringConnection {
+	/**
+	 * Socket, -1 if slot is free
+	 */
+	int fd;
+
+	/**
+	 * URING_CONN_* state
+	 */
+	int state;
+
+	/**
+	 * Incremented when slot is reused, part of connection id
+	 */
+	unsigned int generation;
+
+	/**
+	 * Receive request is armed in kernel
+	 */
+	int recv_armed;
+
+	/**
+	 * Head of send queue is in kernel
+	 */
+	int send_armed;
+
+	/**
+	 * Send will be armed at the end of the current batch
+	 */
+	int send_deferred;
+
+	/**
+	 * Stack was told about connection (and not about disconnection)
+	 */
+	int indicated;
+
+	/**
+	 * Send queue; head is the one in kernel
+	 */
+	UringSend *send_head;
+
+	/**
+	 * Send queue tail
+	 */
+	UringSend *send_tail;
+
+	/**
+	 * Received bytes of an incomplete APDU
+	 */
+	intu8 *partial;
+
+	/**
+	 * Number of bytes in partial
+	 */
+	intu32 partial_size;
+} UringConnection;
+
+/**
+ * Ring and plugin state
+ */
+static struct {
+	int fd;
+	unsigned int *sq_head;
+	unsigned int *sq_tail;
+	unsigned int sq_mask;
+	unsigned int sq_entries;
+	struct io_uring_sqe *sqes;
+	unsigned int sq_local_tail;
+	unsigned int *cq_head;
+	unsigned int *cq_tail;
+	unsigned int cq_mask;
+	struct io_uring_cqe *cqes;
+	void *sq_map;
+	size_t sq_map_size;
+	void *cq_map;
+	size_t cq_map_size;
+	size_t sqes_map_size;
+	int ext_arg;
+} ring = {.fd = -1};
+
+/**
+ * Provided buffer ring
+ */
+static struct io_uring_buf_ring *buf_ring = NULL;
+
+/**
+ * Memory of provided buffers
+ */
+static intu8 *buf_base = NULL;
+
+/**
+ * Number of provided buffers
+ */
+static unsigned int buf_count = URING_DEFAULT_BUFFERS;
+
+/**
+ * Provided buffer ring tail, guarded by reap_mutex
+ */
+static unsigned short buf_tail = 0;
+
+/**
+ * Connection table
+ */
+static UringConnection *conns = NULL;
+
+/**
+ * Size of connection table
+ */
+static unsigned int max_conns = 0;
+
+/**
+ * Stack of free slots
+ */
+static unsigned int *free_slots = NULL;
+
+/**
+ * Number of free slots
+ */
+static unsigned int free_count = 0;
+
+/**
+ * Slots with sends deferred to the end of the current batch
+ */
+static unsigned int *deferred_slots = NULL;
+
+/**
+ * Number of deferred slots
+ */
+static unsigned int deferred_count = 0;
+
+/**
+ * Listening socket
+ */
+static int listen_fd = -1;
+
+/**
+ * TCP port
+ */
+static int tcp_port = 0;
+
+/**
+ * Listening socket is shared with other processes through SO_REUSEPORT
+ */
+static int reuse_port = 0;
+
+/**
+ * Multishot accept is armed
+ */
+static int accept_armed = 0;
+
+/**
+ * Accepting connections, between network_init() and network_finalize()
+ */
+static int listening = 0;
+
+/**
+ * Connections are being handed over to another process
+ */
+static int handing_off = 0;
+
+/**
+ * Unix socket to take connections over from, -1 if none
+ */
+static int takeover_sock = -1;
+
+/**
+ * Plugin ID attributed by stack
+ */
+static unsigned int plugin_id = 0;
+
+/**
+ * Protects submission queue and connection table
+ */
+static pthread_mutex_t uring_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Serializes completion queue consumers, and guards provided buffer
+ * ring. Taken before uring_mutex, if both are needed.
+ */
+static pthread_mutex_t reap_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Thread inside plugin_tcp_uring_process(), if processing is set
+ */
+static pthread_t process_thread;
+
+/**
+ * plugin_tcp_uring_process() is running
+ */
+static int processing = 0;
+
+/**
+ * \cond Undocumented
+ */
+static int uring_setup(unsigned int entries, struct io_uring_params *p)
+{
+	return syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int uring_enter(unsigned int to_submit, unsigned int min_complete,
+		       unsigned int flags, void *arg, size_t argsz)
+{
+	return syscall(__NR_io_uring_enter, ring.fd, to_submit, min_complete,
+		       flags, arg, argsz);
+}
+
+static int uring_register(unsigned int opcode, void *arg,
+			  unsigned int nr_args)
+{
+	return syscall(__NR_io_uring_register, ring.fd, opcode, arg, nr_args);
+}
+/**
+ * \endcond
+ */
+
+/**
+ * Hands queued submission entries to kernel.
+ * Must be called with uring_mutex held.
+ *
+ * @return number of entries submitted, or -1 on error
+ */
+static int submit_pending()
+{
+	unsigned int pending = ring.sq_local_tail - *ring.sq_tail;
+	int ret;
+
+	if (pending == 0) {
+		return 0;
+	}
+
+	__atomic_store_n(ring.sq_tail, ring.sq_local_tail, __ATOMIC_RELEASE);
+
+	do {
+		ret = uring_enter(pending, 0, 0, NULL, 0);
+	} while (ret < 0 && errno == EINTR);
+
+	if (ret < 0) {
+		ERROR("network uring: submit failed: %d", errno);
+	}
+
+	return ret;
+}
+
+/**
+ * Gets a free submission entry, flushing the queue if it is full.
+ * Must be called with uring_mutex held.
+ *
+ * @param user_data value returned in completion
+ * @return zeroed entry or NULL
+ */
+static struct io_uring_sqe *get_sqe(unsigned long long user_data)
+{
+	unsigned int head = __atomic_load_n(ring.sq_head, __ATOMIC_ACQUIRE);
+	struct io_uring_sqe *sqe;
+
+	if (ring.sq_local_tail - head >= ring.sq_entries) {
+		submit_pending();
+		head = __atomic_load_n(ring.sq_head, __ATOMIC_ACQUIRE);
+
+		if (ring.sq_local_tail - head >= ring.sq_entries) {
+			ERROR("network uring: submission queue full");
+			return NULL;
+		}
+	}
+
+	sqe = &ring.sqes[ring.sq_local_tail & ring.sq_mask];
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->user_data = user_data;
+	++ring.sq_local_tail;
+
+	return sqe;
+}
+
+/**
+ * Builds user data of a connection request
+ */
+static unsigned long long conn_user_data(unsigned int slot, int op)
+{
+	return ((unsigned long long) slot << 8) | op;
+}
+
+/**
+ * Builds connection id of a slot
+ */
+static unsigned long long conn_id(unsigned int slot)
+{
+	return ((unsigned long long) conns[slot].generation << 32) | (slot + 1);
+}
+
+/**
+ * Finds connection by connection id.
+ * Must be called with uring_mutex held.
+ *
+ * @param connid connection id
+ * @return connection or NULL if gone
+ */
+static UringConnection *get_conn(unsigned long long connid)
+{
+	unsigned int slot = (connid & 0xffffffffULL) - 1;
+
+	if (conns == NULL || slot >= max_conns) {
+		return NULL;
+	}
+
+	if (conns[slot].state == URING_CONN_FREE
+	    || conns[slot].generation != (connid >> 32)) {
+		return NULL;
+	}
+
+	return &conns[slot];
+}
+
+/**
+ * Gives a provided buffer back to kernel. Must be called with
+ * reap_mutex held, or before the ring is in use.
+ *
+ * @param bid buffer id
+ */
+static void buffer_recycle(unsigned short bid)
+{
+	struct io_uring_buf *buf = &buf_ring->bufs[buf_tail & (buf_count - 1)];
+
+	buf->addr = (unsigned long) (buf_base + bid * URING_BUFFER_SIZE);
+	buf->len = URING_BUFFER_SIZE;
+	buf->bid = bid;
+
+	++buf_tail;
+	__atomic_store_n(&buf_ring->tail, buf_tail, __ATOMIC_RELEASE);
+}
+
+/**
+ * Arms multishot accept. Must be called with uring_mutex held.
+ */
+static void arm_accept()
+{
+	struct io_uring_sqe *sqe = get_sqe(URING_OP_ACCEPT);
+
+	if (sqe == NULL) {
+		return;
+	}
+
+	sqe->opcode = IORING_OP_ACCEPT;
+	sqe->fd = listen_fd;
+	sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+	sqe->accept_flags = SOCK_CLOEXEC;
+	accept_armed = 1;
+}
+
+/**
+ * Arms multishot receive of a connection.
+ * Must be called with uring_mutex held.
+ */
+static void arm_recv(unsigned int slot)
+{
+	struct io_uring_sqe *sqe = get_sqe(conn_user_data(slot, URING_OP_RECV));
+
+	if (sqe == NULL) {
+		return;
+	}
+
+	sqe->opcode = IORING_OP_RECV;
+	sqe->fd = conns[slot].fd;
+	sqe->ioprio = IORING_RECV_MULTISHOT;
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	sqe->buf_group = URING_BUFFER_GROUP;
+	conns[slot].recv_armed = 1;
+}
+
+/**
+ * Queues send of the head of connection send queue.
+ * Must be called with uring_mutex held.
+ */
+static void arm_send(unsigned int slot)
+{
+	UringSend *send = conns[slot].send_head;
+	struct io_uring_sqe *sqe = get_sqe(conn_user_data(slot, URING_OP_SEND));
+
+	if (sqe == NULL) {
+		return;
+	}
+
+	sqe->opcode = IORING_OP_SEND;
+	sqe->fd = conns[slot].fd;
+	sqe->addr = (unsigned long) (send->data + send->offset);
+	sqe->len = send->size - send->offset;
+	sqe->msg_flags = MSG_NOSIGNAL;
+	conns[slot].send_armed = 1;
+}
+
+/**
+ * Discards APDUs not yet sent
+ */
+static void drop_sends(UringConnection *conn)
+{
+	while (conn->send_head) {
+		UringSend *send = conn->send_head;
+		conn->send_head = send->next;
+		free(send);
+	}
+
+	conn->send_tail = NULL;
+}
+
+/**
+ * Starts closing a connection; the socket is shut down so that
+ * armed requests complete. Must be called with uring_mutex held.
+ */
+static void close_conn(UringConnection *conn)
+{
+	if (conn->state == URING_CONN_OPEN) {
+		conn->state = URING_CONN_CLOSING;
+		shutdown(conn->fd, SHUT_RDWR);
+	}
+}
+
+/**
+ * Frees a closing slot once kernel holds no request of it.
+ * Must be called with uring_mutex held.
+ */
+static void release_conn(unsigned int slot)
+{
+	UringConnection *conn = &conns[slot];
+
+	if (conn->state != URING_CONN_CLOSING || conn->recv_armed
+	    || conn->send_armed || conn->indicated) {
+		return;
+	}
+
+	close(conn->fd);
+	conn->fd = -1;
+	conn->state = URING_CONN_FREE;
+	drop_sends(conn);
+	free(conn->partial);
+	conn->partial = NULL;
+	conn->partial_size = 0;
+
+	free_slots[free_count++] = slot;
+}
+
+/**
+ * Handles a new connection
+ *
+ * @param fd connected socket
+ */
+static void handle_accept(int fd)
+{
+	unsigned int slot;
+	int opt = 1;
+
+	pthread_mutex_lock(&uring_mutex);
+
+	if (free_count == 0) {
+		pthread_mutex_unlock(&uring_mutex);
+		DEBUG("network uring: connection limit reached");
+		close(fd);
+		return;
+	}
+
+	slot = free_slots[--free_count];
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+
+	conns[slot].fd = fd;
+	conns[slot].state = URING_CONN_OPEN;
+	conns[slot].indicated = 1;
+	++conns[slot].generation;
+
+	if (!handing_off) {
+		arm_recv(slot);
+	}
+
+	ContextId cid = {plugin_id, conn_id(slot)};
+
+	pthread_mutex_unlock(&uring_mutex);
+
+	DEBUG("network uring: connection %u accepted", slot);
+	communication_transport_connect_indication(cid, "tcp");
+}
+
+/**
+ * Delivers complete APDUs found in data to the stack
+ *
+ * @param ctx connection context (locked), NULL if gone
+ * @param data received bytes
+ * @param size number of bytes
+ * @param count incremented for each APDU delivered
+ * @return number of bytes consumed
+ */
+static intu32 deliver_apdus(Context *ctx, intu8 *data, intu32 size,
+			    int *count)
+{
+	intu32 used = 0;
+
+	while (size - used >= APDU_HEADER_SIZE) {
+		intu32 apdu_size = ((data[used + 2] << 8) | data[used + 3])
+				   + APDU_HEADER_SIZE;
+
+		if (size - used < apdu_size) {
+			break;
+		}
+
+		if (ctx != NULL) {
+			intu8 *apdu = malloc(apdu_size);
+			memcpy(apdu, data + used, apdu_size);
+			communication_process_input_data(ctx,
+				byte_stream_reader_instance(apdu, apdu_size));
+			++*count;
+		}
+
+		used += apdu_size;
+	}
+
+	return used;
+}
+
+/**
+ * Handles received bytes of a connection
+ *
+ * @param slot connection slot
+ * @param data received bytes
+ * @param size number of bytes
+ * @return number of APDUs delivered
+ */
+static int handle_data(unsigned int slot, intu8 *data, intu32 size)
+{
+	UringConnection *conn = &conns[slot];
+	ContextId cid = {plugin_id, conn_id(slot)};
+	Context *ctx = context_get_and_lock(cid);
+	int count = 0;
+	intu32 used;
+
+	if (conn->partial_size == 0) {
+		// fast path, frames straight from provided buffer
+		used = deliver_apdus(ctx, data, size, &count);
+
+		if (used < size) {
+			conn->partial = malloc(size - used);
+			memcpy(conn->partial, data + used, size - used);
+			conn->partial_size = size - used;
+		}
+	} else {
+		conn->partial = realloc(conn->partial, conn->partial_size + size);
+		memcpy(conn->partial + conn->partial_size, data, size);
+		conn->partial_size += size;
+
+		used = deliver_apdus(ctx, conn->partial, conn->partial_size,
+				     &count);
+
+		conn->partial_size -= used;
+		if (conn->partial_size == 0) {
+			free(conn->partial);
+			conn->partial = NULL;
+		} else if (used > 0) {
+			memmove(conn->partial, conn->partial + used,
+				conn->partial_size);
+		}
+	}
+
+	if (ctx != NULL) {
+		context_unlock(ctx);
+	}
+
+	return count;
+}
+
+/**
+ * Handles completion of a receive request
+ *
+ * @return number of APDUs delivered
+ */
+static int handle_recv(unsigned int slot, int res, unsigned int flags)
+{
+	UringConnection *conn = &conns[slot];
+	int count = 0;
+
+	if (res > 0 && (flags & IORING_CQE_F_BUFFER)) {
+		unsigned short bid = flags >> IORING_CQE_BUFFER_SHIFT;
+
+		if (conn->state == URING_CONN_OPEN) {
+			count = handle_data(slot, buf_base + bid * URING_BUFFER_SIZE,
+					    res);
+		}
+
+		buffer_recycle(bid);
+	}
+
+	pthread_mutex_lock(&uring_mutex);
+
+	if (!(flags & IORING_CQE_F_MORE)) {
+		conn->recv_armed = 0;
+
+		if (conn->state == URING_CONN_OPEN && handing_off
+		    && (res > 0 || res == -ECANCELED)) {
+			// cancelled, connection is about to be handed over
+		} else if (conn->state == URING_CONN_OPEN
+			   && (res > 0 || res == -ENOBUFS)) {
+			// kernel ended multishot (e.g. out of buffers)
+			arm_recv(slot);
+		} else {
+			close_conn(conn);
+		}
+	}
+
+	if (conn->state == URING_CONN_CLOSING && !conn->recv_armed
+	    && conn->indicated) {
+		ContextId cid = {plugin_id, conn_id(slot)};
+		conn->indicated = 0;
+		pthread_mutex_unlock(&uring_mutex);
+
+		DEBUG("network uring: connection %u closed", slot);
+		communication_transport_disconnect_indication(cid, "tcp");
+
+		pthread_mutex_lock(&uring_mutex);
+	}
+
+	release_conn(slot);
+	pthread_mutex_unlock(&uring_mutex);
+
+	return count;
+}
+
+/**
+ * Handles completion of a send request
+ */
+static void handle_send(unsigned int slot, int res)
+{
+	UringConnection *conn = &conns[slot];
+
+	pthread_mutex_lock(&uring_mutex);
+
+	conn->send_armed = 0;
+
+	if (res < 0 || conn->state != URING_CONN_OPEN) {
+		drop_sends(conn);
+		close_conn(conn);
+	} else if (conn->send_head) {
+		UringSend *send = conn->send_head;
+		send->offset += res;
+
+		if (send->offset >= send->size) {
+			conn->send_head = send->next;
+			if (conn->send_head == NULL) {
+				conn->send_tail = NULL;
+			}
+			free(send);
+		}
+
+		if (conn->send_head) {
+			arm_send(slot);
+		}
+	}
+
+	release_conn(slot);
+	pthread_mutex_unlock(&uring_mutex);
+}
+
+/**
+ * Reaps all available completions. Must be called with reap_mutex held.
+ *
+ * @return number of APDUs delivered
+ */
+static int reap_completions()
+{
+	int count = 0;
+
+	while (1) {
+		unsigned int head = *ring.cq_head;
+		unsigned int tail = __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE);
+
+		if (head == tail) {
+			break;
+		}
+
+		struct io_uring_cqe *cqe = &ring.cqes[head & ring.cq_mask];
+		unsigned long long user_data = cqe->user_data;
+		int res = cqe->res;
+		unsigned int flags = cqe->flags;
+
+		__atomic_store_n(ring.cq_head, head + 1, __ATOMIC_RELEASE);
+
+		unsigned int slot = user_data >> 8;
+
+		switch (user_data & 0xff) {
+		case URING_OP_ACCEPT:
+			if (res >= 0) {
+				handle_accept(res);
+			}
+
+			if (!(flags & IORING_CQE_F_MORE)) {
+				pthread_mutex_lock(&uring_mutex);
+				accept_armed = 0;
+				if (listening) {
+					arm_accept();
+				}
+				pthread_mutex_unlock(&uring_mutex);
+			}
+			break;
+		case URING_OP_RECV:
+			count += handle_recv(slot, res, flags);
+			break;
+		case URING_OP_SEND:
+			handle_send(slot, res);
+			break;
+		default:
+			break;
+		}
+	}
+
+	return count;
+}
+
+/**
+ * Arms sends deferred during a batch, one per connection.
+ * Must be called with uring_mutex held.
+ */
+static void arm_deferred_sends()
+{
+	unsigned int i;
+
+	for (i = 0; i < deferred_count; ++i) {
+		unsigned int slot = deferred_slots[i];
+
+		conns[slot].send_deferred = 0;
+
+		if (conns[slot].state == URING_CONN_OPEN
+		    && !conns[slot].send_armed && conns[slot].send_head) {
+			arm_send(slot);
+		}
+	}
+
+	deferred_count = 0;
+}
+
+/**
+ * Handles available completions. Replies generated meanwhile are
+ * coalesced per connection and submitted together at the end.
+ *
+ * @return number of APDUs delivered
+ */
+static int process_completions()
+{
+	int count;
+
+	pthread_mutex_lock(&reap_mutex);
+
+	pthread_mutex_lock(&uring_mutex);
+	process_thread = pthread_self();
+	processing = 1;
+	pthread_mutex_unlock(&uring_mutex);
+
+	count = reap_completions();
+
+	pthread_mutex_lock(&uring_mutex);
+	processing = 0;
+	arm_deferred_sends();
+	submit_pending();
+	pthread_mutex_unlock(&uring_mutex);
+
+	pthread_mutex_unlock(&reap_mutex);
+
+	return count;
+}
+
+/**
+ * Waits for completions, submitting queued entries at the same time
+ *
+ * @param timeout_ms milliseconds to wait, 0 = do not wait, <0 = forever
+ * @return 0 on success or timeout, -1 on error
+ */
+static int wait_completions(int timeout_ms)
+{
+	unsigned int pending;
+	struct __kernel_timespec ts;
+	struct io_uring_getevents_arg arg;
+	unsigned int flags = 0;
+	unsigned int wait = 0;
+	void *argp = NULL;
+	size_t argsz = 0;
+	int ret;
+
+	pthread_mutex_lock(&uring_mutex);
+	pending = ring.sq_local_tail - *ring.sq_tail;
+	__atomic_store_n(ring.sq_tail, ring.sq_local_tail, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&uring_mutex);
+
+	if (timeout_ms != 0) {
+		flags |= IORING_ENTER_GETEVENTS;
+		wait = 1;
+
+		if (timeout_ms > 0 && ring.ext_arg) {
+			memset(&arg, 0, sizeof(arg));
+			ts.tv_sec = timeout_ms / 1000;
+			ts.tv_nsec = (timeout_ms % 1000) * 1000000LL;
+			arg.ts = (unsigned long) &ts;
+			argp = &arg;
+			argsz = sizeof(arg);
+			flags |= IORING_ENTER_EXT_ARG;
+		}
+	}
+
+	if (pending == 0 && wait == 0) {
+		return 0;
+	}
+
+	ret = uring_enter(pending, wait, flags, argp, argsz);
+
+	if (ret < 0 && errno != ETIME && errno != EINTR && errno != EBUSY) {
+		ERROR("network uring: io_uring_enter failed: %d", errno);
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * Runs one iteration of the plugin event loop: submits queued
+ * requests, waits for completions up to timeout and handles them.
+ *
+ * @param timeout_ms milliseconds to wait, 0 = do not wait, <0 = forever
+ * @return number of APDUs delivered to stack, -1 on error
+ */
+int plugin_tcp_uring_process(int timeout_ms)
+{
+	int count;
+
+	if (ring.fd < 0 || listen_fd < 0) {
+		return -1;
+	}
+
+	count = process_completions();
+
+	if (count == 0) {
+		// other threads submit by themselves while we sleep
+		if (wait_completions(timeout_ms) < 0) {
+			return -1;
+		}
+
+		count = process_completions();
+	}
+
+	return count;
+}
+
+/**
+ * Returns the io_uring descriptor, which becomes readable when
+ * completions are available. Applications with an event loop of their
+ * own may poll it and call plugin_tcp_uring_process(0) when it fires.
+ *
+ * @return file descriptor, -1 if plugin is not set up
+ */
+int plugin_tcp_uring_fd()
+{
+	return ring.fd;
+}
+
+/**
+ * Makes the listening socket join the SO_REUSEPORT group of the port,
+ * so several processes (each one running its own manager) may listen
+ * on the same port and the kernel spreads incoming connections among
+ * them. Must be called before manager_start().
+ *
+ * @param enable 1 to share the port, 0 to own it exclusively (default)
+ */
+void plugin_tcp_uring_set_reuseport(int enable)
+{
+	reuse_port = enable;
+}
+
+/**
+ * Returns number of open connections
+ *
+ * @return connection count
+ */
+unsigned int plugin_tcp_uring_connection_count()
+{
+	unsigned int count;
+
+	pthread_mutex_lock(&uring_mutex);
+	count = max_conns - free_count;
+	pthread_mutex_unlock(&uring_mutex);
+
+	return count;
+}
+
+/**
+ * Writes all bytes to handoff socket
+ *
+ * @return 1 if successful, 0 otherwise
+ */
+static int handoff_write(int sock, const void *data, size_t size)
+{
+	const intu8 *p = data;
+
+	while (size > 0) {
+		ssize_t ret = write(sock, p, size);
+
+		if (ret < 0 && errno == EINTR) {
+			continue;
+		} else if (ret <= 0) {
+			return 0;
+		}
+
+		p += ret;
+		size -= ret;
+	}
+
+	return 1;
+}
+
+/**
+ * Reads exactly size bytes from handoff socket
+ *
+ * @return 1 if successful, 0 otherwise
+ */
+static int handoff_read(int sock, void *data, size_t size)
+{
+	intu8 *p = data;
+
+	while (size > 0) {
+		ssize_t ret = read(sock, p, size);
+
+		if (ret < 0 && errno == EINTR) {
+			continue;
+		} else if (ret <= 0) {
+			return 0;
+		}
+
+		p += ret;
+		size -= ret;
+	}
+
+	return 1;
+}
+
+/**
+ * Reads and drops bytes of handoff socket
+ *
+ * @param sock Unix socket
+ * @param size number of bytes to drop
+ * @return 1 if successful, 0 otherwise
+ */
+static int handoff_discard(int sock, size_t size)
+{
+	intu8 buf[512];
+
+	while (size > 0) {
+		size_t chunk = size < sizeof(buf) ? size : sizeof(buf);
+
+		if (!handoff_read(sock, buf, chunk)) {
+			return 0;
+		}
+
+		size -= chunk;
+	}
+
+	return 1;
+}
+
+/**
+ * Sends a handoff message
+ *
+ * @param sock Unix socket
+ * @param type URING_HANDOFF_* type
+ * @param fd descriptor to pass, -1 if none
+ * @param partial bytes of incomplete APDU
+ * @param partial_size number of bytes in partial
+ * @param state saved context state, NULL if none
+ * @return 1 if successful, 0 otherwise
+ */
+static int handoff_send(int sock, int type, int fd, intu8 *partial,
+			intu32 partial_size, ByteStreamWriter *state)
+{
+	UringHandoffHeader hdr;
+	struct msghdr msg;
+	struct iovec iov;
+	char control[CMSG_SPACE(sizeof(int))];
+	ssize_t ret;
+
+	hdr.type = type;
+	hdr.partial_size = partial_size;
+	hdr.state_size = state ? state->size : 0;
+
+	memset(&msg, 0, sizeof(msg));
+	iov.iov_base = &hdr;
+	iov.iov_len = sizeof(hdr);
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+
+	if (fd >= 0) {
+		struct cmsghdr *cmsg;
+
+		memset(control, 0, sizeof(control));
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+		cmsg = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+		memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+	}
+
+	do {
+		ret = sendmsg(sock, &msg, MSG_NOSIGNAL);
+	} while (ret < 0 && errno == EINTR);
+
+	if (ret < 0) {
+		ERROR("network uring: handoff send failed: %d", errno);
+		return 0;
+	}
+
+	// ancillary data went with the first byte
+	if (!handoff_write(sock, (intu8 *) &hdr + ret, sizeof(hdr) - ret)) {
+		return 0;
+	}
+
+	if (partial_size > 0 && !handoff_write(sock, partial, partial_size)) {
+		return 0;
+	}
+
+	return state == NULL || handoff_write(sock, state->buffer, state->size);
+}
+
+/**
+ * Receives header of a handoff message, and its descriptor
+ *
+ * @param sock Unix socket
+ * @param hdr filled with message header
+ * @param fd filled with descriptor passed, -1 if none
+ * @return 1 if successful, 0 otherwise
+ */
+static int handoff_recv(int sock, UringHandoffHeader *hdr, int *fd)
+{
+	struct msghdr msg;
+	struct iovec iov;
+	struct cmsghdr *cmsg;
+	char control[CMSG_SPACE(sizeof(int))];
+	ssize_t ret;
+
+	*fd = -1;
+
+	memset(&msg, 0, sizeof(msg));
+	iov.iov_base = hdr;
+	iov.iov_len = sizeof(*hdr);
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+
+	do {
+		ret = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+	} while (ret < 0 && errno == EINTR);
+
+	if (ret <= 0) {
+		return 0;
+	}
+
+	for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+		if (cmsg->cmsg_level == SOL_SOCKET
+		    && cmsg->cmsg_type == SCM_RIGHTS) {
+			memcpy(fd, CMSG_DATA(cmsg), sizeof(int));
+		}
+	}
+
+	if (!handoff_read(sock, (intu8 *) hdr + ret, sizeof(*hdr) - ret)) {
+		if (*fd >= 0) {
+			close(*fd);
+			*fd = -1;
+		}
+		return 0;
+	}
+
+	return 1;
+}
+
+/**
+ * Resumes a connection handed over by another process
+ *
+ * @param fd connected socket
+ * @param partial bytes of incomplete APDU, now owned by plugin
+ * @param partial_size number of bytes in partial
+ * @param state saved context state
+ * @param state_size number of bytes in state
+ */
+static void takeover_connection(int fd, intu8 *partial, intu32 partial_size,
+				intu8 *state, intu32 state_size)
+{
+	unsigned int slot;
+
+	pthread_mutex_lock(&uring_mutex);
+
+	if (free_count == 0) {
+		pthread_mutex_unlock(&uring_mutex);
+		DEBUG("network uring: connection limit reached");
+		free(partial);
+		close(fd);
+		return;
+	}
+
+	slot = free_slots[--free_count];
+
+	conns[slot].fd = fd;
+	conns[slot].state = URING_CONN_OPEN;
+	conns[slot].indicated = 1;
+	conns[slot].partial = partial;
+	conns[slot].partial_size = partial_size;
+	++conns[slot].generation;
+	arm_recv(slot);
+
+	ContextId cid = {plugin_id, conn_id(slot)};
+
+	pthread_mutex_unlock(&uring_mutex);
+
+	if (!handoff_import_context(cid, "tcp", state, state_size)) {
+		pthread_mutex_lock(&uring_mutex);
+		close_conn(&conns[slot]);
+		pthread_mutex_unlock(&uring_mutex);
+	}
+}
+
+/**
+ * Takes listening socket and connections over from another process
+ *
+ * @param sock Unix socket
+ * @return 1 if listening socket was received, 0 otherwise
+ */
+static int takeover_connections(int sock)
+{
+	UringHandoffHeader hdr;
+	unsigned int count = 0;
+	int fd;
+
+	if (!handoff_recv(sock, &hdr, &fd) || hdr.type != URING_HANDOFF_LISTEN
+	    || fd < 0) {
+		ERROR("network uring: no listening socket to take over");
+		if (fd >= 0) {
+			close(fd);
+		}
+		return 0;
+	}
+
+	listen_fd = fd;
+
+	while (handoff_recv(sock, &hdr, &fd) && hdr.type == URING_HANDOFF_CONN) {
+		intu8 *partial = NULL;
+		intu8 *state;
+
+		if (hdr.partial_size > URING_HANDOFF_PARTIAL_MAX
+		    || hdr.state_size > URING_HANDOFF_STATE_MAX) {
+			// rest of the stream cannot be trusted either
+			ERROR("network uring: handoff of %u+%u bytes rejected",
+			      hdr.partial_size, hdr.state_size);
+			if (fd >= 0) {
+				close(fd);
+			}
+			break;
+		}
+
+		state = malloc(hdr.state_size > 0 ? hdr.state_size : 1);
+
+		if (hdr.partial_size > 0) {
+			partial = malloc(hdr.partial_size);
+		}
+
+		if (!state || (hdr.partial_size > 0 && !partial)) {
+			ERROR("network uring: no memory to take connection over");
+			free(partial);
+			free(state);
+			if (fd >= 0) {
+				close(fd);
+			}
+
+			if (!handoff_discard(sock, hdr.partial_size)
+			    || !handoff_discard(sock, hdr.state_size)) {
+				break;
+			}
+			continue;
+		}
+
+		if (!handoff_read(sock, partial, hdr.partial_size)
+		    || !handoff_read(sock, state, hdr.state_size) || fd < 0) {
+			free(partial);
+			free(state);
+			if (fd >= 0) {
+				close(fd);
+			}
+			break;
+		}
+
+		takeover_connection(fd, partial, hdr.partial_size, state,
+				    hdr.state_size);
+		free(state);
+		++count;
+	}
+
+	DEBUG("network uring: took %u connections over", count);
+
+	return 1;
+}
+
+/**
+ * Opens listening socket of the port
+ *
+ * @return 1 if successful, 0 otherwise
+ */
+static int listen_port()
+{
+	struct sockaddr_in addr;
+	int opt = 1;
+
+	listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, IPPROTO_TCP);
+
+	if (listen_fd < 0) {
+		ERROR("network uring: cannot create socket");
+		return 0;
+	}
+
+	setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+	if (reuse_port && setsockopt(listen_fd, SOL_SOCKET, SO_REUSEPORT,
+				     &opt, sizeof(opt)) < 0) {
+		ERROR("network uring: SO_REUSEPORT not supported: %d", errno);
+		close(listen_fd);
+		listen_fd = -1;
+		return 0;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = INADDR_ANY;
+	addr.sin_port = htons(tcp_port);
+
+	if (bind(listen_fd, (struct sockaddr *) &addr, sizeof(addr)) < 0
+	    || listen(listen_fd, URING_BACKLOG) < 0) {
+		ERROR("network uring: cannot listen on port %d: %d",
+		      tcp_port, errno);
+		close(listen_fd);
+		listen_fd = -1;
+		return 0;
+	}
+
+	return 1;
+}
+
+/**
+ * Starts listening and accepting connections. If set up to take
+ * over, listening socket and connections come from another process.
+ *
+ * @param plugin_label the Plugin ID attributed by stack
+ * @return URING_ERROR_NONE if operation succeeds
+ */
+static int network_init(unsigned int plugin_label)
+{
+	plugin_id = plugin_label;
+
+	if (takeover_sock >= 0) {
+		takeover_connections(takeover_sock);
+		close(takeover_sock);
+		takeover_sock = -1;
+	}
+
+	if (listen_fd < 0 && !listen_port()) {
+		return URING_ERROR;
+	}
+
+	pthread_mutex_lock(&uring_mutex);
+	listening = 1;
+	arm_accept();
+	submit_pending();
+	pthread_mutex_unlock(&uring_mutex);
+
+	DEBUG("network uring: listening on port %d", tcp_port);
+
+	return URING_ERROR_NONE;
+}
+
+/**
+ * Waits until kernel holds no request of plugin, or gives up
+ */
+static void drain_requests()
+{
+	int tries;
+	int reaping;
+
+	// called back from completion handling, reap_mutex is ours
+	pthread_mutex_lock(&uring_mutex);
+	reaping = processing && pthread_equal(process_thread, pthread_self());
+	pthread_mutex_unlock(&uring_mutex);
+
+	for (tries = 0; tries < 100; ++tries) {
+		unsigned int i;
+		int busy;
+
+		pthread_mutex_lock(&uring_mutex);
+		busy = accept_armed;
+
+		for (i = 0; i < max_conns && !busy; ++i) {
+			busy = conns[i].recv_armed || conns[i].send_armed;
+		}
+
+		pthread_mutex_unlock(&uring_mutex);
+
+		if (!busy) {
+			break;
+		}
+
+		wait_completions(10);
+
+		if (!reaping) {
+			pthread_mutex_lock(&reap_mutex);
+		}
+
+		reap_completions();
+
+		if (!reaping) {
+			pthread_mutex_unlock(&reap_mutex);
+		}
+	}
+}
+
+/**
+ * Closes all connections and the listening socket. Connections are
+ * reported to the stack as disconnected.
+ *
+ * @return URING_ERROR_NONE
+ */
+static int network_finalize()
+{
+	unsigned int i;
+
+	if (listen_fd < 0) {
+		return URING_ERROR_NONE;
+	}
+
+	pthread_mutex_lock(&uring_mutex);
+
+	listening = 0;
+
+	if (accept_armed) {
+		struct io_uring_sqe *sqe = get_sqe(0);
+
+		if (sqe) {
+			sqe->opcode = IORING_OP_ASYNC_CANCEL;
+			sqe->addr = URING_OP_ACCEPT;
+		}
+	}
+
+	for (i = 0; i < max_conns; ++i) {
+		close_conn(&conns[i]);
+	}
+
+	pthread_mutex_unlock(&uring_mutex);
+
+	drain_requests();
+
+	close(listen_fd);
+	listen_fd = -1;
+	accept_armed = 0;
+
+	return URING_ERROR_NONE;
+}
+
+/**
+ * Closes a connection whose receive is not armed, telling the stack
+ */
+static void close_idle_conn(unsigned int slot)
+{
+	ContextId cid = {plugin_id, conn_id(slot)};
+
+	pthread_mutex_lock(&uring_mutex);
+	close_conn(&conns[slot]);
+	conns[slot].indicated = 0;
+	pthread_mutex_unlock(&uring_mutex);
+
+	communication_transport_disconnect_indication(cid, "tcp");
+
+	pthread_mutex_lock(&uring_mutex);
+	release_conn(slot);
+	pthread_mutex_unlock(&uring_mutex);
+}
+
+/**
+ * Hands listening socket and connections over to another process,
+ * which must be running plugin_tcp_uring_set_takeover() on the other
+ * end of the Unix socket. Contexts handed over are removed from this
+ * process silently; contexts in the middle of a transaction are closed
+ * (their agents reconnect). Afterwards the plugin holds no socket,
+ * and the application is expected to finalize the manager and exit.
+ *
+ * @param sock connected Unix socket
+ * @return URING_ERROR_NONE if listening socket was handed over,
+ *         URING_ERROR otherwise (plugin keeps running)
+ */
+int plugin_tcp_uring_handoff(int sock)
+{
+	unsigned int count = 0;
+	unsigned int i;
+
+	if (listen_fd < 0) {
+		return URING_ERROR;
+	}
+
+	pthread_mutex_lock(&uring_mutex);
+
+	listening = 0;
+	handing_off = 1;
+
+	if (accept_armed) {
+		struct io_uring_sqe *sqe = get_sqe(0);
+
+		if (sqe) {
+			sqe->opcode = IORING_OP_ASYNC_CANCEL;
+			sqe->addr = URING_OP_ACCEPT;
+		}
+	}
+
+	for (i = 0; i < max_conns; ++i) {
+		if (conns[i].state == URING_CONN_OPEN && conns[i].recv_armed) {
+			struct io_uring_sqe *sqe = get_sqe(0);
+
+			if (sqe) {
+				sqe->opcode = IORING_OP_ASYNC_CANCEL;
+				sqe->addr = conn_user_data(i, URING_OP_RECV);
+			}
+		}
+	}
+
+	pthread_mutex_unlock(&uring_mutex);
+
+	// data received meanwhile is handled, replies go out
+	drain_requests();
+
+	if (!handoff_send(sock, URING_HANDOFF_LISTEN, listen_fd, NULL, 0,
+			  NULL)) {
+		pthread_mutex_lock(&uring_mutex);
+		handing_off = 0;
+		listening = 1;
+		arm_accept();
+
+		for (i = 0; i < max_conns; ++i) {
+			if (conns[i].state == URING_CONN_OPEN
+			    && !conns[i].recv_armed) {
+				arm_recv(i);
+			}
+		}
+
+		submit_pending();
+		pthread_mutex_unlock(&uring_mutex);
+
+		return URING_ERROR;
+	}
+
+	for (i = 0; i < max_conns; ++i) {
+		ContextId cid = {plugin_id, conn_id(i)};
+		ByteStreamWriter *state = NULL;
+		Context *ctx;
+		int sent;
+
+		if (conns[i].state != URING_CONN_OPEN) {
+			continue;
+		}
+
+		ctx = context_get_and_lock(cid);
+
+		if (ctx) {
+			state = handoff_export_context(ctx);
+			context_unlock(ctx);
+		}
+
+		if (state == NULL) {
+			close_idle_conn(i);
+			continue;
+		}
+
+		sent = handoff_send(sock, URING_HANDOFF_CONN, conns[i].fd,
+				    conns[i].partial, conns[i].partial_size,
+				    state);
+		del_byte_stream_writer(state, 1);
+
+		if (!sent) {
+			close_idle_conn(i);
+			continue;
+		}
+
+		// connection belongs to the other process now; just let go
+		context_remove(cid);
+
+		pthread_mutex_lock(&uring_mutex);
+		conns[i].state = URING_CONN_CLOSING;
+		conns[i].indicated = 0;
+		release_conn(i);
+		pthread_mutex_unlock(&uring_mutex);
+
+		++count;
+	}
+
+	handoff_send(sock, URING_HANDOFF_END, -1, NULL, 0, NULL);
+
+	close(listen_fd);
+	listen_fd = -1;
+	handing_off = 0;
+
+	DEBUG("network uring: handed %u connections over", count);
+
+	return URING_ERROR_NONE;
+}
+
+/**
+ * Makes plugin take listening socket and connections over from
+ * another process (see plugin_tcp_uring_handoff()) when the manager
+ * starts, instead of binding the port. If nothing is received, the
+ * port is bound as usual.
+ *
+ * @param sock connected Unix socket, closed by plugin
+ */
+void plugin_tcp_uring_set_takeover(int sock)
+{
+	takeover_sock = sock;
+}
+
+/**
+ * Nothing to wait for; plugin_tcp_uring_process() delivers data.
+ *
+ * @param ctx current connection context.
+ * @return URING_ERROR_NONE
+ */
+static int network_wait_for_data(Context *ctx)
+{
+	return URING_ERROR_NONE;
+}
+
+/**
+ * APDUs are pushed to the stack by plugin_tcp_uring_process()
+ *
+ * @param ctx current connection context.
+ * @return NULL
+ */
+static ByteStreamReader *network_get_apdu_stream(Context *ctx)
+{
+	return NULL;
+}
+
+/**
+ * Grows the tail of the send queue of a connection, which must not
+ * be in kernel. Must be called with uring_mutex held.
+ *
+ * @param conn connection
+ * @param size bytes needed
+ * @return 1 if successful, 0 otherwise
+ */
+static int grow_send(UringConnection *conn, intu32 size)
+{
+	UringSend *tail = conn->send_tail;
+	UringSend **link = &conn->send_head;
+	intu32 capacity = tail->capacity * 2;
+
+	if (capacity < size) {
+		capacity = size;
+	}
+
+	while (*link != tail) {
+		link = &(*link)->next;
+	}
+
+	tail = realloc(tail, sizeof(UringSend) + capacity);
+
+	if (tail == NULL) {
+		return 0;
+	}
+
+	tail->capacity = capacity;
+	*link = tail;
+	conn->send_tail = tail;
+
+	return 1;
+}
+
+/**
+ * Queues an encoded APDU to be sent
+ *
+ * @param ctx context
+ * @param stream the apdu to be sent
+ * @return URING_ERROR_NONE if queued, URING_ERROR otherwise
+ */
+static int network_send_apdu_stream(Context *ctx, ByteStreamWriter *stream)
+{
+	UringConnection *conn;
+	UringSend *tail;
+	unsigned int slot;
+	int batch;
+
+	pthread_mutex_lock(&uring_mutex);
+
+	conn = get_conn(ctx->id.connid);
+
+	if (conn == NULL || conn->state != URING_CONN_OPEN) {
+		pthread_mutex_unlock(&uring_mutex);
+		return URING_ERROR;
+	}
+
+	slot = conn - conns;
+	batch = processing && pthread_equal(process_thread, pthread_self());
+	tail = conn->send_tail;
+
+	if (tail && !(conn->send_armed && tail == conn->send_head)
+	    && tail->size + stream->size <= URING_COALESCE_MAX) {
+		// tail is not in kernel yet, APDU joins it
+		if (tail->capacity < tail->size + stream->size) {
+			if (!grow_send(conn, tail->size + stream->size)) {
+				pthread_mutex_unlock(&uring_mutex);
+				return URING_ERROR;
+			}
+			tail = conn->send_tail;
+		}
+	} else {
+		tail = malloc(sizeof(UringSend) + stream->size);
+
+		if (tail == NULL) {
+			pthread_mutex_unlock(&uring_mutex);
+			return URING_ERROR;
+		}
+
+		tail->next = NULL;
+		tail->offset = 0;
+		tail->size = 0;
+		tail->capacity = stream->size;
+
+		if (conn->send_tail) {
+			conn->send_tail->next = tail;
+		} else {
+			conn->send_head = tail;
+		}
+
+		conn->send_tail = tail;
+	}
+
+	memcpy(tail->data + tail->size, stream->buffer, stream->size);
+	tail->size += stream->size;
+
+	if (!conn->send_armed) {
+		if (!batch) {
+			arm_send(slot);
+		} else if (!conn->send_deferred) {
+			// more APDUs for this connection may come in this batch
+			conn->send_deferred = 1;
+			deferred_slots[deferred_count++] = slot;
+		}
+	}
+
+	if (!batch) {
+		// event loop may be sleeping, do not wait for it
+		submit_pending();
+	}
+
+	pthread_mutex_unlock(&uring_mutex);
+
+	return URING_ERROR_NONE;
+}
+
+/**
+ * Closes connection; stack is notified when its requests complete
+ *
+ * @param ctx context
+ * @return URING_ERROR_NONE, or URING_ERROR if connection is gone
+ */
+static int network_disconnect(Context *ctx)
+{
+	UringConnection *conn;
+
+	pthread_mutex_lock(&uring_mutex);
+
+	conn = get_conn(ctx->id.connid);
+
+	if (conn) {
+		close_conn(conn);
+	}
+
+	pthread_mutex_unlock(&uring_mutex);
+
+	return conn ? URING_ERROR_NONE : URING_ERROR;
+}
+
+/**
+ * Releases ring, buffers and connection table
+ */
+static void destroy_ring()
+{
+	if (ring.fd >= 0) {
+		close(ring.fd);
+		ring.fd = -1;
+	}
+
+	if (ring.sqes) {
+		munmap(ring.sqes, ring.sqes_map_size);
+		ring.sqes = NULL;
+	}
+
+	if (ring.cq_map && ring.cq_map != ring.sq_map) {
+		munmap(ring.cq_map, ring.cq_map_size);
+	}
+
+	if (ring.sq_map) {
+		munmap(ring.sq_map, ring.sq_map_size);
+	}
+
+	ring.sq_map = NULL;
+	ring.cq_map = NULL;
+
+	free(buf_ring);
+	buf_ring = NULL;
+	free(buf_base);
+	buf_base = NULL;
+	free(conns);
+	conns = NULL;
+	free(free_slots);
+	free_slots = NULL;
+	free(deferred_slots);
+	deferred_slots = NULL;
+	deferred_count = 0;
+	max_conns = 0;
+	free_count = 0;
+}
+
+/**
+ * Creates ring and registers provided buffers
+ *
+ * @return 1 if successful, 0 otherwise
+ */
+static int create_ring()
+{
+	struct io_uring_params params;
+	struct io_uring_buf_reg reg;
+	unsigned int i;
+
+	memset(&params, 0, sizeof(params));
+	ring.fd = uring_setup(URING_ENTRIES, &params);
+
+	if (ring.fd < 0) {
+		DEBUG("network uring: io_uring not available: %d", errno);
+		return 0;
+	}
+
+	ring.ext_arg = (params.features & IORING_FEAT_EXT_ARG) != 0;
+
+	ring.sq_map_size = params.sq_off.array
+			   + params.sq_entries * sizeof(unsigned int);
+	ring.cq_map_size = params.cq_off.cqes
+			   + params.cq_entries * sizeof(struct io_uring_cqe);
+
+	if (params.features & IORING_FEAT_SINGLE_MMAP) {
+		if (ring.cq_map_size > ring.sq_map_size) {
+			ring.sq_map_size = ring.cq_map_size;
+		}
+		ring.cq_map_size = ring.sq_map_size;
+	}
+
+	ring.sq_map = mmap(NULL, ring.sq_map_size, PROT_READ | PROT_WRITE,
+			   MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_SQ_RING);
+
+	if (ring.sq_map == MAP_FAILED) {
+		ring.sq_map = NULL;
+		return 0;
+	}
+
+	if (params.features & IORING_FEAT_SINGLE_MMAP) {
+		ring.cq_map = ring.sq_map;
+	} else {
+		ring.cq_map = mmap(NULL, ring.cq_map_size, PROT_READ | PROT_WRITE,
+				   MAP_SHARED | MAP_POPULATE, ring.fd,
+				   IORING_OFF_CQ_RING);
+
+		if (ring.cq_map == MAP_FAILED) {
+			ring.cq_map = NULL;
+			return 0;
+		}
+	}
+
+	ring.sqes_map_size = params.sq_entries * sizeof(struct io_uring_sqe);
+	ring.sqes = mmap(NULL, ring.sqes_map_size, PROT_READ | PROT_WRITE,
+			 MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_SQES);
+
+	if (ring.sqes == MAP_FAILED) {
+		ring.sqes = NULL;
+		return 0;
+	}
+
+	ring.sq_head = (unsigned int *) ((char *) ring.sq_map + params.sq_off.head);
+	ring.sq_tail = (unsigned int *) ((char *) ring.sq_map + params.sq_off.tail);
+	ring.sq_mask = *(unsigned int *) ((char *) ring.sq_map
+					  + params.sq_off.ring_mask);
+	ring.sq_entries = params.sq_entries;
+	ring.sq_local_tail = *ring.sq_tail;
+
+	unsigned int *array = (unsigned int *) ((char *) ring.sq_map
+						+ params.sq_off.array);
+	for (i = 0; i < params.sq_entries; ++i) {
+		array[i] = i;
+	}
+
+	ring.cq_head = (unsigned int *) ((char *) ring.cq_map + params.cq_off.head);
+	ring.cq_tail = (unsigned int *) ((char *) ring.cq_map + params.cq_off.tail);
+	ring.cq_mask = *(unsigned int *) ((char *) ring.cq_map
+					  + params.cq_off.ring_mask);
+	ring.cqes = (struct io_uring_cqe *) ((char *) ring.cq_map
+					     + params.cq_off.cqes);
+
+	// provided buffers, shared by all connections
+	if (posix_memalign((void **) &buf_ring, sysconf(_SC_PAGESIZE),
+			   buf_count * sizeof(struct io_uring_buf)) != 0) {
+		buf_ring = NULL;
+		return 0;
+	}
+
+	memset(buf_ring, 0, buf_count * sizeof(struct io_uring_buf));
+	buf_base = malloc(buf_count * URING_BUFFER_SIZE);
+
+	if (buf_base == NULL) {
+		return 0;
+	}
+
+	memset(&reg, 0, sizeof(reg));
+	reg.ring_addr = (unsigned long) buf_ring;
+	reg.ring_entries = buf_count;
+	reg.bgid = URING_BUFFER_GROUP;
+
+	if (uring_register(IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+		DEBUG("network uring: provided buffer rings not supported: %d",
+		      errno);
+		return 0;
+	}
+
+	buf_tail = 0;
+	for (i = 0; i < buf_count; ++i) {
+		buffer_recycle(i);
+	}
+
+	return 1;
+}
+
+/**
+ * Initiates a CommunicationPlugin struct to use the io_uring TCP
+ * transport.
+ *
+ * @param plugin CommunicationPlugin pointer
+ * @param port TCP port to listen on
+ * @param max_connections connection limit (0 = default)
+ * @return URING_ERROR if io_uring is not usable, URING_ERROR_NONE otherwise
+ */
+int plugin_tcp_uring_setup(CommunicationPlugin *plugin, int port,
+			   unsigned int max_connections)
+{
+	unsigned int i;
+
+	DEBUG("network uring: setting up port %d", port);
+
+	if (ring.fd >= 0) {
+		// plugin was already initialized once
+		network_finalize();
+		destroy_ring();
+	}
+
+	if (max_connections == 0) {
+		max_connections = URING_DEFAULT_CONNECTIONS;
+	}
+
+	if (!create_ring()) {
+		destroy_ring();
+		return URING_ERROR;
+	}
+
+	conns = calloc(max_connections, sizeof(UringConnection));
+	free_slots = calloc(max_connections, sizeof(unsigned int));
+	deferred_slots = calloc(max_connections, sizeof(unsigned int));
+
+	if (conns == NULL || free_slots == NULL || deferred_slots == NULL) {
+		destroy_ring();
+		return URING_ERROR;
+	}
+
+	max_conns = max_connections;
+	free_count = max_connections;
+
+	for (i = 0; i < max_connections; ++i) {
+		conns[i].fd = -1;
+		// lowest slots are taken first
+		free_slots[i] = max_connections - 1 - i;
+	}
+
+	tcp_port = port;
+
+	plugin->network_init = network_init;
+	plugin->network_wait_for_data = network_wait_for_data;
+	plugin->network_get_apdu_stream = network_get_apdu_stream;
+	plugin->network_send_apdu_stream = network_send_apdu_stream;
+	plugin->network_disconnect = network_disconnect;
+	plugin->network_finalize = network_finalize;
+
+	return URING_ERROR_NONE;
+}
+
+#else
+
+/**
+ * io_uring is not available in this build
+ *
+ * @return NETWORK_ERROR
+ */
+int plugin_tcp_uring_setup(CommunicationPlugin *plugin, int port,
+			   unsigned int max_connections)
+{
+	DEBUG("network uring: built without io_uring support");
+	return NETWORK_ERROR;
+}
+
+/**
+ * io_uring is not available in this build
+ *
+ * @return -1
+ */
+int plugin_tcp_uring_process(int timeout_ms)
+{
+	return -1;
+}
+
+/**
+ * io_uring is not available in this build
+ *
+ * @return -1
+ */
+int plugin_tcp_uring_fd()
+{
+	return -1;
+}
+
+/**
+ * io_uring is not available in this build
+ *
+ * @param sock ignored
+ * @return NETWORK_ERROR
+ */
+int plugin_tcp_uring_handoff(int sock)
+{
+	return NETWORK_ERROR;
+}
+
+/**
+ * io_uring is not available in this build
+ *
+ * @param sock closed
+ */
+void plugin_tcp_uring_set_takeover(int sock)
+{
+	close(sock);
+}
+
+/**
+ * io_uring is not available in this build
+ *
+ * @param enable ignored
+ */
+void plugin_tcp_uring_set_reuseport(int enable)
+{
+}
+
+/**
+ * io_uring is not available in this build
+ *
+ * @return 0
+ */
+unsigned int plugin_tcp_uring_connection_count()
+{
+	return 0;
+}
+
+#endif
+
+/** @} */
@@ -0,0 +1,65 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+/**
+ * \file plugin_tcp_uring.h
+ * \brief io_uring TCP plugin header.
+ *
+ * Copyright (C) 2010 Signove Tecnologia Corporation.
+ * All rights reserved.
+ * Contact: Signove Tecnologia Corporation (contact@signove.com)
+ *
+ * $LICENSE_TEXT:BEGIN$
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation and appearing
+ * in the file LICENSE included in the packaging of this file; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ * $LICENSE_TEXT:END$
+ *
+ * \date Oct 18, 2026
+ */
+
+#ifndef PLUGIN_TCP_URING_H_
+#define PLUGIN_TCP_URING_H_
+
+#include <communication/plugin/plugin.h>
+
+/**
+ * Default number of provided receive buffers (power of two)
+ */
+#define URING_DEFAULT_BUFFERS 512
+
+/**
+ * Size of each provided receive buffer
+ */
+#define URING_BUFFER_SIZE 2048
+
+/**
+ * Default maximum number of simultaneous connections
+ */
+#define URING_DEFAULT_CONNECTIONS 4096
+
+int plugin_tcp_uring_setup(CommunicationPlugin *plugin, int port,
+			   unsigned int max_connections);
+
+int plugin_tcp_uring_process(int timeout_ms);
+
+int plugin_tcp_uring_fd();
+
+void plugin_tcp_uring_set_reuseport(int enable);
+
+int plugin_tcp_uring_handoff(int sock);
+
+void plugin_tcp_uring_set_takeover(int sock);
+
+unsigned int plugin_tcp_uring_connection_count();
+
+#endif /* PLUGIN_TCP_URING_H_ */
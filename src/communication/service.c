@@ -36,18 +36,75 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "src/communication/service.h"
 #include "src/communication/communication.h"
+#include "src/communication/stats.h"
 #include "src/communication/parser/decoder_ASN1.h"
 #include "src/communication/parser/encoder_ASN1.h"
 #include "src/communication/parser/struct_cleaner.h"
+#include "src/dim/nomenclature.h"
 #include "src/trans/trans.h"
 #include "src/util/log.h"
+#include "src/util/pool.h"
 
 static void service_change_state(Context *ctx, ServiceState new_state);
 static void service_send_apdu_now(Context *ctx, APDU *apdu, timeout_callback timeout);
 static void service_release_resources(Context *ctx);
 
+/**
+ * Updates pending request count and its counter
+ *
+ * @param ctx Current context.
+ * @param delta requests added (positive) or removed (negative)
+ */
+static void service_count_requests(Context *ctx, int delta)
+{
+	ctx->service->requests_count += delta;
+	stats_pending_requests(ctx, delta);
+}
+
+/**
+ * Gets the operation of a request, for latency measurement
+ *
+ * @param req Request
+ * @return StatsOperation, or -1 if not measured
+ */
+static int service_request_operation(Request *req)
+{
+	if (req->apdu == NULL || req->apdu->choice != PRST_CHOSEN) {
+		return -1;
+	}
+
+	DATA_apdu *data_apdu = encode_get_data_apdu(&req->apdu->u.prst);
+
+	switch (data_apdu->message.choice) {
+	case ROIV_CMIP_GET_CHOSEN:
+		return STATS_OP_GET;
+	case ROIV_CMIP_CONFIRMED_SET_CHOSEN:
+		return STATS_OP_SET;
+	case ROIV_CMIP_CONFIRMED_EVENT_REPORT_CHOSEN:
+		return STATS_OP_EVENT_REPORT;
+	case ROIV_CMIP_CONFIRMED_ACTION_CHOSEN:
+		switch (data_apdu->message.u.roiv_cmipConfirmedAction.action_type) {
+		case MDC_ACT_DATA_REQUEST:
+			return STATS_OP_DATA_REQUEST;
+		case MDC_ACT_SEG_GET_INFO:
+			return STATS_OP_SEGMENT_INFO;
+		case MDC_ACT_SEG_TRIG_XFER:
+			return STATS_OP_SEGMENT_TRIG_XFER;
+		default:
+			return STATS_OP_ACTION;
+		}
+	default:
+		return -1;
+	}
+}
+
+/**
+ * Pool of service structures
+ */
+static ObjectPool service_pool = OBJECT_POOL_INITIALIZER(struct Service, 16);
 
 /**
  * Construct service structure
@@ -56,10 +113,29 @@ static void service_release_resources(Context *ctx);
  */
 Service *service_instance()
 {
-	Service *s = calloc(1, sizeof(struct Service));
+	Service *s = pool_alloc(&service_pool);
 	return s;
 }
 
+/**
+ * Pre-allocates service structures
+ *
+ * @param count number of structures to keep ready
+ * @return 1 if successful, 0 otherwise
+ */
+int service_pool_reserve(int count)
+{
+	return pool_reserve(&service_pool, count);
+}
+
+/**
+ * Releases pooled service structures if none is in use
+ */
+void service_pool_trim()
+{
+	pool_trim(&service_pool);
+}
+
 /**
  * Sanitize Request struct
  * @param req Request
@@ -67,10 +143,12 @@ Service *service_instance()
 void clean_request(Request *req)
 {
 	req->is_valid = REQUEST_INVALID;
+	req->is_encoded = 0;
 	req->apdu = NULL;
 	req->timeout.func = NULL;
 	req->timeout.timeout = 0;
 	req->timeout.id = 0;
+	req->sent_at = 0;
 	req->request_callback = NULL;
 	if (req->context) {
 		free(req->context);
@@ -94,6 +172,7 @@ void service_init(Context *ctx)
 	int i;
 
 	if (ctx->service != NULL) {
+		stats_pending_requests(ctx, -ctx->service->requests_count);
 		service_destroy(ctx->service);
 	}
 
@@ -124,7 +203,7 @@ void service_destroy(Service *service)
 			service_del_request(&service->requests_list[i]);
 		}
 
-		free(service);
+		pool_free(&service_pool, service);
 	}
 }
 
@@ -143,7 +222,7 @@ static void service_release_resources(Context *ctx)
 		if (service->requests_list[i].is_valid == REQUEST_VALID) {
 			service->requests_list[i].is_valid = REQUEST_INVALID;
 			service_del_request(&service->requests_list[i]);
-			service->requests_count--;
+			service_count_requests(ctx, -1);
 		}
 	}
 
@@ -151,7 +230,7 @@ static void service_release_resources(Context *ctx)
 	service_change_state(ctx, READY);
 	service->last_invoke_id = 0xF;
 	service->current_invoke_id = 0;
-	service->requests_count = 0;
+	service_count_requests(ctx, -service->requests_count);
 }
 
 /**
@@ -198,7 +277,7 @@ Request *service_send_remote_operation_request(Context *ctx, APDU *apdu, timeout
 			req->is_valid = REQUEST_VALID;
 			req->request_callback = request_callback;
 
-			service->requests_count++;
+			service_count_requests(ctx, 1);
 
 			if (service->state == READY) {
 				service_send_apdu_now(ctx, apdu, timeout);
@@ -234,7 +313,7 @@ void service_trans_request_cb(Context *ctx)
 	req->request_callback(ctx, req, 0);
 	req->is_valid = REQUEST_INVALID;
 	service_del_request(req);
-	ctx->service->requests_count--;
+	service_count_requests(ctx, -1);
 }
 
 /**
@@ -261,7 +340,7 @@ Request *service_trans_request(Context *ctx, service_request_callback request_ca
 	req->is_valid = REQUEST_VALID;
 	req->request_callback = request_callback;
 
-	ctx->service->requests_count++;
+	service_count_requests(ctx, 1);
 
 	// make it wait for the next event loop cycle
 	communication_count_timeout(ctx, service_trans_request_cb, 0);
@@ -301,7 +380,7 @@ Request *service_trans_set_time_request(Context *ctx, SetTimeInvoke *time,
 	req->is_valid = REQUEST_VALID;
 	req->request_callback = request_callback;
 
-	ctx->service->requests_count++;
+	service_count_requests(ctx, 1);
 
 	return req;
 }
@@ -330,7 +409,7 @@ void service_trans_set_time_response(ContextId id, int invoke_id, int ok)
 	req->request_callback(ctx, req, 0);
 	req->is_valid = REQUEST_INVALID;
 	service_del_request(req);
-	ctx->service->requests_count--;
+	service_count_requests(ctx, -1);
 
 	context_unlock(ctx);
 }
@@ -356,6 +435,64 @@ void service_send_unconfirmed_operation_request(Context *ctx, APDU *apdu)
 	free(apdu);
 }
 
+/**
+ * Sends a Remote Operation Invoke apdu that is encoded already, e.g.
+ * patched from a template, writing the new invoke id in place.
+ * Encoded requests are not queued: this fails if another request
+ * is pending, and the caller should send a regular APDU instead.
+ *
+ * @param ctx Current context.
+ * @param encoded_apdu encoded PRST apdu, still owned by caller.
+ * @param timeout A timeout function for this request.
+ * @param request_callback Request callback function.
+ *
+ * @return the request created, or NULL if not sent
+ */
+Request *service_send_remote_operation_encoded(Context *ctx,
+					ByteStreamWriter *encoded_apdu,
+					timeout_callback timeout,
+					service_request_callback request_callback)
+{
+	Service *service = ctx->service;
+	intu8 *buffer = encoded_apdu->buffer;
+
+	if (service->state != READY || service->requests_count > 0
+	    || encoded_apdu->size < 10
+	    || ((buffer[0] << 8) | buffer[1]) != PRST_CHOSEN) {
+		return NULL;
+	}
+
+	InvokeIDType invoke_id = service_get_new_invoke_id(ctx);
+	Request *req = &service->requests_list[invoke_id];
+
+	buffer[6] = invoke_id >> 8;
+	buffer[7] = invoke_id & 0xff;
+
+	memset(&service->encoded_data, 0, sizeof(DATA_apdu));
+	service->encoded_data.invoke_id = invoke_id;
+	service->encoded_data.message.choice = (buffer[8] << 8) | buffer[9];
+	service->encoded_apdu.choice = PRST_CHOSEN;
+	service->encoded_apdu.length = encoded_apdu->size - 4;
+	service->encoded_apdu.u.prst.length = encoded_apdu->size - 6;
+	encode_set_data_apdu(&service->encoded_apdu.u.prst,
+			     &service->encoded_data);
+
+	req->apdu = &service->encoded_apdu;
+	req->is_encoded = 1;
+	req->timeout = timeout;
+	req->is_valid = REQUEST_VALID;
+	req->request_callback = request_callback;
+	req->sent_at = stats_time();
+
+	service_count_requests(ctx, 1);
+
+	communication_send_encoded_apdu(ctx, encoded_apdu);
+	communication_count_timeout(ctx, timeout.func, timeout.timeout);
+	service_change_state(ctx, PROCESSING);
+
+	return req;
+}
+
 /**
  * Returns current invoke id expected or in process
  *
@@ -396,7 +533,7 @@ InvokeIDType service_get_invoke_id(Context *ctx, Request *req)
 void service_del_request(Request *req)
 {
 	if (req != NULL) {
-		if (req->apdu != NULL) {
+		if (req->apdu != NULL && !req->is_encoded) {
 			del_apdu(req->apdu);
 			free(req->apdu);
 		}
@@ -433,12 +570,17 @@ void service_request_retired(Context *ctx, DATA_apdu *response_apdu)
 		InvokeIDType retiredInvokeID = response_apdu->invoke_id;
 		req->is_valid = REQUEST_INVALID;
 
+		if (req->sent_at) {
+			stats_latency_record(ctx, service_request_operation(req),
+					     stats_time() - req->sent_at);
+		}
+
 		if (req->request_callback != NULL) {
 			(req->request_callback)(ctx, req, response_apdu);
 		}
 
 		service_del_request(req);
-		service->requests_count--;
+		service_count_requests(ctx, -1);
 
 
 		if (service->state == PROCESSING) {
@@ -492,6 +634,12 @@ void service_finalize(Context *ctx, service_state_callback_function state_change
  */
 static void service_send_apdu_now(Context *ctx, APDU *apdu, timeout_callback timeout)
 {
+	DATA_apdu *data_apdu = encode_get_data_apdu(&apdu->u.prst);
+
+	if (data_apdu->invoke_id <= 15) {
+		ctx->service->requests_list[data_apdu->invoke_id].sent_at = stats_time();
+	}
+
 	communication_send_apdu(ctx, apdu);
 	communication_count_timeout(ctx, timeout.func, timeout.timeout);
 	service_change_state(ctx, PROCESSING);
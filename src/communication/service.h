@@ -107,11 +107,17 @@ struct RequestRet {
  */
 typedef struct Request {
 	intu16 is_valid;
+	/**
+	 * Non-zero if apdu is the stand-in of a pre-encoded request,
+	 * owned by Service
+	 */
+	intu16 is_encoded;
 	APDU *apdu;
 	timeout_callback timeout;
 	service_request_callback request_callback;
 	void *context;
 	struct RequestRet *return_data;
+	unsigned long long sent_at;
 } Request;
 
 /**
@@ -125,6 +131,16 @@ typedef struct Service {
 	int requests_count;
 	Request requests_list[16];
 
+	/**
+	 * Stand-in for the apdu of the pre-encoded request. Encoded
+	 * requests are not queued, so there is one at most.
+	 */
+	APDU encoded_apdu;
+	/**
+	 * Invoke id and message choice of the pre-encoded request
+	 */
+	DATA_apdu encoded_data;
+
 	service_state_callback_function state_changed_callback;
 } Service;
 
@@ -132,6 +148,10 @@ Service *service_instance();
 
 void service_destroy(Service *serive);
 
+int service_pool_reserve(int count);
+
+void service_pool_trim();
+
 void service_init(Context *ctx);
 
 void service_del_request(Request *req);
@@ -142,6 +162,11 @@ Request *service_trans_request(Context *ctx, service_request_callback request_ca
 
 void service_send_unconfirmed_operation_request(Context *ctx, APDU *apdu);
 
+Request *service_send_remote_operation_encoded(Context *ctx,
+					ByteStreamWriter *encoded_apdu,
+					timeout_callback timeout,
+					service_request_callback request_callback);
+
 InvokeIDType service_get_invoke_id(Context *ctx, Request *req);
 
 InvokeIDType service_get_current_invoke_id(Context *ctx);
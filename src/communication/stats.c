@@ -0,0 +1,612 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+/**
+ * \file stats.c
+ * \brief Communication performance counters.
+ *
+ * Copyright (C) 2010 Signove Tecnologia Corporation.
+ * All rights reserved.
+ * Contact: Signove Tecnologia Corporation (contact@signove.com)
+ *
+ * $LICENSE_TEXT:BEGIN$
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation and appearing
+ * in the file LICENSE included in the packaging of this file; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ * $LICENSE_TEXT:END$
+ *
+ * \date Oct 18, 2026
+ */
+
+/**
+ * \addtogroup Communication
+ *
+ * Every context carries a CommunicationStats, and a global instance
+ * accumulates the same events for the whole process. Counters are
+ * updated with relaxed atomic operations, so they cost a few
+ * instructions in the protocol path and may be read at any time
+ * without taking context locks.
+ *
+ * Latency of confirmed operations is kept in histograms with
+ * logarithmic buckets (HDR-style), also per context and globally.
+ * Histograms of a context are allocated only for the operations
+ * it actually performs.
+ *
+ * @{
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "src/communication/stats.h"
+#include "src/communication/context.h"
+#include "src/communication/fsm.h"
+
+/**
+ * Counters of the whole process
+ */
+static CommunicationStats global_stats;
+
+/**
+ * Latency histograms of the whole process
+ */
+static LatencyHistogram global_latency[STATS_OP_TYPES];
+
+/**
+ * Latency data of a context
+ */
+struct ContextLatency {
+	/**
+	 * When the last PRST APDU was received (us), 0 if acknowledged
+	 */
+	unsigned long long received_at;
+	/**
+	 * Histograms, NULL until the first sample of the operation
+	 */
+	LatencyHistogram *ops[STATS_OP_TYPES];
+};
+
+/**
+ * Adds n to a counter of the context (if any) and to the global one
+ */
+#define STATS_ADD(ctx, field, n) do {					\
+		__atomic_add_fetch(&global_stats.field, (n), __ATOMIC_RELAXED); \
+		if (ctx)						\
+			__atomic_add_fetch(&(ctx)->stats.field, (n),	\
+					   __ATOMIC_RELAXED);		\
+	} while (0)
+
+/**
+ * Raises *p to v if v is greater
+ */
+static void stats_max(unsigned long long *p, unsigned long long v)
+{
+	unsigned long long cur = __atomic_load_n(p, __ATOMIC_RELAXED);
+
+	while (v > cur) {
+		if (__atomic_compare_exchange_n(p, &cur, v, 0, __ATOMIC_RELAXED,
+						__ATOMIC_RELAXED)) {
+			break;
+		}
+	}
+}
+
+/**
+ * Gets latency data of a context, allocating it if needed
+ *
+ * @param ctx context
+ * @return latency data or NULL if out of memory
+ */
+static struct ContextLatency *stats_context_latency(Context *ctx)
+{
+	if (ctx->latency == NULL) {
+		ctx->latency = calloc(1, sizeof(struct ContextLatency));
+	}
+
+	return ctx->latency;
+}
+
+/**
+ * Gets counter slot of an encoded APDU
+ *
+ * @param apdu encoded APDU
+ * @param len APDU length
+ * @return StatsApduType
+ */
+static int stats_apdu_type(const unsigned char *apdu, unsigned long len)
+{
+	if (apdu == NULL || len < 1 || apdu[0] < 0xE2 || apdu[0] > 0xE7) {
+		return STATS_APDU_UNKNOWN;
+	}
+
+	return apdu[0] - 0xE2;
+}
+
+/**
+ * Counts a received APDU
+ *
+ * @param ctx context
+ * @param apdu encoded APDU
+ * @param len APDU length in bytes
+ */
+void stats_apdu_received(Context *ctx, const unsigned char *apdu,
+			 unsigned long len)
+{
+	int type = stats_apdu_type(apdu, len);
+	STATS_ADD(ctx, apdus_in[type], 1);
+	STATS_ADD(ctx, bytes_in[type], len);
+
+	if (ctx != NULL && type == STATS_APDU_PRST) {
+		struct ContextLatency *latency = stats_context_latency(ctx);
+
+		if (latency != NULL) {
+			latency->received_at = stats_time();
+		}
+	}
+}
+
+/**
+ * Counts a sent APDU
+ *
+ * @param ctx context
+ * @param apdu encoded APDU
+ * @param len APDU length in bytes
+ */
+void stats_apdu_sent(Context *ctx, const unsigned char *apdu,
+		     unsigned long len)
+{
+	int type = stats_apdu_type(apdu, len);
+	STATS_ADD(ctx, apdus_out[type], 1);
+	STATS_ADD(ctx, bytes_out[type], len);
+}
+
+/**
+ * Counts an APDU that could not be decoded
+ *
+ * @param ctx context
+ */
+void stats_decode_error(Context *ctx)
+{
+	STATS_ADD(ctx, decode_errors, 1);
+}
+
+/**
+ * Counts an APDU that could not be encoded
+ *
+ * @param ctx context
+ */
+void stats_encode_error(Context *ctx)
+{
+	STATS_ADD(ctx, encode_errors, 1);
+}
+
+/**
+ * Counts an APDU the transport plug-in failed to send
+ *
+ * @param ctx context
+ */
+void stats_send_error(Context *ctx)
+{
+	STATS_ADD(ctx, send_errors, 1);
+}
+
+/**
+ * Counts a timeout
+ *
+ * @param ctx context
+ */
+void stats_timeout(Context *ctx)
+{
+	STATS_ADD(ctx, timeouts, 1);
+}
+
+/**
+ * Tracks associations from state machine transitions
+ *
+ * @param ctx context
+ * @param previous previous fsm_states
+ * @param next new fsm_states
+ */
+void stats_state_transition(Context *ctx, int previous, int next)
+{
+	if (previous != fsm_state_operating && next == fsm_state_operating) {
+		STATS_ADD(ctx, associations, 1);
+		STATS_ADD(ctx, associated, 1);
+	} else if (previous == fsm_state_operating
+		   && next != fsm_state_operating) {
+		STATS_ADD(ctx, associated, -1);
+	}
+}
+
+/**
+ * Tracks the depth of the pending request queue
+ *
+ * @param ctx context
+ * @param delta requests added (positive) or removed (negative)
+ */
+void stats_pending_requests(Context *ctx, int delta)
+{
+	STATS_ADD(ctx, pending_requests, delta);
+
+	if (delta > 0) {
+		unsigned long long depth =
+			__atomic_load_n(&ctx->stats.pending_requests,
+					__ATOMIC_RELAXED);
+		stats_max(&ctx->stats.max_pending_requests, depth);
+		stats_max(&global_stats.max_pending_requests, depth);
+	}
+}
+
+/**
+ * Counts a new context
+ *
+ * @param ctx context
+ */
+void stats_context_created(Context *ctx)
+{
+	STATS_ADD(ctx, contexts, 1);
+}
+
+/**
+ * Removes gauges of a context being destroyed from global counters
+ *
+ * @param ctx context
+ */
+void stats_context_destroyed(Context *ctx)
+{
+	__atomic_sub_fetch(&global_stats.contexts, 1, __ATOMIC_RELAXED);
+	__atomic_sub_fetch(&global_stats.associated, ctx->stats.associated,
+			   __ATOMIC_RELAXED);
+	__atomic_sub_fetch(&global_stats.pending_requests,
+			   ctx->stats.pending_requests, __ATOMIC_RELAXED);
+
+	if (ctx->latency != NULL) {
+		int i;
+
+		for (i = 0; i < STATS_OP_TYPES; ++i) {
+			free(ctx->latency->ops[i]);
+		}
+
+		free(ctx->latency);
+		ctx->latency = NULL;
+	}
+}
+
+/**
+ * Copies a set of counters
+ *
+ * @param from counters being updated
+ * @param to snapshot
+ * @param size size in bytes, multiple of sizeof(unsigned long long)
+ */
+static void stats_snapshot(const void *from, void *to, size_t size)
+{
+	const unsigned long long *src = from;
+	unsigned long long *dst = to;
+	size_t i;
+
+	for (i = 0; i < size / sizeof(unsigned long long); ++i) {
+		dst[i] = __atomic_load_n(&src[i], __ATOMIC_RELAXED);
+	}
+}
+
+/**
+ * Gets a snapshot of process-wide counters
+ *
+ * @param stats snapshot (output)
+ */
+void stats_get_global(CommunicationStats *stats)
+{
+	stats_snapshot(&global_stats, stats, sizeof(CommunicationStats));
+}
+
+/**
+ * Gets a snapshot of the counters of a context
+ *
+ * @param ctx context
+ * @param stats snapshot (output)
+ */
+void stats_get_context(Context *ctx, CommunicationStats *stats)
+{
+	stats_snapshot(&ctx->stats, stats, sizeof(CommunicationStats));
+}
+
+/**
+ * Writes counters in text format, one "name value" per line.
+ * Per-type counters are written as name{type="aarq"}, which also
+ * makes the output readable by Prometheus text collectors.
+ *
+ * @param f output file
+ * @param prefix prepended to counter names (may be NULL)
+ * @param stats counters
+ */
+void stats_print(FILE *f, const char *prefix, const CommunicationStats *stats)
+{
+	static const char *types[STATS_APDU_TYPES] = {
+		"aarq", "aare", "rlrq", "rlre", "abrt", "prst", "unknown"
+	};
+	int i;
+
+	if (prefix == NULL) {
+		prefix = "";
+	}
+
+	for (i = 0; i < STATS_APDU_TYPES; ++i) {
+		fprintf(f, "%sapdus_in{type=\"%s\"} %llu\n", prefix, types[i],
+			stats->apdus_in[i]);
+		fprintf(f, "%sbytes_in{type=\"%s\"} %llu\n", prefix, types[i],
+			stats->bytes_in[i]);
+		fprintf(f, "%sapdus_out{type=\"%s\"} %llu\n", prefix, types[i],
+			stats->apdus_out[i]);
+		fprintf(f, "%sbytes_out{type=\"%s\"} %llu\n", prefix, types[i],
+			stats->bytes_out[i]);
+	}
+
+	fprintf(f, "%sdecode_errors %llu\n", prefix, stats->decode_errors);
+	fprintf(f, "%sencode_errors %llu\n", prefix, stats->encode_errors);
+	fprintf(f, "%ssend_errors %llu\n", prefix, stats->send_errors);
+	fprintf(f, "%stimeouts %llu\n", prefix, stats->timeouts);
+	fprintf(f, "%sassociations %llu\n", prefix, stats->associations);
+	fprintf(f, "%sassociated %llu\n", prefix, stats->associated);
+	fprintf(f, "%spending_requests %llu\n", prefix,
+		stats->pending_requests);
+	fprintf(f, "%smax_pending_requests %llu\n", prefix,
+		stats->max_pending_requests);
+	fprintf(f, "%scontexts %llu\n", prefix, stats->contexts);
+}
+
+/**
+ * Gets monotonic time in microseconds, to be used as
+ * starting point of latency measurements.
+ *
+ * @return time in microseconds
+ */
+unsigned long long stats_time()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+/**
+ * Gets histogram bucket of a value
+ *
+ * @param v value in microseconds
+ * @return bucket index
+ */
+static int stats_latency_bucket(unsigned long long v)
+{
+	int major;
+
+	if (v < 8) {
+		return v;
+	}
+
+	major = 63 - __builtin_clzll(v);
+
+	if (major > 31) {
+		return STATS_LATENCY_BUCKETS - 1;
+	}
+
+	return (major - 2) * 8 + ((v >> (major - 3)) & 7);
+}
+
+/**
+ * Gets the largest value that falls in a histogram bucket
+ *
+ * @param bucket bucket index
+ * @return value in microseconds
+ */
+static unsigned long long stats_latency_bucket_top(int bucket)
+{
+	int major = bucket / 8 + 2;
+
+	if (bucket < 8) {
+		return bucket;
+	}
+
+	return ((8ULL + bucket % 8 + 1) << (major - 3)) - 1;
+}
+
+/**
+ * Adds a sample to a histogram
+ *
+ * @param hist histogram
+ * @param usec sample in microseconds
+ */
+static void stats_histogram_add(LatencyHistogram *hist, unsigned long long usec)
+{
+	__atomic_add_fetch(&hist->count, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&hist->sum, usec, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&hist->buckets[stats_latency_bucket(usec)], 1,
+			   __ATOMIC_RELAXED);
+	stats_max(&hist->max, usec);
+}
+
+/**
+ * Records latency of an operation
+ *
+ * @param ctx context (may be NULL)
+ * @param op StatsOperation
+ * @param usec latency in microseconds
+ */
+void stats_latency_record(Context *ctx, int op, unsigned long long usec)
+{
+	if (op < 0 || op >= STATS_OP_TYPES) {
+		return;
+	}
+
+	stats_histogram_add(&global_latency[op], usec);
+
+	if (ctx != NULL) {
+		struct ContextLatency *latency = stats_context_latency(ctx);
+
+		if (latency == NULL) {
+			return;
+		}
+
+		if (latency->ops[op] == NULL) {
+			latency->ops[op] = calloc(1, sizeof(LatencyHistogram));
+		}
+
+		if (latency->ops[op] != NULL) {
+			stats_histogram_add(latency->ops[op], usec);
+		}
+	}
+}
+
+/**
+ * Records the time taken to acknowledge the last event report
+ * received by this context
+ *
+ * @param ctx context
+ */
+void stats_event_report_acked(Context *ctx)
+{
+	if (ctx->latency == NULL || ctx->latency->received_at == 0) {
+		return;
+	}
+
+	stats_latency_record(ctx, STATS_OP_EVENT_REPORT_ACK,
+			     stats_time() - ctx->latency->received_at);
+	ctx->latency->received_at = 0;
+}
+
+/**
+ * Gets a snapshot of a process-wide latency histogram
+ *
+ * @param op StatsOperation
+ * @param hist snapshot (output)
+ */
+void stats_get_global_latency(int op, LatencyHistogram *hist)
+{
+	memset(hist, 0, sizeof(LatencyHistogram));
+
+	if (op < 0 || op >= STATS_OP_TYPES) {
+		return;
+	}
+
+	stats_snapshot(&global_latency[op], hist, sizeof(LatencyHistogram));
+}
+
+/**
+ * Gets a snapshot of a latency histogram of a context
+ *
+ * @param ctx context
+ * @param op StatsOperation
+ * @param hist snapshot (output), empty if operation never happened
+ */
+void stats_get_context_latency(Context *ctx, int op, LatencyHistogram *hist)
+{
+	memset(hist, 0, sizeof(LatencyHistogram));
+
+	if (op < 0 || op >= STATS_OP_TYPES || ctx->latency == NULL
+	    || ctx->latency->ops[op] == NULL) {
+		return;
+	}
+
+	stats_snapshot(ctx->latency->ops[op], hist, sizeof(LatencyHistogram));
+}
+
+/**
+ * Estimates a percentile of a latency histogram. The result is the
+ * upper bound of the bucket where the percentile falls, so it is never
+ * lower than the actual value.
+ *
+ * @param hist histogram
+ * @param percentile percentile, e.g. 99.9
+ * @return latency in microseconds, 0 if histogram is empty
+ */
+unsigned long long stats_latency_percentile(const LatencyHistogram *hist,
+					    double percentile)
+{
+	unsigned long long target;
+	unsigned long long seen = 0;
+	unsigned long long top;
+	int i;
+
+	if (hist->count == 0) {
+		return 0;
+	}
+
+	target = (unsigned long long) (hist->count * percentile / 100.0 + 0.999999);
+
+	if (target < 1) {
+		target = 1;
+	} else if (target > hist->count) {
+		target = hist->count;
+	}
+
+	for (i = 0; i < STATS_LATENCY_BUCKETS - 1; ++i) {
+		seen += hist->buckets[i];
+
+		if (seen >= target) {
+			break;
+		}
+	}
+
+	// last bucket has no upper bound
+	if (i == STATS_LATENCY_BUCKETS - 1) {
+		return hist->max;
+	}
+
+	top = stats_latency_bucket_top(i);
+
+	return top < hist->max ? top : hist->max;
+}
+
+/**
+ * Writes latency histograms in text format, as count, sum, max and
+ * quantiles of each operation that has samples.
+ *
+ * @param f output file
+ * @param prefix prepended to names (may be NULL)
+ * @param hist histograms, indexed by StatsOperation
+ */
+void stats_print_latency(FILE *f, const char *prefix,
+			 const LatencyHistogram hist[STATS_OP_TYPES])
+{
+	static const char *ops[STATS_OP_TYPES] = {
+		"get", "set", "data_request", "segment_info",
+		"segment_trig_xfer", "action", "event_report",
+		"event_report_ack"
+	};
+	static const double quantiles[] = {50.0, 90.0, 99.0, 99.9};
+	unsigned int q;
+	int i;
+
+	if (prefix == NULL) {
+		prefix = "";
+	}
+
+	for (i = 0; i < STATS_OP_TYPES; ++i) {
+		if (hist[i].count == 0) {
+			continue;
+		}
+
+		for (q = 0; q < sizeof(quantiles) / sizeof(quantiles[0]); ++q) {
+			fprintf(f, "%slatency_us{op=\"%s\",quantile=\"%g\"} %llu\n",
+				prefix, ops[i], quantiles[q] / 100.0,
+				stats_latency_percentile(&hist[i], quantiles[q]));
+		}
+
+		fprintf(f, "%slatency_us_max{op=\"%s\"} %llu\n", prefix, ops[i],
+			hist[i].max);
+		fprintf(f, "%slatency_us_sum{op=\"%s\"} %llu\n", prefix, ops[i],
+			hist[i].sum);
+		fprintf(f, "%slatency_us_count{op=\"%s\"} %llu\n", prefix, ops[i],
+			hist[i].count);
+	}
+}
+
+/** @} */
@@ -0,0 +1,214 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+/**
+ * \file stats.h
+ * \brief Communication performance counters header.
+ *
+ * Copyright (C) 2010 Signove Tecnologia Corporation.
+ * All rights reserved.
+ * Contact: Signove Tecnologia Corporation (contact@signove.com)
+ *
+ * $LICENSE_TEXT:BEGIN$
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation and appearing
+ * in the file LICENSE included in the packaging of this file; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ * $LICENSE_TEXT:END$
+ *
+ * \date Oct 18, 2026
+ */
+
+#ifndef STATS_H_
+#define STATS_H_
+
+#include <stdio.h>
+
+/**
+ * \ingroup Communication
+ * @{
+ */
+
+/**
+ * APDU types counted separately, indexed by (choice >> 8) - 0xE2
+ */
+typedef enum {
+	STATS_APDU_AARQ = 0,
+	STATS_APDU_AARE,
+	STATS_APDU_RLRQ,
+	STATS_APDU_RLRE,
+	STATS_APDU_ABRT,
+	STATS_APDU_PRST,
+	STATS_APDU_UNKNOWN,
+	STATS_APDU_TYPES
+} StatsApduType;
+
+/**
+ * Communication counters, kept for each context and globally.
+ *
+ * All members are unsigned long long, so that snapshots and sums may
+ * treat the structure as an array. Aborts are the ABRT entries of the
+ * per-type counters.
+ */
+typedef struct CommunicationStats {
+	/**
+	 * APDUs received, by type
+	 */
+	unsigned long long apdus_in[STATS_APDU_TYPES];
+	/**
+	 * Bytes received, by APDU type
+	 */
+	unsigned long long bytes_in[STATS_APDU_TYPES];
+	/**
+	 * APDUs sent, by type
+	 */
+	unsigned long long apdus_out[STATS_APDU_TYPES];
+	/**
+	 * Bytes sent, by APDU type
+	 */
+	unsigned long long bytes_out[STATS_APDU_TYPES];
+	/**
+	 * Received APDUs that could not be decoded
+	 */
+	unsigned long long decode_errors;
+	/**
+	 * APDUs that could not be encoded
+	 */
+	unsigned long long encode_errors;
+	/**
+	 * APDUs refused by the transport plug-in
+	 */
+	unsigned long long send_errors;
+	/**
+	 * Timeouts fired
+	 */
+	unsigned long long timeouts;
+	/**
+	 * Times the operating state was entered
+	 */
+	unsigned long long associations;
+	/**
+	 * Contexts currently in operating state (gauge)
+	 */
+	unsigned long long associated;
+	/**
+	 * Confirmed requests queued or awaiting response (gauge)
+	 */
+	unsigned long long pending_requests;
+	/**
+	 * Highest pending request queue depth seen in a single context
+	 */
+	unsigned long long max_pending_requests;
+	/**
+	 * Existing contexts (gauge, global counters only)
+	 */
+	unsigned long long contexts;
+} CommunicationStats;
+
+/**
+ * Confirmed operations whose latency is measured
+ */
+typedef enum {
+	STATS_OP_GET = 0,
+	STATS_OP_SET,
+	STATS_OP_DATA_REQUEST,
+	STATS_OP_SEGMENT_INFO,
+	STATS_OP_SEGMENT_TRIG_XFER,
+	STATS_OP_ACTION,
+	STATS_OP_EVENT_REPORT,
+	STATS_OP_EVENT_REPORT_ACK,
+	STATS_OP_TYPES
+} StatsOperation;
+
+/**
+ * Number of buckets of a latency histogram. Values below 8us have
+ * a bucket each; above that, each power of two is split in 8
+ * buckets, so percentiles are within 12.5% of the actual value.
+ * Values above 2^32us (71 minutes) fall in the last bucket.
+ */
+#define STATS_LATENCY_BUCKETS 240
+
+/**
+ * Latency histogram in microseconds. Requests sent by this side
+ * are measured from sending to the arrival of the response;
+ * STATS_OP_EVENT_REPORT_ACK measures the time taken by this side to
+ * acknowledge an event report since it was received.
+ */
+typedef struct LatencyHistogram {
+	/**
+	 * Number of samples
+	 */
+	unsigned long long count;
+	/**
+	 * Sum of samples
+	 */
+	unsigned long long sum;
+	/**
+	 * Largest sample
+	 */
+	unsigned long long max;
+	/**
+	 * Sample count of each bucket
+	 */
+	unsigned long long buckets[STATS_LATENCY_BUCKETS];
+} LatencyHistogram;
+
+struct Context;
+
+void stats_apdu_received(struct Context *ctx, const unsigned char *apdu,
+			 unsigned long len);
+
+void stats_apdu_sent(struct Context *ctx, const unsigned char *apdu,
+		     unsigned long len);
+
+void stats_decode_error(struct Context *ctx);
+
+void stats_encode_error(struct Context *ctx);
+
+void stats_send_error(struct Context *ctx);
+
+void stats_timeout(struct Context *ctx);
+
+void stats_state_transition(struct Context *ctx, int previous, int next);
+
+void stats_pending_requests(struct Context *ctx, int delta);
+
+void stats_context_created(struct Context *ctx);
+
+void stats_context_destroyed(struct Context *ctx);
+
+void stats_get_global(CommunicationStats *stats);
+
+void stats_get_context(struct Context *ctx, CommunicationStats *stats);
+
+void stats_print(FILE *f, const char *prefix, const CommunicationStats *stats);
+
+unsigned long long stats_time();
+
+void stats_latency_record(struct Context *ctx, int op,
+			  unsigned long long usec);
+
+void stats_event_report_acked(struct Context *ctx);
+
+void stats_get_global_latency(int op, LatencyHistogram *hist);
+
+void stats_get_context_latency(struct Context *ctx, int op,
+			       LatencyHistogram *hist);
+
+unsigned long long stats_latency_percentile(const LatencyHistogram *hist,
+					    double percentile);
+
+void stats_print_latency(FILE *f, const char *prefix,
+			 const LatencyHistogram hist[STATS_OP_TYPES]);
+
+/** @} */
+
+#endif /* STATS_H_ */
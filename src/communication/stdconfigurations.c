@@ -36,8 +36,20 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include "src/communication/stdconfigurations.h"
+#include "src/communication/parser/struct_cleaner.h"
 #include "src/util/log.h"
 
+/**
+ * Standard configuration IDs are in range 0x0001-0x3FFF; the index
+ * is split in pages of 256 IDs, allocated only when used.
+ */
+#define STD_CONFIG_INDEX_PAGES 0x40
+
+/**
+ * Number of IDs in each index page
+ */
+#define STD_CONFIG_INDEX_PAGE_SIZE 0x100
+
 /**
  * Number of the standard configurations that are supported.
  */
@@ -48,10 +60,40 @@ static int std_configurations_count = 0;
  */
 static struct StdConfiguration **std_configuration_list = NULL;
 
-// TODO use a LinkedList
+/**
+ * Direct index of standard configurations by config_id
+ */
+static struct StdConfiguration **std_configuration_index[STD_CONFIG_INDEX_PAGES];
 
 /**
- * This method adds a new configuration.
+ * Adds configuration to the config_id index. If the ID is already
+ * indexed, the configuration registered first is kept.
+ *
+ * @param config configuration
+ */
+static void std_configurations_index(struct StdConfiguration *config)
+{
+	ConfigId id = config->dev_config_id;
+	int page = id / STD_CONFIG_INDEX_PAGE_SIZE;
+
+	if (page >= STD_CONFIG_INDEX_PAGES) {
+		ERROR("Standard configuration id %d out of range", id);
+		return;
+	}
+
+	if (std_configuration_index[page] == NULL) {
+		std_configuration_index[page] = calloc(STD_CONFIG_INDEX_PAGE_SIZE,
+					sizeof(struct StdConfiguration *));
+	}
+
+	if (std_configuration_index[page][id % STD_CONFIG_INDEX_PAGE_SIZE] == NULL) {
+		std_configuration_index[page][id % STD_CONFIG_INDEX_PAGE_SIZE] = config;
+	}
+}
+
+/**
+ * This method adds a new configuration. The configuration object
+ * list is built once here and shared by every association.
  *
  * @param config Configuration described in the specialization document
  */
@@ -71,6 +113,10 @@ void std_configurations_register_conf(struct StdConfiguration *config)
 	}
 
 	std_configuration_list[last_index] = config;
+
+	config->config_obj_list = config->configure_action();
+
+	std_configurations_index(config);
 }
 
 /**
@@ -83,15 +129,13 @@ void std_configurations_register_conf(struct StdConfiguration *config)
  */
 struct StdConfiguration *std_configurations_get_supported_standard(ConfigId config_id)
 {
-	int i;
+	int page = config_id / STD_CONFIG_INDEX_PAGE_SIZE;
 
-	for (i = 0; i < std_configurations_count; i++) {
-		if (std_configuration_list[i]->dev_config_id == config_id) {
-			return std_configuration_list[i];
-		}
+	if (page >= STD_CONFIG_INDEX_PAGES || std_configuration_index[page] == NULL) {
+		return NULL;
 	}
 
-	return NULL;
+	return std_configuration_index[page][config_id % STD_CONFIG_INDEX_PAGE_SIZE];
 }
 
 /**
@@ -122,7 +166,10 @@ int std_configurations_is_supported_standard(ConfigId config_id)
 
 /**
  * This method return the Extended Configuration described in the specialization
- * document and identified by config_report parameter
+ * document and identified by config_report parameter.
+ *
+ * The list is shared by all contexts and owned by the standard
+ * configuration: it must not be modified nor freed by the caller.
  *
  * @param config_id Identify the configuration described in the specialization
  *                      document;
@@ -137,7 +184,7 @@ ConfigObjectList *std_configurations_get_configuration_attributes(
 		std_configurations_get_supported_standard(config_id);
 
 	if (standard != NULL) {
-		return standard->configure_action();
+		return standard->config_obj_list;
 	}
 
 	return NULL;
@@ -148,12 +195,21 @@ ConfigObjectList *std_configurations_get_configuration_attributes(
  */
 void std_configurations_destroy()
 {
+	int i;
+
 	if (std_configuration_list != NULL) {
 		struct StdConfiguration *std_conf = NULL;
-		int i = 0;
 
 		for (i = 0; i < std_configurations_count; i++) {
 			std_conf = std_configuration_list[i];
+
+			if (std_conf->config_obj_list != NULL) {
+				del_configobjectlist(std_conf->config_obj_list);
+				free(std_conf->config_obj_list);
+			}
+
+			free(std_conf->event_report_template);
+
 			free(std_conf);
 			std_conf = NULL;
 		}
@@ -161,6 +217,11 @@ void std_configurations_destroy()
 
 	free(std_configuration_list);
 
+	for (i = 0; i < STD_CONFIG_INDEX_PAGES; i++) {
+		free(std_configuration_index[i]);
+		std_configuration_index[i] = NULL;
+	}
+
 	std_configuration_list = NULL;
 	std_configurations_count = 0;
 }
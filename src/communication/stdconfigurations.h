@@ -39,6 +39,7 @@
 #include <stdlib.h>
 #include <asn1/phd_types.h>
 #include <dim/mds.h>
+#include <util/bytelib.h>
 
 /**
  * This Function Pointer return the Extended Configuration described
@@ -56,6 +57,14 @@ typedef char *(*mds_to_string)(MDS *mds);
  */
 typedef DATA_apdu *(*agent_event_report)(void *data);
 
+/**
+ * Writes the observed values of an event report, measure after
+ * measure, in the same order and format used by agent_event_report (agent)
+ */
+typedef int (*agent_event_report_values)(void *data, ByteStreamWriter *stream);
+
+struct EventReportTemplate;
+
 /**
  * Represent the standard configuration described in the
  * specialization document (IEEE-11073-10xxx)
@@ -75,6 +84,24 @@ struct StdConfiguration {
 	 * This function pointer fills a DATA_apdu with data event report
 	 */
 	agent_event_report event_report;
+
+	/**
+	 * This function pointer writes only the observed values of an
+	 * event report, so it can be sent from a pre-encoded template.
+	 * Optional.
+	 */
+	agent_event_report_values event_report_values;
+
+	/**
+	 * Pre-encoded event report, built on first use
+	 */
+	struct EventReportTemplate *event_report_template;
+
+	/**
+	 * Configuration object list, built by configure_action at
+	 * registration and shared read-only by all contexts
+	 */
+	ConfigObjectList *config_obj_list;
 };
 
 void std_configurations_register_conf(struct StdConfiguration *config);
@@ -10,9 +10,14 @@ LOCAL_SRC_FILES = \
 			       dimutil.c \
 			       pmstore.c \
 			       pmsegment.c \
+			       pmsegment_export.c \
+			       pmstore_cache.c \
+			       pmstore_delivery.c \
+			       obs_filter.c \
 			       cfg_scanner.c \
 			       epi_cfg_scanner.c \
 			       mds.c \
+			       mds_template.c \
 			       metric.c \
 			       numeric.c \
 			       rtsa.c \
@@ -31,6 +31,7 @@
 
 #include "dimutil.h"
 #include "mds.h"
+#include "obs_filter.h"
 #include "src/api/data_encoder.h"
 #include "src/api/text_encoder.h"
 #include "src/api/oid_string.h"
@@ -1067,6 +1068,21 @@ int dimutil_fill_epi_scanner_attr(struct EpiCfgScanner *epi_scanner,
 	return result;
 }
 
+/**
+ * Returns the Metric part of a metric object
+ */
+static struct Metric *dimutil_metric_of(struct Metric_object *metric_obj)
+{
+	switch (metric_obj->choice) {
+	case METRIC_NUMERIC:
+		return &metric_obj->u.numeric.metric;
+	case METRIC_ENUM:
+		return &metric_obj->u.enumeration.metric;
+	default:
+		return &metric_obj->u.rtsa.metric;
+	}
+}
+
 /**
  * Initializes a given Metric/Numeric/Enumeration/RT-SA object from a list
  * of attributes.
@@ -1077,7 +1093,8 @@ int dimutil_fill_epi_scanner_attr(struct EpiCfgScanner *epi_scanner,
  * \param attr_list list of the attributes to initialize the Metric_object.
  */
 static void dimutil_fill_metric_object(struct MDS *mds, DataEntry *data_entry,
-				       struct Metric_object *metric_obj, AttributeList *attr_list)
+				       struct Metric_object *metric_obj, AttributeList *attr_list,
+				       ASN1_HANDLE handle)
 {
 
 	data_entry->choice = COMPOUND_DATA_ENTRY;
@@ -1086,8 +1103,10 @@ static void dimutil_fill_metric_object(struct MDS *mds, DataEntry *data_entry,
 	cmp_entry->entries = calloc(attr_list->count, sizeof(DataEntry));
 
 	int j;
+	int n = 0;
 	octet_string val;
 	OID_Type attr_id;
+	struct Metric *metric = dimutil_metric_of(metric_obj);
 
 	switch (metric_obj->choice) {
 	case METRIC_NUMERIC:
@@ -1095,13 +1114,18 @@ static void dimutil_fill_metric_object(struct MDS *mds, DataEntry *data_entry,
 
 		for (j = 0; j < attr_list->count; ++j) {
 			attr_id = attr_list->value[j].attribute_id;
+
+			if (!obs_filter_accepts(mds, handle, metric, attr_id)) {
+				continue;
+			}
+
 			val.length = attr_list->value[j].attribute_value.length;
 			val.value = attr_list->value[j].attribute_value.value;
 
 			ByteStreamReader *stream = byte_stream_reader_instance(val.value,
 						   val.length);
 
-			int result = dimutil_fill_numeric_attr(&(metric_obj->u.numeric), attr_id, stream, &(cmp_entry->entries[j]));
+			int result = dimutil_fill_numeric_attr(&(metric_obj->u.numeric), attr_id, stream, &(cmp_entry->entries[n++]));
 
 			if (result == 0) {
 				ERROR("ERROR filling numeric attribute");
@@ -1116,6 +1140,11 @@ static void dimutil_fill_metric_object(struct MDS *mds, DataEntry *data_entry,
 
 		for (j = 0; j < attr_list->count; ++j) {
 			attr_id = attr_list->value[j].attribute_id;
+
+			if (!obs_filter_accepts(mds, handle, metric, attr_id)) {
+				continue;
+			}
+
 			val.length = attr_list->value[j].attribute_value.length;
 			val.value = attr_list->value[j].attribute_value.value;
 
@@ -1123,7 +1152,7 @@ static void dimutil_fill_metric_object(struct MDS *mds, DataEntry *data_entry,
 						   val.length);
 
 			int result = dimutil_fill_enumeration_attr(&(metric_obj->u.enumeration), attr_id,
-					stream, &(cmp_entry->entries[j]));
+					stream, &(cmp_entry->entries[n++]));
 
 			if (result == 0) {
 				ERROR("ERROR filling enumeration attr");
@@ -1138,6 +1167,11 @@ static void dimutil_fill_metric_object(struct MDS *mds, DataEntry *data_entry,
 
 		for (j = 0; j < attr_list->count; ++j) {
 			attr_id = attr_list->value[j].attribute_id;
+
+			if (!obs_filter_accepts(mds, handle, metric, attr_id)) {
+				continue;
+			}
+
 			val.length = attr_list->value[j].attribute_value.length;
 			val.value = attr_list->value[j].attribute_value.value;
 
@@ -1145,7 +1179,7 @@ static void dimutil_fill_metric_object(struct MDS *mds, DataEntry *data_entry,
 						   val.length);
 
 			int result = dimutil_fill_rtsa_attr(&(metric_obj->u.rtsa), attr_id,
-							    stream, &(cmp_entry->entries[j]));
+							    stream, &(cmp_entry->entries[n++]));
 
 			if (result == 0) {
 				ERROR("ERROR filling stsa attr");
@@ -1159,6 +1193,7 @@ static void dimutil_fill_metric_object(struct MDS *mds, DataEntry *data_entry,
 		break;
 	}
 
+	cmp_entry->entries_count = n;
 }
 
 
@@ -1189,6 +1224,12 @@ void dimutil_update_mds_from_obs_scan(struct MDS *mds, ObservationScan *var_obs,
 			pmstore = &(object->u.pmstore);
 	}
 
+	if (metric_obj != NULL
+	    && !obs_filter_accepts(mds, obj_handle, dimutil_metric_of(metric_obj), 0)) {
+		// nobody subscribed; entry is left empty
+		metric_obj = NULL;
+	}
+
 	AttributeList attr_list = var_obs->attributes;
 	int attr_list_size = attr_list.count;
 	OID_Type attr_id;
@@ -1199,7 +1240,7 @@ void dimutil_update_mds_from_obs_scan(struct MDS *mds, ObservationScan *var_obs,
 		data_meta_set_handle(measurement_data, obj_handle);
 
 		dimutil_fill_metric_object(mds, measurement_data,
-					   metric_obj, &attr_list);
+					   metric_obj, &attr_list, obj_handle);
 	}
 
 	if (pmstore != NULL) {
@@ -1239,7 +1280,14 @@ void dimutil_update_mds_from_obs_scan_fixed(struct MDS *mds, ObservationScanFixe
 			metric_obj = &(object->u.metric);
 	}
 
+	if (metric_obj != NULL
+	    && !obs_filter_accepts(mds, handle, dimutil_metric_of(metric_obj), 0)) {
+		// nobody subscribed; entry is left empty
+		metric_obj = NULL;
+	}
+
 	int attr_list_size;
+	int n = 0;
 
 	if (metric_obj != NULL) {
 		DataEntry *measurement_entry = data_entry;
@@ -1260,9 +1308,15 @@ void dimutil_update_mds_from_obs_scan_fixed(struct MDS *mds, ObservationScanFixe
 			int j;
 
 			for (j = 0; j < attr_list_size; ++j) {
+				if (!obs_filter_accepts(mds, handle, dimutil_metric_of(metric_obj),
+							val_map.value[j].attribute_id)) {
+					read_skip(stream, val_map.value[j].attribute_len, NULL);
+					continue;
+				}
+
 				result = dimutil_fill_numeric_attr(&(metric_obj->u.numeric),
 								   val_map.value[j].attribute_id,
-								   stream, &(cmp_entry->entries[j]));
+								   stream, &(cmp_entry->entries[n++]));
 
 				if (result == 0) {
 					ERROR("ERROR filling numeric attr");
@@ -1280,10 +1334,16 @@ void dimutil_update_mds_from_obs_scan_fixed(struct MDS *mds, ObservationScanFixe
 			int j;
 
 			for (j = 0; j < attr_list_size; ++j) {
+				if (!obs_filter_accepts(mds, handle, dimutil_metric_of(metric_obj),
+							val_map.value[j].attribute_id)) {
+					read_skip(stream, val_map.value[j].attribute_len, NULL);
+					continue;
+				}
+
 				result = dimutil_fill_enumeration_attr(&(metric_obj->u.enumeration),
 								       val_map.value[j].attribute_id,
 								       stream,
-								       &(cmp_entry->entries[j]));
+								       &(cmp_entry->entries[n++]));
 
 				if (result == 0) {
 					ERROR("ERROR filling enumeration attr");
@@ -1301,9 +1361,15 @@ void dimutil_update_mds_from_obs_scan_fixed(struct MDS *mds, ObservationScanFixe
 			int j;
 
 			for (j = 0; j < attr_list_size; ++j) {
+				if (!obs_filter_accepts(mds, handle, dimutil_metric_of(metric_obj),
+							val_map.value[j].attribute_id)) {
+					read_skip(stream, val_map.value[j].attribute_len, NULL);
+					continue;
+				}
+
 				result = dimutil_fill_rtsa_attr(&(metric_obj->u.rtsa),
 								val_map.value[j].attribute_id,
-								stream,  &(cmp_entry->entries[j]));
+								stream,  &(cmp_entry->entries[n++]));
 
 				if (result == 0) {
 					ERROR("ERROR filling rtsa attr");
@@ -1313,6 +1379,7 @@ void dimutil_update_mds_from_obs_scan_fixed(struct MDS *mds, ObservationScanFixe
 		break;
 		}
 
+		cmp_entry->entries_count = n;
 		free(stream);
 	}
 }
@@ -1337,6 +1404,23 @@ void dimutil_update_mds_from_grouped_observations(struct MDS *mds, ByteStreamRea
 
 	struct MDS_object *obj = mds_get_object_by_handle(mds, val_map_entry->obj_handle);
 	AttrValMap *val_map = &val_map_entry->attr_val_map;
+	struct Metric *metric = NULL;
+	int k;
+	int n = 0;
+
+	if (obj != NULL && obj->choice == MDS_OBJ_METRIC) {
+		metric = dimutil_metric_of(&obj->u.metric);
+	}
+
+	if (metric == NULL
+	    || !obs_filter_accepts(mds, val_map_entry->obj_handle, metric, 0)) {
+		// unknown object, or nobody subscribed; entry is left empty
+		for (k = 0; k < val_map->count; k++) {
+			read_skip(stream, val_map->value[k].attribute_len, NULL);
+		}
+
+		return;
+	}
 
 	measurement_entry->choice = COMPOUND_DATA_ENTRY;
 	data_meta_set_handle(measurement_entry, val_map_entry->obj_handle);
@@ -1355,14 +1439,18 @@ void dimutil_update_mds_from_grouped_observations(struct MDS *mds, ByteStreamRea
 		}
 	}
 
-	int k;
-
 	for (k = 0; k < val_map->count; k++) {
+		if (!obs_filter_accepts(mds, val_map_entry->obj_handle, metric,
+					val_map->value[k].attribute_id)) {
+			read_skip(stream, val_map->value[k].attribute_len, NULL);
+			continue;
+		}
+
 		switch (obj->u.metric.choice) {
 		case METRIC_NUMERIC: {
 			int result = dimutil_fill_numeric_attr(&(obj->u.metric.u.numeric),
 							       val_map->value[k].attribute_id,
-							       stream, &cmp_entry->entries[k]);
+							       stream, &cmp_entry->entries[n++]);
 
 			if (!result) {
 				ERROR("numeric attribute id %d not found",
@@ -1373,7 +1461,7 @@ void dimutil_update_mds_from_grouped_observations(struct MDS *mds, ByteStreamRea
 		case METRIC_ENUM: {
 			int result = dimutil_fill_enumeration_attr(&(obj->u.metric.u.enumeration),
 					val_map->value[k].attribute_id,
-					stream, &cmp_entry->entries[k]);
+					stream, &cmp_entry->entries[n++]);
 
 			if (!result) {
 				ERROR("enum attribute id %d not found",
@@ -1385,7 +1473,7 @@ void dimutil_update_mds_from_grouped_observations(struct MDS *mds, ByteStreamRea
 			int result = dimutil_fill_rtsa_attr(
 					     &(obj->u.metric.u.rtsa),
 					     val_map->value[k].attribute_id,
-					     stream, &cmp_entry->entries[k]);
+					     stream, &cmp_entry->entries[n++]);
 
 			if (!result) {
 				ERROR("rtsa attribute id %d not found",
@@ -1395,6 +1483,8 @@ void dimutil_update_mds_from_grouped_observations(struct MDS *mds, ByteStreamRea
 		break;
 		}
 	}
+
+	cmp_entry->entries_count = n;
 }
 
 /** @} */
@@ -32,6 +32,7 @@
 #include <stdio.h>
 #include <string.h>
 #include "mds.h"
+#include "mds_template.h"
 #include "dimutil.h"
 #include "nomenclature.h"
 #include "pmstore.h"
@@ -46,9 +47,11 @@
 #include "src/communication/extconfigurations.h"
 #include "src/api/data_encoder.h"
 #include "src/api/text_encoder.h"
+#include "src/api/xml_encoder.h"
 #include "src/api/oid_string.h"
 #include "src/manager_p.h"
 #include "src/util/log.h"
+#include "src/util/pool.h"
 
 /**
  * \defgroup MDS MDS
@@ -85,6 +88,81 @@ static const intu32 MDS_TO_CONFIRM_SET = 3;
  */
 static const intu32 MDS_TO_INTER_SERVICE = 3;
 
+/**
+ * Pool of MDS structures
+ */
+static ObjectPool mds_pool = OBJECT_POOL_INITIALIZER(struct MDS, 16);
+
+/**
+ * Data list snapshot and its XML form, built from a given version
+ * of MDS attributes
+ */
+typedef struct MDSSnapshot {
+	/**
+	 * Whether list reflects the version below
+	 */
+	int valid;
+
+	/**
+	 * MDS attributes version the snapshot was built from
+	 */
+	intu32 version;
+
+	/**
+	 * Data list, owned by the cache
+	 */
+	DataList *list;
+
+	/**
+	 * XML form of list, encoded on first demand
+	 */
+	char *xml;
+} MDSSnapshot;
+
+/**
+ * Per-MDS cache of encoded attributes and data list snapshots.
+ *
+ * Attributes of an MDS only change through mds_set_attribute() or when
+ * the agent is (re)configured, so GET responses and API queries are
+ * served from here until mds_attributes_changed() bumps the version.
+ */
+struct MDSCache {
+	/**
+	 * Whether ava reflects ava_version
+	 */
+	int ava_valid;
+
+	/**
+	 * MDS attributes version the encoded attributes were built from
+	 */
+	intu32 ava_version;
+
+	/**
+	 * Encoded attributes, as returned by mds_get_attributes()
+	 */
+	AVA_Type *ava;
+
+	/**
+	 * Number of encoded attributes
+	 */
+	intu16 ava_count;
+
+	/**
+	 * Encoded length added to the APDU by the attributes
+	 */
+	intu16 ava_length;
+
+	/**
+	 * Snapshot of MDS attributes
+	 */
+	MDSSnapshot attributes;
+
+	/**
+	 * Snapshot of device configuration
+	 */
+	MDSSnapshot configuration;
+};
+
 /**
  * Returns a new instance of an MDS object, with an empty object list.
  *
@@ -92,7 +170,7 @@ static const intu32 MDS_TO_INTER_SERVICE = 3;
  */
 MDS *mds_create()
 {
-	MDS *mds = calloc(1, sizeof(struct MDS));
+	MDS *mds = pool_alloc(&mds_pool);
 	mds->dim.id = mds_get_nomenclature_code();
 	mds->objects_list = NULL;
 	mds->objects_list_count = 0;
@@ -468,26 +546,19 @@ Request *mds_get_pmstore(Context *ctx, int handle, service_request_callback requ
 }
 
 /**
- * This function configure the MDS structure using agent sent data which
- * provides information about the supported measurement capabilities
- * of the agent.
+ * Adds to MDS the objects described by a configuration object list,
+ * decoding their attributes.
  *
- * After configuration steps the Manager is ready to execute operational mode
- *
- * \param ctx context Operating Context
+ * \param mds the MDS
  * \param config_obj_list Configuration object list
- * \param manager Manager flag
  */
-void mds_configure_operating(Context *ctx, ConfigObjectList *config_obj_list,
-				int manager)
+static void mds_configure_objects(MDS *mds, ConfigObjectList *config_obj_list)
 {
 	int obj_list_size = config_obj_list->count;
 	int attr_list_size = 0;
 	int i;
 	int j;
 
-	MDS *mds  = ctx->mds;
-
 	for (i = 0; i < obj_list_size; ++i) {
 		struct MDS_object object;
 
@@ -686,6 +757,60 @@ void mds_configure_operating(Context *ctx, ConfigObjectList *config_obj_list,
 			break;
 		}
 	}
+}
+
+/**
+ * This function configure the MDS structure using agent sent data which
+ * provides information about the supported measurement capabilities
+ * of the agent.
+ *
+ * After configuration steps the Manager is ready to execute operational mode
+ *
+ * The configuration object list is only read, so it may be a shared
+ * standard configuration; caller keeps ownership of it. Objects are
+ * copied from a template when the configuration was built before
+ * (see mds_template.c).
+ *
+ * \param ctx context Operating Context
+ * \param config_obj_list Configuration object list
+ * \param manager Manager flag
+ */
+void mds_configure_operating(Context *ctx, ConfigObjectList *config_obj_list,
+				int manager)
+{
+	MDS *mds  = ctx->mds;
+	octet_string *system_id = &mds->system_id;
+	int first = mds->objects_list_count;
+	intu8 content_id[EXT_CONFIG_CONTENT_ID_SIZE];
+	octet_string content_key;
+
+	mds_attributes_changed(mds);
+
+	if (std_configurations_get_configuration_attributes(
+		    mds->dev_configuration_id) == config_obj_list) {
+		// standard configuration, same objects for every agent
+		system_id = NULL;
+	}
+
+	if (system_id && system_id->length > 0
+	    && ext_configurations_get_content_id(system_id,
+				mds->dev_configuration_id, content_id)) {
+		// agents with the same extended configuration share template
+		content_key.length = EXT_CONFIG_CONTENT_ID_SIZE;
+		content_key.value = content_id;
+		system_id = &content_key;
+	}
+
+	if (system_id && system_id->length == 0) {
+		// extended configuration of unidentified agent, not cached
+		mds_configure_objects(mds, config_obj_list);
+	} else if (!mds_template_apply(mds, mds->dev_configuration_id,
+				       system_id)) {
+		mds_configure_objects(mds, config_obj_list);
+		mds_template_store(mds->dev_configuration_id, system_id,
+				   mds->objects_list + first,
+				   mds->objects_list_count - first);
+	}
 
 	service_init(ctx);
 
@@ -696,8 +821,6 @@ void mds_configure_operating(Context *ctx, ConfigObjectList *config_obj_list,
 		manager_notify_evt_device_available(ctx, list);
 	}
 
-	del_configobjectlist(config_obj_list);
-	config_obj_list = NULL;
 }
 
 /**
@@ -797,13 +920,16 @@ DataList *mds_populate_configuration(MDS *mds)
 	}
 
 	ConfigObjectList *config;
+	int standard = std_configurations_is_supported_standard(
+							mds->dev_configuration_id);
 
-	// gets a copy of config attributes
-	if (std_configurations_is_supported_standard(mds->dev_configuration_id)) {
+	// standard config attributes are shared; extended ones are shared
+	// by agents with the same configuration, until released
+	if (standard) {
 		config = std_configurations_get_configuration_attributes(
 								mds->dev_configuration_id);
 	} else {
-		config = ext_configurations_get_configuration_attributes(&mds->system_id,
+		config = ext_configurations_acquire_configuration_attributes(&mds->system_id,
 								mds->dev_configuration_id);
 	}
 
@@ -824,8 +950,9 @@ DataList *mds_populate_configuration(MDS *mds)
 		mds_populate_configuration_attributes(cfgobj->obj_class, name, atts, entry);
 	}
 
-	del_configobjectlist(config);
-	free(config);
+	if (!standard) {
+		ext_configurations_release_configuration_attributes(config);
+	}
 
 	return list;
 }
@@ -1064,14 +1191,15 @@ void mds_event_report_dynamic_data_update_mp_fixed(Context *ctx,
 }
 
 /**
- * Gets all attributes of MDS Instance as an array of AVA_Type's
+ * Encodes all attributes of MDS Instance as an array of AVA_Type's
  *
  * \param mds the mds.
  * \param count The number of attributes
  * \param tot_length The total length of the MDS
  * \return Array of AVA_Type with attributes
  */
-AVA_Type* mds_get_attributes(MDS *mds, intu16* count, intu16 *tot_length)
+static AVA_Type *mds_encode_attributes(MDS *mds, intu16 *count,
+					intu16 *tot_length)
 {
 	int i;
 	*count = 17;
@@ -1253,6 +1381,248 @@ AVA_Type* mds_get_attributes(MDS *mds, intu16* count, intu16 *tot_length)
 	return ava;
 }
 
+/**
+ * Returns the cache of an MDS, creating it on first use.
+ *
+ * \param mds the mds.
+ * \return the cache, or NULL if out of memory
+ */
+static struct MDSCache *mds_cache(MDS *mds)
+{
+	if (mds->cache == NULL) {
+		mds->cache = calloc(1, sizeof(struct MDSCache));
+	}
+
+	return mds->cache;
+}
+
+/**
+ * Deletes encoded attributes held by the cache.
+ *
+ * \param cache the MDS cache.
+ */
+static void mds_cache_del_attributes(struct MDSCache *cache)
+{
+	int i;
+
+	if (cache->ava != NULL) {
+		for (i = 0; i < cache->ava_count; ++i) {
+			free(cache->ava[i].attribute_value.value);
+		}
+
+		free(cache->ava);
+	}
+
+	cache->ava = NULL;
+	cache->ava_count = 0;
+	cache->ava_length = 0;
+	cache->ava_valid = 0;
+}
+
+/**
+ * Deletes a data list snapshot and its XML form.
+ *
+ * \param snapshot the snapshot.
+ */
+static void mds_snapshot_del(MDSSnapshot *snapshot)
+{
+	data_list_del(snapshot->list);
+	free(snapshot->xml);
+	snapshot->list = NULL;
+	snapshot->xml = NULL;
+	snapshot->valid = 0;
+}
+
+/**
+ * Gets all attributes of MDS Instance as an array of AVA_Type's, owned
+ * by the MDS and valid until attributes change or MDS is destroyed.
+ * The encoding is done once per attributes version.
+ *
+ * \param mds the mds.
+ * \param count The number of attributes
+ * \param tot_length The total length of the MDS, added to
+ * \return Array of AVA_Type with attributes, NULL if out of memory
+ */
+const AVA_Type *mds_get_cached_attributes(MDS *mds, intu16 *count,
+					  intu16 *tot_length)
+{
+	struct MDSCache *cache = mds_cache(mds);
+
+	*count = 0;
+
+	if (cache == NULL)
+		return NULL;
+
+	if (!cache->ava_valid || cache->ava_version != mds->attributes_version) {
+		mds_cache_del_attributes(cache);
+		cache->ava = mds_encode_attributes(mds, &cache->ava_count,
+						   &cache->ava_length);
+		cache->ava_version = mds->attributes_version;
+		cache->ava_valid = 1;
+	}
+
+	*count = cache->ava_count;
+	*tot_length += cache->ava_length;
+
+	return cache->ava;
+}
+
+/**
+ * Gets all attributes of MDS Instance as an array of AVA_Type's
+ *
+ * \param mds the mds.
+ * \param count The number of attributes
+ * \param tot_length The total length of the MDS
+ * \return Array of AVA_Type with attributes, owned by caller
+ */
+AVA_Type* mds_get_attributes(MDS *mds, intu16* count, intu16 *tot_length)
+{
+	const AVA_Type *cached = mds_get_cached_attributes(mds, count,
+							   tot_length);
+	AVA_Type *ava;
+	int i;
+
+	if (cached == NULL)
+		return NULL;
+
+	ava = calloc(*count, sizeof(AVA_Type));
+
+	for (i = 0; i < *count; ++i) {
+		intu16 length = cached[i].attribute_value.length;
+
+		ava[i].attribute_id = cached[i].attribute_id;
+		ava[i].attribute_value.length = length;
+		ava[i].attribute_value.value = malloc(length);
+		memcpy(ava[i].attribute_value.value,
+		       cached[i].attribute_value.value, length);
+	}
+
+	return ava;
+}
+
+/**
+ * Signals that MDS attributes or configuration have been changed,
+ * invalidating encoded attributes and snapshots built before.
+ *
+ * Must be called by code that writes MDS attributes directly,
+ * mds_set_attribute() and mds_configure_operating() already do.
+ *
+ * \param mds the mds.
+ */
+void mds_attributes_changed(MDS *mds)
+{
+	if (mds != NULL) {
+		++mds->attributes_version;
+	}
+}
+
+/**
+ * Gets data list of MDS attributes, as mds_populate_attributes() fills,
+ * built once per attributes version. The list is owned by the MDS and
+ * valid until attributes change or MDS is destroyed; callers that keep
+ * it must use data_list_clone().
+ *
+ * \param mds the mds.
+ * \return data list with one entry, NULL if out of memory
+ */
+DataList *mds_get_attributes_snapshot(MDS *mds)
+{
+	struct MDSCache *cache = mds_cache(mds);
+
+	if (cache == NULL)
+		return NULL;
+
+	MDSSnapshot *snapshot = &cache->attributes;
+
+	if (!snapshot->valid || snapshot->version != mds->attributes_version) {
+		mds_snapshot_del(snapshot);
+		snapshot->list = data_list_new(1);
+		mds_populate_attributes(mds, &snapshot->list->values[0]);
+		snapshot->version = mds->attributes_version;
+		snapshot->valid = 1;
+	}
+
+	return snapshot->list;
+}
+
+/**
+ * Gets data list of device configuration, as mds_populate_configuration()
+ * returns, built once per attributes version. The list is owned by the
+ * MDS and valid until attributes change or MDS is destroyed; callers that
+ * keep it must use data_list_clone().
+ *
+ * \param mds the mds.
+ * \return data list of configuration, NULL if configuration is unknown
+ */
+DataList *mds_get_configuration_snapshot(MDS *mds)
+{
+	struct MDSCache *cache = mds_cache(mds);
+
+	if (cache == NULL)
+		return NULL;
+
+	MDSSnapshot *snapshot = &cache->configuration;
+
+	if (!snapshot->valid || snapshot->version != mds->attributes_version) {
+		mds_snapshot_del(snapshot);
+		snapshot->list = mds_populate_configuration(mds);
+
+		if (snapshot->list == NULL) {
+			// not cached, configuration may still be agreed upon
+			return NULL;
+		}
+
+		snapshot->version = mds->attributes_version;
+		snapshot->valid = 1;
+	}
+
+	return snapshot->list;
+}
+
+/**
+ * Encodes a snapshot as XML, once per snapshot.
+ *
+ * \param snapshot a valid snapshot.
+ * \return XML document owned by the snapshot
+ */
+static const char *mds_snapshot_xml(MDSSnapshot *snapshot)
+{
+	if (snapshot->xml == NULL) {
+		snapshot->xml = xml_encode_data_list(snapshot->list);
+	}
+
+	return snapshot->xml;
+}
+
+/**
+ * Gets XML form of mds_get_attributes_snapshot(), with the same lifetime.
+ *
+ * \param mds the mds.
+ * \return XML document owned by the MDS, NULL if not available
+ */
+const char *mds_get_attributes_xml(MDS *mds)
+{
+	if (mds_get_attributes_snapshot(mds) == NULL)
+		return NULL;
+
+	return mds_snapshot_xml(&mds->cache->attributes);
+}
+
+/**
+ * Gets XML form of mds_get_configuration_snapshot(), with the same
+ * lifetime.
+ *
+ * \param mds the mds.
+ * \return XML document owned by the MDS, NULL if not available
+ */
+const char *mds_get_configuration_xml(MDS *mds)
+{
+	if (mds_get_configuration_snapshot(mds) == NULL)
+		return NULL;
+
+	return mds_snapshot_xml(&mds->cache->configuration);
+}
+
 /**
  * Sets the specified attribute of an MDS instance.
  *
@@ -1457,6 +1827,8 @@ void mds_set_attribute(MDS *mds, AVA_Type *attribute)
 	default:
 		DEBUG("MDS attribute unknown: %d", attribute->attribute_id);
 	}
+
+	mds_attributes_changed(mds);
 }
 
 /**
@@ -1502,6 +1874,45 @@ Request *mds_set_operational_state_of_the_scanner(Context *ctx, ASN1_HANDLE hand
 }
 
 
+/**
+ * Finalizes the contents of an MDS object.
+ *
+ * \param object the object to be finalized.
+ */
+void mds_destroy_object(struct MDS_object *object)
+{
+	if (object->choice == MDS_OBJ_PMSTORE) {
+		pmstore_destroy(&(object->u.pmstore));
+	} else if (object->choice == MDS_OBJ_METRIC) {
+
+		switch (object->u.metric.choice) {
+		case METRIC_NUMERIC:
+			numeric_destroy(&(object->u.metric.u.numeric));
+			break;
+		case METRIC_ENUM:
+			enumeration_destroy(&(object->u.metric.u.enumeration));
+			break;
+		case METRIC_RTSA:
+			rtsa_destroy(&(object->u.metric.u.rtsa));
+			break;
+		default:
+			break;
+		}
+
+	} else if (object->choice == MDS_OBJ_SCANNER) {
+		switch (object->u.scanner.choice) {
+		case EPI_CFG_SCANNER:
+			epi_cfg_scanner_destroy(&(object->u.scanner.u.epi_cfg_scanner));
+			break;
+		case PERI_CFG_SCANNER:
+			peri_cfg_scanner_destroy(&(object->u.scanner.u.peri_cfg_scanner));
+			break;
+		default:
+			break;
+		}
+	}
+}
+
 /**
  * Finalizes and deallocate the current MDS instance.
  *
@@ -1514,37 +1925,7 @@ void mds_destroy(MDS *mds)
 
 		if (mds->objects_list != NULL) {
 			for (i = 0; i < mds->objects_list_count; ++i) {
-				if (mds->objects_list[i].choice == MDS_OBJ_PMSTORE) {
-					pmstore_destroy(
-						&(mds->objects_list[i].u.pmstore));
-				} else if (mds->objects_list[i].choice == MDS_OBJ_METRIC) {
-
-					switch (mds->objects_list[i].u.metric.choice) {
-					case METRIC_NUMERIC:
-						numeric_destroy(&(mds->objects_list[i].u.metric.u.numeric));
-						break;
-					case METRIC_ENUM:
-						enumeration_destroy(&(mds->objects_list[i].u.metric.u.enumeration));
-						break;
-					case METRIC_RTSA:
-						rtsa_destroy(&(mds->objects_list[i].u.metric.u.rtsa));
-						break;
-					default:
-						break;
-					}
-
-				} else if (mds->objects_list[i].choice == MDS_OBJ_SCANNER) {
-					switch (mds->objects_list[i].u.scanner.choice) {
-					case EPI_CFG_SCANNER:
-						epi_cfg_scanner_destroy(&(mds->objects_list[i].u.scanner.u.epi_cfg_scanner));
-						break;
-					case PERI_CFG_SCANNER:
-						peri_cfg_scanner_destroy(&(mds->objects_list[i].u.scanner.u.peri_cfg_scanner));
-						break;
-					default:
-						break;
-					}
-				}
+				mds_destroy_object(&mds->objects_list[i]);
 			}
 
 			free(mds->objects_list);
@@ -1560,11 +1941,37 @@ void mds_destroy(MDS *mds)
 		del_highresrelativetime(&mds->hires_relative_time);
 		del_typeverlist(&mds->system_type_spec_list);
 
+		if (mds->cache != NULL) {
+			mds_cache_del_attributes(mds->cache);
+			mds_snapshot_del(&mds->cache->attributes);
+			mds_snapshot_del(&mds->cache->configuration);
+			free(mds->cache);
+			mds->cache = NULL;
+		}
 
-		free(mds);
+		pool_free(&mds_pool, mds);
 		mds = NULL;
 	}
 }
 
+/**
+ * Pre-allocates MDS structures
+ *
+ * \param count number of structures to keep ready
+ * \return 1 if successful, 0 otherwise
+ */
+int mds_pool_reserve(int count)
+{
+	return pool_reserve(&mds_pool, count);
+}
+
+/**
+ * Releases pooled MDS structures if none is in use
+ */
+void mds_pool_trim()
+{
+	pool_trim(&mds_pool);
+}
+
 
 /** @} */
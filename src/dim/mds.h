@@ -284,6 +284,17 @@ typedef struct MDS {
 	 * Count of PM-Store objects among children
  	 */
 	int pmstore_count;
+
+	/**
+	 * Version of attributes and configuration, bumped on every change
+	 * (see mds_attributes_changed())
+	 */
+	intu32 attributes_version;
+
+	/**
+	 * Encoded attributes and snapshots built from a given version
+	 */
+	struct MDSCache *cache;
 } MDS;
 
 /**
@@ -363,14 +374,33 @@ struct MDS_object *mds_get_object_by_handle(MDS *mds, ASN1_HANDLE obj_handle);
 
 MDS *mds_create();
 
+void mds_destroy_object(struct MDS_object *object);
+
 void mds_destroy(MDS *mds);
 
+int mds_pool_reserve(int count);
+
+void mds_pool_trim();
+
 int mds_get_nomenclature_code();
 
 void mds_set_attribute(MDS *mds, AVA_Type *attribute);
 
 AVA_Type* mds_get_attributes(MDS *mds, intu16* count, intu16 *length);
 
+const AVA_Type *mds_get_cached_attributes(MDS *mds, intu16 *count,
+					  intu16 *length);
+
+void mds_attributes_changed(MDS *mds);
+
+DataList *mds_get_attributes_snapshot(MDS *mds);
+
+DataList *mds_get_configuration_snapshot(MDS *mds);
+
+const char *mds_get_attributes_xml(MDS *mds);
+
+const char *mds_get_configuration_xml(MDS *mds);
+
 Request *mds_set_operational_state_of_the_scanner(Context *ctx, ASN1_HANDLE handle, OperationalState state,
 		service_request_callback callback);
 
@@ -0,0 +1,397 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+/**
+ * \file mds_template.c
+ * \brief Configured MDS object templates.
+ *
+ * Copyright (C) 2010 Signove Tecnologia Corporation.
+ * All rights reserved.
+ * Contact: Signove Tecnologia Corporation (contact@signove.com)
+ *
+ * $LICENSE_TEXT:BEGIN$
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation and appearing
+ * in the file LICENSE included in the packaging of this file; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ * $LICENSE_TEXT:END$
+ *
+ * \date Oct 18, 2026
+ */
+
+/**
+ * \addtogroup MDS
+ *
+ * Building the objects of an MDS from a configuration means decoding
+ * every attribute of every configuration object. Once a configuration
+ * has been built, the resulting objects are kept as a template, keyed
+ * by configuration id and system id (or just configuration id for
+ * standard configurations), and further associations with the same
+ * configuration get a deep copy of the template instead.
+ *
+ * Extended configurations are keyed by their content id in place of
+ * system id when the store knows it, so every agent reporting the
+ * same configuration shares one template. Templates keyed by system
+ * id are invalidated when the configuration is registered again.
+ *
+ * @{
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "src/dim/mds_template.h"
+#include "src/communication/communication.h"
+#include "src/communication/parser/struct_cleaner.h"
+#include "src/util/log.h"
+
+/**
+ * Maximum number of templates kept; least recently stored are dropped
+ */
+#define MDS_TEMPLATE_MAX 64
+
+/**
+ * Configured objects of a configuration
+ */
+typedef struct MDSTemplate {
+	/**
+	 * Configuration id
+	 */
+	ConfigId config_id;
+	/**
+	 * System id of the agent, empty for standard configurations
+	 */
+	octet_string system_id;
+	/**
+	 * Number of objects
+	 */
+	int count;
+	/**
+	 * Configured objects
+	 */
+	struct MDS_object *objects;
+	/**
+	 * Next (older) template
+	 */
+	struct MDSTemplate *next;
+} MDSTemplate;
+
+/**
+ * Templates, most recently stored first
+ */
+static MDSTemplate *templates = NULL;
+
+/**
+ * Number of templates in list
+ */
+static int templates_count = 0;
+
+/**
+ * Duplicates a memory block, NULL if empty
+ */
+static void *template_dup(void *value, size_t size)
+{
+	void *copy;
+
+	if (value == NULL || size == 0) {
+		return NULL;
+	}
+
+	copy = malloc(size);
+	memcpy(copy, value, size);
+	return copy;
+}
+
+/**
+ * Makes the list owned by the structure a private copy
+ */
+#define DUP_LIST(list) \
+	(list).value = template_dup((list).value, \
+				    (list).count * sizeof(*(list).value))
+
+/**
+ * Makes the octet string a private copy
+ */
+#define DUP_OCTET(octet) \
+	(octet).value = template_dup((octet).value, (octet).length)
+
+static void template_clone_metric(struct Metric *metric)
+{
+	DUP_LIST(metric->supplemental_types);
+	DUP_LIST(metric->metric_id_list);
+	DUP_LIST(metric->attribute_value_map);
+	DUP_OCTET(metric->label_string);
+	DUP_OCTET(metric->unit_label_string);
+}
+
+static void template_clone_scanner(struct Scanner *scanner)
+{
+	int i;
+
+	DUP_LIST(scanner->scan_handle_list);
+	DUP_LIST(scanner->scan_handle_attr_val_map);
+
+	for (i = 0; i < scanner->scan_handle_attr_val_map.count; ++i) {
+		DUP_LIST(scanner->scan_handle_attr_val_map.value[i].attr_val_map);
+	}
+}
+
+/**
+ * Deep copy of a configured object. PM-Store segments are not
+ * part of configuration, so they are never copied.
+ *
+ * \param dest copy, to be freed by mds_destroy_object()
+ * \param src object to be copied
+ */
+void mds_object_clone(struct MDS_object *dest, struct MDS_object *src)
+{
+	*dest = *src;
+
+	switch (dest->choice) {
+	case MDS_OBJ_METRIC:
+		switch (dest->u.metric.choice) {
+		case METRIC_NUMERIC: {
+			struct Numeric *numeric = &dest->u.metric.u.numeric;
+			template_clone_metric(&numeric->metric);
+			DUP_LIST(numeric->compound_simple_nu_observed_value);
+			DUP_LIST(numeric->compound_basic_nu_observed_value);
+			DUP_LIST(numeric->compound_nu_observed_value);
+			break;
+		}
+		case METRIC_ENUM: {
+			struct Enumeration *enumeration = &dest->u.metric.u.enumeration;
+			template_clone_metric(&enumeration->metric);
+			DUP_OCTET(enumeration->enum_observed_value_simple_str);
+			if (enumeration->enum_observed_value.value.choice
+			    == TEXT_STRING_CHOSEN) {
+				DUP_OCTET(enumeration->enum_observed_value.value.u.enum_text_string);
+			}
+			break;
+		}
+		case METRIC_RTSA: {
+			struct RTSA *rtsa = &dest->u.metric.u.rtsa;
+			template_clone_metric(&rtsa->metric);
+			DUP_OCTET(rtsa->simple_sa_observed_value);
+			break;
+		}
+		default:
+			break;
+		}
+		break;
+	case MDS_OBJ_PMSTORE:
+		DUP_OCTET(dest->u.pmstore.pm_store_label);
+		dest->u.pmstore.segm_list = NULL;
+		dest->u.pmstore.segment_list_count = 0;
+		break;
+	case MDS_OBJ_SCANNER:
+		switch (dest->u.scanner.choice) {
+		case EPI_CFG_SCANNER:
+			template_clone_scanner(
+				&dest->u.scanner.u.epi_cfg_scanner.scanner.scanner);
+			break;
+		case PERI_CFG_SCANNER:
+			template_clone_scanner(
+				&dest->u.scanner.u.peri_cfg_scanner.scanner.scanner);
+			break;
+		default:
+			break;
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+/**
+ * Compares template key, NULL or empty system id means standard
+ */
+static int template_matches(MDSTemplate *template, ConfigId config_id,
+			    octet_string *system_id)
+{
+	int length = system_id ? system_id->length : 0;
+
+	if (template->config_id != config_id
+	    || template->system_id.length != length) {
+		return 0;
+	}
+
+	return length == 0 || memcmp(template->system_id.value,
+				     system_id->value, length) == 0;
+}
+
+static void template_destroy(MDSTemplate *template)
+{
+	int i;
+
+	for (i = 0; i < template->count; ++i) {
+		mds_destroy_object(&template->objects[i]);
+	}
+
+	free(template->objects);
+	del_octet_string(&template->system_id);
+	free(template);
+}
+
+/**
+ * Adds copies of the template objects to MDS, if a template
+ * of the configuration is known.
+ *
+ * \param mds the MDS to be configured
+ * \param config_id configuration id
+ * \param system_id system id of agent, NULL for standard configurations
+ *
+ * \return 1 if MDS objects were added from template, 0 otherwise
+ */
+int mds_template_apply(MDS *mds, ConfigId config_id, octet_string *system_id)
+{
+	MDSTemplate *template;
+	int i;
+
+	gil_lock();
+
+	for (template = templates; template; template = template->next) {
+		if (template_matches(template, config_id, system_id)) {
+			break;
+		}
+	}
+
+	if (template) {
+		for (i = 0; i < template->count; ++i) {
+			struct MDS_object object;
+			mds_object_clone(&object, &template->objects[i]);
+			mds_add_object(mds, object);
+		}
+	}
+
+	gil_unlock();
+
+	return template != NULL;
+}
+
+/**
+ * Keeps a copy of configured objects as template of a configuration.
+ * Does nothing if there is a template for the configuration already.
+ *
+ * \param config_id configuration id
+ * \param system_id system id of agent, NULL for standard configurations
+ * \param objects configured objects, still owned by caller
+ * \param count number of objects
+ */
+void mds_template_store(ConfigId config_id, octet_string *system_id,
+			struct MDS_object *objects, int count)
+{
+	MDSTemplate *template;
+	MDSTemplate **last;
+	int i;
+
+	gil_lock();
+
+	for (template = templates; template; template = template->next) {
+		if (template_matches(template, config_id, system_id)) {
+			gil_unlock();
+			return;
+		}
+	}
+
+	template = calloc(1, sizeof(MDSTemplate));
+	template->config_id = config_id;
+
+	if (system_id && system_id->length > 0) {
+		template->system_id = *system_id;
+		DUP_OCTET(template->system_id);
+	}
+
+	template->count = count;
+	template->objects = calloc(count > 0 ? count : 1,
+				   sizeof(struct MDS_object));
+
+	for (i = 0; i < count; ++i) {
+		mds_object_clone(&template->objects[i], &objects[i]);
+	}
+
+	template->next = templates;
+	templates = template;
+
+	if (++templates_count > MDS_TEMPLATE_MAX) {
+		last = &templates;
+		while ((*last)->next) {
+			last = &(*last)->next;
+		}
+		template_destroy(*last);
+		*last = NULL;
+		--templates_count;
+	}
+
+	DEBUG("MDS template stored for configuration %d (%d objects)",
+	      config_id, count);
+
+	gil_unlock();
+}
+
+/**
+ * Drops the template of a configuration, if any
+ *
+ * \param config_id configuration id
+ * \param system_id system id of agent, NULL for standard configurations
+ */
+void mds_template_invalidate(ConfigId config_id, octet_string *system_id)
+{
+	MDSTemplate **template;
+
+	gil_lock();
+
+	for (template = &templates; *template; template = &(*template)->next) {
+		if (template_matches(*template, config_id, system_id)) {
+			MDSTemplate *found = *template;
+			*template = found->next;
+			template_destroy(found);
+			--templates_count;
+			break;
+		}
+	}
+
+	gil_unlock();
+}
+
+/**
+ * Drops all templates
+ */
+void mds_template_clear()
+{
+	gil_lock();
+
+	while (templates) {
+		MDSTemplate *template = templates;
+		templates = template->next;
+		template_destroy(template);
+	}
+
+	templates_count = 0;
+
+	gil_unlock();
+}
+
+/**
+ * Returns the number of templates kept
+ *
+ * \return number of templates
+ */
+int mds_template_count()
+{
+	int count;
+
+	gil_lock();
+	count = templates_count;
+	gil_unlock();
+
+	return count;
+}
+
+/** @} */
@@ -0,0 +1,56 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+/**
+ * \file mds_template.h
+ * \brief Configured MDS object templates header.
+ *
+ * Copyright (C) 2010 Signove Tecnologia Corporation.
+ * All rights reserved.
+ * Contact: Signove Tecnologia Corporation (contact@signove.com)
+ *
+ * $LICENSE_TEXT:BEGIN$
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation and appearing
+ * in the file LICENSE included in the packaging of this file; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ * $LICENSE_TEXT:END$
+ *
+ * \date Oct 18, 2026
+ */
+
+#ifndef MDS_TEMPLATE_H_
+#define MDS_TEMPLATE_H_
+
+#include "asn1/phd_types.h"
+#include "mds.h"
+
+/**
+ * \ingroup MDS
+ * @{
+ */
+
+int mds_template_apply(MDS *mds, ConfigId config_id, octet_string *system_id);
+
+void mds_template_store(ConfigId config_id, octet_string *system_id,
+			struct MDS_object *objects, int count);
+
+void mds_template_invalidate(ConfigId config_id, octet_string *system_id);
+
+void mds_template_clear();
+
+int mds_template_count();
+
+void mds_object_clone(struct MDS_object *dest, struct MDS_object *src);
+
+/** @} */
+
+#endif /* MDS_TEMPLATE_H_ */
@@ -0,0 +1,191 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+/**
+ * \file obs_filter.c
+ * \brief Filters of observations materialized for listeners.
+ *
+ * Copyright (C) 2010 Signove Tecnologia Corporation.
+ * All rights reserved.
+ * Contact: Signove Tecnologia Corporation (contact@signove.com)
+ *
+ * $LICENSE_TEXT:BEGIN$
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation and appearing
+ * in the file LICENSE included in the packaging of this file; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ * $LICENSE_TEXT:END$
+ *
+ * \date Oct 18, 2026
+ */
+
+/**
+ * \addtogroup MDS
+ *
+ * Listeners may subscribe to some observations only (see
+ * ManagerSubscription). Subscriptions of all listeners are kept here
+ * as a list of rules, and scan report decoding asks whether each
+ * observed object, and each of its attributes, is wanted before it
+ * is decoded. Unwanted observations are skipped over at byte level:
+ * neither the MDS object nor the measurement data is updated.
+ *
+ * A rule matches an object when its system id, handle, partition and
+ * code match (zero, or NULL system id, matching anything), and an
+ * attribute when the object matches and the rule attribute is zero
+ * or the attribute id. With no rules, everything is accepted.
+ *
+ * @{
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "src/dim/obs_filter.h"
+
+/**
+ * Size of system id compared by rules
+ */
+#define OBS_FILTER_SYSTEM_ID_SIZE 8
+
+/**
+ * Observations wanted by a subscription
+ */
+typedef struct ObsFilterRule {
+	/**
+	 * System id of device
+	 */
+	intu8 system_id[OBS_FILTER_SYSTEM_ID_SIZE];
+	/**
+	 * 1 if any device matches
+	 */
+	int any_system;
+	/**
+	 * Object handle, or 0
+	 */
+	ASN1_HANDLE handle;
+	/**
+	 * Metric partition, or 0
+	 */
+	intu16 partition;
+	/**
+	 * Metric code, or 0
+	 */
+	intu16 code;
+	/**
+	 * Attribute id, or 0
+	 */
+	OID_Type attribute;
+} ObsFilterRule;
+
+/**
+ * Rules in effect
+ */
+static ObsFilterRule *rules = NULL;
+
+/**
+ * Number of rules in effect
+ */
+static int rules_count = 0;
+
+/**
+ * Drops all rules, so that every observation is accepted
+ */
+void obs_filter_reset()
+{
+	free(rules);
+	rules = NULL;
+	rules_count = 0;
+}
+
+/**
+ * Adds a rule. Once there is a rule, observations matched by no rule
+ * are no longer decoded.
+ *
+ * \param system_id system id of device, 8 octets, or NULL for any
+ * \param handle object handle, or 0 for any
+ * \param partition metric partition, or 0 for any
+ * \param code metric code, or 0 for any
+ * \param attribute attribute id, or 0 for all attributes
+ */
+void obs_filter_add(const intu8 *system_id, ASN1_HANDLE handle,
+		    intu16 partition, intu16 code, OID_Type attribute)
+{
+	ObsFilterRule *rule;
+
+	rules = realloc(rules, (rules_count + 1) * sizeof(ObsFilterRule));
+	rule = &rules[rules_count++];
+
+	memset(rule, 0, sizeof(ObsFilterRule));
+	rule->any_system = system_id == NULL;
+	if (system_id) {
+		memcpy(rule->system_id, system_id, OBS_FILTER_SYSTEM_ID_SIZE);
+	}
+	rule->handle = handle;
+	rule->partition = partition;
+	rule->code = code;
+	rule->attribute = attribute;
+}
+
+/**
+ * Tells whether observations are being filtered
+ *
+ * \return 1 if there are rules, 0 if everything is accepted
+ */
+int obs_filter_active()
+{
+	return rules_count > 0;
+}
+
+/**
+ * Tells whether an observed object, or one of its attributes, is
+ * wanted by some listener
+ *
+ * \param mds MDS of device
+ * \param handle object handle
+ * \param metric metric object
+ * \param attribute attribute id, or 0 to ask about the object
+ *
+ * \return 1 if it must be decoded, 0 if it may be skipped
+ */
+int obs_filter_accepts(struct MDS *mds, ASN1_HANDLE handle,
+		       struct Metric *metric, OID_Type attribute)
+{
+	int i;
+
+	if (rules_count == 0) {
+		return 1;
+	}
+
+	for (i = 0; i < rules_count; ++i) {
+		ObsFilterRule *rule = &rules[i];
+
+		if (!rule->any_system
+		    && (mds->system_id.length != OBS_FILTER_SYSTEM_ID_SIZE
+			|| memcmp(mds->system_id.value, rule->system_id,
+				  OBS_FILTER_SYSTEM_ID_SIZE) != 0)) {
+			continue;
+		}
+
+		if ((rule->handle && rule->handle != handle)
+		    || (rule->partition && rule->partition != metric->type.partition)
+		    || (rule->code && rule->code != metric->type.code)) {
+			continue;
+		}
+
+		if (attribute == 0 || rule->attribute == 0
+		    || rule->attribute == attribute) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/** @} */
@@ -0,0 +1,54 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+/**
+ * \file obs_filter.h
+ * \brief Filters of observations materialized for listeners.
+ *
+ * Copyright (C) 2010 Signove Tecnologia Corporation.
+ * All rights reserved.
+ * Contact: Signove Tecnologia Corporation (contact@signove.com)
+ *
+ * $LICENSE_TEXT:BEGIN$
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation and appearing
+ * in the file LICENSE included in the packaging of this file; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ * $LICENSE_TEXT:END$
+ *
+ * \date Oct 18, 2026
+ */
+
+#ifndef OBS_FILTER_H_
+#define OBS_FILTER_H_
+
+#include "asn1/phd_types.h"
+#include "mds.h"
+#include "metric.h"
+
+/**
+ * \ingroup MDS
+ * @{
+ */
+
+void obs_filter_reset();
+
+void obs_filter_add(const intu8 *system_id, ASN1_HANDLE handle,
+		    intu16 partition, intu16 code, OID_Type attribute);
+
+int obs_filter_active();
+
+int obs_filter_accepts(struct MDS *mds, ASN1_HANDLE handle,
+		       struct Metric *metric, OID_Type attribute);
+
+/** @} */
+
+#endif /* OBS_FILTER_H_ */
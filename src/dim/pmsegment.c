@@ -29,6 +29,7 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 #include "pmsegment.h"
 #include "src/communication/parser/struct_cleaner.h"
 
@@ -67,8 +68,6 @@ struct PMSegment *pmsegment_instance(InstNumber instance_number)
 
 	segment->instance_number = instance_number;
 	segment->dim.id = pmsegment_get_nomenclature_code();
-	segment->fixed_segment_data.value = NULL;
-	segment->fixed_segment_data.length = 0;
 	segment->segment_usage_count = 0;
 	segment->empiric_usage_count = 0;
 	return segment;
@@ -82,11 +81,10 @@ struct PMSegment *pmsegment_instance(InstNumber instance_number)
  */
 void pmsegment_remove_all_entries(struct PMSegment *pm_segment)
 {
-	if (pm_segment->fixed_segment_data.value != NULL) {
+	if (pm_segment->fixed_segment_data.data != NULL) {
 		pm_segment->segment_usage_count = 0;
 		pm_segment->empiric_usage_count = 0;
-		free(pm_segment->fixed_segment_data.value);
-		pm_segment->fixed_segment_data.value = NULL;
+		spillbuff_clear(&pm_segment->fixed_segment_data);
 	}
 }
 
@@ -112,7 +110,84 @@ void pmsegment_destroy(struct PMSegment *pm_segment)
 		del_octet_string(&pm_segment->segment_label);
 		del_absolutetimeadjust(&pm_segment->date_and_time_adjustment);
 		del_segmentstatistics(&pm_segment->segment_statistics);
-		del_octet_string(&pm_segment->fixed_segment_data);
+		spillbuff_clear(&pm_segment->fixed_segment_data);
+	}
+}
+
+/**
+ * Returns the size of each entry of segments with the given entry map.
+ *
+ * \param map the entry map
+ *
+ * \return entry size, or 0 if entry header has unknown bits
+ */
+intu32 pmsegment_entry_size(PmSegmentEntryMap *map)
+{
+	intu32 size = 0;
+	int i, k;
+
+	if (map->segm_entry_header & ~(SEG_ELEM_HDR_ABSOLUTE_TIME
+				       | SEG_ELEM_HDR_RELATIVE_TIME
+				       | SEG_ELEM_HDR_HIRES_RELATIVE_TIME)) {
+		return 0;
+	}
+
+	if (map->segm_entry_header & SEG_ELEM_HDR_ABSOLUTE_TIME) {
+		size += 8;
+	}
+
+	if (map->segm_entry_header & SEG_ELEM_HDR_RELATIVE_TIME) {
+		size += 4;
+	}
+
+	if (map->segm_entry_header & SEG_ELEM_HDR_HIRES_RELATIVE_TIME) {
+		size += 8;
+	}
+
+	for (i = 0; i < map->segm_entry_elem_list.count; ++i) {
+		AttrValMap *attrs = &map->segm_entry_elem_list.value[i].attr_val_map;
+
+		for (k = 0; k < attrs->count; ++k) {
+			size += attrs->value[k].attribute_len;
+		}
+	}
+
+	return size;
+}
+
+/**
+ * Deep copy of an entry map.
+ *
+ * \param dest copy, to be freed by del_pmsegmententrymap()
+ * \param src entry map to be copied
+ */
+void pmsegment_copy_entry_map(PmSegmentEntryMap *dest, PmSegmentEntryMap *src)
+{
+	SegmEntryElemList *list = &src->segm_entry_elem_list;
+	int i;
+
+	*dest = *src;
+	dest->segm_entry_elem_list.value = NULL;
+
+	if (list->count == 0) {
+		return;
+	}
+
+	dest->segm_entry_elem_list.value = calloc(list->count, sizeof(SegmEntryElem));
+
+	for (i = 0; i < list->count; ++i) {
+		SegmEntryElem *elem = &dest->segm_entry_elem_list.value[i];
+		AttrValMap *attrs = &list->value[i].attr_val_map;
+
+		*elem = list->value[i];
+		elem->attr_val_map.value = NULL;
+
+		if (attrs->count > 0) {
+			elem->attr_val_map.value = malloc(attrs->count
+							  * sizeof(AttrValMapEntry));
+			memcpy(elem->attr_val_map.value, attrs->value,
+			       attrs->count * sizeof(AttrValMapEntry));
+		}
 	}
 }
 
@@ -35,6 +35,7 @@
 #include "asn1/phd_types.h"
 #include "nomenclature.h"
 #include "dim.h"
+#include "src/util/spillbuff.h"
 
 /**
  * \brief An instance of the PM-segment class represents a
@@ -164,10 +165,13 @@ struct PMSegment {
 	 * array of entries in a format as specified in the PM-Segment-Entry-Map
 	 * attribute.
 	 *
+	 * Large transfers are buffered in a temporary file (see
+	 * spillbuff.h), so they do not take process memory.
+	 *
 	 * Qualifier: Mandatory
 	 *
 	 */
-	octet_string fixed_segment_data;
+	SpillBuffer fixed_segment_data;
 
 	/**
 	 * This informational timeout attribute defines the minimum
@@ -201,4 +205,8 @@ int pmsegment_get_nomenclature_code();
 
 void pmsegment_destroy(struct PMSegment *pm_segment);
 
+intu32 pmsegment_entry_size(PmSegmentEntryMap *map);
+
+void pmsegment_copy_entry_map(PmSegmentEntryMap *dest, PmSegmentEntryMap *src);
+
 #endif /* PMSEGMENT_H_ */
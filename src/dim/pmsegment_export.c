@@ -0,0 +1,477 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+/**
+ * \file pmsegment_export.c
+ * \brief Columnar export of PM-Segment data.
+ *
+ * Copyright (C) 2010 Signove Tecnologia Corporation.
+ * All rights reserved.
+ * Contact: Signove Tecnologia Corporation (contact@signove.com)
+ *
+ * $LICENSE_TEXT:BEGIN$
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation and appearing
+ * in the file LICENSE included in the packaging of this file; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ * $LICENSE_TEXT:END$
+ *
+ * \date Oct 18, 2026
+ */
+
+
+/**
+ * \addtogroup PMStore
+ *
+ * PM-Segment entries all have the layout given by the segment's entry
+ * map: optional header times, then a fixed-size value for every
+ * attribute of every element. Columnar export transposes the entries
+ * into one contiguous array per header time and per attribute, so
+ * long logs can be read by vectorized tools without going through
+ * DataList and XML.
+ *
+ * Export layout, all integers and doubles big-endian:
+ *
+ * - header: magic (4), version (2), column count (2), row count (4),
+ *   entry map header bits (2), segment instance number (2);
+ * - one descriptor per column: kind (1), value type (1), value width
+ *   (2), element handle (2), attribute id (2), metric id (2),
+ *   partition (2), type code (2), reserved (2);
+ * - column values, in descriptor order, each column padded to a
+ *   multiple of 8 bytes.
+ *
+ * Numeric observed values (FLOAT, SFLOAT) become doubles and absolute
+ * times become microseconds since 1970; other attributes are exported
+ * as received.
+ *
+ * @{
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "src/dim/pmsegment_export.h"
+#include "src/dim/nomenclature.h"
+#include "src/communication/parser/decoder_ASN1.h"
+#include "src/util/dateutil.h"
+#include "src/util/log.h"
+
+/**
+ * File export writes values in chunks of this size
+ */
+#define EXPORT_CHUNK 65536
+
+/**
+ * Column of export
+ */
+typedef struct ExportColumn {
+	intu8 kind;
+	intu8 type;
+	intu16 width;
+	ASN1_HANDLE handle;
+	OID_Type attribute;
+	intu16 metric_id;
+	NomPartition partition;
+	OID_Type code;
+	/**
+	 * Offset of value in segment entry
+	 */
+	intu32 offset;
+	/**
+	 * Length of value in segment entry
+	 */
+	intu32 length;
+} ExportColumn;
+
+/**
+ * Segment layout, as columns
+ */
+typedef struct ExportSchema {
+	ExportColumn *columns;
+	int count;
+	/**
+	 * Size of each segment entry
+	 */
+	intu32 entry_size;
+	/**
+	 * Complete entries in segment
+	 */
+	intu32 rows;
+} ExportSchema;
+
+/**
+ * Where export is written: stream only, or stream flushed to file
+ */
+typedef struct ExportSink {
+	ByteStreamWriter *stream;
+	FILE *file;
+	int error;
+} ExportSink;
+
+static ExportColumn *export_add_column(ExportSchema *schema, intu8 kind,
+				       intu8 type, intu16 width, intu32 offset,
+				       intu32 length)
+{
+	ExportColumn *column;
+
+	schema->columns = realloc(schema->columns,
+				  (schema->count + 1) * sizeof(ExportColumn));
+	column = &schema->columns[schema->count++];
+	memset(column, 0, sizeof(ExportColumn));
+
+	column->kind = kind;
+	column->type = type;
+	column->width = width;
+	column->offset = offset;
+	column->length = length;
+
+	return column;
+}
+
+/**
+ * Chooses how an attribute value is exported
+ */
+static intu8 export_attribute_type(OID_Type attribute, int length)
+{
+	if (attribute == MDC_ATTR_NU_VAL_OBS_SIMP && length == 4) {
+		return PMSEGMENT_EXPORT_F64;
+	} else if (attribute == MDC_ATTR_NU_VAL_OBS_BASIC && length == 2) {
+		return PMSEGMENT_EXPORT_F64;
+	} else if (attribute == MDC_ATTR_TIME_STAMP_ABS && length == 8) {
+		return PMSEGMENT_EXPORT_TIME;
+	}
+
+	return PMSEGMENT_EXPORT_RAW;
+}
+
+/**
+ * Builds columns from segment entry map
+ *
+ * \return 1 if successful, 0 if entry map is not understood
+ */
+static int export_schema(struct MDS *mds, struct PMSegment *segment,
+			 ExportSchema *schema)
+{
+	PmSegmentEntryMap *map = &segment->pm_segment_entry_map;
+	intu16 header = map->segm_entry_header;
+	intu32 offset = 0;
+	int i, k;
+
+	memset(schema, 0, sizeof(ExportSchema));
+
+	if (header & ~(SEG_ELEM_HDR_ABSOLUTE_TIME | SEG_ELEM_HDR_RELATIVE_TIME
+		       | SEG_ELEM_HDR_HIRES_RELATIVE_TIME)) {
+		DEBUG("PM-Segment export: unknown header bit in %x", header);
+		return 0;
+	}
+
+	if (header & SEG_ELEM_HDR_ABSOLUTE_TIME) {
+		export_add_column(schema, PMSEGMENT_EXPORT_ABS_TIME,
+				  PMSEGMENT_EXPORT_TIME, 8, offset, 8);
+		offset += 8;
+	}
+
+	if (header & SEG_ELEM_HDR_RELATIVE_TIME) {
+		export_add_column(schema, PMSEGMENT_EXPORT_REL_TIME,
+				  PMSEGMENT_EXPORT_U32, 4, offset, 4);
+		offset += 4;
+	}
+
+	if (header & SEG_ELEM_HDR_HIRES_RELATIVE_TIME) {
+		export_add_column(schema, PMSEGMENT_EXPORT_HIRES_TIME,
+				  PMSEGMENT_EXPORT_U64, 8, offset, 8);
+		offset += 8;
+	}
+
+	for (i = 0; i < map->segm_entry_elem_list.count; ++i) {
+		SegmEntryElem *elem = &map->segm_entry_elem_list.value[i];
+		struct Metric *metric = NULL;
+		struct MDS_object *object = NULL;
+
+		if (mds != NULL) {
+			object = mds_get_object_by_handle(mds, elem->handle);
+		}
+
+		if (object != NULL && object->choice == MDS_OBJ_METRIC) {
+			switch (object->u.metric.choice) {
+			case METRIC_NUMERIC:
+				metric = &object->u.metric.u.numeric.metric;
+				break;
+			case METRIC_ENUM:
+				metric = &object->u.metric.u.enumeration.metric;
+				break;
+			case METRIC_RTSA:
+				metric = &object->u.metric.u.rtsa.metric;
+				break;
+			default:
+				break;
+			}
+		}
+
+		for (k = 0; k < elem->attr_val_map.count; ++k) {
+			AttrValMapEntry *attr = &elem->attr_val_map.value[k];
+			intu8 type = export_attribute_type(attr->attribute_id,
+							   attr->attribute_len);
+			ExportColumn *column = export_add_column(schema,
+					       PMSEGMENT_EXPORT_ATTRIBUTE, type,
+					       type == PMSEGMENT_EXPORT_RAW ?
+					       attr->attribute_len : 8,
+					       offset, attr->attribute_len);
+
+			column->handle = elem->handle;
+			column->attribute = attr->attribute_id;
+			column->partition = elem->metric_type.partition;
+			column->code = elem->metric_type.code;
+			column->metric_id = metric ? metric->metric_id
+					    : elem->metric_type.code;
+
+			offset += attr->attribute_len;
+		}
+	}
+
+	schema->entry_size = offset;
+
+	if (offset > 0) {
+		schema->rows = segment->fixed_segment_data.length / offset;
+
+		if (schema->rows > segment->empiric_usage_count) {
+			schema->rows = segment->empiric_usage_count;
+		}
+	}
+
+	return 1;
+}
+
+/**
+ * Writes stream contents to file, if exporting to file
+ */
+static int export_flush(ExportSink *sink)
+{
+	if (sink->error) {
+		return 0;
+	}
+
+	if (sink->file != NULL && sink->stream->size > 0) {
+		if (fwrite(sink->stream->buffer, 1, sink->stream->size, sink->file)
+		    != sink->stream->size) {
+			ERROR("PM-Segment export: write error");
+			sink->error = 1;
+			return 0;
+		}
+
+		sink->stream->size = 0;
+	}
+
+	return 1;
+}
+
+/**
+ * Gets room for a value, flushing stream to file if needed
+ */
+static int export_reserve(ExportSink *sink, intu32 need)
+{
+	if (sink->stream->size + need > (intu32) sink->stream->buffer_size) {
+		return export_flush(sink);
+	}
+
+	return !sink->error;
+}
+
+static void export_u16(ExportSink *sink, intu16 value)
+{
+	if (export_reserve(sink, 2) && !write_intu16(sink->stream, value)) {
+		sink->error = 1;
+	}
+}
+
+static void export_u32(ExportSink *sink, intu32 value)
+{
+	if (export_reserve(sink, 4) && !write_intu32(sink->stream, value)) {
+		sink->error = 1;
+	}
+}
+
+static void export_bytes(ExportSink *sink, intu8 *bytes, intu32 length)
+{
+	int error = 0;
+
+	if (export_reserve(sink, length)) {
+		write_intu8_many(sink->stream, bytes, length, &error);
+		sink->error |= error;
+	}
+}
+
+static void export_u64(ExportSink *sink, unsigned long long value)
+{
+	export_u32(sink, (intu32) (value >> 32));
+	export_u32(sink, (intu32) value);
+}
+
+/**
+ * Writes one value of a column
+ */
+static void export_value(ExportSink *sink, ExportColumn *column, intu8 *value)
+{
+	ByteStreamReader stream;
+	AbsoluteTime time;
+	double real;
+	unsigned long long bits;
+	int error = 0;
+
+	stream.buffer_cur = value;
+	stream.unread_bytes = column->length;
+
+	switch (column->type) {
+	case PMSEGMENT_EXPORT_TIME:
+		decode_absolutetime(&stream, &time, &error);
+		export_u64(sink, error ? PMSEGMENT_EXPORT_NO_TIME :
+			   date_util_absolute_time_to_epoch_us(time));
+		break;
+	case PMSEGMENT_EXPORT_F64:
+		if (column->length == 4) {
+			real = read_float(&stream, &error);
+		} else {
+			real = read_sfloat(&stream, &error);
+		}
+
+		memcpy(&bits, &real, sizeof(bits));
+		export_u64(sink, bits);
+		break;
+	default:
+		// integers are big-endian as received
+		export_bytes(sink, value, column->length);
+		break;
+	}
+}
+
+/**
+ * Writes export to sink
+ */
+static int export_write(ExportSink *sink, ExportSchema *schema,
+			struct PMSegment *segment)
+{
+	intu8 padding[8] = {0};
+	intu8 *data = segment->fixed_segment_data.data;
+	intu32 row;
+	int i;
+
+	export_u32(sink, PMSEGMENT_EXPORT_MAGIC);
+	export_u16(sink, PMSEGMENT_EXPORT_VERSION);
+	export_u16(sink, schema->count);
+	export_u32(sink, schema->rows);
+	export_u16(sink, segment->pm_segment_entry_map.segm_entry_header);
+	export_u16(sink, segment->instance_number);
+
+	for (i = 0; i < schema->count; ++i) {
+		ExportColumn *column = &schema->columns[i];
+
+		export_bytes(sink, &column->kind, 1);
+		export_bytes(sink, &column->type, 1);
+		export_u16(sink, column->width);
+		export_u16(sink, column->handle);
+		export_u16(sink, column->attribute);
+		export_u16(sink, column->metric_id);
+		export_u16(sink, column->partition);
+		export_u16(sink, column->code);
+		export_u16(sink, 0);
+	}
+
+	for (i = 0; i < schema->count; ++i) {
+		ExportColumn *column = &schema->columns[i];
+		intu32 size = schema->rows * column->width;
+
+		for (row = 0; row < schema->rows && !sink->error; ++row) {
+			export_value(sink, column, data + row * schema->entry_size
+				     + column->offset);
+		}
+
+		export_bytes(sink, padding, (8 - size % 8) % 8);
+	}
+
+	return !sink->error;
+}
+
+/**
+ * Gets the size of an export
+ */
+static intu32 export_size(ExportSchema *schema)
+{
+	intu32 size = PMSEGMENT_EXPORT_HEADER_SIZE
+		      + schema->count * PMSEGMENT_EXPORT_COLUMN_SIZE;
+	int i;
+
+	for (i = 0; i < schema->count; ++i) {
+		size += (schema->rows * schema->columns[i].width + 7) & ~7U;
+	}
+
+	return size;
+}
+
+/**
+ * Exports the entries of a transferred segment as columns
+ *
+ * \param mds the MDS of the segment, used to fill metric ids
+ * \param segment the segment
+ *
+ * \return export, to be freed by del_byte_stream_writer(stream, 1);
+ * NULL if entry map is not understood
+ */
+ByteStreamWriter *pmsegment_export_columnar(struct MDS *mds,
+					    struct PMSegment *segment)
+{
+	ExportSchema schema;
+	ExportSink sink = {NULL, NULL, 0};
+
+	if (!export_schema(mds, segment, &schema)) {
+		free(schema.columns);
+		return NULL;
+	}
+
+	sink.stream = byte_stream_writer_instance(export_size(&schema));
+
+	if (!export_write(&sink, &schema, segment)) {
+		del_byte_stream_writer(sink.stream, 1);
+		sink.stream = NULL;
+	}
+
+	free(schema.columns);
+
+	return sink.stream;
+}
+
+/**
+ * Exports the entries of a transferred segment as columns to a file,
+ * using a small buffer whatever the segment size.
+ *
+ * \param mds the MDS of the segment, used to fill metric ids
+ * \param segment the segment
+ * \param file open file, written from current position
+ *
+ * \return 1 if successful, 0 otherwise
+ */
+int pmsegment_export_columnar_file(struct MDS *mds, struct PMSegment *segment,
+				   FILE *file)
+{
+	ExportSchema schema;
+	ExportSink sink = {NULL, file, 0};
+	int ok = 0;
+
+	if (export_schema(mds, segment, &schema)) {
+		sink.stream = byte_stream_writer_instance(EXPORT_CHUNK);
+		ok = export_write(&sink, &schema, segment) && export_flush(&sink);
+		del_byte_stream_writer(sink.stream, 1);
+	}
+
+	free(schema.columns);
+
+	return ok;
+}
+
+/** @} */
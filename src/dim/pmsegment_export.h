@@ -0,0 +1,100 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+/**
+ * \file pmsegment_export.h
+ * \brief Columnar export of PM-Segment data header.
+ *
+ * Copyright (C) 2010 Signove Tecnologia Corporation.
+ * All rights reserved.
+ * Contact: Signove Tecnologia Corporation (contact@signove.com)
+ *
+ * $LICENSE_TEXT:BEGIN$
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation and appearing
+ * in the file LICENSE included in the packaging of this file; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ * $LICENSE_TEXT:END$
+ *
+ * \date Oct 18, 2026
+ */
+
+#ifndef PMSEGMENT_EXPORT_H_
+#define PMSEGMENT_EXPORT_H_
+
+#include <stdio.h>
+#include "asn1/phd_types.h"
+#include "src/util/bytelib.h"
+#include "src/util/dateutil.h"
+#include "mds.h"
+#include "pmsegment.h"
+
+/**
+ * \ingroup PMStore
+ * @{
+ */
+
+/**
+ * Export magic number ("PMCX")
+ */
+#define PMSEGMENT_EXPORT_MAGIC 0x504D4358
+
+/**
+ * Export format version
+ */
+#define PMSEGMENT_EXPORT_VERSION 1
+
+/**
+ * Size of export header
+ */
+#define PMSEGMENT_EXPORT_HEADER_SIZE 16
+
+/**
+ * Size of each column descriptor
+ */
+#define PMSEGMENT_EXPORT_COLUMN_SIZE 16
+
+/**
+ * Column kinds: entry header times, or attribute of an element
+ */
+#define PMSEGMENT_EXPORT_ABS_TIME 1
+#define PMSEGMENT_EXPORT_REL_TIME 2
+#define PMSEGMENT_EXPORT_HIRES_TIME 3
+#define PMSEGMENT_EXPORT_ATTRIBUTE 4
+
+/**
+ * Column value types
+ */
+/** Attribute bytes as received, width given by entry map */
+#define PMSEGMENT_EXPORT_RAW 0
+/** Unsigned 32-bit integer */
+#define PMSEGMENT_EXPORT_U32 1
+/** Unsigned 64-bit integer */
+#define PMSEGMENT_EXPORT_U64 2
+/** IEEE 754 double, from MDER FLOAT or SFLOAT */
+#define PMSEGMENT_EXPORT_F64 3
+/** Signed 64-bit microseconds since 1970-01-01, agent clock */
+#define PMSEGMENT_EXPORT_TIME 4
+
+/**
+ * Value of a TIME column whose absolute time is not valid
+ */
+#define PMSEGMENT_EXPORT_NO_TIME DATE_UTIL_INVALID_TIME
+
+ByteStreamWriter *pmsegment_export_columnar(struct MDS *mds,
+					    struct PMSegment *segment);
+
+int pmsegment_export_columnar_file(struct MDS *mds, struct PMSegment *segment,
+				   FILE *file);
+
+/** @} */
+
+#endif /* PMSEGMENT_EXPORT_H_ */
@@ -48,6 +48,9 @@
 #include "src/util/log.h"
 #include "src/dim/mds.h"
 #include "src/dim/dimutil.h"
+#include "src/dim/pmsegment_export.h"
+#include "src/dim/pmstore_cache.h"
+#include "src/dim/pmstore_delivery.h"
 
 /**
  * \defgroup PMStore PMStore
@@ -645,9 +648,7 @@ int pmstore_segment_data_event(Context *ctx, struct PMStore *pm_store,
 
 	if (first) {
 		pmsegment->empiric_usage_count = 0;
-		free(pmsegment->fixed_segment_data.value);
-		pmsegment->fixed_segment_data.value = NULL;
-		pmsegment->fixed_segment_data.length = 0;
+		spillbuff_clear(&pmsegment->fixed_segment_data);
 	}
 
 	// It is correct to expect segments to come in order
@@ -657,22 +658,21 @@ int pmstore_segment_data_event(Context *ctx, struct PMStore *pm_store,
 		return 0;
 	}
 
+	if (!spillbuff_append(&pmsegment->fixed_segment_data,
+			      event.segm_data_event_entries.value,
+			      event.segm_data_event_entries.length)) {
+		DEBUG("PM-Segment data event: cannot buffer segment part");
+		return 0;
+	}
+
 	pmsegment->empiric_usage_count = event.segm_data_event_descr.segm_evt_entry_index +
 					event.segm_data_event_descr.segm_evt_entry_count;
 
-	int offset = pmsegment->fixed_segment_data.length;
-	pmsegment->fixed_segment_data.length += event.segm_data_event_entries.length;
-
-	pmsegment->fixed_segment_data.value = realloc(pmsegment->fixed_segment_data.value,
-		  				      pmsegment->fixed_segment_data.length);
-
-	memcpy(&(pmsegment->fixed_segment_data.value[offset]),
-	       	event.segm_data_event_entries.value,
-		event.segm_data_event_entries.length);
-
 	if (last) {
 		DEBUG("Decoding PM-Segment data...");
 		decode_fixed_segment_data(ctx, pm_store, pmsegment, last);
+		// decoded; large segments need not stay resident
+		spillbuff_release_pages(&pmsegment->fixed_segment_data);
 	}
 
 	return 1;
@@ -1086,7 +1086,7 @@ static void pmstore_populate_all_attributes(struct MDS *mds, struct PMStore *pms
 	segm_data_entry->u.compound.entries_count = entry_count;
 	segm_data_entry->u.compound.entries = calloc(entry_count, sizeof(DataEntry));
 
-	ByteStreamReader *stream = byte_stream_reader_instance(segment->fixed_segment_data.value,
+	ByteStreamReader *stream = byte_stream_reader_instance(segment->fixed_segment_data.data,
 							       segment->fixed_segment_data.length);
 	//  stream length double-checked at the end of every iteration
 	int offset = 0;
@@ -1286,7 +1286,7 @@ static void pmstore_populate_all_attributes(struct MDS *mds, struct PMStore *pms
 			break;
 		}
 
-		if (offset > segment->fixed_segment_data.length) {
+		if ((intu32) offset > segment->fixed_segment_data.length) {
 			DEBUG("PM-Segment buffer overrun");
 			segm_data_entry->u.compound.entries_count = i;
 			break;
@@ -1296,6 +1296,19 @@ static void pmstore_populate_all_attributes(struct MDS *mds, struct PMStore *pms
 	free(stream);
 }
 
+/**
+ * Decodes transferred entries of a segment
+ *
+ * \param mds the MDS, whose metric objects describe entries
+ * \param segment the segment
+ * \param entry output parameter, "PM-Segment" compound of entries
+ */
+void pmstore_segment_entries_as_dataentry(struct MDS *mds, struct PMSegment *segment,
+					  DataEntry *entry)
+{
+	pmstore_populate_all_attributes(mds, NULL, segment, entry);
+}
+
 /**
  * Choose a segment to decode fixed segment data
  *
@@ -1308,10 +1321,28 @@ static void decode_fixed_segment_data(Context *ctx, struct PMStore *pmstore,
 {
 	if (last) {
 		DataList *list = data_list_new(1);
+		struct PMSegment delta = *segment;
+		intu32 skip = pmstore_delivery_update(&ctx->mds->system_id,
+						      pmstore->handle, segment);
+
+		if (skip > 0) {
+			// entries delivered before are left out
+			intu32 size = pmsegment_entry_size(&segment->pm_segment_entry_map);
+			delta.fixed_segment_data.data += skip * size;
+			delta.fixed_segment_data.length -= skip * size;
+			delta.empiric_usage_count -= skip;
+		}
 
-		pmstore_populate_all_attributes(ctx->mds, pmstore, segment,
+		pmstore_populate_all_attributes(ctx->mds, pmstore, &delta,
 						&list->values[0]);
 
+		if (pmstore_delivery_is_enabled()) {
+			data_set_meta_att(&list->values[0], data_strcp("first-entry"),
+					  intu32_2str(skip));
+		}
+
+		pmstore_cache_add(&ctx->mds->system_id, pmstore->handle, segment);
+
 		manager_notify_evt_segment_data(ctx, pmstore->handle,
 						segment->instance_number,
 						list);
@@ -1610,10 +1641,10 @@ static void data_set_segment_stat_entry(struct MDS *mds,
 		DEBUG("PM-Segment stat entry: problem to decode");
 	}
 
-	if (offset > segment->fixed_segment_data.length) {
+	if ((intu32) offset > segment->fixed_segment_data.length) {
 		DEBUG("PM-Segment stat entry: buffer overrun");
 	}
-	if (offset < segment->fixed_segment_data.length) {
+	if ((intu32) offset < segment->fixed_segment_data.length) {
 		DEBUG("PM-Segment stat entry: buffer underrun");
 	}
 }
@@ -1775,4 +1806,77 @@ DataList *pmstore_get_segment_info_data_as_datalist(Context *ctx, ASN1_HANDLE ha
 		
 	return list;
 }
+
+/**
+ * Finds a segment of a PM-Store
+ *
+ * \param ctx the context
+ * \param handle PM-Store handle
+ * \param inst segment instance number
+ *
+ * \return the segment, or NULL if not found
+ */
+static struct PMSegment *pmstore_find_segment(Context *ctx, ASN1_HANDLE handle,
+					      InstNumber inst)
+{
+	struct MDS_object *mds_obj;
+
+	if (ctx->mds == NULL) {
+		return NULL;
+	}
+
+	mds_obj = mds_get_object_by_handle(ctx->mds, handle);
+
+	if (mds_obj == NULL || mds_obj->choice != MDS_OBJ_PMSTORE) {
+		return NULL;
+	}
+
+	return pmstore_get_segment_by_inst_number(&mds_obj->u.pmstore, inst);
+}
+
+/**
+ * Exports transferred entries of a segment as columns
+ * (see pmsegment_export.c)
+ *
+ * \param ctx the context
+ * \param handle PM-Store handle
+ * \param inst segment instance number
+ *
+ * \return export, or NULL if segment is unknown
+ */
+ByteStreamWriter *pmstore_export_segment_columnar(Context *ctx, ASN1_HANDLE handle,
+						  InstNumber inst)
+{
+	struct PMSegment *segment = pmstore_find_segment(ctx, handle, inst);
+
+	if (segment == NULL) {
+		return NULL;
+	}
+
+	return pmsegment_export_columnar(ctx->mds, segment);
+}
+
+/**
+ * Exports transferred entries of a segment as columns to a file
+ * (see pmsegment_export.c)
+ *
+ * \param ctx the context
+ * \param handle PM-Store handle
+ * \param inst segment instance number
+ * \param file open file
+ *
+ * \return 1 if successful, 0 otherwise
+ */
+int pmstore_export_segment_columnar_file(Context *ctx, ASN1_HANDLE handle,
+					 InstNumber inst, FILE *file)
+{
+	struct PMSegment *segment = pmstore_find_segment(ctx, handle, inst);
+
+	if (segment == NULL) {
+		return 0;
+	}
+
+	return pmsegment_export_columnar_file(ctx->mds, segment, file);
+}
+
 /** @} */
@@ -31,6 +31,7 @@
 #ifndef PMSTORE_H_
 #define PMSTORE_H_
 
+#include <stdio.h>
 #include "nomenclature.h"
 #include "dim.h"
 #include "pmsegment.h"
@@ -214,4 +215,13 @@ DataList *pmstore_get_data_as_datalist(Context *ctx, ASN1_HANDLE handle);
 
 DataList *pmstore_get_segment_info_data_as_datalist(Context *ctx, ASN1_HANDLE handle);
 
+void pmstore_segment_entries_as_dataentry(struct MDS *mds, struct PMSegment *segment,
+					  DataEntry *entry);
+
+ByteStreamWriter *pmstore_export_segment_columnar(Context *ctx, ASN1_HANDLE handle,
+						  InstNumber inst);
+
+int pmstore_export_segment_columnar_file(Context *ctx, ASN1_HANDLE handle,
+					 InstNumber inst, FILE *file);
+
 #endif /* PMSTORE_H_ */
@@ -0,0 +1,661 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+/**
+ * \file pmstore_cache.c
+ * \brief Time-indexed cache of transferred PM-Segment entries.
+ *
+ * Copyright (C) 2010 Signove Tecnologia Corporation.
+ * All rights reserved.
+ * Contact: Signove Tecnologia Corporation (contact@signove.com)
+ *
+ * $LICENSE_TEXT:BEGIN$
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation and appearing
+ * in the file LICENSE included in the packaging of this file; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ * $LICENSE_TEXT:END$
+ *
+ * \date Oct 18, 2026
+ */
+
+/**
+ * \addtogroup PMStore
+ *
+ * Every PM-Segment transferred from an agent is kept by the manager,
+ * keyed by system id, PM-Store handle and instance number, so that
+ * history can be queried again without a new transfer. Only segments
+ * whose entries carry absolute time are kept.
+ *
+ * Each PM-Store has an index of (time, segment, row) sorted by time,
+ * where time is the entry absolute time in microseconds since epoch
+ * (see date_util_absolute_time_to_epoch_us()). A range query finds
+ * its first entry by binary search. A new transfer of a segment
+ * replaces its rows: the old ones are filtered out of the index and
+ * the new ones, sorted, are merged in.
+ *
+ * A range is served locally only if it falls entirely within the
+ * time covered by cached segments; otherwise the device may have
+ * entries the manager has not seen, and pmstore_cache_query() fails.
+ * Segment coverage is taken from Segment-Start-Abs-Time and
+ * Segment-End-Abs-Time when the agent reports them, and from the
+ * first and last entries otherwise.
+ *
+ * The total number of entries is bounded; segments transferred least
+ * recently are dropped first. Large segments are kept in temporary
+ * files (see spillbuff.c).
+ *
+ * @{
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "src/dim/pmstore_cache.h"
+#include "src/dim/pmstore.h"
+#include "src/communication/communication.h"
+#include "src/communication/parser/struct_cleaner.h"
+#include "src/api/data_list.h"
+#include "src/util/dateutil.h"
+#include "src/util/spillbuff.h"
+#include "src/util/log.h"
+
+/**
+ * Cached entries of one segment
+ */
+typedef struct CachedSegment {
+	/**
+	 * Segment instance number
+	 */
+	InstNumber instance;
+	/**
+	 * Private copy of segment entry map
+	 */
+	PmSegmentEntryMap entry_map;
+	/**
+	 * Size of each entry
+	 */
+	intu32 entry_size;
+	/**
+	 * Number of entries
+	 */
+	intu32 count;
+	/**
+	 * Entries, as transferred
+	 */
+	SpillBuffer data;
+	/**
+	 * First microsecond covered by segment
+	 */
+	long long start;
+	/**
+	 * Last microsecond covered by segment
+	 */
+	long long end;
+	/**
+	 * Order of transfer, to pick segments to be dropped
+	 */
+	unsigned long serial;
+	/**
+	 * Entries picked by the running query
+	 */
+	intu32 picked;
+	/**
+	 * Next segment of the same store
+	 */
+	struct CachedSegment *next;
+} CachedSegment;
+
+/**
+ * Index entry: one cached entry, by time
+ */
+typedef struct CacheIndexEntry {
+	/**
+	 * Entry absolute time, microseconds since epoch
+	 */
+	long long time;
+	/**
+	 * Segment holding the entry
+	 */
+	CachedSegment *segment;
+	/**
+	 * Entry position within segment
+	 */
+	intu32 row;
+} CacheIndexEntry;
+
+/**
+ * Cached segments of one PM-Store of one agent
+ */
+typedef struct CachedStore {
+	/**
+	 * System id of the agent
+	 */
+	octet_string system_id;
+	/**
+	 * PM-Store handle
+	 */
+	ASN1_HANDLE handle;
+	/**
+	 * Cached segments
+	 */
+	CachedSegment *segments;
+	/**
+	 * Entries of all segments, sorted by time
+	 */
+	CacheIndexEntry *index;
+	/**
+	 * Number of entries in index
+	 */
+	intu32 index_count;
+	/**
+	 * Next store
+	 */
+	struct CachedStore *next;
+} CachedStore;
+
+/**
+ * Cached stores
+ */
+static CachedStore *stores = NULL;
+
+/**
+ * Entries cached, all stores together
+ */
+static intu32 cached_entries = 0;
+
+/**
+ * Maximum number of entries cached
+ */
+static intu32 cache_limit = PMSTORE_CACHE_DEFAULT_LIMIT;
+
+/**
+ * Transfer counter
+ */
+static unsigned long cache_serial = 0;
+
+/**
+ * Reads the absolute time in front of a cached entry
+ */
+static long long entry_time(const intu8 *entry)
+{
+	AbsoluteTime time;
+
+	time.century = entry[0];
+	time.year = entry[1];
+	time.month = entry[2];
+	time.day = entry[3];
+	time.hour = entry[4];
+	time.minute = entry[5];
+	time.second = entry[6];
+	time.sec_fractions = entry[7];
+
+	return date_util_absolute_time_to_epoch_us(time);
+}
+
+/**
+ * Orders index entries by time, then by position
+ */
+static int index_entry_cmp(const void *a, const void *b)
+{
+	const CacheIndexEntry *x = a;
+	const CacheIndexEntry *y = b;
+
+	if (x->time != y->time) {
+		return x->time < y->time ? -1 : 1;
+	}
+
+	return x->row < y->row ? -1 : (x->row > y->row);
+}
+
+/**
+ * Finds the cached store of an agent PM-Store
+ */
+static CachedStore *find_store(octet_string *system_id, ASN1_HANDLE handle)
+{
+	CachedStore *store;
+
+	for (store = stores; store; store = store->next) {
+		if (store->handle == handle
+		    && store->system_id.length == system_id->length
+		    && (system_id->length == 0
+			|| memcmp(store->system_id.value, system_id->value,
+				  system_id->length) == 0)) {
+			return store;
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * Frees a cached segment
+ */
+static void free_segment(CachedSegment *segment)
+{
+	del_pmsegmententrymap(&segment->entry_map);
+	spillbuff_clear(&segment->data);
+	free(segment);
+}
+
+/**
+ * Drops a store if it has no segments left
+ */
+static void drop_store_if_empty(CachedStore *store)
+{
+	CachedStore **link;
+
+	if (store->segments) {
+		return;
+	}
+
+	for (link = &stores; *link; link = &(*link)->next) {
+		if (*link == store) {
+			*link = store->next;
+			break;
+		}
+	}
+
+	free(store->index);
+	free(store->system_id.value);
+	free(store);
+}
+
+/**
+ * Unlinks a segment from its store, dropping its entries from index
+ */
+static void remove_segment(CachedStore *store, CachedSegment *segment)
+{
+	CachedSegment **link;
+	intu32 i, j;
+
+	for (i = 0, j = 0; i < store->index_count; ++i) {
+		if (store->index[i].segment != segment) {
+			store->index[j++] = store->index[i];
+		}
+	}
+
+	store->index_count = j;
+
+	for (link = &store->segments; *link; link = &(*link)->next) {
+		if (*link == segment) {
+			*link = segment->next;
+			break;
+		}
+	}
+
+	cached_entries -= segment->count;
+	free_segment(segment);
+}
+
+/**
+ * Drops segments transferred least recently until entries fit in limit
+ */
+static void enforce_limit()
+{
+	while (cached_entries > cache_limit) {
+		CachedStore *store;
+		CachedStore *oldest_store = NULL;
+		CachedSegment *segment;
+		CachedSegment *oldest = NULL;
+
+		for (store = stores; store; store = store->next) {
+			for (segment = store->segments; segment; segment = segment->next) {
+				if (!oldest || segment->serial < oldest->serial) {
+					oldest = segment;
+					oldest_store = store;
+				}
+			}
+		}
+
+		if (!oldest) {
+			break;
+		}
+
+		DEBUG("PM-Store cache: dropping segment %d", oldest->instance);
+		remove_segment(oldest_store, oldest);
+		drop_store_if_empty(oldest_store);
+	}
+}
+
+/**
+ * Merges sorted index entries of a new segment into store index
+ */
+static void merge_index(CachedStore *store, CacheIndexEntry *added,
+			intu32 count)
+{
+	CacheIndexEntry *merged = malloc((store->index_count + count)
+					 * sizeof(CacheIndexEntry));
+	intu32 i = 0, j = 0, k = 0;
+
+	while (i < store->index_count && j < count) {
+		if (added[j].time < store->index[i].time) {
+			merged[k++] = added[j++];
+		} else {
+			merged[k++] = store->index[i++];
+		}
+	}
+
+	while (i < store->index_count) {
+		merged[k++] = store->index[i++];
+	}
+
+	while (j < count) {
+		merged[k++] = added[j++];
+	}
+
+	free(store->index);
+	store->index = merged;
+	store->index_count = k;
+}
+
+/**
+ * Keeps the transferred entries of a segment, replacing entries of a
+ * previous transfer of the same segment. Segments whose entries have
+ * no absolute time are ignored.
+ *
+ * \param system_id system id of the agent
+ * \param handle PM-Store handle
+ * \param segment the segment, just transferred
+ */
+void pmstore_cache_add(octet_string *system_id, ASN1_HANDLE handle,
+		       struct PMSegment *segment)
+{
+	PmSegmentEntryMap *map = &segment->pm_segment_entry_map;
+	intu32 entry_size = pmsegment_entry_size(map);
+	intu32 count;
+	CachedStore *store;
+	CachedSegment *cached;
+	CacheIndexEntry *added;
+	intu32 i, n;
+	long long start, end;
+
+	if (!(map->segm_entry_header & SEG_ELEM_HDR_ABSOLUTE_TIME)
+	    || entry_size == 0) {
+		return;
+	}
+
+	count = segment->fixed_segment_data.length / entry_size;
+
+	if (count > segment->empiric_usage_count) {
+		count = segment->empiric_usage_count;
+	}
+
+	gil_lock();
+
+	if (count == 0 || count > cache_limit) {
+		gil_unlock();
+		return;
+	}
+
+	store = find_store(system_id, handle);
+
+	if (store) {
+		for (cached = store->segments; cached; cached = cached->next) {
+			if (cached->instance == segment->instance_number) {
+				remove_segment(store, cached);
+				break;
+			}
+		}
+	} else {
+		store = calloc(1, sizeof(CachedStore));
+		store->handle = handle;
+		store->system_id.length = system_id->length;
+		if (system_id->length > 0) {
+			store->system_id.value = malloc(system_id->length);
+			memcpy(store->system_id.value, system_id->value,
+			       system_id->length);
+		}
+		store->next = stores;
+		stores = store;
+	}
+
+	cached = calloc(1, sizeof(CachedSegment));
+	cached->instance = segment->instance_number;
+	cached->entry_size = entry_size;
+	cached->serial = ++cache_serial;
+	pmsegment_copy_entry_map(&cached->entry_map, map);
+
+	if (!spillbuff_append(&cached->data, segment->fixed_segment_data.data,
+			      count * entry_size)) {
+		ERROR("PM-Store cache: cannot keep segment %d", cached->instance);
+		free_segment(cached);
+		drop_store_if_empty(store);
+		gil_unlock();
+		return;
+	}
+
+	added = malloc(count * sizeof(CacheIndexEntry));
+
+	for (i = 0, n = 0; i < count; ++i) {
+		long long time = entry_time(cached->data.data + i * entry_size);
+
+		if (time == DATE_UTIL_INVALID_TIME) {
+			continue;
+		}
+
+		added[n].time = time;
+		added[n].segment = cached;
+		added[n].row = i;
+		++n;
+	}
+
+	qsort(added, n, sizeof(CacheIndexEntry), index_entry_cmp);
+
+	start = date_util_absolute_time_to_epoch_us(segment->segment_start_abs_time);
+	end = date_util_absolute_time_to_epoch_us(segment->segment_end_abs_time);
+
+	if (start == DATE_UTIL_INVALID_TIME || end == DATE_UTIL_INVALID_TIME
+	    || end < start) {
+		start = n > 0 ? added[0].time : DATE_UTIL_INVALID_TIME;
+		end = n > 0 ? added[n - 1].time : DATE_UTIL_INVALID_TIME;
+	}
+
+	cached->start = start;
+	cached->end = end;
+	cached->count = count;
+	cached->next = store->segments;
+	store->segments = cached;
+	cached_entries += count;
+
+	merge_index(store, added, n);
+	free(added);
+
+	spillbuff_release_pages(&cached->data);
+
+	DEBUG("PM-Store cache: segment %d, %d entries", cached->instance, count);
+
+	enforce_limit();
+
+	gil_unlock();
+}
+
+/**
+ * Tells whether cached segments cover a time range
+ */
+static int store_covers(CachedStore *store, long long start, long long end)
+{
+	CachedSegment *segment;
+	int progress = 1;
+
+	// extend coverage until no segment helps
+	while (progress && start <= end) {
+		progress = 0;
+		for (segment = store->segments; segment; segment = segment->next) {
+			if (segment->start == DATE_UTIL_INVALID_TIME) {
+				continue;
+			}
+			if (segment->start <= start && segment->end >= start) {
+				if (segment->end == end) {
+					return 1;
+				}
+				start = segment->end + 1;
+				progress = 1;
+			}
+		}
+	}
+
+	return start > end;
+}
+
+/**
+ * Returns cached entries of a PM-Store within a time range, in the
+ * same form as segment data events: one "PM-Segment" compound per
+ * segment with entries in range, entries sorted by time.
+ *
+ * \param mds MDS of the agent, whose objects describe entries
+ * \param handle PM-Store handle
+ * \param start first microsecond since epoch
+ * \param end last microsecond since epoch
+ * \param result entries (output), freed by caller
+ *
+ * \return 1 if range is served from cache, 0 if agent must be asked
+ */
+int pmstore_cache_query(struct MDS *mds, ASN1_HANDLE handle,
+			long long start, long long end, DataList **result)
+{
+	CachedStore *store;
+	CachedSegment *segment;
+	intu32 lo, hi, i;
+	int touched = 0;
+	int k;
+
+	gil_lock();
+
+	store = find_store(&mds->system_id, handle);
+
+	if (!store || start > end || !store_covers(store, start, end)) {
+		gil_unlock();
+		return 0;
+	}
+
+	// first entry not before start
+	lo = 0;
+	hi = store->index_count;
+
+	while (lo < hi) {
+		intu32 mid = lo + (hi - lo) / 2;
+
+		if (store->index[mid].time < start) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	for (segment = store->segments; segment; segment = segment->next) {
+		segment->picked = 0;
+	}
+
+	for (i = lo; i < store->index_count && store->index[i].time <= end; ++i) {
+		if (store->index[i].segment->picked++ == 0) {
+			++touched;
+		}
+	}
+
+	hi = i;
+	*result = data_list_new(touched);
+
+	k = 0;
+
+	// one compound per segment, in order of first entry
+	for (i = lo; i < hi; ++i) {
+		struct PMSegment pick;
+		intu32 j, n;
+
+		segment = store->index[i].segment;
+
+		if (segment->picked == 0) {
+			continue;
+		}
+
+		memset(&pick, 0, sizeof(struct PMSegment));
+		pick.instance_number = segment->instance;
+		pick.pm_segment_entry_map = segment->entry_map;
+		pick.empiric_usage_count = segment->picked;
+		pick.fixed_segment_data.length = segment->picked * segment->entry_size;
+		pick.fixed_segment_data.data = malloc(pick.fixed_segment_data.length);
+
+		for (j = i, n = 0; j < hi && n < segment->picked; ++j) {
+			if (store->index[j].segment == segment) {
+				memcpy(pick.fixed_segment_data.data
+				       + n * segment->entry_size,
+				       segment->data.data
+				       + store->index[j].row * segment->entry_size,
+				       segment->entry_size);
+				++n;
+			}
+		}
+
+		pmstore_segment_entries_as_dataentry(mds, &pick,
+						     &(*result)->values[k++]);
+		free(pick.fixed_segment_data.data);
+		segment->picked = 0;
+		spillbuff_release_pages(&segment->data);
+	}
+
+	gil_unlock();
+
+	return 1;
+}
+
+/**
+ * Sets maximum number of entries cached, all agents together.
+ * Zero disables caching.
+ *
+ * \param entries maximum number of entries
+ */
+void pmstore_cache_set_limit(intu32 entries)
+{
+	gil_lock();
+	cache_limit = entries;
+	enforce_limit();
+	gil_unlock();
+}
+
+/**
+ * Returns number of entries cached
+ *
+ * \return number of entries
+ */
+intu32 pmstore_cache_count()
+{
+	intu32 count;
+
+	gil_lock();
+	count = cached_entries;
+	gil_unlock();
+
+	return count;
+}
+
+/**
+ * Drops all cached entries
+ */
+void pmstore_cache_clear()
+{
+	gil_lock();
+
+	while (stores) {
+		CachedStore *store = stores;
+
+		while (store->segments) {
+			remove_segment(store, store->segments);
+		}
+
+		drop_store_if_empty(store);
+	}
+
+	cached_entries = 0;
+
+	gil_unlock();
+}
+
+/** @} */
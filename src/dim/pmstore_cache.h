@@ -0,0 +1,65 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+/**
+ * \file pmstore_cache.h
+ * \brief Time-indexed cache of transferred PM-Segment entries.
+ *
+ * Copyright (C) 2010 Signove Tecnologia Corporation.
+ * All rights reserved.
+ * Contact: Signove Tecnologia Corporation (contact@signove.com)
+ *
+ * $LICENSE_TEXT:BEGIN$
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation and appearing
+ * in the file LICENSE included in the packaging of this file; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ * $LICENSE_TEXT:END$
+ *
+ * \date Oct 18, 2026
+ */
+
+#ifndef PMSTORE_CACHE_H_
+#define PMSTORE_CACHE_H_
+
+#include "asn1/phd_types.h"
+#include "api/api_definitions.h"
+#include "mds.h"
+#include "pmsegment.h"
+
+/**
+ * \ingroup PMStore
+ * @{
+ */
+
+/**
+ * Default maximum number of cached entries, all devices together
+ */
+#define PMSTORE_CACHE_DEFAULT_LIMIT (256 * 1024)
+
+void pmstore_cache_add(octet_string *system_id, ASN1_HANDLE handle,
+		       struct PMSegment *segment);
+
+void pmstore_cache_remove(octet_string *system_id, ASN1_HANDLE handle,
+			  InstNumber inst);
+
+int pmstore_cache_query(struct MDS *mds, ASN1_HANDLE handle,
+			long long start, long long end, DataList **result);
+
+void pmstore_cache_set_limit(intu32 entries);
+
+intu32 pmstore_cache_count();
+
+void pmstore_cache_clear();
+
+/** @} */
+
+#endif /* PMSTORE_CACHE_H_ */
@@ -0,0 +1,286 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+/**
+ * \file pmstore_delivery.c
+ * \brief Tracking of PM-Segment entries delivered to the application.
+ *
+ * Copyright (C) 2010 Signove Tecnologia Corporation.
+ * All rights reserved.
+ * Contact: Signove Tecnologia Corporation (contact@signove.com)
+ *
+ * $LICENSE_TEXT:BEGIN$
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation and appearing
+ * in the file LICENSE included in the packaging of this file; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ * $LICENSE_TEXT:END$
+ *
+ * \date Oct 18, 2026
+ */
+
+/**
+ * \addtogroup PMStore
+ *
+ * Agents usually send a whole segment on every transfer, though most
+ * of its entries were transferred before. With delta delivery enabled
+ * (see pmstore_delivery_set_enabled()), the manager remembers, per
+ * agent, PM-Store and segment, how many entries were delivered to the
+ * application, along with a fingerprint of the first and the last of
+ * them. When a new transfer of the segment still holds those entries
+ * at the same positions, only the entries after them are decoded and
+ * delivered.
+ *
+ * If the segment shrank, or the fingerprints do not match (e.g. the
+ * segment was cleared and filled again), the whole segment is
+ * delivered, as if delta delivery were disabled.
+ *
+ * @{
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "src/dim/pmstore_delivery.h"
+#include "src/communication/communication.h"
+#include "src/util/checksum.h"
+#include "src/util/log.h"
+
+/**
+ * Entries of a segment delivered to the application
+ */
+typedef struct DeliveredSegment {
+	/**
+	 * System id of the agent
+	 */
+	octet_string system_id;
+	/**
+	 * PM-Store handle
+	 */
+	ASN1_HANDLE handle;
+	/**
+	 * Segment instance number
+	 */
+	InstNumber instance;
+	/**
+	 * Size of each entry
+	 */
+	intu32 entry_size;
+	/**
+	 * Number of entries delivered
+	 */
+	intu32 delivered;
+	/**
+	 * Fingerprint of first entry delivered
+	 */
+	intu32 first_fingerprint;
+	/**
+	 * Fingerprint of last entry delivered
+	 */
+	intu32 last_fingerprint;
+	/**
+	 * Next (less recently delivered) segment
+	 */
+	struct DeliveredSegment *next;
+} DeliveredSegment;
+
+/**
+ * Tracked segments, most recently delivered first
+ */
+static DeliveredSegment *delivered_list = NULL;
+
+/**
+ * Non-zero if delta delivery is enabled
+ */
+static int delivery_enabled = 0;
+
+/**
+ * Fingerprint of an entry
+ */
+static intu32 entry_fingerprint(struct PMSegment *segment, intu32 entry_size,
+				intu32 row)
+{
+	return checksum_fnv1a(CHECKSUM_FNV1A_INIT,
+			      segment->fixed_segment_data.data + row * entry_size,
+			      entry_size);
+}
+
+/**
+ * Frees a tracked segment
+ */
+static void free_delivered(DeliveredSegment *tracked)
+{
+	free(tracked->system_id.value);
+	free(tracked);
+}
+
+/**
+ * Enables or disables delta delivery of segment data. Disabling it
+ * forgets segments delivered so far.
+ *
+ * \param enabled non-zero to deliver only new entries
+ */
+void pmstore_delivery_set_enabled(int enabled)
+{
+	gil_lock();
+	delivery_enabled = enabled;
+	gil_unlock();
+
+	if (!enabled) {
+		pmstore_delivery_clear();
+	}
+}
+
+/**
+ * Tells whether delta delivery of segment data is enabled
+ *
+ * \return non-zero if enabled
+ */
+int pmstore_delivery_is_enabled()
+{
+	int enabled;
+
+	gil_lock();
+	enabled = delivery_enabled;
+	gil_unlock();
+
+	return enabled;
+}
+
+/**
+ * Finds the entries of a transferred segment that were delivered to
+ * the application before, and records that all of them are going to
+ * be delivered now.
+ *
+ * \param system_id system id of the agent
+ * \param handle PM-Store handle
+ * \param segment the segment, just transferred
+ *
+ * \return number of leading entries delivered before, which need not
+ * be delivered again; 0 if delta delivery is disabled
+ */
+intu32 pmstore_delivery_update(octet_string *system_id, ASN1_HANDLE handle,
+			       struct PMSegment *segment)
+{
+	intu32 entry_size = pmsegment_entry_size(&segment->pm_segment_entry_map);
+	DeliveredSegment **link;
+	DeliveredSegment *tracked = NULL;
+	intu32 count;
+	intu32 skip = 0;
+	int n;
+
+	if (entry_size == 0) {
+		return 0;
+	}
+
+	count = segment->fixed_segment_data.length / entry_size;
+
+	if (count > segment->empiric_usage_count) {
+		count = segment->empiric_usage_count;
+	}
+
+	gil_lock();
+
+	if (!delivery_enabled) {
+		gil_unlock();
+		return 0;
+	}
+
+	for (link = &delivered_list; *link; link = &(*link)->next) {
+		DeliveredSegment *t = *link;
+
+		if (t->handle == handle && t->instance == segment->instance_number
+		    && t->system_id.length == system_id->length
+		    && (system_id->length == 0
+			|| memcmp(t->system_id.value, system_id->value,
+				  system_id->length) == 0)) {
+			tracked = t;
+			*link = t->next;
+			break;
+		}
+	}
+
+	if (tracked && tracked->entry_size == entry_size
+	    && tracked->delivered <= count
+	    && tracked->first_fingerprint == entry_fingerprint(segment, entry_size, 0)
+	    && tracked->last_fingerprint == entry_fingerprint(segment, entry_size,
+							      tracked->delivered - 1)) {
+		skip = tracked->delivered;
+	}
+
+	if (count == 0) {
+		if (tracked) {
+			free_delivered(tracked);
+		}
+		gil_unlock();
+		return 0;
+	}
+
+	if (!tracked) {
+		tracked = calloc(1, sizeof(DeliveredSegment));
+		tracked->handle = handle;
+		tracked->instance = segment->instance_number;
+		tracked->system_id.length = system_id->length;
+		if (system_id->length > 0) {
+			tracked->system_id.value = malloc(system_id->length);
+			memcpy(tracked->system_id.value, system_id->value,
+			       system_id->length);
+		}
+	}
+
+	tracked->entry_size = entry_size;
+	tracked->delivered = count;
+	tracked->first_fingerprint = entry_fingerprint(segment, entry_size, 0);
+	tracked->last_fingerprint = entry_fingerprint(segment, entry_size, count - 1);
+
+	tracked->next = delivered_list;
+	delivered_list = tracked;
+
+	// forget segments delivered least recently
+	for (link = &delivered_list, n = 0; *link; link = &(*link)->next, ++n) {
+		if (n == PMSTORE_DELIVERY_MAX) {
+			DeliveredSegment *t = *link;
+			*link = NULL;
+
+			while (t) {
+				DeliveredSegment *next = t->next;
+				free_delivered(t);
+				t = next;
+			}
+
+			break;
+		}
+	}
+
+	gil_unlock();
+
+	DEBUG("PM-Segment %d: %d entries, %d delivered before",
+	      segment->instance_number, count, skip);
+
+	return skip;
+}
+
+/**
+ * Forgets all segments delivered so far
+ */
+void pmstore_delivery_clear()
+{
+	gil_lock();
+
+	while (delivered_list) {
+		DeliveredSegment *next = delivered_list->next;
+		free_delivered(delivered_list);
+		delivered_list = next;
+	}
+
+	gil_unlock();
+}
+
+/** @} */
@@ -0,0 +1,57 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+/**
+ * \file pmstore_delivery.h
+ * \brief Tracking of PM-Segment entries delivered to the application.
+ *
+ * Copyright (C) 2010 Signove Tecnologia Corporation.
+ * All rights reserved.
+ * Contact: Signove Tecnologia Corporation (contact@signove.com)
+ *
+ * $LICENSE_TEXT:BEGIN$
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation and appearing
+ * in the file LICENSE included in the packaging of this file; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ * $LICENSE_TEXT:END$
+ *
+ * \date Oct 18, 2026
+ */
+
+#ifndef PMSTORE_DELIVERY_H_
+#define PMSTORE_DELIVERY_H_
+
+#include "asn1/phd_types.h"
+#include "pmsegment.h"
+
+/**
+ * \ingroup PMStore
+ * @{
+ */
+
+/**
+ * Maximum number of segments tracked, all agents together
+ */
+#define PMSTORE_DELIVERY_MAX 256
+
+void pmstore_delivery_set_enabled(int enabled);
+
+int pmstore_delivery_is_enabled();
+
+intu32 pmstore_delivery_update(octet_string *system_id, ASN1_HANDLE handle,
+			       struct PMSegment *segment);
+
+void pmstore_delivery_clear();
+
+/** @} */
+
+#endif /* PMSTORE_DELIVERY_H_ */
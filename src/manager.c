@@ -95,12 +95,19 @@
 #include "src/communication/extconfigurations.h"
 #include "src/communication/configuring.h"
 #include "src/communication/stdconfigurations.h"
+#include "src/communication/stats.h"
+#include "src/communication/manager_batch.h"
+#include "src/dim/mds_template.h"
+#include "src/dim/obs_filter.h"
+#include "src/dim/pmstore_cache.h"
+#include "src/dim/pmstore_delivery.h"
 #include "src/specializations/blood_pressure_monitor.h"
 #include "src/specializations/pulse_oximeter.h"
 #include "src/specializations/weighing_scale.h"
 #include "src/specializations/glucometer.h"
 #include "src/util/log.h"
 #include "src/util/dateutil.h"
+#include "src/util/spillbuff.h"
 
 
 /**
@@ -113,6 +120,21 @@ static ManagerListener *manager_listener_list = NULL;
  */
 static int manager_listener_count = 0;
 
+/**
+ * 1 if some listener wants all observations
+ */
+static int subscriptions_disabled = 0;
+
+/**
+ * Reports of a device notified together, 0 or 1 to notify each one
+ */
+static int batch_max_reports = 0;
+
+/**
+ * Time, in milliseconds, measurement data may wait in queue
+ */
+static int batch_window = 0;
+
 static void manager_handle_transition_evt(Context *ctx, fsm_states previous, fsm_states next);
 
 
@@ -169,22 +191,26 @@ void manager_init(CommunicationPlugin **plugins)
 
 	// Listen to all communication state transitions
 	communication_add_state_transition_listener(fsm_state_size, &manager_handle_transition_evt);
-	communication_set_connection_listeners(&manager_notify_evt_device_connected,
+	communication_set_connection_listeners(MANAGER_CONTEXT,
+						&manager_notify_evt_device_connected,
 						&manager_notify_evt_device_disconnected);
 
-	// Register standard configurations for each specialization.
+	// Register standard configurations for each specialization,
+	// unless agent has done it already.
 	// (comment these if you want to test acquisition of extended
 	// configurations)
-	std_configurations_register_conf(
-		blood_pressure_monitor_create_std_config_ID02BC());
-	std_configurations_register_conf(
-		pulse_oximeter_create_std_config_ID0190());
-	std_configurations_register_conf(
-		pulse_oximeter_create_std_config_ID0191());
-	std_configurations_register_conf(
-		weighting_scale_create_std_config_ID05DC());
-	std_configurations_register_conf(
-		glucometer_create_std_config_ID06A4());
+	if (communication_role_ref() == 1) {
+		std_configurations_register_conf(
+			blood_pressure_monitor_create_std_config_ID02BC());
+		std_configurations_register_conf(
+			pulse_oximeter_create_std_config_ID0190());
+		std_configurations_register_conf(
+			pulse_oximeter_create_std_config_ID0191());
+		std_configurations_register_conf(
+			weighting_scale_create_std_config_ID05DC());
+		std_configurations_register_conf(
+			glucometer_create_std_config_ID06A4());
+	}
 
 	// Load Configurations File
 	ext_configurations_load_configurations();
@@ -202,11 +228,62 @@ void manager_finalize()
 	DEBUG("Manager Finalization");
 
 	manager_remove_all_listeners();
+	communication_set_connection_listeners(MANAGER_CONTEXT, NULL, NULL);
 	ext_configurations_destroy();
+	pmstore_cache_clear();
+	pmstore_delivery_clear();
+
+	// shared state is torn down by the last role
+	if (communication_role_unref() > 0) {
+		return;
+	}
+
+	mds_template_clear();
 	std_configurations_destroy();
 	communication_finalize();
 }
 
+/**
+ * Pre-allocates the per-connection structures of count
+ * connections, so that they are not allocated one by one as
+ * devices connect. Optional; pools grow on demand anyway.
+ *
+ * @param count number of connections
+ * @return 1 if successful, 0 otherwise
+ */
+int manager_reserve_contexts(int count)
+{
+	return communication_reserve_contexts(count);
+}
+
+
+/**
+ * Turns subscriptions of a new listener into filters of scan report
+ * decoding. Once some listener of measurements has no subscriptions,
+ * everything is decoded.
+ *
+ * @param listener the listener being added
+ */
+static void manager_compile_subscriptions(ManagerListener *listener)
+{
+	int i;
+
+	if (subscriptions_disabled) {
+		return;
+	}
+
+	if (listener->measurement_data_updated && listener->subscription_count == 0) {
+		subscriptions_disabled = 1;
+		obs_filter_reset();
+		return;
+	}
+
+	for (i = 0; i < listener->subscription_count; i++) {
+		const ManagerSubscription *sub = &listener->subscriptions[i];
+		obs_filter_add(sub->system_id, sub->handle, sub->partition,
+			       sub->code, sub->attribute);
+	}
+}
 
 /**
  * Adds a manager listener.
@@ -239,6 +316,8 @@ int manager_add_listener(ManagerListener listener)
 
 	manager_listener_count++;
 
+	manager_compile_subscriptions(&listener);
+
 	return 1;
 
 }
@@ -256,6 +335,9 @@ void manager_remove_all_listeners()
 		free(manager_listener_list);
 		manager_listener_list = NULL;
 	}
+
+	obs_filter_reset();
+	subscriptions_disabled = 0;
 }
 
 /**
@@ -363,15 +445,44 @@ int manager_notify_evt_device_disconnected(Context *ctx, const char *addr)
 }
 
 /**
- * Notifies 'measurement data updated'  event.
- * This function should be visible to source layer of events.
- * This function must be called in a thread safe communication context.
+ * Removes entries of observations nobody subscribed to, which were
+ * left empty by decoding. Deletes the list if nothing is left.
  *
- * @param ctx
- * @param data_list with the measured data.
+ * @param data_list measurement data
+ * @return 1 if some entry is left, 0 if list was deleted
+ */
+static int manager_drop_skipped_entries(DataList *data_list)
+{
+	int i, n = 0;
+
+	for (i = 0; i < data_list->size; i++) {
+		DataEntry *entry = &data_list->values[i];
+
+		if (entry->choice == SIMPLE_DATA_ENTRY && entry->u.simple.name == NULL) {
+			data_entry_del(entry);
+		} else {
+			data_list->values[n++] = *entry;
+		}
+	}
+
+	data_list->size = n;
+
+	if (n == 0) {
+		data_list_del(data_list);
+		return 0;
+	}
+
+	return 1;
+}
+
+/**
+ * Passes measurement data to listeners, then deletes it
+ *
+ * @param ctx context
+ * @param data_list measurement data
  * @return 1 if any listener catches the notification, 0 if not
  */
-int manager_notify_evt_measurement_data_updated(Context *ctx, DataList *data_list)
+static int manager_deliver_measurement_data(Context *ctx, DataList *data_list)
 {
 	int ret_val = 0;
 	int i;
@@ -387,7 +498,84 @@ int manager_notify_evt_measurement_data_updated(Context *ctx, DataList *data_lis
 
 	data_list_del(data_list);
 	return ret_val;
+}
 
+/**
+ * Notifies measurement data queued by a context
+ *
+ * @param ctx context, locked
+ * @return 1 if any listener catches the notification, 0 if not or
+ * if nothing was queued
+ */
+static int manager_flush_measurement_batch(Context *ctx)
+{
+	DataList *data_list = manager_batch_take(ctx);
+
+	if (data_list == NULL) {
+		return 0;
+	}
+
+	return manager_deliver_measurement_data(ctx, data_list);
+}
+
+/**
+ * Gets time, in milliseconds, until measurement data queued by a
+ * context must be notified
+ *
+ * @param ctx context, locked
+ * @return remaining time, 0 if due, -1 if nothing is queued
+ */
+static int manager_measurement_batch_due(Context *ctx)
+{
+	long long age;
+
+	if (manager_batch_reports(ctx) == 0) {
+		return -1;
+	}
+
+	age = (stats_time() - manager_batch_first_at(ctx)) / 1000;
+
+	return age >= batch_window ? 0 : batch_window - age;
+}
+
+/**
+ * Notifies 'measurement data updated'  event.
+ * This function should be visible to source layer of events.
+ * This function must be called in a thread safe communication context.
+ * If measurement batching is enabled, data is queued and notified
+ * later, along with data of other reports of the device (see
+ * manager_set_measurement_batching()).
+ *
+ * @param ctx
+ * @param data_list with the measured data. Ownership is transferred.
+ * @return 1 if any listener catches the notification, 0 if not
+ */
+int manager_notify_evt_measurement_data_updated(Context *ctx, DataList *data_list)
+{
+	int i;
+
+	if (obs_filter_active() && !manager_drop_skipped_entries(data_list)) {
+		return 0;
+	}
+
+	if (batch_max_reports <= 1) {
+		return manager_deliver_measurement_data(ctx, data_list);
+	}
+
+	manager_batch_add(ctx, data_list);
+
+	if (manager_batch_reports(ctx) >= batch_max_reports
+	    || manager_measurement_batch_due(ctx) == 0) {
+		return manager_flush_measurement_batch(ctx);
+	}
+
+	for (i = 0; i < manager_listener_count; i++) {
+		if (manager_listener_list[i].measurement_data_updated != NULL) {
+			return 1;
+		}
+	}
+
+	return 0;
 }
 
 /**
@@ -581,13 +769,45 @@ DataList *manager_get_configuration(ContextId id)
 		return NULL;
 	}
 
-	DataList *list = mds_populate_configuration(mds);
+	// snapshot is rebuilt only after MDS attributes or configuration change
+	DataList *list = data_list_clone(mds_get_configuration_snapshot(mds));
 
 	context_unlock(ctx);
 
 	return list;
 }
 
+/**
+ * Returns configuration of medical device as XML document, encoded once
+ * until the configuration changes.
+ *
+ * @param id context id
+ * @return XML document to be freed by caller, NULL if not available
+ */
+char *manager_get_configuration_xml(ContextId id)
+{
+	Context *ctx = context_get_and_lock(id);
+	const char *xml = NULL;
+	char *copy = NULL;
+
+	if (!ctx)
+		return NULL;
+
+	if (ctx->mds) {
+		xml = mds_get_configuration_xml(ctx->mds);
+	} else {
+		ERROR("No MDS data is available");
+	}
+
+	if (xml) {
+		copy = data_strcp(xml);
+	}
+
+	context_unlock(ctx);
+
+	return copy;
+}
+
 /**
  * Returns attributes from medical device since last updated.
  *
@@ -607,14 +827,8 @@ DataList *manager_get_mds_attributes(ContextId id)
 			return NULL;
 		}
 
-		DataList *list = data_list_new(1);
-
-		if (list == NULL) {
-			context_unlock(ctx);
-			return NULL;
-		}
-
-		mds_populate_attributes(mds, &list->values[0]);
+		// snapshot is rebuilt only after MDS attributes change
+		DataList *list = data_list_clone(mds_get_attributes_snapshot(mds));
 
 		context_unlock(ctx);
 
@@ -624,6 +838,37 @@ DataList *manager_get_mds_attributes(ContextId id)
 	return NULL;
 }
 
+/**
+ * Returns attributes from medical device as XML document, encoded once
+ * until attributes change.
+ *
+ * @param id context id
+ * @return XML document to be freed by caller, NULL if not available
+ */
+char *manager_get_mds_attributes_xml(ContextId id)
+{
+	Context *ctx = context_get_and_lock(id);
+	const char *xml = NULL;
+	char *copy = NULL;
+
+	if (!ctx)
+		return NULL;
+
+	if (ctx->mds) {
+		xml = mds_get_attributes_xml(ctx->mds);
+	} else {
+		ERROR("No MDS data is available");
+	}
+
+	if (xml) {
+		copy = data_strcp(xml);
+	}
+
+	context_unlock(ctx);
+
+	return copy;
+}
+
 /**
  * Requests "measurement data transmission", if agent support this feature it
  * will start to send back measurement data.
@@ -862,7 +1107,15 @@ Request *manager_set_time(ContextId id, time_t time, service_request_callback ca
  */
 void manager_handle_transition_evt(Context *ctx, fsm_states previous, fsm_states next)
 {
+	if (!(ctx->type & MANAGER_CONTEXT)) {
+		// agent running in the same process
+		return;
+	}
+
 	if (previous == fsm_state_operating && next != previous) {
+		// queued measurements go before device leaves
+		manager_flush_measurement_batch(ctx);
+
 		DEBUG(" manager: Notify device unavailable.\n");
 		// Exiting operating state
 		manager_notify_evt_device_unavailable(ctx);
@@ -890,6 +1143,110 @@ void manager_set_system_id(const intu8 *system_id, intu16 len)
 	memcpy(mgr_system_id, system_id, len);
 }
 
+/**
+ * Set size above which PM-Segment data being transferred is buffered
+ * in a temporary file instead of memory. Default is
+ * SPILLBUFF_DEFAULT_THRESHOLD.
+ *
+ * @param bytes threshold, 0 to always buffer in memory
+ */
+void manager_set_segment_spill_threshold(intu32 bytes)
+{
+	spillbuff_set_threshold(bytes);
+}
+
+/**
+ * Set maximum number of transferred PM-Segment entries kept for
+ * manager_get_segment_data_range(), all agents together. Default is
+ * PMSTORE_CACHE_DEFAULT_LIMIT.
+ *
+ * @param entries maximum number of entries, 0 to disable cache
+ */
+void manager_set_segment_cache_limit(intu32 entries)
+{
+	pmstore_cache_set_limit(entries);
+}
+
+/**
+ * Enables delivery of new PM-Segment entries only. When enabled, a
+ * segment transferred again is reported with just the entries that
+ * were not reported before; its "PM-Segment" compound gets a
+ * "first-entry" meta attribute with the index of its first entry.
+ * Disabled by default.
+ *
+ * @param enabled non-zero to enable
+ */
+void manager_set_segment_delta_delivery(int enabled)
+{
+	pmstore_delivery_set_enabled(enabled);
+}
+
+/**
+ * Sets how measurement data of a device is batched. Instead of one
+ * measurement_data_updated notification per scan report, data of
+ * max_reports reports is notified in a single list, or less if the
+ * first of them is window milliseconds old. The window is checked
+ * when reports arrive and by manager_poll_measurements(). Queued
+ * data is also notified when the device leaves operating state.
+ *
+ * @param max_reports reports in a batch, 0 or 1 to notify each one
+ * at once
+ * @param window time data may wait in queue, in milliseconds
+ */
+void manager_set_measurement_batching(int max_reports, int window)
+{
+	batch_max_reports = max_reports;
+	batch_window = window;
+}
+
+/**
+ * Notifies measurement data queued for a device now
+ *
+ * @param id context id
+ * @return 1 if data was notified, 0 if nothing was queued
+ */
+int manager_flush_measurements(ContextId id)
+{
+	Context *ctx = context_get_and_lock(id);
+	int ret = 0;
+
+	if (ctx) {
+		ret = manager_batch_reports(ctx) > 0;
+		manager_flush_measurement_batch(ctx);
+		context_unlock(ctx);
+	}
+
+	return ret;
+}
+
+/**
+ * Notifies measurement data queued for a device if its window has
+ * elapsed. Applications that batch measurements should call this
+ * from their main loop, in the time returned at most.
+ *
+ * @param id context id
+ * @return time until queued data is due, in milliseconds, or -1 if
+ * nothing is queued
+ */
+int manager_poll_measurements(ContextId id)
+{
+	Context *ctx = context_get_and_lock(id);
+	int ret = -1;
+
+	if (ctx) {
+		ret = manager_measurement_batch_due(ctx);
+
+		if (ret == 0) {
+			manager_flush_measurement_batch(ctx);
+			ret = -1;
+		}
+
+		context_unlock(ctx);
+	}
+
+	return ret;
+}
+
 /**
  * Return length of manager system id
  *
@@ -965,4 +1322,174 @@ DataList *manager_get_segment_info_data(ContextId id, int handle)
 	return list;
 }
 
+/**
+ * Exports entries of a transferred PM-Segment as columns, one array
+ * per entry time and attribute (format described in
+ * pmsegment_export.c)
+ *
+ * @param id context id
+ * @param handle PM-Store handle
+ * @param instnumber segment instance number
+ * @param size export size (output)
+ * @return export, freed by caller; NULL if segment is unknown
+ */
+intu8 *manager_export_segment_data(ContextId id, int handle, int instnumber,
+				   intu32 *size)
+{
+	intu8 *buffer = NULL;
+	Context *ctx = context_get_and_lock(id);
+
+	if (!ctx)
+		return NULL;
+
+	ByteStreamWriter *stream = pmstore_export_segment_columnar(ctx, handle,
+								   instnumber);
+	context_unlock(ctx);
+
+	if (stream) {
+		buffer = stream->buffer;
+		*size = stream->size;
+		del_byte_stream_writer(stream, 0);
+	}
+
+	return buffer;
+}
+
+/**
+ * Exports entries of a transferred PM-Segment as columns to a file
+ * (see manager_export_segment_data())
+ *
+ * @param id context id
+ * @param handle PM-Store handle
+ * @param instnumber segment instance number
+ * @param path file to be created
+ * @return 1 if successful, 0 otherwise
+ */
+int manager_export_segment_data_file(ContextId id, int handle, int instnumber,
+				     const char *path)
+{
+	int ok = 0;
+	FILE *file = fopen(path, "wb");
+
+	if (!file) {
+		ERROR("Unable to create %s", path);
+		return 0;
+	}
+
+	Context *ctx = context_get_and_lock(id);
+
+	if (ctx) {
+		ok = pmstore_export_segment_columnar_file(ctx, handle, instnumber,
+							  file);
+		context_unlock(ctx);
+	}
+
+	ok = (fclose(file) == 0) && ok;
+
+	if (!ok) {
+		remove(path);
+	}
+
+	return ok;
+}
+
+/**
+ * Returns PM-Store entries within a time range from segments already
+ * transferred, without asking the agent. Entries are in the same
+ * format as segment data events, one "PM-Segment" compound for each
+ * segment with entries in range.
+ *
+ * If transferred segments do not cover the range, NULL is returned
+ * and the application must use manager_request_get_segment_data().
+ *
+ * @param id context id
+ * @param handle PM-Store handle
+ * @param start range start, seconds since epoch (UTC)
+ * @param end range end, inclusive, seconds since epoch (UTC)
+ * @return entries, freed by caller; NULL if not available locally
+ */
+DataList *manager_get_segment_data_range(ContextId id, int handle,
+					 time_t start, time_t end)
+{
+	DataList *list = NULL;
+	Context *ctx = context_get_and_lock(id);
+
+	if (!ctx)
+		return NULL;
+
+	if (ctx->mds) {
+		pmstore_cache_query(ctx->mds, handle,
+				    (long long) start * 1000000,
+				    (long long) end * 1000000 + 999999, &list);
+	}
+
+	context_unlock(ctx);
+
+	return list;
+}
+
+/**
+ * Returns communication counters of the whole process, which
+ * include agent contexts if agent runs in the same process.
+ *
+ * @param stats counters snapshot (output)
+ */
+void manager_get_stats(CommunicationStats *stats)
+{
+	stats_get_global(stats);
+}
+
+/**
+ * Returns communication counters of a context
+ *
+ * @param id context id
+ * @param stats counters snapshot (output)
+ * @return 1 if context exists, 0 if not
+ */
+int manager_get_context_stats(ContextId id, CommunicationStats *stats)
+{
+	Context *ctx = context_get_and_lock(id);
+
+	if (!ctx)
+		return 0;
+
+	stats_get_context(ctx, stats);
+	context_unlock(ctx);
+
+	return 1;
+}
+
+/**
+ * Returns latency histogram of an operation for the whole process.
+ * Use stats_latency_percentile() to query percentiles.
+ *
+ * @param op operation (StatsOperation)
+ * @param hist histogram snapshot (output)
+ */
+void manager_get_latency(int op, LatencyHistogram *hist)
+{
+	stats_get_global_latency(op, hist);
+}
+
+/**
+ * Returns latency histogram of an operation performed by a context
+ *
+ * @param id context id
+ * @param op operation (StatsOperation)
+ * @param hist histogram snapshot (output)
+ * @return 1 if context exists, 0 if not
+ */
+int manager_get_context_latency(ContextId id, int op, LatencyHistogram *hist)
+{
+	Context *ctx = context_get_and_lock(id);
+
+	if (!ctx)
+		return 0;
+
+	stats_get_context_latency(ctx, op, hist);
+	context_unlock(ctx);
+
+	return 1;
+}
+
 /** @} */
@@ -38,6 +38,33 @@
 #include <communication/plugin/plugin.h>
 #include <communication/service.h>
 
+/**
+ * Observations a listener wants in measurement_data_updated. Zero
+ * fields (NULL system id) match anything.
+ */
+typedef struct ManagerSubscription {
+	/**
+	 * System id of device, 8 octets, or NULL for any device
+	 */
+	const intu8 *system_id;
+	/**
+	 * Object handle, or 0 for any object
+	 */
+	ASN1_HANDLE handle;
+	/**
+	 * Metric type partition, or 0 for any
+	 */
+	intu16 partition;
+	/**
+	 * Metric type code, or 0 for any
+	 */
+	intu16 code;
+	/**
+	 * Attribute id, or 0 for all attributes of matching objects
+	 */
+	OID_Type attribute;
+} ManagerSubscription;
+
 /**
  * Manager event listener definition
  */
@@ -72,6 +99,17 @@ typedef struct ManagerListener {
  	* Called when peer disconnects
  	*/
 	int (*device_disconnected)(Context *ctx, const char *addr);
+	/**
+	 * Observations wanted in measurement_data_updated, or NULL for
+	 * all of them. Copied by manager_add_listener(). Observations
+	 * no listener wants are not decoded at all, and MDS objects are
+	 * not updated with them.
+	 */
+	const ManagerSubscription *subscriptions;
+	/**
+	 * Number of subscriptions
+	 */
+	int subscription_count;
 } ManagerListener;
 
 #define MANAGER_LISTENER_EMPTY {\
@@ -81,13 +119,17 @@ typedef struct ManagerListener {
 			.device_disconnected = NULL,\
 			.device_available = NULL,\
 			.device_unavailable = NULL,\
-			.timeout = NULL\
+			.timeout = NULL,\
+			.subscriptions = NULL,\
+			.subscription_count = 0\
 			}
 
 void manager_init(CommunicationPlugin **plugins);
 
 void manager_finalize();
 
+int manager_reserve_contexts(int count);
+
 void manager_start();
 
 void manager_stop();
@@ -98,6 +140,8 @@ int manager_add_listener(ManagerListener listener);
 
 DataList *manager_get_mds_attributes(ContextId id);
 
+char *manager_get_mds_attributes_xml(ContextId id);
+
 Request *manager_request_measurement_data_transmission(ContextId id, service_request_callback callback);
 
 Request *manager_request_get_all_mds_attributes(ContextId id, service_request_callback callback);
@@ -124,10 +168,41 @@ Request *manager_set_time(ContextId id, time_t time, service_request_callback ca
 
 DataList *manager_get_configuration(ContextId id);
 
+char *manager_get_configuration_xml(ContextId id);
+
+intu8 *manager_export_segment_data(ContextId id, int handle, int instnumber,
+				   intu32 *size);
+
+int manager_export_segment_data_file(ContextId id, int handle, int instnumber,
+				     const char *path);
+
+DataList *manager_get_segment_data_range(ContextId id, int handle,
+					 time_t start, time_t end);
+
 void manager_request_association_release(ContextId id);
 
 void manager_request_association_abort(ContextId id);
 
 void manager_set_system_id(const intu8 *system_id, intu16 len);
 
+void manager_set_segment_spill_threshold(intu32 bytes);
+
+void manager_set_segment_cache_limit(intu32 entries);
+
+void manager_set_segment_delta_delivery(int enabled);
+
+void manager_set_measurement_batching(int max_reports, int window);
+
+int manager_flush_measurements(ContextId id);
+
+int manager_poll_measurements(ContextId id);
+
+void manager_get_stats(CommunicationStats *stats);
+
+int manager_get_context_stats(ContextId id, CommunicationStats *stats);
+
+void manager_get_latency(int op, LatencyHistogram *hist);
+
+int manager_get_context_latency(ContextId id, int op, LatencyHistogram *hist);
+
 #endif /* MANAGER_H_ */
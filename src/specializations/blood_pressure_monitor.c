@@ -387,6 +387,37 @@ static DATA_apdu *blood_pressure_populate_event_report(void *edata)
 
 	return data;
 }
+/**
+ * Writes the observed values of an event report, for templates
+ */
+static int blood_pressure_event_report_values(void *edata,
+					      ByteStreamWriter *stream)
+{
+	struct blood_pressure_event_report_data *evtdata = edata;
+	BasicNuObsValue pressure[3];
+	BasicNuObsValueCmp nu_pressure;
+	AbsoluteTime nu_time;
+
+	nu_time = date_util_create_absolute_time(evtdata->century * 100 + evtdata->year,
+						evtdata->month,
+						evtdata->day,
+						evtdata->hour,
+						evtdata->minute,
+						evtdata->second,
+						evtdata->sec_fractions);
+
+	pressure[0] = evtdata->systolic;
+	pressure[1] = evtdata->diastolic;
+	pressure[2] = evtdata->mean;
+	nu_pressure.count = 3;
+	nu_pressure.length = 6;
+	nu_pressure.value = pressure;
+
+	return encode_basicnuobsvaluecmp(stream, &nu_pressure)
+		&& encode_absolutetime(stream, &nu_time)
+		&& encode_basicnuobsvalue(stream, &evtdata->pulse_rate)
+		&& encode_absolutetime(stream, &nu_time);
+}
 
 /**
  *  Creates the standard configuration for <em>Blood Pressure Monitor</em> specialization (02BC).
@@ -403,6 +434,7 @@ struct StdConfiguration *blood_pressure_monitor_create_std_config_ID02BC()
 	result->dev_config_id = 0x02BC;
 	result->configure_action = &blood_pressure_monitor_get_config_ID02BC;
 	result->event_report = &blood_pressure_populate_event_report;
+	result->event_report_values = &blood_pressure_event_report_values;
 	return result;
 }
 
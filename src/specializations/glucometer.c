@@ -143,18 +143,18 @@ static DATA_apdu *glucometer_populate_event_report(void *edata)
 	data->invoke_id = 0xffff;
 
 	data->message.choice = ROIV_CMIP_CONFIRMED_EVENT_REPORT_CHOSEN;
-	data->message.length = 34;
+	data->message.length = 32;
 
 	evt.obj_handle = 0;
 	evt.event_time = 0xFFFFFFFF;
 	evt.event_type = MDC_NOTI_SCAN_REPORT_FIXED;
-	evt.event_info.length = 24;
+	evt.event_info.length = 22;
 
 	scan.data_req_id = 0xF000;
 	scan.scan_report_no = 0;
 
 	scan_fixed.count = 1;
-	scan_fixed.length = 16;
+	scan_fixed.length = 14;
 	scan_fixed.value = measure;
 
 	measure[0].obj_handle = 1;
@@ -184,6 +184,26 @@ static DATA_apdu *glucometer_populate_event_report(void *edata)
 	return data;
 }
 
+/**
+ * Writes the observed values of an event report, for templates
+ */
+static int glucometer_event_report_values(void *edata,
+					  ByteStreamWriter *stream)
+{
+	struct glucometer_event_report_data *evtdata = edata;
+	AbsoluteTime nu_time;
+
+	nu_time = date_util_create_absolute_time(evtdata->century * 100 + evtdata->year,
+						evtdata->month,
+						evtdata->day,
+						evtdata->hour,
+						evtdata->minute,
+						evtdata->second,
+						evtdata->sec_fractions);
+
+	return encode_basicnuobsvalue(stream, &evtdata->capillary_whole_blood)
+		&& encode_absolutetime(stream, &nu_time);
+}
 
 /**
  *  Creates the first standard configuration for <em>Glucometer</em> specialization (0x06A4).
@@ -195,10 +215,11 @@ static DATA_apdu *glucometer_populate_event_report(void *edata)
  */
 struct StdConfiguration *glucometer_create_std_config_ID06A4()
 {
-	struct StdConfiguration *result = malloc(sizeof(struct StdConfiguration));
+	struct StdConfiguration *result = calloc(1, sizeof(struct StdConfiguration));
 	result->dev_config_id = 0x06A4;
 	result->configure_action = &glucometer_get_config_ID06A4;
 	result->event_report = &glucometer_populate_event_report;
+	result->event_report_values = &glucometer_event_report_values;
 	return result;
 }
 
@@ -422,6 +422,28 @@ static DATA_apdu *pulse_oximeter_populate_event_report(void *edata)
 	return data;
 }
 
+/**
+ * Writes the observed values of an event report, for templates
+ */
+static int pulse_oximeter_event_report_values(void *edata,
+					      ByteStreamWriter *stream)
+{
+	struct oximeter_event_report_data *evtdata = edata;
+	AbsoluteTime nu_time;
+
+	nu_time = date_util_create_absolute_time(evtdata->century * 100 + evtdata->year,
+						evtdata->month,
+						evtdata->day,
+						evtdata->hour,
+						evtdata->minute,
+						evtdata->second,
+						evtdata->sec_fractions);
+
+	return encode_basicnuobsvalue(stream, &evtdata->oximetry)
+		&& encode_absolutetime(stream, &nu_time)
+		&& encode_basicnuobsvalue(stream, &evtdata->beats)
+		&& encode_absolutetime(stream, &nu_time);
+}
 
 /**
  *  Creates the first standard configuration for <em>Pulse Oximeter Monitor</em> specialization (0190).
@@ -433,10 +455,11 @@ static DATA_apdu *pulse_oximeter_populate_event_report(void *edata)
  */
 struct StdConfiguration *pulse_oximeter_create_std_config_ID0190()
 {
-	struct StdConfiguration *result = malloc(sizeof(struct StdConfiguration));
+	struct StdConfiguration *result = calloc(1, sizeof(struct StdConfiguration));
 	result->dev_config_id = 0x0190;
 	result->configure_action = &pulse_oximeter_get_config_ID0190;
 	result->event_report = &pulse_oximeter_populate_event_report;
+	result->event_report_values = &pulse_oximeter_event_report_values;
 	return result;
 }
 
@@ -450,10 +473,11 @@ struct StdConfiguration *pulse_oximeter_create_std_config_ID0190()
  */
 struct StdConfiguration *pulse_oximeter_create_std_config_ID0191()
 {
-	struct StdConfiguration *result = malloc(sizeof(struct StdConfiguration));
+	struct StdConfiguration *result = calloc(1, sizeof(struct StdConfiguration));
 	result->dev_config_id = 0x0191;
 	result->configure_action = &pulse_oximeter_get_config_ID0191;
 	result->event_report = &pulse_oximeter_populate_event_report;
+	result->event_report_values = &pulse_oximeter_event_report_values;
 	return result;
 }
 
@@ -254,6 +254,36 @@ static DATA_apdu *weight_scale_populate_event_report(void *edata)
 
 	return data;
 }
+/**
+ * Writes the observed values of an event report, for templates
+ */
+static int weight_scale_event_report_values(void *edata,
+					    ByteStreamWriter *stream)
+{
+	struct weightscale_event_report_data *evtdata = edata;
+	AbsoluteTime nu_time;
+	int i;
+
+	nu_time = date_util_create_absolute_time(evtdata->century * 100 + evtdata->year,
+						evtdata->month,
+						evtdata->day,
+						evtdata->hour,
+						evtdata->minute,
+						evtdata->second,
+						evtdata->sec_fractions);
+
+	// weight and BMI are reported twice, as in the regular report
+	for (i = 0; i < 2; ++i) {
+		if (!write_float(stream, evtdata->weight)
+		    || !encode_absolutetime(stream, &nu_time)
+		    || !write_float(stream, evtdata->bmi)
+		    || !encode_absolutetime(stream, &nu_time)) {
+			return 0;
+		}
+	}
+
+	return 1;
+}
 
 /**
  *  Creates the standard configuration for <em>Weighing Scale</em> specialization (05DC).
@@ -265,11 +295,12 @@ static DATA_apdu *weight_scale_populate_event_report(void *edata)
  */
 struct StdConfiguration *weighting_scale_create_std_config_ID05DC()
 {
-	struct StdConfiguration *result = malloc(
+	struct StdConfiguration *result = calloc(1,
 			sizeof(struct StdConfiguration));
 	result->dev_config_id = 0x05DC;
 	result->configure_action = &weighting_scale_get_config_ID05DC;
 	result->event_report = &weight_scale_populate_event_report;
+	result->event_report_values = &weight_scale_event_report_values;
 	return result;
 }
 
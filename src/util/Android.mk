@@ -6,9 +6,14 @@ LOCAL_CFLAGS:= -Wall
 LOCAL_C_INCLUDES := $(LOCAL_PATH) $(LOCAL_PATH)/.. $(LOCAL_PATH)/../..
 
 LOCAL_SRC_FILES = bytelib.c \
+                    checksum.c \
                     dateutil.c \
                     ioutil.c \
+                    journal.c \
                     linkedlist.c \
+                    pool.c \
+                    ringbuff.c \
+                    spillbuff.c \
                     strbuff.c
 
 LOCAL_MODULE:= libantidoteutil
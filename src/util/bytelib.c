@@ -182,6 +182,28 @@ void read_intu8_many(ByteStreamReader *stream, intu8 *buf, int len, int *error)
 	}
 }
 
+/**
+ * Consumes a number of bytes from data, without reading them.
+ *
+ * @param stream The current ByteStreamReader.
+ * @param len The exact number of bytes that are to be consumed
+ * @param error A reference to a boolean to hold the error code.
+ */
+void read_skip(ByteStreamReader *stream, int len, int *error)
+{
+	if (stream && stream->unread_bytes >= (unsigned) len) {
+		stream->buffer_cur += len;
+		stream->unread_bytes -= len;
+	} else {
+		if (error) {
+			*error = 1;
+		}
+
+		ERROR("read_skip")
+		;
+	}
+}
+
 /**
  * Consumes an intu16 from data, rearranging it to the proper endianism.
  *
@@ -82,6 +82,8 @@ intu8 read_intu8(ByteStreamReader *stream, int *error);
 
 void read_intu8_many(ByteStreamReader *stream, intu8 *buf, int len, int *error);
 
+void read_skip(ByteStreamReader *stream, int len, int *error);
+
 intu16 read_intu16(ByteStreamReader *stream, int *error);
 
 intu32 read_intu32(ByteStreamReader *stream, int *error);
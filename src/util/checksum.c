@@ -0,0 +1,82 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+/**
+ * \file checksum.c
+ * \brief Checksums and hashes.
+ *
+ * Copyright (C) 2010 Signove Tecnologia Corporation.
+ * All rights reserved.
+ * Contact: Signove Tecnologia Corporation (contact@signove.com)
+ *
+ * $LICENSE_TEXT:BEGIN$
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation and appearing
+ * in the file LICENSE included in the packaging of this file; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ * $LICENSE_TEXT:END$
+ *
+ * \date Oct 18, 2026
+ */
+
+#include "src/util/checksum.h"
+
+/**
+ * Computes CRC-32 (IEEE 802.3) of a memory block, used to detect
+ * damaged records in files. Start with crc 0; a running CRC may be
+ * passed again to continue over the next block.
+ *
+ * @param crc CRC of previous blocks, or 0
+ * @param data memory block
+ * @param length block length in bytes
+ * @return CRC of the blocks
+ */
+intu32 checksum_crc32(intu32 crc, const void *data, intu32 length)
+{
+	const intu8 *bytes = data;
+	intu32 i;
+	int bit;
+
+	crc = ~crc;
+
+	for (i = 0; i < length; ++i) {
+		crc ^= bytes[i];
+
+		for (bit = 0; bit < 8; ++bit) {
+			crc = (crc >> 1) ^ (0xEDB88320U & -(crc & 1));
+		}
+	}
+
+	return ~crc;
+}
+
+/**
+ * Computes the FNV-1a hash of a memory block, used to index tables.
+ * Start with CHECKSUM_FNV1A_INIT; a running hash may be passed again
+ * to continue over the next block.
+ *
+ * @param hash hash of previous blocks, or CHECKSUM_FNV1A_INIT
+ * @param data memory block
+ * @param length block length in bytes
+ * @return hash of the blocks
+ */
+intu32 checksum_fnv1a(intu32 hash, const void *data, intu32 length)
+{
+	const intu8 *bytes = data;
+	intu32 i;
+
+	for (i = 0; i < length; ++i) {
+		hash ^= bytes[i];
+		hash *= 0x01000193U;
+	}
+
+	return hash;
+}
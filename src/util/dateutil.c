@@ -199,4 +199,40 @@ int date_util_compare_absolute_time(AbsoluteTime time_1, AbsoluteTime time_2)
 	return 0;
 }
 
+/**
+ *  Converts an AbsoluteTime to microseconds since 1970-01-01, taking
+ *  its fields as UTC (agents do not report time zone).
+ *
+ *  \param time the AbsoluteTime
+ *
+ *  \return microseconds since epoch, or DATE_UTIL_INVALID_TIME if the
+ *  date is not valid
+ */
+long long date_util_absolute_time_to_epoch_us(AbsoluteTime time)
+{
+	int year = date_util_convert_bcd_to_number(time.century) * 100
+		   + date_util_convert_bcd_to_number(time.year);
+	int month = date_util_convert_bcd_to_number(time.month);
+	int day = date_util_convert_bcd_to_number(time.day);
+
+	if (month < 1 || month > 12 || day < 1 || day > 31) {
+		return DATE_UTIL_INVALID_TIME;
+	}
+
+	// days since 1970-01-01 of a proleptic Gregorian date
+	year -= month <= 2;
+	int era = (year >= 0 ? year : year - 399) / 400;
+	int year_of_era = year - era * 400;
+	int day_of_year = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+	int day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100
+			 + day_of_year;
+	long long days = (long long) era * 146097 + day_of_era - 719468;
+
+	return ((days * 86400
+		 + date_util_convert_bcd_to_number(time.hour) * 3600
+		 + date_util_convert_bcd_to_number(time.minute) * 60
+		 + date_util_convert_bcd_to_number(time.second)) * 100
+		+ date_util_convert_bcd_to_number(time.sec_fractions)) * 10000;
+}
+
 /*! @} */
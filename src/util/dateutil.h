@@ -44,4 +44,11 @@ AbsoluteTime date_util_create_absolute_time_t(time_t time);
 intu8 date_util_convert_number_to_bcd(int value);
 int date_util_convert_bcd_to_number(intu8 field);
 
+/**
+ * Returned by date_util_absolute_time_to_epoch_us() for invalid dates
+ */
+#define DATE_UTIL_INVALID_TIME ((long long) 0x8000000000000000ULL)
+
+long long date_util_absolute_time_to_epoch_us(AbsoluteTime time);
+
 #endif /* DATAUTIL_H_ */
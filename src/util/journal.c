@@ -0,0 +1,1151 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+/**
+ * \file journal.c
+ * \brief Append-only journal of typed records in memory-mapped segments.
+ *
+ * Copyright (C) 2010 Signove Tecnologia Corporation.
+ * All rights reserved.
+ * Contact: Signove Tecnologia Corporation (contact@signove.com)
+ *
+ * $LICENSE_TEXT:BEGIN$
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation and appearing
+ * in the file LICENSE included in the packaging of this file; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ * $LICENSE_TEXT:END$
+ *
+ * \date Oct 18, 2026
+ */
+
+/**
+ * \addtogroup Utility
+ *
+ * Journal keeps records for consumers that may be slow or away. Records
+ * are appended to fixed-size segment files mapped in memory, so writing
+ * is sequential and buffered records live in page cache rather than in
+ * process memory. A full segment is closed and a new one started; the
+ * oldest segments are removed beyond a maximum count, which bounds disk
+ * usage.
+ *
+ * Each consumer has a cursor, the last record it got. Cursors are saved
+ * on journal_sync(), together with the records written since previous
+ * sync, so after a crash consumers get every record at least once.
+ *
+ * A record a consumer cannot take yet, while it takes the following
+ * ones (e.g. its device is away), is deferred: it is appended again,
+ * marked as deferred for that consumer, and the cursor moves on.
+ * Deferred records are skipped by journal_replay() and retried by
+ * journal_retry_deferred().
+ *
+ * @{
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "journal.h"
+#include "checksum.h"
+#include "log.h"
+
+/**
+ * Record header, as laid out in segment files
+ */
+typedef struct JournalRecord {
+	/**
+	 * Payload length, payload follows the header
+	 */
+	intu32 length;
+
+	/**
+	 * Record type
+	 */
+	intu16 type;
+
+	/**
+	 * Zero, or JOURNAL_RECORD_DEFERRED plus consumer id
+	 */
+	intu16 deferred;
+
+	/**
+	 * Sequence number, one more than previous record
+	 */
+	unsigned long long seq;
+
+	/**
+	 * CRC-32 of header (with this field zeroed) and payload
+	 */
+	intu32 crc;
+
+	/**
+	 * Unused, zero
+	 */
+	intu32 padding;
+} JournalRecord;
+
+/**
+ * Segment file, mapped in memory
+ */
+typedef struct JournalSegment {
+	/**
+	 * Sequence number of first record, also in file name
+	 */
+	unsigned long long first_seq;
+
+	/**
+	 * Sequence number of last record, first_seq - 1 if empty
+	 */
+	unsigned long long last_seq;
+
+	/**
+	 * File mapping
+	 */
+	intu8 *map;
+
+	/**
+	 * File size
+	 */
+	intu32 size;
+
+	/**
+	 * Bytes taken by records
+	 */
+	intu32 used;
+
+	/**
+	 * Bytes already flushed to disk
+	 */
+	intu32 synced;
+
+	/**
+	 * File path
+	 */
+	char *path;
+} JournalSegment;
+
+/**
+ * Consumer of journal records
+ */
+typedef struct JournalConsumer {
+	/**
+	 * Name, also of cursor file
+	 */
+	char *name;
+
+	/**
+	 * Sequence number of last delivered record
+	 */
+	unsigned long long cursor;
+
+	/**
+	 * Cursor value in file
+	 */
+	unsigned long long saved;
+
+	/**
+	 * Segment (first_seq) where replay stopped, 0 if none
+	 */
+	unsigned long long hint_segment;
+
+	/**
+	 * Offset in that segment of record after cursor
+	 */
+	intu32 hint_offset;
+
+	/**
+	 * Records deferred for consumer and not retried yet are at this
+	 * sequence number or later
+	 */
+	unsigned long long deferred_from;
+
+	/**
+	 * deferred_from value in file
+	 */
+	unsigned long long deferred_saved;
+} JournalConsumer;
+
+/**
+ * Copy of a record being deferred
+ */
+typedef struct JournalDeferred {
+	intu16 type;
+	intu32 length;
+	intu8 *data;
+} JournalDeferred;
+
+/**
+ * Records deferred during a replay, appended when it ends
+ */
+typedef struct JournalDeferList {
+	JournalDeferred *records;
+	int count;
+	intu32 bytes;
+} JournalDeferList;
+
+/**
+ * Journal
+ */
+struct Journal {
+	/**
+	 * Directory of segment and cursor files
+	 */
+	char *dir;
+
+	/**
+	 * Size of new segments
+	 */
+	intu32 segment_size;
+
+	/**
+	 * Number of segments kept
+	 */
+	int max_segments;
+
+	/**
+	 * Segments, oldest first
+	 */
+	JournalSegment *segments;
+
+	/**
+	 * Number of segments
+	 */
+	int segment_count;
+
+	/**
+	 * Sequence number of next record
+	 */
+	unsigned long long next_seq;
+
+	/**
+	 * Records between automatic syncs, 0 for explicit sync only
+	 */
+	int sync_batch;
+
+	/**
+	 * Records appended since last sync
+	 */
+	int unsynced;
+
+	/**
+	 * Consumers
+	 */
+	JournalConsumer consumers[JOURNAL_MAX_CONSUMERS];
+
+	/**
+	 * Number of consumers
+	 */
+	int consumer_count;
+
+	/**
+	 * Lock file, held while journal is open
+	 */
+	int lock_fd;
+};
+
+/**
+ * Marks a record deferred for the consumer id in lower bits
+ */
+#define JOURNAL_RECORD_DEFERRED 0x8000
+
+/**
+ * Space taken by a record, records are 8-byte aligned
+ */
+static intu32 journal_record_size(intu32 length)
+{
+	return (sizeof(JournalRecord) + length + 7) & ~7U;
+}
+
+/**
+ * Computes record CRC
+ */
+static intu32 journal_record_crc(const JournalRecord *record)
+{
+	JournalRecord header = *record;
+	intu32 crc;
+
+	header.crc = 0;
+	crc = checksum_crc32(0, &header, sizeof(header));
+	return checksum_crc32(crc, (const intu8 *) (record + 1),
+			      record->length);
+}
+
+/**
+ * Builds path of a file in journal directory
+ */
+static char *journal_path(Journal *journal, const char *name)
+{
+	char *path = malloc(strlen(journal->dir) + strlen(name) + 2);
+
+	sprintf(path, "%s/%s", journal->dir, name);
+	return path;
+}
+
+/**
+ * Builds path of a segment file
+ */
+static char *journal_segment_path(Journal *journal, unsigned long long first_seq)
+{
+	char name[32];
+
+	snprintf(name, sizeof(name), "journal-%016llx.seg",
+		 first_seq);
+	return journal_path(journal, name);
+}
+
+/**
+ * Maps a segment file and finds its valid records. Records past the
+ * first damaged or missing one (e.g. torn by a crash) are ignored, and
+ * overwritten by next appends.
+ *
+ * @return 1 if successful, 0 otherwise
+ */
+static int journal_segment_load(JournalSegment *segment)
+{
+	struct stat st;
+	int fd = open(segment->path, O_RDWR);
+
+	if (fd < 0) {
+		ERROR("journal: cannot open %s: %d", segment->path, errno);
+		return 0;
+	}
+
+	if (fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(JournalRecord)
+	    || st.st_size > 0x7fffffff) {
+		ERROR("journal: bad segment %s", segment->path);
+		close(fd);
+		return 0;
+	}
+
+	segment->size = st.st_size;
+	segment->map = mmap(NULL, segment->size, PROT_READ | PROT_WRITE,
+			    MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (segment->map == MAP_FAILED) {
+		ERROR("journal: cannot map %s: %d", segment->path, errno);
+		segment->map = NULL;
+		return 0;
+	}
+
+	segment->last_seq = segment->first_seq - 1;
+	segment->used = 0;
+
+	while (segment->size - segment->used >= sizeof(JournalRecord)) {
+		JournalRecord *record = (JournalRecord *)
+					(segment->map + segment->used);
+
+		if (record->seq != segment->last_seq + 1
+		    || record->length > segment->size - segment->used
+					- sizeof(JournalRecord)
+		    || record->crc != journal_record_crc(record)) {
+			break;
+		}
+
+		segment->last_seq = record->seq;
+		segment->used += journal_record_size(record->length);
+
+		if (segment->used > segment->size) {
+			segment->used = segment->size;
+		}
+	}
+
+	segment->synced = segment->used;
+
+	return 1;
+}
+
+/**
+ * Unmaps a segment and frees its path
+ */
+static void journal_segment_unload(JournalSegment *segment)
+{
+	if (segment->map != NULL) {
+		munmap(segment->map, segment->size);
+	}
+
+	free(segment->path);
+	segment->map = NULL;
+	segment->path = NULL;
+}
+
+/**
+ * Compares sequence numbers, for qsort()
+ */
+static int journal_seq_cmp(const void *a, const void *b)
+{
+	unsigned long long x = *(const unsigned long long *) a;
+	unsigned long long y = *(const unsigned long long *) b;
+
+	return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+/**
+ * Finds and loads segment files in journal directory
+ *
+ * @return 1 if successful, 0 otherwise
+ */
+static int journal_scan(Journal *journal)
+{
+	DIR *d = opendir(journal->dir);
+	struct dirent *entry;
+	unsigned long long *seqs = NULL;
+	int count = 0;
+	int i;
+
+	if (d == NULL) {
+		ERROR("journal: cannot read %s: %d", journal->dir, errno);
+		return 0;
+	}
+
+	while ((entry = readdir(d)) != NULL) {
+		unsigned long long seq;
+		char tail[8];
+
+		if (strlen(entry->d_name) != 28
+		    || sscanf(entry->d_name, "journal-%16llx%4s", &seq, tail) != 2
+		    || strcmp(tail, ".seg") != 0 || seq == 0) {
+			continue;
+		}
+
+		seqs = realloc(seqs, (count + 1) * sizeof(unsigned long long));
+		seqs[count++] = seq;
+	}
+
+	closedir(d);
+
+	if (count == 0) {
+		return 1;
+	}
+
+	qsort(seqs, count, sizeof(unsigned long long), journal_seq_cmp);
+	journal->segments = calloc(count, sizeof(JournalSegment));
+
+	for (i = 0; i < count; ++i) {
+		JournalSegment *segment;
+
+		segment = &journal->segments[journal->segment_count];
+		segment->first_seq = seqs[i];
+		segment->path = journal_segment_path(journal, seqs[i]);
+
+		if (!journal_segment_load(segment)) {
+			journal_segment_unload(segment);
+			continue;
+		}
+
+		++journal->segment_count;
+	}
+
+	free(seqs);
+
+	return 1;
+}
+
+/**
+ * Locks journal directory, so that no other process uses it meanwhile
+ *
+ * @return 1 if successful, 0 if directory is in use or cannot be locked
+ */
+static int journal_lock(Journal *journal)
+{
+	char *path = journal_path(journal, "lock");
+
+	journal->lock_fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+
+	if (journal->lock_fd < 0) {
+		ERROR("journal: cannot open %s: %d", path, errno);
+		free(path);
+		return 0;
+	}
+
+	if (flock(journal->lock_fd, LOCK_EX | LOCK_NB) != 0) {
+		ERROR("journal: %s is in use by another process", journal->dir);
+		close(journal->lock_fd);
+		free(path);
+		return 0;
+	}
+
+	free(path);
+	return 1;
+}
+
+/**
+ * Opens a journal, creating its directory if needed. Records left by a
+ * previous run are kept, and delivered to consumers that did not get
+ * them yet.
+ *
+ * @param dir directory of journal files
+ * @param segment_size size of segment files, 0 for default
+ * @param max_segments segments kept on disk, 0 for default
+ * @return journal, or NULL if directory cannot be used or is in use
+ */
+Journal *journal_open(const char *dir, intu32 segment_size, int max_segments)
+{
+	Journal *journal;
+
+	if (mkdir(dir, 0700) != 0 && errno != EEXIST) {
+		ERROR("journal: cannot create %s: %d", dir, errno);
+		return NULL;
+	}
+
+	journal = calloc(1, sizeof(Journal));
+	journal->dir = strdup(dir);
+
+	if (!journal_lock(journal)) {
+		free(journal->dir);
+		free(journal);
+		return NULL;
+	}
+
+	journal->segment_size = segment_size ? segment_size
+				: JOURNAL_DEFAULT_SEGMENT_SIZE;
+	journal->max_segments = max_segments > 0 ? max_segments
+				: JOURNAL_DEFAULT_MAX_SEGMENTS;
+
+	if (!journal_scan(journal)) {
+		close(journal->lock_fd);
+		free(journal->dir);
+		free(journal);
+		return NULL;
+	}
+
+	journal->next_seq = 1;
+
+	if (journal->segment_count > 0) {
+		JournalSegment *last;
+
+		last = &journal->segments[journal->segment_count - 1];
+		journal->next_seq = last->last_seq + 1;
+	}
+
+	DEBUG("journal: %s, %d segments, next record %llu", dir,
+	      journal->segment_count, journal->next_seq);
+
+	return journal;
+}
+
+/**
+ * Syncs and closes a journal. Files are kept for next journal_open().
+ *
+ * @param journal the journal
+ */
+void journal_close(Journal *journal)
+{
+	int i;
+
+	if (journal == NULL) {
+		return;
+	}
+
+	journal_sync(journal);
+
+	for (i = 0; i < journal->segment_count; ++i) {
+		journal_segment_unload(&journal->segments[i]);
+	}
+
+	for (i = 0; i < journal->consumer_count; ++i) {
+		free(journal->consumers[i].name);
+	}
+
+	free(journal->segments);
+	free(journal->dir);
+	// releases lock
+	close(journal->lock_fd);
+	free(journal);
+}
+
+/**
+ * Removes oldest segment, and its records
+ */
+static void journal_drop_oldest(Journal *journal)
+{
+	JournalSegment *oldest = &journal->segments[0];
+
+	DEBUG("journal: removing records %llu to %llu", oldest->first_seq,
+	      oldest->last_seq);
+
+	unlink(oldest->path);
+	journal_segment_unload(oldest);
+
+	--journal->segment_count;
+	memmove(journal->segments, journal->segments + 1,
+		journal->segment_count * sizeof(JournalSegment));
+}
+
+/**
+ * Starts a new segment, large enough for a record of given size
+ *
+ * @return 1 if successful, 0 otherwise
+ */
+static int journal_rotate(Journal *journal, intu32 record_size)
+{
+	JournalSegment segment;
+	JournalSegment *grown;
+	int fd;
+
+	memset(&segment, 0, sizeof(segment));
+	segment.first_seq = journal->next_seq;
+	segment.last_seq = journal->next_seq - 1;
+	segment.size = journal->segment_size;
+
+	if (segment.size < record_size) {
+		segment.size = record_size;
+	}
+
+	segment.path = journal_segment_path(journal, segment.first_seq);
+	fd = open(segment.path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+
+	if (fd < 0) {
+		ERROR("journal: cannot create %s: %d", segment.path, errno);
+		free(segment.path);
+		return 0;
+	}
+
+	// file is sparse until written
+	if (ftruncate(fd, segment.size) != 0) {
+		ERROR("journal: cannot grow %s: %d", segment.path, errno);
+		close(fd);
+		unlink(segment.path);
+		free(segment.path);
+		return 0;
+	}
+
+	segment.map = mmap(NULL, segment.size, PROT_READ | PROT_WRITE,
+			   MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (segment.map == MAP_FAILED) {
+		ERROR("journal: cannot map %s: %d", segment.path, errno);
+		unlink(segment.path);
+		free(segment.path);
+		return 0;
+	}
+
+	grown = realloc(journal->segments,
+			(journal->segment_count + 1) * sizeof(JournalSegment));
+
+	if (grown == NULL) {
+		munmap(segment.map, segment.size);
+		unlink(segment.path);
+		free(segment.path);
+		return 0;
+	}
+
+	journal->segments = grown;
+	journal->segments[journal->segment_count++] = segment;
+
+	while (journal->segment_count > journal->max_segments) {
+		journal_drop_oldest(journal);
+	}
+
+	return 1;
+}
+
+/**
+ * Appends a record, possibly marked as deferred
+ *
+ * @return 1 if successful, 0 otherwise
+ */
+static int journal_append_record(Journal *journal, intu16 type,
+				 intu16 deferred, const intu8 *data,
+				 intu32 length, unsigned long long *seq)
+{
+	intu32 size = journal_record_size(length);
+	JournalSegment *segment = NULL;
+	JournalRecord *record;
+
+	if (size < length) {
+		return 0;
+	}
+
+	if (journal->segment_count > 0) {
+		segment = &journal->segments[journal->segment_count - 1];
+	}
+
+	if (segment == NULL || segment->size - segment->used < size) {
+		if (!journal_rotate(journal, size)) {
+			return 0;
+		}
+
+		segment = &journal->segments[journal->segment_count - 1];
+	}
+
+	record = (JournalRecord *) (segment->map + segment->used);
+	record->length = length;
+	record->type = type;
+	record->deferred = deferred;
+	record->seq = journal->next_seq;
+	record->padding = 0;
+	memcpy(record + 1, data, length);
+	record->crc = journal_record_crc(record);
+
+	segment->used += size;
+	segment->last_seq = journal->next_seq;
+
+	if (seq != NULL) {
+		*seq = journal->next_seq;
+	}
+
+	++journal->next_seq;
+
+	if (journal->sync_batch > 0
+	    && ++journal->unsynced >= journal->sync_batch) {
+		journal_sync(journal);
+	}
+
+	return 1;
+}
+
+/**
+ * Appends a record to journal. Record is flushed to disk by next
+ * journal_sync(), which is called automatically every few records if
+ * set by journal_set_sync_batch().
+ *
+ * @param journal the journal
+ * @param type record type, opaque to journal
+ * @param data payload
+ * @param length payload length
+ * @param seq if not NULL, filled with sequence number of record
+ * @return 1 if successful, 0 otherwise
+ */
+int journal_append(Journal *journal, intu16 type, const intu8 *data,
+		   intu32 length, unsigned long long *seq)
+{
+	return journal_append_record(journal, type, 0, data, length, seq);
+}
+
+/**
+ * Sets how many appended records trigger a journal_sync(). Syncing in
+ * batches trades durability of last records for write throughput.
+ *
+ * @param journal the journal
+ * @param records records between syncs, 0 to sync on explicit call only
+ */
+void journal_set_sync_batch(Journal *journal, int records)
+{
+	journal->sync_batch = records;
+}
+
+/**
+ * Writes a consumer cursor to its file, replaced atomically
+ *
+ * @return 1 if successful, 0 otherwise
+ */
+static int journal_save_cursor(Journal *journal, JournalConsumer *consumer)
+{
+	char name[80];
+	char *path;
+	char *tmp_path;
+	FILE *f;
+	int ok;
+
+	snprintf(name, sizeof(name), "%s.cursor", consumer->name);
+	path = journal_path(journal, name);
+	tmp_path = malloc(strlen(path) + 5);
+	sprintf(tmp_path, "%s.tmp", path);
+
+	f = fopen(tmp_path, "w");
+	ok = f != NULL;
+
+	if (ok) {
+		ok = fprintf(f, "%llu %llu\n", consumer->cursor,
+			     consumer->deferred_from) > 0;
+		ok = fflush(f) == 0 && ok;
+		ok = fsync(fileno(f)) == 0 && ok;
+		ok = fclose(f) == 0 && ok;
+	}
+
+	if (ok) {
+		ok = rename(tmp_path, path) == 0;
+	}
+
+	if (ok) {
+		consumer->saved = consumer->cursor;
+		consumer->deferred_saved = consumer->deferred_from;
+	} else {
+		ERROR("journal: cannot save cursor %s: %d", path, errno);
+	}
+
+	free(tmp_path);
+	free(path);
+
+	return ok;
+}
+
+/**
+ * Flushes appended records and consumer cursors to disk
+ *
+ * @param journal the journal
+ * @return 1 if successful, 0 otherwise
+ */
+int journal_sync(Journal *journal)
+{
+	long page = sysconf(_SC_PAGESIZE);
+	int ok = 1;
+	int i;
+
+	for (i = 0; i < journal->segment_count; ++i) {
+		JournalSegment *segment = &journal->segments[i];
+		intu32 start = segment->synced & ~((intu32) page - 1);
+
+		if (segment->synced >= segment->used) {
+			continue;
+		}
+
+		if (msync(segment->map + start, segment->used - start,
+			  MS_SYNC) != 0) {
+			ERROR("journal: cannot sync %s: %d", segment->path,
+			      errno);
+			ok = 0;
+			continue;
+		}
+
+		segment->synced = segment->used;
+	}
+
+	for (i = 0; i < journal->consumer_count; ++i) {
+		JournalConsumer *consumer = &journal->consumers[i];
+
+		if (consumer->cursor != consumer->saved
+		    || consumer->deferred_from != consumer->deferred_saved) {
+			ok = journal_save_cursor(journal, consumer) && ok;
+		}
+	}
+
+	journal->unsynced = 0;
+
+	return ok;
+}
+
+/**
+ * Adds a consumer, whose cursor is loaded from a previous run if any.
+ * New consumers get every record kept in journal.
+ *
+ * @param journal the journal
+ * @param name consumer name, a plain file name
+ * @return consumer id, or -1 if name is invalid or there are too many
+ */
+int journal_add_consumer(Journal *journal, const char *name)
+{
+	JournalConsumer *consumer;
+	unsigned long long cursor = 0;
+	unsigned long long deferred_from = journal->next_seq;
+	char file_name[80];
+	char *path;
+	FILE *f;
+	int i;
+
+	if (strchr(name, '/') != NULL || strlen(name) == 0
+	    || strlen(name) > 64) {
+		return -1;
+	}
+
+	for (i = 0; i < journal->consumer_count; ++i) {
+		if (strcmp(journal->consumers[i].name, name) == 0) {
+			return i;
+		}
+	}
+
+	if (journal->consumer_count >= JOURNAL_MAX_CONSUMERS) {
+		return -1;
+	}
+
+	snprintf(file_name, sizeof(file_name), "%s.cursor", name);
+	path = journal_path(journal, file_name);
+	f = fopen(path, "r");
+
+	if (f != NULL) {
+		int n = fscanf(f, "%llu %llu", &cursor, &deferred_from);
+
+		if (n < 1) {
+			cursor = 0;
+		}
+
+		if (n < 2) {
+			deferred_from = journal->next_seq;
+		}
+
+		fclose(f);
+	}
+
+	free(path);
+
+	if (cursor >= journal->next_seq) {
+		// journal was removed behind the cursor
+		cursor = journal->next_seq - 1;
+	}
+
+	if (deferred_from > journal->next_seq) {
+		deferred_from = journal->next_seq;
+	}
+
+	consumer = &journal->consumers[journal->consumer_count];
+	memset(consumer, 0, sizeof(JournalConsumer));
+	consumer->name = strdup(name);
+	consumer->cursor = cursor;
+	consumer->saved = cursor;
+	consumer->deferred_from = deferred_from;
+	consumer->deferred_saved = deferred_from;
+
+	return journal->consumer_count++;
+}
+
+/**
+ * Keeps a copy of a record to be deferred
+ *
+ * @return 1 if successful, 0 otherwise
+ */
+static int journal_defer_add(JournalDeferList *list,
+			     const JournalRecord *record)
+{
+	JournalDeferred *grown;
+	JournalDeferred *copy;
+
+	grown = realloc(list->records,
+			(list->count + 1) * sizeof(JournalDeferred));
+
+	if (grown == NULL) {
+		return 0;
+	}
+
+	list->records = grown;
+	copy = &list->records[list->count];
+	copy->data = malloc(record->length ? record->length : 1);
+
+	if (copy->data == NULL) {
+		return 0;
+	}
+
+	copy->type = record->type;
+	copy->length = record->length;
+	memcpy(copy->data, record + 1, record->length);
+	list->bytes += record->length;
+	++list->count;
+
+	return 1;
+}
+
+/**
+ * Appends deferred records again, marked for consumer, and frees list
+ */
+static void journal_defer_flush(Journal *journal, int consumer_id,
+				JournalDeferList *list)
+{
+	int i;
+
+	for (i = 0; i < list->count; ++i) {
+		JournalDeferred *copy = &list->records[i];
+
+		if (!journal_append_record(journal, copy->type,
+					   JOURNAL_RECORD_DEFERRED | consumer_id,
+					   copy->data, copy->length, NULL)) {
+			ERROR("journal: %s lost deferred record",
+			      journal->consumers[consumer_id].name);
+		}
+
+		free(copy->data);
+	}
+
+	free(list->records);
+	memset(list, 0, sizeof(*list));
+}
+
+/**
+ * Walks records of a consumer from a sequence number on, up to the
+ * last one at call time, handing them to deliver callback. Records
+ * deferred by callback are appended again once the walk ends; a walk
+ * stops early when they take a segment worth of memory.
+ *
+ * @param from first sequence number
+ * @param deferred 1 to walk records deferred for consumer, 0 to walk
+ * the other ones
+ * @param stop filled with sequence number walk stopped at, 0 if it
+ * got to the end
+ * @return number of records delivered
+ */
+static int journal_walk(Journal *journal, int consumer_id,
+			unsigned long long from, int deferred,
+			journal_deliver_cb deliver, void *arg,
+			unsigned long long *stop)
+{
+	JournalConsumer *consumer = &journal->consumers[consumer_id];
+	JournalDeferList list = {NULL, 0, 0};
+	unsigned long long last = journal->next_seq - 1;
+	int delivered = 0;
+	int i;
+
+	*stop = 0;
+
+	for (i = 0; i < journal->segment_count && !*stop; ++i) {
+		JournalSegment *segment = &journal->segments[i];
+		intu32 offset = 0;
+
+		if (segment->last_seq < from) {
+			continue;
+		}
+
+		if (!deferred && consumer->hint_segment == segment->first_seq) {
+			offset = consumer->hint_offset;
+		}
+
+		while (offset < segment->used && !*stop) {
+			JournalRecord *record = (JournalRecord *)
+						(segment->map + offset);
+			int mine = record->deferred
+				   == (JOURNAL_RECORD_DEFERRED | consumer_id);
+			int ret = JOURNAL_DELIVERED;
+
+			if (record->seq > last) {
+				*stop = record->seq;
+				break;
+			}
+
+			if (record->seq >= from
+			    && (deferred ? mine : !record->deferred)) {
+				if (list.bytes >= journal->segment_size) {
+					*stop = record->seq;
+					break;
+				}
+
+				ret = deliver(record->type, record->seq,
+					      (const intu8 *) (record + 1),
+					      record->length, arg);
+
+				if (ret == JOURNAL_DEFER
+				    && !journal_defer_add(&list, record)) {
+					ret = JOURNAL_STOP;
+				}
+
+				if (ret == JOURNAL_STOP) {
+					*stop = record->seq;
+					break;
+				}
+
+				if (ret != JOURNAL_DEFER) {
+					++delivered;
+				}
+			}
+
+			if (!deferred && record->seq > consumer->cursor) {
+				consumer->cursor = record->seq;
+			}
+
+			offset += journal_record_size(record->length);
+		}
+
+		if (!deferred) {
+			consumer->hint_segment = segment->first_seq;
+			consumer->hint_offset = offset;
+		}
+	}
+
+	journal_defer_flush(journal, consumer_id, &list);
+
+	return delivered;
+}
+
+/**
+ * Delivers records a consumer did not get yet, oldest first, until
+ * deliver callback refuses one. Records the callback defers are kept
+ * for journal_retry_deferred(), and do not hold the following ones.
+ *
+ * @param journal the journal
+ * @param consumer_id consumer id
+ * @param deliver delivery callback
+ * @param arg argument of callback
+ * @return number of records delivered
+ */
+int journal_replay(Journal *journal, int consumer_id, journal_deliver_cb deliver,
+		   void *arg)
+{
+	JournalConsumer *consumer = &journal->consumers[consumer_id];
+	unsigned long long stop;
+
+	if (journal->segment_count > 0
+	    && consumer->cursor + 1 < journal->segments[0].first_seq) {
+		ERROR("journal: %s lost records %llu to %llu", consumer->name,
+		      consumer->cursor + 1, journal->segments[0].first_seq - 1);
+		consumer->cursor = journal->segments[0].first_seq - 1;
+	}
+
+	return journal_walk(journal, consumer_id, consumer->cursor + 1, 0,
+			    deliver, arg, &stop);
+}
+
+/**
+ * Delivers records deferred for a consumer, oldest first, until
+ * deliver callback refuses one. Records deferred again are kept for
+ * next retry. Should be called when some deferred record may be
+ * taken now.
+ *
+ * @param journal the journal
+ * @param consumer_id consumer id
+ * @param deliver delivery callback
+ * @param arg argument of callback
+ * @return number of records delivered
+ */
+int journal_retry_deferred(Journal *journal, int consumer_id,
+			   journal_deliver_cb deliver, void *arg)
+{
+	JournalConsumer *consumer = &journal->consumers[consumer_id];
+	unsigned long long end = journal->next_seq;
+	unsigned long long stop;
+	int delivered;
+
+	if (consumer->deferred_from >= end) {
+		return 0;
+	}
+
+	if (journal->segment_count > 0
+	    && consumer->deferred_from < journal->segments[0].first_seq) {
+		consumer->deferred_from = journal->segments[0].first_seq;
+	}
+
+	delivered = journal_walk(journal, consumer_id, consumer->deferred_from,
+				 1, deliver, arg, &stop);
+
+	// records deferred again are past end
+	consumer->deferred_from = stop ? stop : end;
+
+	return delivered;
+}
+
+/**
+ * Gets number of records a consumer did not get yet
+ *
+ * @param journal the journal
+ * @param consumer consumer id
+ * @return number of records
+ */
+unsigned long long journal_pending(Journal *journal, int consumer)
+{
+	return journal->next_seq - 1 - journal->consumers[consumer].cursor;
+}
+
+/**
+ * Gets number of segment files
+ *
+ * @param journal the journal
+ * @return number of segments
+ */
+int journal_segment_count(Journal *journal)
+{
+	return journal->segment_count;
+}
+
+/** @} */
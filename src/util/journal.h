@@ -0,0 +1,114 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+/**
+ * \file journal.h
+ * \brief Append-only journal of typed records in memory-mapped segments.
+ *
+ * Copyright (C) 2010 Signove Tecnologia Corporation.
+ * All rights reserved.
+ * Contact: Signove Tecnologia Corporation (contact@signove.com)
+ *
+ * $LICENSE_TEXT:BEGIN$
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation and appearing
+ * in the file LICENSE included in the packaging of this file; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ * $LICENSE_TEXT:END$
+ *
+ * \date Oct 18, 2026
+ */
+
+#ifndef JOURNAL_H_
+#define JOURNAL_H_
+
+#include <asn1/phd_types.h>
+
+/**
+ * \ingroup Utility
+ * @{
+ */
+
+/**
+ * Default size of a journal segment file
+ */
+#define JOURNAL_DEFAULT_SEGMENT_SIZE (4 * 1024 * 1024)
+
+/**
+ * Default number of segments kept; older ones are removed
+ */
+#define JOURNAL_DEFAULT_MAX_SEGMENTS 64
+
+/**
+ * Maximum number of consumers of a journal
+ */
+#define JOURNAL_MAX_CONSUMERS 8
+
+/**
+ * Returned by journal_deliver_cb: record was taken
+ */
+#define JOURNAL_DELIVERED 1
+
+/**
+ * Returned by journal_deliver_cb: consumer cannot take records now
+ */
+#define JOURNAL_STOP 0
+
+/**
+ * Returned by journal_deliver_cb: record cannot be taken now, but
+ * following ones can; record is retried by journal_retry_deferred()
+ */
+#define JOURNAL_DEFER 2
+
+/**
+ * Journal of records, opaque
+ */
+typedef struct Journal Journal;
+
+/**
+ * Delivers a journal record to a consumer. Must not append to the journal.
+ *
+ * @param type record type, given to journal_append()
+ * @param seq record sequence number
+ * @param data record payload
+ * @param length payload length
+ * @param arg argument given to journal_replay()
+ * @return JOURNAL_DELIVERED, JOURNAL_STOP or JOURNAL_DEFER
+ */
+typedef int (*journal_deliver_cb)(intu16 type, unsigned long long seq,
+				  const intu8 *data, intu32 length, void *arg);
+
+Journal *journal_open(const char *dir, intu32 segment_size, int max_segments);
+
+void journal_close(Journal *journal);
+
+int journal_append(Journal *journal, intu16 type, const intu8 *data,
+		   intu32 length, unsigned long long *seq);
+
+void journal_set_sync_batch(Journal *journal, int records);
+
+int journal_sync(Journal *journal);
+
+int journal_add_consumer(Journal *journal, const char *name);
+
+int journal_replay(Journal *journal, int consumer, journal_deliver_cb deliver,
+		   void *arg);
+
+int journal_retry_deferred(Journal *journal, int consumer,
+			   journal_deliver_cb deliver, void *arg);
+
+unsigned long long journal_pending(Journal *journal, int consumer);
+
+int journal_segment_count(Journal *journal);
+
+/** @} */
+
+#endif /* JOURNAL_H_ */
@@ -0,0 +1,235 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+/**
+ * \file pool.c
+ * \brief Object pools.
+ *
+ * Copyright (C) 2010 Signove Tecnologia Corporation.
+ * All rights reserved.
+ * Contact: Signove Tecnologia Corporation (contact@signove.com)
+ *
+ * $LICENSE_TEXT:BEGIN$
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation and appearing
+ * in the file LICENSE included in the packaging of this file; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ * $LICENSE_TEXT:END$
+ *
+ * \date Oct 18, 2026
+ */
+
+/**
+ * \addtogroup Utility
+ *
+ * Object pools keep per-connection structures (contexts, state
+ * machines, services, MDS instances) for reuse, so that short
+ * connections do not hit the system allocator several times each.
+ * Objects handed out by pool_alloc() are always zeroed, just like
+ * calloc() would return them.
+ *
+ * Building with POOLS_DISABLED (configure --disable-pools) maps the
+ * pools straight to calloc() and free(), which is what memory
+ * checkers want to see.
+ *
+ * @{
+ */
+
+#include "pool.h"
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Alignment of objects within a slab
+ */
+#define POOL_ALIGN 16
+
+/**
+ * Rounds size up to POOL_ALIGN
+ */
+#define POOL_ROUND(size) (((size) + POOL_ALIGN - 1) & ~(size_t) (POOL_ALIGN - 1))
+
+/**
+ * Slab header, objects follow it
+ */
+struct PoolSlab {
+	/**
+	 * Next slab of pool
+	 */
+	struct PoolSlab *next;
+};
+
+#ifndef POOLS_DISABLED
+
+/**
+ * Size of each object slot in a slab
+ */
+static size_t pool_slot_size(ObjectPool *pool)
+{
+	size_t size = pool->object_size;
+
+	if (size < sizeof(void *)) {
+		size = sizeof(void *);
+	}
+
+	return POOL_ROUND(size);
+}
+
+/**
+ * Allocates one more slab and puts its objects in free list.
+ * Must be called with pool mutex held.
+ *
+ * \return 1 if successful, 0 otherwise
+ */
+static int pool_grow(ObjectPool *pool)
+{
+	size_t slot = pool_slot_size(pool);
+	int count = pool->slab_objects > 0 ? pool->slab_objects : 1;
+	struct PoolSlab *slab;
+	char *objects;
+	int i;
+
+	slab = malloc(POOL_ROUND(sizeof(struct PoolSlab)) + slot * count);
+
+	if (slab == NULL) {
+		return 0;
+	}
+
+	slab->next = pool->slabs;
+	pool->slabs = slab;
+
+	objects = (char *) slab + POOL_ROUND(sizeof(struct PoolSlab));
+
+	for (i = count - 1; i >= 0; --i) {
+		void *object = objects + slot * i;
+		*(void **) object = pool->free_list;
+		pool->free_list = object;
+	}
+
+	pool->free_count += count;
+
+	return 1;
+}
+
+#endif
+
+/**
+ * Gets a zeroed object from pool
+ *
+ * \param pool the pool
+ * \return object, or NULL if memory is exhausted
+ */
+void *pool_alloc(ObjectPool *pool)
+{
+#ifdef POOLS_DISABLED
+	return calloc(1, pool->object_size);
+#else
+	void *object = NULL;
+
+	pthread_mutex_lock(&pool->mutex);
+
+	if (pool->free_list != NULL || pool_grow(pool)) {
+		object = pool->free_list;
+		pool->free_list = *(void **) object;
+		--pool->free_count;
+		++pool->in_use;
+	}
+
+	pthread_mutex_unlock(&pool->mutex);
+
+	if (object != NULL) {
+		memset(object, 0, pool->object_size);
+	}
+
+	return object;
+#endif
+}
+
+/**
+ * Gives an object back to pool
+ *
+ * \param pool the pool the object was taken from
+ * \param object the object, may be NULL
+ */
+void pool_free(ObjectPool *pool, void *object)
+{
+#ifdef POOLS_DISABLED
+	free(object);
+#else
+	if (object == NULL) {
+		return;
+	}
+
+	pthread_mutex_lock(&pool->mutex);
+
+	*(void **) object = pool->free_list;
+	pool->free_list = object;
+	++pool->free_count;
+	--pool->in_use;
+
+	pthread_mutex_unlock(&pool->mutex);
+#endif
+}
+
+/**
+ * Makes sure the pool has at least count objects ready to be
+ * handed out, so that they are not allocated when connections
+ * arrive.
+ *
+ * \param pool the pool
+ * \param count number of free objects wanted
+ * \return 1 if successful, 0 otherwise
+ */
+int pool_reserve(ObjectPool *pool, int count)
+{
+#ifdef POOLS_DISABLED
+	return 1;
+#else
+	int ok = 1;
+
+	pthread_mutex_lock(&pool->mutex);
+
+	while (ok && pool->free_count < count) {
+		ok = pool_grow(pool);
+	}
+
+	pthread_mutex_unlock(&pool->mutex);
+
+	return ok;
+#endif
+}
+
+/**
+ * Gives all slabs back to the system if no object is in use
+ *
+ * \param pool the pool
+ */
+void pool_trim(ObjectPool *pool)
+{
+#ifndef POOLS_DISABLED
+	pthread_mutex_lock(&pool->mutex);
+
+	if (pool->in_use == 0) {
+		while (pool->slabs != NULL) {
+			struct PoolSlab *slab = pool->slabs;
+			pool->slabs = slab->next;
+			free(slab);
+		}
+
+		pool->free_list = NULL;
+		pool->free_count = 0;
+	}
+
+	pthread_mutex_unlock(&pool->mutex);
+#endif
+}
+
+/** @} */
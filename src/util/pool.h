@@ -0,0 +1,103 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+/**
+ * \file pool.h
+ * \brief Object pools header.
+ *
+ * Copyright (C) 2010 Signove Tecnologia Corporation.
+ * All rights reserved.
+ * Contact: Signove Tecnologia Corporation (contact@signove.com)
+ *
+ * $LICENSE_TEXT:BEGIN$
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation and appearing
+ * in the file LICENSE included in the packaging of this file; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ * $LICENSE_TEXT:END$
+ *
+ * \date Oct 18, 2026
+ */
+
+#ifndef POOL_H_
+#define POOL_H_
+
+#include <pthread.h>
+#include <stddef.h>
+
+/**
+ * \ingroup Utility
+ * @{
+ */
+
+struct PoolSlab;
+
+/**
+ * Pool of fixed size objects, carved from slabs allocated a few
+ * objects at a time. Released objects go back to a free list
+ * and are never handed back to the system allocator until
+ * pool_trim() finds no object in use.
+ */
+typedef struct ObjectPool {
+	/**
+	 * Size of each object
+	 */
+	size_t object_size;
+
+	/**
+	 * Objects per slab
+	 */
+	int slab_objects;
+
+	/**
+	 * Slabs allocated so far
+	 */
+	struct PoolSlab *slabs;
+
+	/**
+	 * Released objects, linked through their first word
+	 */
+	void *free_list;
+
+	/**
+	 * Number of objects in free list
+	 */
+	int free_count;
+
+	/**
+	 * Number of objects handed out and not released
+	 */
+	int in_use;
+
+	/**
+	 * Protects the members above
+	 */
+	pthread_mutex_t mutex;
+} ObjectPool;
+
+/**
+ * Static initializer of an ObjectPool of objects of given type
+ */
+#define OBJECT_POOL_INITIALIZER(type, slab_objects) \
+	{sizeof(type), (slab_objects), NULL, NULL, 0, 0, \
+	 PTHREAD_MUTEX_INITIALIZER}
+
+void *pool_alloc(ObjectPool *pool);
+
+void pool_free(ObjectPool *pool, void *object);
+
+int pool_reserve(ObjectPool *pool, int count);
+
+void pool_trim(ObjectPool *pool);
+
+/** @} */
+
+#endif /* POOL_H_ */
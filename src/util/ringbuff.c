@@ -0,0 +1,255 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+/**
+ * \file ringbuff.c
+ * \brief Single-producer single-consumer byte ring buffer.
+ *
+ * Copyright (C) 2010 Signove Tecnologia Corporation.
+ * All rights reserved.
+ * Contact: Signove Tecnologia Corporation (contact@signove.com)
+ *
+ * $LICENSE_TEXT:BEGIN$
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation and appearing
+ * in the file LICENSE included in the packaging of this file; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ * $LICENSE_TEXT:END$
+ *
+ * \date Oct 18, 2026
+ */
+
+/**
+ * \addtogroup Utility
+ *
+ * Ring buffer is a bounded byte queue that one thread may fill while
+ * another one drains it, with no locking. Writes are all-or-nothing, so a
+ * consumer never observes half of a record pushed by the producer.
+ *
+ * @{
+ */
+
+#include "ringbuff.h"
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Loads an index written by the other side of the queue
+ */
+#define RB_LOAD_ACQUIRE(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+
+/**
+ * Publishes an index to the other side of the queue
+ */
+#define RB_STORE_RELEASE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+/**
+ * Loads an index owned by the caller
+ */
+#define RB_LOAD_RELAXED(p) __atomic_load_n((p), __ATOMIC_RELAXED)
+
+/**
+ * Creates a ring buffer
+ *
+ * @param min_capacity minimum number of bytes the buffer must hold,
+ *        rounded up to the next power of two
+ * @return new ring buffer or NULL if out of memory
+ */
+RingBuffer *ringbuff_new(intu32 min_capacity)
+{
+	intu32 capacity = RINGBUFF_CACHE_LINE;
+
+	while (capacity < min_capacity && capacity < 0x80000000) {
+		capacity <<= 1;
+	}
+
+	RingBuffer *rb = calloc(1, sizeof(RingBuffer));
+
+	if (rb == NULL) {
+		return NULL;
+	}
+
+	rb->buffer = malloc(capacity);
+
+	if (rb->buffer == NULL) {
+		free(rb);
+		return NULL;
+	}
+
+	rb->capacity = capacity;
+	rb->mask = capacity - 1;
+
+	return rb;
+}
+
+/**
+ * Destroys a ring buffer
+ *
+ * @param rb ring buffer
+ */
+void ringbuff_del(RingBuffer *rb)
+{
+	if (rb != NULL) {
+		free(rb->buffer);
+		free(rb);
+	}
+}
+
+/**
+ * Discards all contents. Must not race with producer nor consumer.
+ *
+ * @param rb ring buffer
+ */
+void ringbuff_reset(RingBuffer *rb)
+{
+	RB_STORE_RELEASE(&rb->head, 0);
+	RB_STORE_RELEASE(&rb->tail, 0);
+}
+
+/**
+ * Number of bytes available for reading. Exact when called by the
+ * consumer, a lower bound otherwise.
+ *
+ * @param rb ring buffer
+ * @return byte count
+ */
+intu32 ringbuff_used(RingBuffer *rb)
+{
+	return RB_LOAD_ACQUIRE(&rb->head) - RB_LOAD_ACQUIRE(&rb->tail);
+}
+
+/**
+ * Number of bytes available for writing. Exact when called by the
+ * producer, a lower bound otherwise.
+ *
+ * @param rb ring buffer
+ * @return byte count
+ */
+intu32 ringbuff_free_space(RingBuffer *rb)
+{
+	return rb->capacity - ringbuff_used(rb);
+}
+
+/**
+ * Copies bytes in or out of the storage area, handling wrap-around
+ *
+ * @param rb ring buffer
+ * @param pos free-running index
+ * @param data caller's buffer
+ * @param len byte count
+ * @param out 1 copies from ring to data, 0 from data to ring
+ */
+static void copy_wrapped(RingBuffer *rb, intu32 pos, intu8 *data,
+				intu32 len, int out)
+{
+	intu32 offset = pos & rb->mask;
+	intu32 first = rb->capacity - offset;
+
+	if (first > len) {
+		first = len;
+	}
+
+	if (out) {
+		memcpy(data, rb->buffer + offset, first);
+		memcpy(data + first, rb->buffer, len - first);
+	} else {
+		memcpy(rb->buffer + offset, data, first);
+		memcpy(rb->buffer, data + first, len - first);
+	}
+}
+
+/**
+ * Appends bytes to ring buffer (producer side). Either all bytes
+ * are written or none.
+ *
+ * @param rb ring buffer
+ * @param data bytes to be written
+ * @param len byte count
+ * @return 1 if written, 0 if there is not enough room
+ */
+int ringbuff_write(RingBuffer *rb, const intu8 *data, intu32 len)
+{
+	intu32 head = RB_LOAD_RELAXED(&rb->head);
+	intu32 tail = RB_LOAD_ACQUIRE(&rb->tail);
+
+	if (rb->capacity - (head - tail) < len) {
+		return 0;
+	}
+
+	copy_wrapped(rb, head, (intu8 *) data, len, 0);
+	RB_STORE_RELEASE(&rb->head, head + len);
+
+	return 1;
+}
+
+/**
+ * Copies bytes from ring buffer without consuming them (consumer side).
+ *
+ * @param rb ring buffer
+ * @param data destination
+ * @param len byte count
+ * @return 1 if copied, 0 if less than len bytes are available
+ */
+int ringbuff_peek(RingBuffer *rb, intu8 *data, intu32 len)
+{
+	intu32 tail = RB_LOAD_RELAXED(&rb->tail);
+	intu32 head = RB_LOAD_ACQUIRE(&rb->head);
+
+	if (head - tail < len) {
+		return 0;
+	}
+
+	copy_wrapped(rb, tail, data, len, 1);
+
+	return 1;
+}
+
+/**
+ * Removes bytes from ring buffer (consumer side). Either all bytes
+ * are read or none.
+ *
+ * @param rb ring buffer
+ * @param data destination
+ * @param len byte count
+ * @return 1 if read, 0 if less than len bytes are available
+ */
+int ringbuff_read(RingBuffer *rb, intu8 *data, intu32 len)
+{
+	if (!ringbuff_peek(rb, data, len)) {
+		return 0;
+	}
+
+	RB_STORE_RELEASE(&rb->tail, RB_LOAD_RELAXED(&rb->tail) + len);
+
+	return 1;
+}
+
+/**
+ * Discards bytes from ring buffer (consumer side)
+ *
+ * @param rb ring buffer
+ * @param len byte count
+ * @return 1 if discarded, 0 if less than len bytes are available
+ */
+int ringbuff_skip(RingBuffer *rb, intu32 len)
+{
+	intu32 tail = RB_LOAD_RELAXED(&rb->tail);
+
+	if (RB_LOAD_ACQUIRE(&rb->head) - tail < len) {
+		return 0;
+	}
+
+	RB_STORE_RELEASE(&rb->tail, tail + len);
+
+	return 1;
+}
+
+/** @} */
@@ -0,0 +1,91 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+/**
+ * \file ringbuff.h
+ * \brief Single-producer single-consumer byte ring buffer header.
+ *
+ * Copyright (C) 2010 Signove Tecnologia Corporation.
+ * All rights reserved.
+ * Contact: Signove Tecnologia Corporation (contact@signove.com)
+ *
+ * $LICENSE_TEXT:BEGIN$
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation and appearing
+ * in the file LICENSE included in the packaging of this file; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ * $LICENSE_TEXT:END$
+ *
+ * \date Oct 18, 2026
+ */
+
+#ifndef RINGBUFF_H_
+#define RINGBUFF_H_
+
+#include <asn1/phd_types.h>
+
+/**
+ * Assumed cache line size, used to keep producer and consumer
+ * indexes from sharing a line
+ */
+#define RINGBUFF_CACHE_LINE 64
+
+/**
+ * Lock-free byte queue for exactly one producer thread and one
+ * consumer thread. Indexes run freely and are masked on access,
+ * so capacity is always a power of two.
+ */
+typedef struct RingBuffer {
+	/**
+	 * Storage area
+	 */
+	intu8 *buffer;
+
+	/**
+	 * Storage size in bytes (power of two)
+	 */
+	intu32 capacity;
+
+	/**
+	 * capacity - 1
+	 */
+	intu32 mask;
+
+	char pad0[RINGBUFF_CACHE_LINE];
+
+	/**
+	 * Write index, only changed by producer
+	 */
+	intu32 head;
+
+	char pad1[RINGBUFF_CACHE_LINE];
+
+	/**
+	 * Read index, only changed by consumer
+	 */
+	intu32 tail;
+
+	char pad2[RINGBUFF_CACHE_LINE];
+} RingBuffer;
+
+RingBuffer *ringbuff_new(intu32 min_capacity);
+void ringbuff_del(RingBuffer *rb);
+void ringbuff_reset(RingBuffer *rb);
+
+intu32 ringbuff_used(RingBuffer *rb);
+intu32 ringbuff_free_space(RingBuffer *rb);
+
+int ringbuff_write(RingBuffer *rb, const intu8 *data, intu32 len);
+int ringbuff_peek(RingBuffer *rb, intu8 *data, intu32 len);
+int ringbuff_read(RingBuffer *rb, intu8 *data, intu32 len);
+int ringbuff_skip(RingBuffer *rb, intu32 len);
+
+#endif /* RINGBUFF_H_ */
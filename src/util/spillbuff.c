@@ -0,0 +1,284 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+/**
+ * \file spillbuff.c
+ * \brief Spill-to-disk byte buffer.
+ *
+ * Copyright (C) 2010 Signove Tecnologia Corporation.
+ * All rights reserved.
+ * Contact: Signove Tecnologia Corporation (contact@signove.com)
+ *
+ * $LICENSE_TEXT:BEGIN$
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation and appearing
+ * in the file LICENSE included in the packaging of this file; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ * $LICENSE_TEXT:END$
+ *
+ * \date Oct 18, 2026
+ */
+
+/**
+ * \addtogroup Utility
+ *
+ * Spill buffer accumulates bytes on the heap until they exceed a
+ * threshold, and from then on in an unlinked temporary file. The file
+ * is written with pwrite() and mapped read-only, so buffered bytes
+ * stay in page cache instead of process memory, and are read through
+ * the mapping as if they were on the heap.
+ *
+ * @{
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "spillbuff.h"
+#include "ioutil.h"
+#include "log.h"
+
+/**
+ * Buffers larger than this are kept in a temporary file, 0 for never
+ */
+static intu32 spill_threshold = SPILLBUFF_DEFAULT_THRESHOLD;
+
+/**
+ * Sets size above which buffers are moved to a temporary file. It
+ * applies to buffers growing past it from then on.
+ *
+ * @param bytes threshold, 0 to keep buffers always on heap
+ */
+void spillbuff_set_threshold(intu32 bytes)
+{
+	spill_threshold = bytes;
+}
+
+/**
+ * Gets size above which buffers are moved to a temporary file
+ *
+ * @return threshold in bytes, 0 if buffers are always on heap
+ */
+intu32 spillbuff_get_threshold()
+{
+	return spill_threshold;
+}
+
+/**
+ * Rounds capacity up to a power of two
+ */
+static intu32 spillbuff_capacity(intu32 current, intu32 needed)
+{
+	intu32 capacity = current ? current : 256;
+
+	while (capacity < needed && capacity < 0x80000000) {
+		capacity <<= 1;
+	}
+
+	return capacity < needed ? needed : capacity;
+}
+
+/**
+ * Writes a whole block to file
+ *
+ * @return 1 if successful, 0 otherwise
+ */
+static int spillbuff_write(int fd, const intu8 *data, intu32 length,
+			   intu32 offset)
+{
+	while (length > 0) {
+		ssize_t written = pwrite(fd, data, length, offset);
+
+		if (written < 0 && errno == EINTR) {
+			continue;
+		} else if (written <= 0) {
+			ERROR("spill buffer write: %d", errno);
+			return 0;
+		}
+
+		data += written;
+		length -= written;
+		offset += written;
+	}
+
+	return 1;
+}
+
+/**
+ * Grows temporary file and its mapping
+ *
+ * @return 1 if successful, 0 otherwise
+ */
+static int spillbuff_map(SpillBuffer *buf, intu32 capacity)
+{
+	void *map;
+
+	if (ftruncate(buf->fd, capacity) != 0) {
+		ERROR("spill buffer truncate: %d", errno);
+		return 0;
+	}
+
+	map = mmap(NULL, capacity, PROT_READ, MAP_SHARED, buf->fd, 0);
+
+	if (map == MAP_FAILED) {
+		ERROR("spill buffer mmap: %d", errno);
+		return 0;
+	}
+
+	if (buf->data != NULL) {
+		munmap(buf->data, buf->capacity);
+	}
+
+	buf->data = map;
+	buf->capacity = capacity;
+
+	return 1;
+}
+
+/**
+ * Moves heap contents to a new temporary file
+ *
+ * @return 1 if successful, 0 otherwise (buffer left on heap)
+ */
+static int spillbuff_spill(SpillBuffer *buf, intu32 needed)
+{
+	char *tmp = ioutil_get_tmp();
+	char *path = malloc(strlen(tmp) + 16);
+	intu8 *heap = buf->data;
+	intu32 heap_capacity = buf->capacity;
+
+	sprintf(path, "%sspillXXXXXX", tmp);
+	free(tmp);
+
+	buf->fd = mkstemp(path);
+
+	if (buf->fd < 0) {
+		ERROR("spill buffer: cannot create %s: %d", path, errno);
+		free(path);
+		return 0;
+	}
+
+	// nobody else needs the name; space is reclaimed on close
+	unlink(path);
+	free(path);
+
+	buf->data = NULL;
+	buf->capacity = 0;
+
+	if (!spillbuff_map(buf, spillbuff_capacity(heap_capacity, needed))
+	    || !spillbuff_write(buf->fd, heap, buf->length, 0)) {
+		if (buf->data != NULL) {
+			munmap(buf->data, buf->capacity);
+		}
+
+		close(buf->fd);
+		buf->data = heap;
+		buf->capacity = heap_capacity;
+		return 0;
+	}
+
+	DEBUG("spill buffer: %d bytes moved to file", buf->length);
+
+	free(heap);
+	buf->spilled = 1;
+
+	return 1;
+}
+
+/**
+ * Appends bytes to buffer, moving it to a temporary file when it grows
+ * past the threshold. Buffer data pointer may change.
+ *
+ * @param buf buffer
+ * @param data bytes to be appended
+ * @param length number of bytes
+ * @return 1 if successful, 0 otherwise (buffer unchanged)
+ */
+int spillbuff_append(SpillBuffer *buf, const intu8 *data, intu32 length)
+{
+	intu32 needed = buf->length + length;
+
+	if (needed < buf->length) {
+		return 0;
+	}
+
+	if (!buf->spilled && spill_threshold > 0 && needed > spill_threshold) {
+		// on failure, keep trying on heap
+		spillbuff_spill(buf, needed);
+	}
+
+	if (buf->spilled) {
+		if (needed > buf->capacity
+		    && !spillbuff_map(buf, spillbuff_capacity(buf->capacity, needed))) {
+			return 0;
+		}
+
+		if (!spillbuff_write(buf->fd, data, length, buf->length)) {
+			return 0;
+		}
+	} else {
+		if (needed > buf->capacity) {
+			intu32 capacity = spillbuff_capacity(buf->capacity, needed);
+			intu8 *grown = realloc(buf->data, capacity);
+
+			if (grown == NULL) {
+				return 0;
+			}
+
+			buf->data = grown;
+			buf->capacity = capacity;
+		}
+
+		memcpy(buf->data + buf->length, data, length);
+	}
+
+	buf->length = needed;
+
+	return 1;
+}
+
+/**
+ * Drops pages of a spilled buffer from process memory, after it has
+ * been read. Contents stay in file and are paged in again if read.
+ *
+ * @param buf buffer
+ */
+void spillbuff_release_pages(SpillBuffer *buf)
+{
+	if (buf->spilled && buf->data != NULL) {
+		madvise(buf->data, buf->capacity, MADV_DONTNEED);
+	}
+}
+
+/**
+ * Empties buffer, releasing memory and temporary file
+ *
+ * @param buf buffer
+ */
+void spillbuff_clear(SpillBuffer *buf)
+{
+	if (buf->spilled) {
+		if (buf->data != NULL) {
+			munmap(buf->data, buf->capacity);
+		}
+
+		close(buf->fd);
+	} else {
+		free(buf->data);
+	}
+
+	memset(buf, 0, sizeof(SpillBuffer));
+}
+
+/** @} */
@@ -0,0 +1,89 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*- */
+/**
+ * \file spillbuff.h
+ * \brief Spill-to-disk byte buffer header.
+ *
+ * Copyright (C) 2010 Signove Tecnologia Corporation.
+ * All rights reserved.
+ * Contact: Signove Tecnologia Corporation (contact@signove.com)
+ *
+ * $LICENSE_TEXT:BEGIN$
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation and appearing
+ * in the file LICENSE included in the packaging of this file; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ * $LICENSE_TEXT:END$
+ *
+ * \date Oct 18, 2026
+ */
+
+#ifndef SPILLBUFF_H_
+#define SPILLBUFF_H_
+
+#include <asn1/phd_types.h>
+
+/**
+ * \ingroup Utility
+ * @{
+ */
+
+/**
+ * Default size above which buffers move to a temporary file
+ */
+#define SPILLBUFF_DEFAULT_THRESHOLD (1024 * 1024)
+
+/**
+ * Growable byte buffer that lives on the heap while small, and in a
+ * memory-mapped temporary file above a threshold. A zeroed structure
+ * is an empty buffer.
+ */
+typedef struct SpillBuffer {
+	/**
+	 * Contents, on heap or mapped read-only from file
+	 */
+	intu8 *data;
+
+	/**
+	 * Bytes in buffer
+	 */
+	intu32 length;
+
+	/**
+	 * Bytes allocated on heap, or size of file and mapping
+	 */
+	intu32 capacity;
+
+	/**
+	 * Non-zero if contents are in a temporary file
+	 */
+	int spilled;
+
+	/**
+	 * Temporary file, valid if spilled
+	 */
+	int fd;
+} SpillBuffer;
+
+void spillbuff_set_threshold(intu32 bytes);
+
+intu32 spillbuff_get_threshold();
+
+int spillbuff_append(SpillBuffer *buf, const intu8 *data, intu32 length);
+
+void spillbuff_release_pages(SpillBuffer *buf);
+
+void spillbuff_clear(SpillBuffer *buf);
+
+/** @} */
+
+#endif /* SPILLBUFF_H_ */
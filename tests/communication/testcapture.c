@@ -0,0 +1,166 @@
+/**********************************************************************
+ * Copyright (C) 2010 Signove Tecnologia Corporation.
+ * All rights reserved.
+ * Contact: Signove Tecnologia Corporation (contact@signove.com)
+ *
+ * $LICENSE_TEXT:BEGIN$
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation and appearing
+ * in the file LICENSE included in the packaging of this file; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ * $LICENSE_TEXT:END$
+ *
+ * testcapture.c
+ *
+ * Created on: Oct 18, 2026
+ **********************************************************************/
+
+#ifdef TEST_ENABLED
+
+#include "testcapture.h"
+#include "src/communication/apdu_capture.h"
+#include "src/util/ioutil.h"
+#include "Basic.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define CAPTURE_TEST_FILE "capture_test.bin"
+
+static int test_init_suite(void)
+{
+	return 0;
+}
+
+static int test_finish_suite(void)
+{
+	return 0;
+}
+
+void testcapture_add_suite()
+{
+	CU_pSuite suite = CU_add_suite("APDU Capture Test Suite",
+				       test_init_suite, test_finish_suite);
+
+	/* Add tests here - Start */
+	CU_add_test(suite, "testcapture_records", testcapture_records);
+	CU_add_test(suite, "testcapture_rotation", testcapture_rotation);
+
+	/* Add tests here - End */
+}
+
+static intu8 rlrq[] = {0xE4, 0x00, 0x00, 0x02, 0x00, 0x00};
+static intu8 rlre[] = {0xE5, 0x00, 0x00, 0x02, 0x00, 0x00};
+
+void testcapture_records()
+{
+	Context ctx;
+	unsigned long size = 0;
+
+	memset(&ctx, 0, sizeof(Context));
+	ctx.type = MANAGER_CONTEXT;
+	ctx.id.plugin = 3;
+	ctx.id.connid = 0x0102030405ULL;
+
+	// disabled: no-op
+	apdu_capture_record(&ctx, 0, rlrq, sizeof(rlrq));
+
+	CU_ASSERT_TRUE(apdu_capture_start(CAPTURE_TEST_FILE, 0, 0));
+	CU_ASSERT_TRUE(apdu_capture_is_active());
+	CU_ASSERT_FALSE(apdu_capture_start(CAPTURE_TEST_FILE, 0, 0));
+
+	apdu_capture_record(&ctx, 0, rlrq, sizeof(rlrq));
+	apdu_capture_record(&ctx, 1, rlre, sizeof(rlre));
+
+	apdu_capture_stop();
+	CU_ASSERT_FALSE(apdu_capture_is_active());
+	CU_ASSERT_EQUAL(apdu_capture_dropped_records(), 0);
+
+	intu8 *buf = ioutil_buffer_from_file(CAPTURE_TEST_FILE, &size);
+	CU_ASSERT_PTR_NOT_NULL(buf);
+	CU_ASSERT_EQUAL(size, APDU_CAPTURE_FILE_HEADER_SIZE
+			+ 2 * (APDU_CAPTURE_RECORD_HEADER_SIZE + 6));
+
+	if (buf && size >= APDU_CAPTURE_FILE_HEADER_SIZE
+	    + 2 * APDU_CAPTURE_RECORD_HEADER_SIZE + 12) {
+		intu8 *r1 = buf + APDU_CAPTURE_FILE_HEADER_SIZE;
+		intu8 *r2 = r1 + APDU_CAPTURE_RECORD_HEADER_SIZE + 6;
+
+		CU_ASSERT_EQUAL(memcmp(buf, APDU_CAPTURE_MAGIC, 8), 0);
+
+		// connid, plugin, length, flags
+		CU_ASSERT_EQUAL(r1[11], 0x01);
+		CU_ASSERT_EQUAL(r1[15], 0x05);
+		CU_ASSERT_EQUAL(r1[19], 3);
+		CU_ASSERT_EQUAL(r1[23], 6);
+		CU_ASSERT_EQUAL(r1[24], APDU_CAPTURE_MANAGER);
+		CU_ASSERT_EQUAL(r2[24], APDU_CAPTURE_MANAGER | APDU_CAPTURE_SENT);
+		CU_ASSERT_EQUAL(memcmp(r1 + APDU_CAPTURE_RECORD_HEADER_SIZE,
+				       rlrq, 6), 0);
+		CU_ASSERT_EQUAL(memcmp(r2 + APDU_CAPTURE_RECORD_HEADER_SIZE,
+				       rlre, 6), 0);
+
+		// timestamps are monotonic
+		CU_ASSERT(memcmp(r1, r2, 8) <= 0);
+	}
+
+	free(buf);
+	remove(CAPTURE_TEST_FILE);
+}
+
+static unsigned long file_size(const char *path)
+{
+	unsigned long size = 0;
+	intu8 *buf = ioutil_buffer_from_file(path, &size);
+
+	if (!buf) {
+		return 0;
+	}
+
+	free(buf);
+	return size;
+}
+
+void testcapture_rotation()
+{
+	Context ctx;
+	unsigned long record = APDU_CAPTURE_FILE_HEADER_SIZE
+			       + APDU_CAPTURE_RECORD_HEADER_SIZE + sizeof(rlrq);
+	int i;
+
+	memset(&ctx, 0, sizeof(Context));
+	ctx.type = AGENT_CONTEXT;
+
+	// any file holding a record is full
+	CU_ASSERT_TRUE(apdu_capture_start(CAPTURE_TEST_FILE, 40, 2));
+
+	for (i = 0; i < 4; ++i) {
+		apdu_capture_record(&ctx, 1, rlrq, sizeof(rlrq));
+		// gives writer thread time to flush each record apart
+		usleep(50000);
+	}
+
+	apdu_capture_stop();
+
+	CU_ASSERT_EQUAL(file_size(CAPTURE_TEST_FILE), record);
+	CU_ASSERT_EQUAL(file_size(CAPTURE_TEST_FILE ".1"), record);
+	CU_ASSERT_EQUAL(file_size(CAPTURE_TEST_FILE ".2"), record);
+	CU_ASSERT_EQUAL(file_size(CAPTURE_TEST_FILE ".3"), 0);
+
+	remove(CAPTURE_TEST_FILE);
+	remove(CAPTURE_TEST_FILE ".1");
+	remove(CAPTURE_TEST_FILE ".2");
+}
+
+#endif
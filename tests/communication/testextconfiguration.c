@@ -38,9 +38,12 @@
 #include "src/specializations/glucometer.h"
 #include "Basic.h"
 #include "src/communication/extconfigurations.h"
+#include "src/util/ioutil.h"
 #include "testextconfiguration.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
 
 int test_ext_configuration_init_suite(void)
 {
@@ -59,6 +62,8 @@ void testextconfiguration_add_suite()
 
 	/* Add tests here - Start */
 	CU_add_test(suite, "test_extconfiguration_persistent_config", test_extconfiguration_persistent_config);
+	CU_add_test(suite, "test_extconfiguration_store_recovery", test_extconfiguration_store_recovery);
+	CU_add_test(suite, "test_extconfiguration_shared_content", test_extconfiguration_shared_content);
 
 	/* Add tests here - End */
 }
@@ -287,4 +292,143 @@ void test_extconfiguration_persistent_config()
 	free(glu_object_list);
 
 }
+static int count_stored_configs(ConfigObjectList *expected, intu8 *sys_id_buffer)
+{
+	octet_string sys_id = {8, sys_id_buffer};
+	int found = 0;
+	int i;
+
+	for (i = 0; i < 300; ++i) {
+		sys_id_buffer[6] = i >> 8;
+		sys_id_buffer[7] = i & 0xff;
+
+		ConfigObjectList *result =
+			ext_configurations_get_configuration_attributes(&sys_id, 0x4000);
+
+		if (result != NULL) {
+			found += result->count == expected->count
+				 && result->length == expected->length;
+			del_configobjectlist(result);
+			free(result);
+		}
+	}
+
+	return found;
+}
+
+void test_extconfiguration_store_recovery()
+{
+	struct StdConfiguration *bp_std_config = blood_pressure_monitor_create_std_config_ID02BC();
+	ConfigObjectList *bp_object_list = bp_std_config->configure_action();
+	intu8 sys_id_buffer[] = {0x00, 0x22, 0x09, 0x22, 0x58, 0x08, 0x00, 0x00};
+	octet_string sys_id = {8, sys_id_buffer};
+	ConfigObjectList empty_object_list = {0, 0, NULL};
+	struct stat st;
+	int i;
+
+	char *tmp = ioutil_get_tmp();
+	char *path = calloc(strlen(tmp) + 20, 1);
+	sprintf(path, "%sext_configs.db", tmp);
+	free(tmp);
+
+	ext_configurations_remove_all_configs();
+	ext_configurations_load_configurations();
+
+	// Grows hash table past its initial size
+	for (i = 0; i < 300; ++i) {
+		sys_id_buffer[6] = i >> 8;
+		sys_id_buffer[7] = i & 0xff;
+		ext_configurations_register_conf(&sys_id, 0x4000, bp_object_list);
+	}
+
+	// Configuration changed over and over is compacted
+	sys_id_buffer[6] = 0;
+	sys_id_buffer[7] = 0;
+
+	for (i = 0; i <= 3000; ++i) {
+		ext_configurations_register_conf(&sys_id, 0x4000,
+						 i % 2 ? &empty_object_list : bp_object_list);
+	}
+
+	CU_ASSERT(stat(path, &st) == 0);
+	CU_ASSERT(st.st_size < 3000 * 24);
+
+	ext_configurations_destroy();
+	ext_configurations_load_configurations();
+	CU_ASSERT_EQUAL(count_stored_configs(bp_object_list, sys_id_buffer), 300);
+
+	// Damaged header: records are recovered by scanning the file
+	ext_configurations_destroy();
+	FILE *f = fopen(path, "r+b");
+	CU_ASSERT(f != NULL);
+	fputs("JUNK", f);
+	fclose(f);
+
+	ext_configurations_load_configurations();
+	CU_ASSERT_EQUAL(count_stored_configs(bp_object_list, sys_id_buffer), 300);
+
+	ext_configurations_remove_all_configs();
+
+	free(path);
+	free(bp_std_config);
+	del_configobjectlist(bp_object_list);
+	free(bp_object_list);
+}
+
+void test_extconfiguration_shared_content()
+{
+	struct StdConfiguration *bp_std_config = blood_pressure_monitor_create_std_config_ID02BC();
+	struct StdConfiguration *po_std_config = pulse_oximeter_create_std_config_ID0190();
+	ConfigObjectList *bp_object_list = bp_std_config->configure_action();
+	ConfigObjectList *po_object_list = po_std_config->configure_action();
+	intu8 sys_id_one_buffer[] = {0x00, 0x22, 0x09, 0x22, 0x58, 0x08, 0x03, 0xcc};
+	intu8 sys_id_two_buffer[] = {0x00, 0x22, 0x09, 0x22, 0x58, 0x07, 0xe8, 0x6b};
+	intu8 sys_id_three_buffer[] = {0x00, 0x22, 0x09, 0x22, 0x58, 0x07, 0xe8, 0x77};
+	octet_string sys_id_one = {8, sys_id_one_buffer};
+	octet_string sys_id_two = {8, sys_id_two_buffer};
+	octet_string sys_id_three = {8, sys_id_three_buffer};
+	intu8 id_one[EXT_CONFIG_CONTENT_ID_SIZE];
+	intu8 id_two[EXT_CONFIG_CONTENT_ID_SIZE];
+	intu8 id_three[EXT_CONFIG_CONTENT_ID_SIZE];
+
+	ext_configurations_remove_all_configs();
+	ext_configurations_load_configurations();
+
+	ext_configurations_register_conf(&sys_id_one, 0x4000, bp_object_list);
+	ext_configurations_register_conf(&sys_id_two, 0x4000, bp_object_list);
+	ext_configurations_register_conf(&sys_id_three, 0x4000, po_object_list);
+
+	CU_ASSERT(ext_configurations_get_content_id(&sys_id_one, 0x4000, id_one));
+	CU_ASSERT(ext_configurations_get_content_id(&sys_id_two, 0x4000, id_two));
+	CU_ASSERT(ext_configurations_get_content_id(&sys_id_three, 0x4000, id_three));
+	CU_ASSERT(!ext_configurations_get_content_id(&sys_id_one, 0x4001, id_one));
+	CU_ASSERT(memcmp(id_one, id_two, EXT_CONFIG_CONTENT_ID_SIZE) == 0);
+	CU_ASSERT(memcmp(id_one, id_three, EXT_CONFIG_CONTENT_ID_SIZE) != 0);
+
+	// Decoded once for both agents
+	ConfigObjectList *one = ext_configurations_acquire_configuration_attributes(&sys_id_one, 0x4000);
+	ConfigObjectList *two = ext_configurations_acquire_configuration_attributes(&sys_id_two, 0x4000);
+	ConfigObjectList *three = ext_configurations_acquire_configuration_attributes(&sys_id_three, 0x4000);
+
+	CU_ASSERT(one != NULL && one == two);
+	CU_ASSERT(three != NULL && three != one);
+	CU_ASSERT_EQUAL(one->count, bp_object_list->count);
+	CU_ASSERT_EQUAL(three->count, po_object_list->count);
+
+	// Lists in use survive the store going away
+	ext_configurations_remove_all_configs();
+	CU_ASSERT_EQUAL(two->count, bp_object_list->count);
+
+	ext_configurations_release_configuration_attributes(one);
+	ext_configurations_release_configuration_attributes(two);
+	ext_configurations_release_configuration_attributes(three);
+
+	free(bp_std_config);
+	free(po_std_config);
+	del_configobjectlist(bp_object_list);
+	del_configobjectlist(po_object_list);
+	free(bp_object_list);
+	free(po_object_list);
+}
+
 #endif
@@ -33,6 +33,8 @@
 
 void testextconfiguration_add_suite();
 void test_extconfiguration_persistent_config();
+void test_extconfiguration_store_recovery();
+void test_extconfiguration_shared_content();
 
 #endif /* TEST_ENABLED */
 
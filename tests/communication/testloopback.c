@@ -0,0 +1,760 @@
+/**********************************************************************
+ * Copyright (C) 2010 Signove Tecnologia Corporation.
+ * All rights reserved.
+ * Contact: Signove Tecnologia Corporation (contact@signove.com)
+ *
+ * $LICENSE_TEXT:BEGIN$
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation and appearing
+ * in the file LICENSE included in the packaging of this file; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ * $LICENSE_TEXT:END$
+ *
+ * testloopback.c
+ *
+ * Created on: Oct 18, 2026
+ **********************************************************************/
+
+#ifdef TEST_ENABLED
+
+#include "testloopback.h"
+#include "src/manager_p.h"
+#include "src/agent.h"
+#include "src/communication/communication.h"
+#include "src/communication/plugin/plugin_loopback.h"
+#include "src/communication/parser/encoder_ASN1.h"
+#include "src/communication/event_template.h"
+#include "src/communication/service.h"
+#include "src/communication/stdconfigurations.h"
+#include "src/communication/parser/struct_cleaner.h"
+#include "src/specializations/blood_pressure_monitor.h"
+#include "src/specializations/glucometer.h"
+#include "src/specializations/pulse_oximeter.h"
+#include "src/specializations/weighing_scale.h"
+#include "src/util/ringbuff.h"
+#include "src/util/ioutil.h"
+#include "Basic.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define LOOPBACK_TEST_PAIRS 4
+
+static CommunicationPlugin manager_plugin;
+static CommunicationPlugin agent_plugin;
+
+static int available_count = 0;
+static int measurement_count = 0;
+static int disconnected_count = 0;
+static int measurement_size = 0;
+static int measurement_attrs[2];
+
+static int test_init_suite(void)
+{
+	return 0;
+}
+
+static int test_finish_suite(void)
+{
+	return 0;
+}
+
+void testloopback_add_suite()
+{
+	CU_pSuite suite = CU_add_suite("Loopback Plugin Test Suite",
+				       test_init_suite, test_finish_suite);
+
+	/* Add tests here - Start */
+	CU_add_test(suite, "testloopback_ringbuff", testloopback_ringbuff);
+	CU_add_test(suite, "testloopback_association", testloopback_association);
+	CU_add_test(suite, "testloopback_peer", testloopback_peer);
+	CU_add_test(suite, "testloopback_event_report_template",
+		    testloopback_event_report_template);
+	CU_add_test(suite, "testloopback_batch", testloopback_batch);
+	CU_add_test(suite, "testloopback_measurement_batch",
+		    testloopback_measurement_batch);
+	CU_add_test(suite, "testloopback_subscriptions",
+		    testloopback_subscriptions);
+	CU_add_test(suite, "testloopback_event_report_ack",
+		    testloopback_event_report_ack);
+
+	/* Add tests here - End */
+}
+
+void testloopback_ringbuff()
+{
+	intu8 in[100];
+	intu8 out[100];
+	int i;
+
+	for (i = 0; i < 100; ++i) {
+		in[i] = i;
+	}
+
+	RingBuffer *rb = ringbuff_new(100);
+	CU_ASSERT_EQUAL(rb->capacity, 128);
+	CU_ASSERT_EQUAL(ringbuff_free_space(rb), 128);
+
+	CU_ASSERT_TRUE(ringbuff_write(rb, in, 100));
+	CU_ASSERT_FALSE(ringbuff_write(rb, in, 100));
+	CU_ASSERT_EQUAL(ringbuff_used(rb), 100);
+
+	CU_ASSERT_TRUE(ringbuff_peek(rb, out, 4));
+	CU_ASSERT_EQUAL(ringbuff_used(rb), 100);
+	CU_ASSERT_TRUE(ringbuff_read(rb, out, 60));
+	CU_ASSERT_EQUAL(memcmp(in, out, 60), 0);
+
+	// this one wraps around the end of storage
+	CU_ASSERT_TRUE(ringbuff_write(rb, in, 80));
+	CU_ASSERT_FALSE(ringbuff_read(rb, out, 121));
+	CU_ASSERT_TRUE(ringbuff_skip(rb, 40));
+	CU_ASSERT_TRUE(ringbuff_read(rb, out, 80));
+	CU_ASSERT_EQUAL(memcmp(in, out, 80), 0);
+	CU_ASSERT_EQUAL(ringbuff_used(rb), 0);
+
+	ringbuff_del(rb);
+}
+
+static void *oximeter_data_cb()
+{
+	struct oximeter_event_report_data *data =
+		calloc(1, sizeof(struct oximeter_event_report_data));
+
+	data->beats = 70;
+	data->oximetry = 97;
+	data->century = 20;
+	data->year = 26;
+	data->month = 10;
+	data->day = 18;
+
+	return data;
+}
+
+static void *blood_pressure_data_cb()
+{
+	struct blood_pressure_event_report_data *data =
+		calloc(1, sizeof(struct blood_pressure_event_report_data));
+
+	data->systolic = 120;
+	data->diastolic = 80;
+	data->mean = 90;
+	data->pulse_rate = 60 + measurement_count;
+	data->century = 20;
+	data->year = 26;
+	data->month = 10;
+	data->day = 18;
+	data->second = measurement_count;
+
+	return data;
+}
+
+static struct mds_system_data *mds_data_cb()
+{
+	struct mds_system_data *data = calloc(1, sizeof(struct mds_system_data));
+	data->system_id[7] = 0x42;
+	return data;
+}
+
+static void agent_connected(Context *ctx, const char *addr)
+{
+	agent_associate(ctx->id);
+}
+
+static void manager_available(Context *ctx, DataList *list)
+{
+	++available_count;
+}
+
+static void manager_measurement(Context *ctx, DataList *list)
+{
+	++measurement_count;
+	measurement_size = list->size;
+	measurement_attrs[0] = measurement_attrs[1] = -1;
+
+	int i;
+
+	for (i = 0; i < list->size && i < 2; ++i) {
+		measurement_attrs[i] = list->values[i].u.compound.entries_count;
+	}
+}
+
+static int manager_disconnected(Context *ctx, const char *addr)
+{
+	++disconnected_count;
+	return 1;
+}
+
+static void process_all()
+{
+	while (plugin_loopback_process(MANAGER_CONTEXT | AGENT_CONTEXT) > 0)
+		;
+}
+
+void testloopback_association()
+{
+	unsigned int i;
+
+	manager_plugin = communication_plugin();
+	agent_plugin = communication_plugin();
+
+	CU_ASSERT_EQUAL(plugin_loopback_setup(&manager_plugin, &agent_plugin,
+					      LOOPBACK_TEST_PAIRS, 0),
+			NETWORK_ERROR_NONE);
+
+	CommunicationPlugin *mplugins[] = {&manager_plugin, 0};
+	CommunicationPlugin *aplugins[] = {&agent_plugin, 0};
+
+	manager_init(mplugins);
+	agent_init(aplugins, 0x0190, oximeter_data_cb, mds_data_cb);
+
+	ManagerListener mlistener = MANAGER_LISTENER_EMPTY;
+	mlistener.device_available = manager_available;
+	mlistener.measurement_data_updated = manager_measurement;
+	mlistener.device_disconnected = manager_disconnected;
+	manager_add_listener(mlistener);
+
+	AgentListener alistener = AGENT_LISTENER_EMPTY;
+	alistener.device_connected = agent_connected;
+	agent_add_listener(alistener);
+
+	manager_start();
+
+	for (i = 1; i <= LOOPBACK_TEST_PAIRS; ++i) {
+		CU_ASSERT_EQUAL(plugin_loopback_connect(i), NETWORK_ERROR_NONE);
+	}
+
+	// already connected
+	CU_ASSERT_EQUAL(plugin_loopback_connect(1), NETWORK_ERROR);
+
+	process_all();
+	CU_ASSERT_EQUAL(available_count, LOOPBACK_TEST_PAIRS);
+
+	for (i = 1; i <= LOOPBACK_TEST_PAIRS; ++i) {
+		ContextId mgr_id = {communication_plugin_id(&manager_plugin), i};
+		ContextId agent_id = {communication_plugin_id(&agent_plugin), i};
+
+		Context *ctx = context_get_and_lock(mgr_id);
+		CU_ASSERT_PTR_NOT_NULL(ctx);
+		CU_ASSERT_EQUAL(communication_get_state(ctx), fsm_state_operating);
+		context_unlock(ctx);
+
+		agent_send_data(agent_id);
+	}
+
+	process_all();
+	CU_ASSERT_EQUAL(measurement_count, LOOPBACK_TEST_PAIRS);
+
+	CommunicationStats stats;
+	ContextId mgr_id = {communication_plugin_id(&manager_plugin), 2};
+	CU_ASSERT_TRUE(manager_get_context_stats(mgr_id, &stats));
+	CU_ASSERT_EQUAL(stats.apdus_in[STATS_APDU_AARQ], 1);
+	CU_ASSERT_EQUAL(stats.apdus_out[STATS_APDU_AARE], 1);
+	CU_ASSERT(stats.bytes_in[STATS_APDU_AARQ] > 4);
+	CU_ASSERT(stats.apdus_in[STATS_APDU_PRST] >= 1);
+	CU_ASSERT_EQUAL(stats.associations, 1);
+	CU_ASSERT_EQUAL(stats.associated, 1);
+	CU_ASSERT_EQUAL(stats.pending_requests, 0);
+	CU_ASSERT_EQUAL(stats.decode_errors, 0);
+
+	// oximeter agent sends unconfirmed event reports, nothing to ack
+	LatencyHistogram hist;
+	CU_ASSERT_TRUE(manager_get_context_latency(mgr_id, STATS_OP_EVENT_REPORT_ACK,
+						   &hist));
+	CU_ASSERT_EQUAL(hist.count, 0);
+
+	manager_get_stats(&stats);
+	CU_ASSERT(stats.contexts >= 2 * LOOPBACK_TEST_PAIRS);
+	CU_ASSERT(stats.associated >= 2 * LOOPBACK_TEST_PAIRS);
+
+	// agent-initiated release and disconnection of pair 1
+	ContextId agent_id = {communication_plugin_id(&agent_plugin), 1};
+	agent_request_association_release(agent_id);
+	process_all();
+	agent_disconnect(agent_id);
+	process_all();
+
+	CU_ASSERT_FALSE(plugin_loopback_is_connected(1));
+	CU_ASSERT_EQUAL(disconnected_count, 1);
+
+	// pair may be reused
+	CU_ASSERT_EQUAL(plugin_loopback_connect(1), NETWORK_ERROR_NONE);
+	process_all();
+	CU_ASSERT_EQUAL(available_count, LOOPBACK_TEST_PAIRS + 1);
+	CU_ASSERT_EQUAL(plugin_loopback_dropped_apdus(), 0);
+
+	agent_finalize();
+	manager_finalize();
+}
+
+void testloopback_peer()
+{
+	unsigned long size = 0;
+	intu8 reply[256];
+
+	available_count = 0;
+	manager_plugin = communication_plugin();
+
+	CU_ASSERT_EQUAL(plugin_loopback_setup(&manager_plugin, NULL, 1, 0),
+			NETWORK_ERROR_NONE);
+
+	CommunicationPlugin *mplugins[] = {&manager_plugin, 0};
+	manager_init(mplugins);
+	manager_start();
+
+	// no agent side; application plays it
+	CU_ASSERT_EQUAL(plugin_loopback_connect(1), NETWORK_ERROR);
+	CU_ASSERT_EQUAL(plugin_loopback_peer_connect(1), NETWORK_ERROR_NONE);
+
+	intu8 *aarq = ioutil_buffer_from_file(
+		"tests/resources/apdu/blood_pressure/aarq", &size);
+	CU_ASSERT_PTR_NOT_NULL(aarq);
+
+	CU_ASSERT_EQUAL(plugin_loopback_peer_send(1, aarq, size),
+			NETWORK_ERROR_NONE);
+	CU_ASSERT_EQUAL(plugin_loopback_peer_recv(1, reply, sizeof(reply)), 0);
+
+	plugin_loopback_process(MANAGER_CONTEXT);
+
+	CU_ASSERT(plugin_loopback_peer_recv(1, reply, sizeof(reply)) > 0);
+	CU_ASSERT_EQUAL(reply[0], 0xE3);
+
+	plugin_loopback_peer_disconnect(1);
+	plugin_loopback_process(MANAGER_CONTEXT);
+
+	// manager has seen the disconnection, pair is free again
+	CU_ASSERT_EQUAL(plugin_loopback_peer_connect(1), NETWORK_ERROR_NONE);
+
+	free(aarq);
+	manager_finalize();
+}
+
+static int peer_exchange(const char *path, intu8 *reply, int size)
+{
+	unsigned long length = 0;
+	intu8 *apdu = ioutil_buffer_from_file(path, &length);
+
+	CU_ASSERT_PTR_NOT_NULL(apdu);
+
+	if (apdu == NULL) {
+		return -1;
+	}
+
+	CU_ASSERT_EQUAL(plugin_loopback_peer_send(1, apdu, length),
+			NETWORK_ERROR_NONE);
+	plugin_loopback_process(MANAGER_CONTEXT);
+	free(apdu);
+
+	return plugin_loopback_peer_recv(1, reply, size);
+}
+
+void testloopback_event_report_ack()
+{
+	intu8 reply[256];
+	int length;
+
+	manager_plugin = communication_plugin();
+
+	CU_ASSERT_EQUAL(plugin_loopback_setup(&manager_plugin, NULL, 1, 0),
+			NETWORK_ERROR_NONE);
+
+	CommunicationPlugin *mplugins[] = {&manager_plugin, 0};
+	manager_init(mplugins);
+	manager_start();
+
+	CU_ASSERT_EQUAL(plugin_loopback_peer_connect(1), NETWORK_ERROR_NONE);
+
+	peer_exchange("tests/resources/apdu/blood_pressure/aarq", reply,
+		      sizeof(reply));
+	peer_exchange("tests/resources/apdu/blood_pressure/roiv_mdc_noti_config",
+		      reply, sizeof(reply));
+
+	length = peer_exchange("tests/resources/apdu/blood_pressure/"
+			       "roiv_mds_note_scan_report_mp_fixed",
+			       reply, sizeof(reply));
+
+	// response patched from template must match encoder output
+	APDU apdu;
+	DATA_apdu data_apdu;
+	memset(&apdu, 0, sizeof(APDU));
+	memset(&data_apdu, 0, sizeof(DATA_apdu));
+
+	apdu.choice = PRST_CHOSEN;
+	apdu.length = 18;
+	apdu.u.prst.length = 16;
+	data_apdu.invoke_id = 0x0001;
+	data_apdu.message.choice = RORS_CMIP_CONFIRMED_EVENT_REPORT_CHOSEN;
+	data_apdu.message.length = 10;
+	data_apdu.message.u.rors_cmipConfirmedEventReport.obj_handle = 0;
+	data_apdu.message.u.rors_cmipConfirmedEventReport.currentTime =
+		0xFFFFFFFF;
+	data_apdu.message.u.rors_cmipConfirmedEventReport.event_type =
+		MDC_NOTI_SCAN_REPORT_MP_FIXED;
+	encode_set_data_apdu(&apdu.u.prst, &data_apdu);
+
+	ByteStreamWriter *expected = byte_stream_writer_instance(22);
+	encode_apdu(expected, &apdu);
+
+	CU_ASSERT_EQUAL(length, (int) expected->size);
+	CU_ASSERT_EQUAL(memcmp(reply, expected->buffer, expected->size), 0);
+
+	del_byte_stream_writer(expected, 1);
+
+	plugin_loopback_peer_disconnect(1);
+	plugin_loopback_process(MANAGER_CONTEXT);
+	manager_finalize();
+}
+
+/**
+ * Compares the event report patched from template with encoder output
+ */
+static void assert_template_encoding(struct StdConfiguration *cfg,
+				     void *first, void *second)
+{
+	intu8 buffer[512];
+	ByteStreamWriter writer = {0, buffer, sizeof(buffer), 0};
+	APDU apdu;
+
+	// first report builds the template, second one is patched
+	CU_ASSERT_TRUE(event_template_encode(cfg, first, &writer));
+	writer.size = 0;
+	CU_ASSERT_TRUE(event_template_encode(cfg, second, &writer));
+
+	DATA_apdu *data = cfg->event_report(second);
+	apdu.choice = PRST_CHOSEN;
+	apdu.u.prst.length = data->message.length + 6;
+	apdu.length = apdu.u.prst.length + 2;
+	encode_set_data_apdu(&apdu.u.prst, data);
+
+	ByteStreamWriter *expected = byte_stream_writer_instance(apdu.length + 4);
+	encode_apdu(expected, &apdu);
+
+	CU_ASSERT_EQUAL(writer.size, expected->size);
+	CU_ASSERT_EQUAL(memcmp(buffer, expected->buffer, expected->size), 0);
+
+	del_byte_stream_writer(expected, 1);
+	del_data_apdu(data);
+	free(data);
+	free(cfg->event_report_template);
+	free(cfg);
+	free(first);
+	free(second);
+}
+
+void testloopback_event_report_template()
+{
+	struct oximeter_event_report_data *oximeter;
+	struct glucometer_event_report_data *glucose;
+	struct weightscale_event_report_data *weight;
+	struct blood_pressure_event_report_data *pressure;
+	int i;
+
+	pressure = blood_pressure_data_cb();
+	pressure->systolic = 135;
+	pressure->pulse_rate = 77;
+	pressure->second = 30;
+	assert_template_encoding(blood_pressure_monitor_create_std_config_ID02BC(),
+				 blood_pressure_data_cb(), pressure);
+
+	oximeter = oximeter_data_cb();
+	oximeter->oximetry = 95;
+	oximeter->minute = 42;
+	assert_template_encoding(pulse_oximeter_create_std_config_ID0191(),
+				 oximeter_data_cb(), oximeter);
+
+	glucose = calloc(1, sizeof(struct glucometer_event_report_data));
+	glucose->capillary_whole_blood = 5.5;
+	glucose->year = 26;
+	assert_template_encoding(glucometer_create_std_config_ID06A4(),
+				 calloc(1, sizeof(struct glucometer_event_report_data)),
+				 glucose);
+
+	weight = calloc(1, sizeof(struct weightscale_event_report_data));
+	weight->weight = 70.2;
+	weight->bmi = 22.5;
+	weight->hour = 13;
+	assert_template_encoding(weighting_scale_create_std_config_ID05DC(),
+				 calloc(1, sizeof(struct weightscale_event_report_data)),
+				 weight);
+
+	// confirmed reports from template are acknowledged by manager
+	manager_plugin = communication_plugin();
+	agent_plugin = communication_plugin();
+
+	CU_ASSERT_EQUAL(plugin_loopback_setup(&manager_plugin, &agent_plugin,
+					      1, 0),
+			NETWORK_ERROR_NONE);
+
+	CommunicationPlugin *mplugins[] = {&manager_plugin, 0};
+	CommunicationPlugin *aplugins[] = {&agent_plugin, 0};
+
+	manager_init(mplugins);
+	agent_init(aplugins, 0x02BC, blood_pressure_data_cb, mds_data_cb);
+
+	ManagerListener mlistener = MANAGER_LISTENER_EMPTY;
+	mlistener.measurement_data_updated = manager_measurement;
+	manager_add_listener(mlistener);
+
+	AgentListener alistener = AGENT_LISTENER_EMPTY;
+	alistener.device_connected = agent_connected;
+	agent_add_listener(alistener);
+
+	manager_start();
+
+	CU_ASSERT_EQUAL(plugin_loopback_connect(1), NETWORK_ERROR_NONE);
+	process_all();
+
+	ContextId agent_id = {communication_plugin_id(&agent_plugin), 1};
+	measurement_count = 0;
+
+	for (i = 1; i <= 3; ++i) {
+		agent_send_data(agent_id);
+		process_all();
+		CU_ASSERT_EQUAL(measurement_count, i);
+	}
+
+	Context *ctx = context_get_and_lock(agent_id);
+	CU_ASSERT_PTR_NOT_NULL(ctx);
+	if (ctx) {
+		CU_ASSERT_EQUAL(ctx->service->requests_count, 0);
+		context_unlock(ctx);
+	}
+
+	CU_ASSERT_EQUAL(plugin_loopback_dropped_apdus(), 0);
+
+	agent_finalize();
+	manager_finalize();
+}
+
+void testloopback_batch()
+{
+	CommunicationStats stats;
+
+	manager_plugin = communication_plugin();
+	agent_plugin = communication_plugin();
+
+	CU_ASSERT_EQUAL(plugin_loopback_setup(&manager_plugin, &agent_plugin,
+					      1, 0),
+			NETWORK_ERROR_NONE);
+
+	CommunicationPlugin *mplugins[] = {&manager_plugin, 0};
+	CommunicationPlugin *aplugins[] = {&agent_plugin, 0};
+
+	manager_init(mplugins);
+	agent_init(aplugins, 0x02BC, blood_pressure_data_cb, mds_data_cb);
+
+	ManagerListener mlistener = MANAGER_LISTENER_EMPTY;
+	mlistener.measurement_data_updated = manager_measurement;
+	manager_add_listener(mlistener);
+
+	AgentListener alistener = AGENT_LISTENER_EMPTY;
+	alistener.device_connected = agent_connected;
+	agent_add_listener(alistener);
+
+	manager_start();
+
+	CU_ASSERT_EQUAL(plugin_loopback_connect(1), NETWORK_ERROR_NONE);
+	process_all();
+
+	ContextId agent_id = {communication_plugin_id(&agent_plugin), 1};
+	ContextId mgr_id = {communication_plugin_id(&manager_plugin), 1};
+	measurement_count = 0;
+
+	// three readings in a single fixed scan report
+	agent_set_batching(3, 60000);
+	agent_queue_data(agent_id);
+	agent_queue_data(agent_id);
+	process_all();
+	CU_ASSERT_EQUAL(measurement_count, 0);
+	CU_ASSERT(agent_poll_data(agent_id) > 0);
+
+	agent_queue_data(agent_id);
+	process_all();
+	CU_ASSERT_EQUAL(measurement_count, 1);
+	CU_ASSERT_EQUAL(agent_poll_data(agent_id), -1);
+
+	// two persons, one notification each
+	agent_queue_person_data(agent_id, 1);
+	agent_queue_person_data(agent_id, 2);
+	CU_ASSERT_TRUE(agent_flush_data(agent_id));
+	CU_ASSERT_FALSE(agent_flush_data(agent_id));
+	process_all();
+	CU_ASSERT_EQUAL(measurement_count, 3);
+
+	// window elapsed
+	agent_set_batching(10, 1);
+	agent_queue_data(agent_id);
+	usleep(2000);
+	CU_ASSERT_EQUAL(agent_poll_data(agent_id), -1);
+	process_all();
+	CU_ASSERT_EQUAL(measurement_count, 4);
+
+	CU_ASSERT_TRUE(manager_get_context_stats(mgr_id, &stats));
+	CU_ASSERT_EQUAL(stats.decode_errors, 0);
+	CU_ASSERT_EQUAL(stats.pending_requests, 0);
+	CU_ASSERT_EQUAL(plugin_loopback_dropped_apdus(), 0);
+
+	// not operating, readings are refused
+	agent_request_association_release(agent_id);
+	process_all();
+	CU_ASSERT_FALSE(agent_queue_data(agent_id));
+	CU_ASSERT_EQUAL(agent_poll_data(agent_id), -1);
+
+	agent_set_batching(0, 0);
+	agent_finalize();
+	manager_finalize();
+}
+
+void testloopback_measurement_batch()
+{
+	manager_plugin = communication_plugin();
+	agent_plugin = communication_plugin();
+
+	CU_ASSERT_EQUAL(plugin_loopback_setup(&manager_plugin, &agent_plugin,
+					      1, 0),
+			NETWORK_ERROR_NONE);
+
+	CommunicationPlugin *mplugins[] = {&manager_plugin, 0};
+	CommunicationPlugin *aplugins[] = {&agent_plugin, 0};
+
+	manager_init(mplugins);
+	agent_init(aplugins, 0x02BC, blood_pressure_data_cb, mds_data_cb);
+
+	ManagerListener mlistener = MANAGER_LISTENER_EMPTY;
+	mlistener.measurement_data_updated = manager_measurement;
+	manager_add_listener(mlistener);
+
+	AgentListener alistener = AGENT_LISTENER_EMPTY;
+	alistener.device_connected = agent_connected;
+	agent_add_listener(alistener);
+
+	manager_start();
+
+	CU_ASSERT_EQUAL(plugin_loopback_connect(1), NETWORK_ERROR_NONE);
+	process_all();
+
+	ContextId agent_id = {communication_plugin_id(&agent_plugin), 1};
+	ContextId mgr_id = {communication_plugin_id(&manager_plugin), 1};
+	measurement_count = 0;
+
+	agent_send_data(agent_id);
+	process_all();
+	CU_ASSERT_EQUAL(measurement_count, 1);
+	int report_size = measurement_size;
+	CU_ASSERT(report_size > 0);
+
+	// three reports in a single notification
+	manager_set_measurement_batching(3, 60000);
+	agent_send_data(agent_id);
+	agent_send_data(agent_id);
+	process_all();
+	CU_ASSERT_EQUAL(measurement_count, 1);
+	CU_ASSERT(manager_poll_measurements(mgr_id) > 0);
+
+	agent_send_data(agent_id);
+	process_all();
+	CU_ASSERT_EQUAL(measurement_count, 2);
+	CU_ASSERT_EQUAL(measurement_size, 3 * report_size);
+	CU_ASSERT_EQUAL(manager_poll_measurements(mgr_id), -1);
+
+	agent_send_data(agent_id);
+	process_all();
+	CU_ASSERT_TRUE(manager_flush_measurements(mgr_id));
+	CU_ASSERT_FALSE(manager_flush_measurements(mgr_id));
+	CU_ASSERT_EQUAL(measurement_count, 3);
+	CU_ASSERT_EQUAL(measurement_size, report_size);
+
+	// queued data is notified before device leaves
+	agent_send_data(agent_id);
+	process_all();
+	agent_request_association_release(agent_id);
+	process_all();
+	CU_ASSERT_EQUAL(measurement_count, 4);
+
+	manager_set_measurement_batching(0, 0);
+	agent_finalize();
+	manager_finalize();
+}
+
+void testloopback_subscriptions()
+{
+	manager_plugin = communication_plugin();
+	agent_plugin = communication_plugin();
+
+	CU_ASSERT_EQUAL(plugin_loopback_setup(&manager_plugin, &agent_plugin,
+					      1, 0),
+			NETWORK_ERROR_NONE);
+
+	CommunicationPlugin *mplugins[] = {&manager_plugin, 0};
+	CommunicationPlugin *aplugins[] = {&agent_plugin, 0};
+
+	manager_init(mplugins);
+	agent_init(aplugins, 0x02BC, blood_pressure_data_cb, mds_data_cb);
+
+	// pulse rate, and time stamp of blood pressure
+	ManagerSubscription subscriptions[] = {
+		{NULL, 0, MDC_PART_SCADA, MDC_PULS_RATE_NON_INV, 0},
+		{NULL, 1, 0, 0, MDC_ATTR_TIME_STAMP_ABS},
+	};
+
+	ManagerListener mlistener = MANAGER_LISTENER_EMPTY;
+	mlistener.measurement_data_updated = manager_measurement;
+	mlistener.subscriptions = subscriptions;
+	mlistener.subscription_count = 2;
+	manager_add_listener(mlistener);
+
+	AgentListener alistener = AGENT_LISTENER_EMPTY;
+	alistener.device_connected = agent_connected;
+	agent_add_listener(alistener);
+
+	manager_start();
+
+	CU_ASSERT_EQUAL(plugin_loopback_connect(1), NETWORK_ERROR_NONE);
+	process_all();
+
+	ContextId agent_id = {communication_plugin_id(&agent_plugin), 1};
+	measurement_count = 0;
+
+	agent_send_data(agent_id);
+	process_all();
+	CU_ASSERT_EQUAL(measurement_count, 1);
+	CU_ASSERT_EQUAL(measurement_size, 2);
+	CU_ASSERT_EQUAL(measurement_attrs[0], 1);
+	CU_ASSERT_EQUAL(measurement_attrs[1], 2);
+
+	// pulse rate only
+	manager_remove_all_listeners();
+	mlistener.subscription_count = 1;
+	manager_add_listener(mlistener);
+
+	agent_send_data(agent_id);
+	process_all();
+	CU_ASSERT_EQUAL(measurement_count, 2);
+	CU_ASSERT_EQUAL(measurement_size, 1);
+	CU_ASSERT_EQUAL(measurement_attrs[0], 2);
+
+	// a listener of everything
+	ManagerListener all = MANAGER_LISTENER_EMPTY;
+	all.measurement_data_updated = manager_measurement;
+	manager_add_listener(all);
+
+	agent_send_data(agent_id);
+	process_all();
+	CU_ASSERT_EQUAL(measurement_count, 4);
+	CU_ASSERT_EQUAL(measurement_size, 2);
+	CU_ASSERT_EQUAL(measurement_attrs[0], 2);
+
+	agent_finalize();
+	manager_finalize();
+}
+
+#endif
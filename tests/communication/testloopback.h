@@ -0,0 +1,45 @@
+/**********************************************************************
+ * Copyright (C) 2010 Signove Tecnologia Corporation.
+ * All rights reserved.
+ * Contact: Signove Tecnologia Corporation (contact@signove.com)
+ *
+ * $LICENSE_TEXT:BEGIN$
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation and appearing
+ * in the file LICENSE included in the packaging of this file; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ * $LICENSE_TEXT:END$
+ *
+ * testloopback.h
+ *
+ * Created on: Oct 18, 2026
+ **********************************************************************/
+
+#ifndef TESTLOOPBACK_H_
+#define TESTLOOPBACK_H_
+
+#ifdef TEST_ENABLED
+
+void testloopback_add_suite();
+void testloopback_ringbuff();
+void testloopback_association();
+void testloopback_peer();
+void testloopback_event_report_template();
+void testloopback_batch();
+void testloopback_measurement_batch();
+void testloopback_subscriptions();
+void testloopback_event_report_ack();
+
+#endif /* TEST_ENABLED */
+
+#endif /* TESTLOOPBACK_H_ */
@@ -0,0 +1,142 @@
+/**********************************************************************
+ * Copyright (C) 2010 Signove Tecnologia Corporation.
+ * All rights reserved.
+ * Contact: Signove Tecnologia Corporation (contact@signove.com)
+ *
+ * $LICENSE_TEXT:BEGIN$
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation and appearing
+ * in the file LICENSE included in the packaging of this file; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ * $LICENSE_TEXT:END$
+ *
+ * teststats.c
+ *
+ * Created on: Oct 18, 2026
+ **********************************************************************/
+
+#ifdef TEST_ENABLED
+
+#include "teststats.h"
+#include "src/communication/stats.h"
+#include "src/communication/context.h"
+#include "Basic.h"
+#include <stdlib.h>
+#include <string.h>
+
+static int test_init_suite(void)
+{
+	return 0;
+}
+
+static int test_finish_suite(void)
+{
+	return 0;
+}
+
+void teststats_add_suite()
+{
+	CU_pSuite suite = CU_add_suite("Communication Stats Test Suite",
+				       test_init_suite, test_finish_suite);
+
+	/* Add tests here - Start */
+	CU_add_test(suite, "teststats_latency_percentiles",
+		    teststats_latency_percentiles);
+	CU_add_test(suite, "teststats_latency_operations",
+		    teststats_latency_operations);
+
+	/* Add tests here - End */
+}
+
+void teststats_latency_percentiles()
+{
+	LatencyHistogram hist;
+	Context *ctx = calloc(1, sizeof(Context));
+	unsigned long long p;
+	int i;
+
+	stats_context_created(ctx);
+
+	stats_get_context_latency(ctx, STATS_OP_GET, &hist);
+	CU_ASSERT_EQUAL(hist.count, 0);
+	CU_ASSERT_EQUAL(stats_latency_percentile(&hist, 99.0), 0);
+
+	for (i = 1; i <= 1000; ++i) {
+		stats_latency_record(ctx, STATS_OP_GET, i);
+	}
+
+	stats_latency_record(ctx, STATS_OP_SET, 5);
+
+	stats_get_context_latency(ctx, STATS_OP_GET, &hist);
+	CU_ASSERT_EQUAL(hist.count, 1000);
+	CU_ASSERT_EQUAL(hist.sum, 500500);
+	CU_ASSERT_EQUAL(hist.max, 1000);
+
+	// bucket upper bounds are at most 12.5% above actual value
+	p = stats_latency_percentile(&hist, 50.0);
+	CU_ASSERT(p >= 500 && p <= 563);
+	p = stats_latency_percentile(&hist, 99.9);
+	CU_ASSERT(p >= 999 && p <= 1000);
+	CU_ASSERT_EQUAL(stats_latency_percentile(&hist, 100.0), 1000);
+	CU_ASSERT_EQUAL(stats_latency_percentile(&hist, 0.0), 1);
+
+	// values below 8us are exact
+	stats_get_context_latency(ctx, STATS_OP_SET, &hist);
+	CU_ASSERT_EQUAL(stats_latency_percentile(&hist, 50.0), 5);
+
+	// very large values land in the last bucket
+	stats_latency_record(ctx, STATS_OP_ACTION, 1ULL << 40);
+	stats_get_context_latency(ctx, STATS_OP_ACTION, &hist);
+	CU_ASSERT_EQUAL(hist.buckets[STATS_LATENCY_BUCKETS - 1], 1);
+	CU_ASSERT_EQUAL(stats_latency_percentile(&hist, 50.0), 1ULL << 40);
+
+	stats_context_destroyed(ctx);
+	CU_ASSERT_PTR_NULL(ctx->latency);
+	free(ctx);
+}
+
+void teststats_latency_operations()
+{
+	LatencyHistogram before;
+	LatencyHistogram after;
+	Context *ctx = calloc(1, sizeof(Context));
+	const unsigned char prst[] = {0xE7, 0x00, 0x00, 0x02, 0x00, 0x00};
+
+	stats_context_created(ctx);
+	stats_get_global_latency(STATS_OP_EVENT_REPORT_ACK, &before);
+
+	// no event report received yet
+	stats_event_report_acked(ctx);
+	stats_get_context_latency(ctx, STATS_OP_EVENT_REPORT_ACK, &after);
+	CU_ASSERT_EQUAL(after.count, 0);
+
+	stats_apdu_received(ctx, prst, sizeof(prst));
+	stats_event_report_acked(ctx);
+
+	// acknowledged only once
+	stats_event_report_acked(ctx);
+
+	stats_get_context_latency(ctx, STATS_OP_EVENT_REPORT_ACK, &after);
+	CU_ASSERT_EQUAL(after.count, 1);
+	stats_get_global_latency(STATS_OP_EVENT_REPORT_ACK, &after);
+	CU_ASSERT_EQUAL(after.count, before.count + 1);
+
+	// unknown operations are ignored
+	stats_latency_record(ctx, -1, 10);
+	stats_latency_record(ctx, STATS_OP_TYPES, 10);
+
+	stats_context_destroyed(ctx);
+	free(ctx);
+}
+
+#endif
@@ -0,0 +1,339 @@
+/**********************************************************************
+ * Copyright (C) 2010 Signove Tecnologia Corporation.
+ * All rights reserved.
+ * Contact: Signove Tecnologia Corporation (contact@signove.com)
+ *
+ * $LICENSE_TEXT:BEGIN$
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation and appearing
+ * in the file LICENSE included in the packaging of this file; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ * $LICENSE_TEXT:END$
+ *
+ * testuring.c
+ *
+ * Created on: Oct 18, 2026
+ **********************************************************************/
+
+#ifdef TEST_ENABLED
+
+#include "testuring.h"
+#include "src/manager_p.h"
+#include "src/communication/plugin/plugin_tcp_uring.h"
+#include "src/util/ioutil.h"
+#include "Basic.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#define URING_TEST_PORT 6093
+
+static int measurement_count = 0;
+
+static int test_init_suite(void)
+{
+	return 0;
+}
+
+static int test_finish_suite(void)
+{
+	return 0;
+}
+
+void testuring_add_suite()
+{
+	CU_pSuite suite = CU_add_suite("io_uring TCP Plugin Test Suite",
+				       test_init_suite, test_finish_suite);
+
+	/* Add tests here - Start */
+	CU_add_test(suite, "testuring_association", testuring_association);
+	CU_add_test(suite, "testuring_reuseport", testuring_reuseport);
+	CU_add_test(suite, "testuring_handoff", testuring_handoff);
+
+	/* Add tests here - End */
+}
+
+static int connect_client()
+{
+	struct sockaddr_in addr;
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(URING_TEST_PORT);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+static int client_recv(int fd, intu8 *buffer, int size)
+{
+	struct pollfd pfd = {fd, POLLIN, 0};
+	int tries;
+
+	for (tries = 0; tries < 50; ++tries) {
+		plugin_tcp_uring_process(20);
+
+		if (poll(&pfd, 1, 0) > 0) {
+			return recv(fd, buffer, size, 0);
+		}
+	}
+
+	return -1;
+}
+
+static void send_file(int fd, const char *path, intu8 *reply, int size,
+		      int *received)
+{
+	unsigned long length = 0;
+	intu8 *apdu = ioutil_buffer_from_file(path, &length);
+
+	CU_ASSERT_PTR_NOT_NULL(apdu);
+
+	if (apdu) {
+		CU_ASSERT_EQUAL(send(fd, apdu, length, 0), (int) length);
+		*received = client_recv(fd, reply, size);
+		free(apdu);
+	}
+}
+
+static void process_until_connections(unsigned int count)
+{
+	int tries;
+
+	for (tries = 0; tries < 50; ++tries) {
+		if (plugin_tcp_uring_connection_count() == count) {
+			break;
+		}
+		plugin_tcp_uring_process(20);
+	}
+}
+
+void testuring_association()
+{
+	CommunicationPlugin plugin = communication_plugin();
+	unsigned long size = 0;
+	intu8 reply[256];
+
+	if (plugin_tcp_uring_setup(&plugin, URING_TEST_PORT, 8)
+	    != NETWORK_ERROR_NONE) {
+		// kernel without io_uring; plain TCP plugin is the fallback
+		return;
+	}
+
+	CommunicationPlugin *plugins[] = {&plugin, 0};
+	manager_init(plugins);
+	manager_start();
+
+	CU_ASSERT(plugin_tcp_uring_fd() >= 0);
+
+	int fd = connect_client();
+	CU_ASSERT(fd >= 0);
+
+	if (fd < 0) {
+		manager_finalize();
+		return;
+	}
+
+	process_until_connections(1);
+	CU_ASSERT_EQUAL(plugin_tcp_uring_connection_count(), 1);
+
+	intu8 *aarq = ioutil_buffer_from_file(
+		"tests/resources/apdu/blood_pressure/aarq", &size);
+	CU_ASSERT_PTR_NOT_NULL(aarq);
+
+	if (aarq) {
+		// split header, so that APDU must be reassembled
+		CU_ASSERT_EQUAL(send(fd, aarq, 3, 0), 3);
+		plugin_tcp_uring_process(20);
+		CU_ASSERT_EQUAL(send(fd, aarq + 3, size - 3, 0), (int) size - 3);
+
+		CU_ASSERT(client_recv(fd, reply, sizeof(reply)) > 4);
+		CU_ASSERT_EQUAL(reply[0], 0xE3);
+		free(aarq);
+	}
+
+	close(fd);
+	process_until_connections(0);
+	CU_ASSERT_EQUAL(plugin_tcp_uring_connection_count(), 0);
+
+	manager_finalize();
+}
+
+static int bind_shared(int reuse)
+{
+	struct sockaddr_in addr;
+	int opt = 1;
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+	if (reuse) {
+		setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt));
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(URING_TEST_PORT);
+	addr.sin_addr.s_addr = INADDR_ANY;
+
+	if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0
+	    || listen(fd, 1) < 0) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+void testuring_reuseport()
+{
+	CommunicationPlugin plugin = communication_plugin();
+
+	if (plugin_tcp_uring_setup(&plugin, URING_TEST_PORT, 8)
+	    != NETWORK_ERROR_NONE) {
+		return;
+	}
+
+	plugin_tcp_uring_set_reuseport(1);
+
+	CommunicationPlugin *plugins[] = {&plugin, 0};
+	manager_init(plugins);
+	manager_start();
+
+	// another worker may listen on the same port, others may not
+	int fd = bind_shared(1);
+	CU_ASSERT(fd >= 0);
+	CU_ASSERT_EQUAL(bind_shared(0), -1);
+
+	if (fd >= 0) {
+		close(fd);
+	}
+
+	manager_finalize();
+	plugin_tcp_uring_set_reuseport(0);
+}
+
+static void measurement_received(Context *ctx, DataList *list)
+{
+	++measurement_count;
+}
+
+void testuring_handoff()
+{
+	CommunicationPlugin plugin = communication_plugin();
+	CommunicationPlugin *plugins[] = {&plugin, 0};
+	ManagerListener listener = MANAGER_LISTENER_EMPTY;
+	intu8 reply[256];
+	int received = 0;
+	int sv[2];
+
+	if (plugin_tcp_uring_setup(&plugin, URING_TEST_PORT, 8)
+	    != NETWORK_ERROR_NONE) {
+		return;
+	}
+
+	manager_init(plugins);
+	manager_start();
+
+	int fd = connect_client();
+	CU_ASSERT(fd >= 0);
+
+	if (fd < 0) {
+		manager_finalize();
+		return;
+	}
+
+	process_until_connections(1);
+
+	// associate, with extended configuration
+	send_file(fd, "tests/resources/apdu/blood_pressure/aarq", reply,
+		  sizeof(reply), &received);
+	CU_ASSERT(received > 4);
+	CU_ASSERT_EQUAL(reply[0], 0xE3);
+
+	send_file(fd, "tests/resources/apdu/blood_pressure/roiv_mdc_noti_config",
+		  reply, sizeof(reply), &received);
+	CU_ASSERT(received > 4);
+	CU_ASSERT_EQUAL(reply[0], 0xE7);
+
+	CU_ASSERT_EQUAL(socketpair(AF_UNIX, SOCK_STREAM, 0, sv), 0);
+
+	// old process lets go of everything, agent does not notice
+	CU_ASSERT_EQUAL(plugin_tcp_uring_handoff(sv[0]), NETWORK_ERROR_NONE);
+	CU_ASSERT_EQUAL(plugin_tcp_uring_connection_count(), 0);
+	close(sv[0]);
+	manager_finalize();
+
+	// new process resumes
+	plugin = communication_plugin();
+	CU_ASSERT_EQUAL(plugin_tcp_uring_setup(&plugin, URING_TEST_PORT, 8),
+			NETWORK_ERROR_NONE);
+	plugin_tcp_uring_set_takeover(sv[1]);
+
+	manager_init(plugins);
+	measurement_count = 0;
+	listener.measurement_data_updated = measurement_received;
+	manager_add_listener(listener);
+	manager_start();
+
+	CU_ASSERT_EQUAL(plugin_tcp_uring_connection_count(), 1);
+
+	CommunicationStats stats;
+	manager_get_stats(&stats);
+	CU_ASSERT_EQUAL(stats.associated, 1);
+
+	send_file(fd, "tests/resources/apdu/blood_pressure/"
+		  "roiv_mds_note_scan_report_mp_fixed", reply, sizeof(reply),
+		  &received);
+	CU_ASSERT(received > 4);
+	CU_ASSERT_EQUAL(reply[0], 0xE7);
+	CU_ASSERT_EQUAL(measurement_count, 1);
+
+	// two reports in one segment; acknowledgements go out together
+	unsigned long length = 0;
+	intu8 *report = ioutil_buffer_from_file("tests/resources/apdu/"
+			"blood_pressure/roiv_mds_note_scan_report_mp_fixed",
+			&length);
+	intu8 *reports = malloc(2 * length);
+	memcpy(reports, report, length);
+	memcpy(reports + length, report, length);
+	reports[length + 7] = 0x02; // invoke id
+
+	CU_ASSERT_EQUAL(send(fd, reports, 2 * length, 0), 2 * (int) length);
+	received = client_recv(fd, reply, sizeof(reply));
+	CU_ASSERT_EQUAL(received, 44);
+	CU_ASSERT_EQUAL(reply[7], 0x01);
+	CU_ASSERT_EQUAL(reply[22], 0xE7);
+	CU_ASSERT_EQUAL(reply[22 + 7], 0x02);
+	CU_ASSERT_EQUAL(measurement_count, 3);
+
+	free(report);
+	free(reports);
+	close(fd);
+	process_until_connections(0);
+	CU_ASSERT_EQUAL(plugin_tcp_uring_connection_count(), 0);
+
+	manager_finalize();
+}
+
+#endif
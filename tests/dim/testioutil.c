@@ -30,9 +30,13 @@
 
 #include "testioutil.h"
 #include "src/util/ioutil.h"
+#include "src/util/journal.h"
 #include "Basic.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <unistd.h>
 
 int test_ioutil_init_suite(void)
 {
@@ -51,6 +55,8 @@ void testioutil_add_suite()
 
 	/* Add tests here - Start */
 	CU_add_test(suite, "test_ioutil_get_tmp", test_ioutil_get_tmp);
+	CU_add_test(suite, "test_journal_replay", test_journal_replay);
+	CU_add_test(suite, "test_journal_defer", test_journal_defer);
 	/* Add tests here - End */
 }
 
@@ -59,4 +65,230 @@ void test_ioutil_get_tmp(void)
 	char *tmp = ioutil_get_tmp();
 	free(tmp);
 }
+/**
+ * Records seen by a journal consumer in test
+ */
+typedef struct {
+	int limit;
+	int count;
+	unsigned long long last;
+	int in_order;
+} journal_test_consumer;
+
+static int journal_test_deliver(intu16 type, unsigned long long seq,
+				const intu8 *data, intu32 length, void *arg)
+{
+	journal_test_consumer *c = arg;
+	char expected[48];
+
+	if (c->count >= c->limit)
+		return 0;
+
+	snprintf(expected, sizeof(expected), "record %llu", seq);
+
+	if ((c->last && seq != c->last + 1) || type != 7 || length != 40
+	    || strcmp((const char *) data, expected) != 0) {
+		c->in_order = 0;
+	}
+
+	c->last = seq;
+	c->count++;
+	return 1;
+}
+
+static void journal_test_append(Journal *journal, int first, int count)
+{
+	char record[40];
+	unsigned long long seq;
+	int i;
+
+	for (i = 0; i < count; ++i) {
+		memset(record, 0, sizeof(record));
+		snprintf(record, sizeof(record), "record %d", first + i);
+		CU_ASSERT_TRUE(journal_append(journal, 7, (intu8 *) record,
+					      sizeof(record), &seq));
+		CU_ASSERT_EQUAL(seq, first + i);
+	}
+}
+
+static int journal_test_replay(Journal *journal, int consumer, int limit,
+			       unsigned long long *last)
+{
+	journal_test_consumer c = {limit, 0, *last, 1};
+
+	journal_replay(journal, consumer, journal_test_deliver, &c);
+	CU_ASSERT_TRUE(c.in_order);
+	*last = c.last;
+	return c.count;
+}
+
+/**
+ * Removes a test journal directory
+ */
+static void journal_test_remove(char *dir)
+{
+	struct dirent *entry;
+	DIR *d = opendir(dir);
+
+	while (d && (entry = readdir(d)) != NULL) {
+		if (entry->d_name[0] != '.') {
+			char *path = malloc(strlen(dir) + strlen(entry->d_name) + 2);
+			sprintf(path, "%s/%s", dir, entry->d_name);
+			unlink(path);
+			free(path);
+		}
+	}
+
+	if (d)
+		closedir(d);
+
+	rmdir(dir);
+	free(dir);
+}
+
+void test_journal_replay(void)
+{
+	char *tmp = ioutil_get_tmp();
+	char *dir = malloc(strlen(tmp) + 16);
+	unsigned long long last_a = 0;
+	unsigned long long last_b = 0;
+	Journal *journal;
+
+	sprintf(dir, "%sjournalXXXXXX", tmp);
+	free(tmp);
+	CU_ASSERT_PTR_NOT_NULL(mkdtemp(dir));
+
+	// 4 records of 64 bytes per segment, 3 segments kept
+	journal = journal_open(dir, 256, 3);
+	CU_ASSERT_PTR_NOT_NULL(journal);
+	// directory is locked while open
+	CU_ASSERT_PTR_NULL(journal_open(dir, 256, 3));
+	CU_ASSERT_EQUAL(journal_add_consumer(journal, "a"), 0);
+	CU_ASSERT_EQUAL(journal_add_consumer(journal, "b"), 1);
+	CU_ASSERT_EQUAL(journal_add_consumer(journal, "a"), 0);
+
+	journal_test_append(journal, 1, 10);
+	CU_ASSERT_EQUAL(journal_segment_count(journal), 3);
+
+	// consumer stops taking records, then resumes where it stopped
+	CU_ASSERT_EQUAL(journal_test_replay(journal, 0, 3, &last_a), 3);
+	CU_ASSERT_EQUAL(journal_pending(journal, 0), 7);
+	CU_ASSERT_EQUAL(journal_test_replay(journal, 0, 100, &last_a), 7);
+	CU_ASSERT_EQUAL(last_a, 10);
+	CU_ASSERT_EQUAL(journal_pending(journal, 1), 10);
+
+	// cursors and records survive reopening
+	journal_close(journal);
+	journal = journal_open(dir, 256, 3);
+	CU_ASSERT_EQUAL(journal_add_consumer(journal, "b"), 0);
+	CU_ASSERT_EQUAL(journal_add_consumer(journal, "a"), 1);
+	CU_ASSERT_EQUAL(journal_pending(journal, 1), 0);
+	CU_ASSERT_EQUAL(journal_pending(journal, 0), 10);
+
+	journal_test_append(journal, 11, 1);
+	CU_ASSERT_EQUAL(journal_test_replay(journal, 1, 100, &last_a), 1);
+	CU_ASSERT_EQUAL(last_a, 11);
+
+	// oldest segments go away, lagging consumer gets what is left
+	journal_test_append(journal, 12, 6);
+	CU_ASSERT_EQUAL(journal_segment_count(journal), 3);
+	CU_ASSERT_EQUAL(journal_test_replay(journal, 0, 100, &last_b), 9);
+	CU_ASSERT_EQUAL(last_b, 17);
+
+	journal_close(journal);
+	journal_test_remove(dir);
+}
+
+/**
+ * Consumer of records of two devices, "A" and "B", in test
+ */
+typedef struct {
+	int b_present;
+	char seen[64];
+} journal_test_devices;
+
+static int journal_test_deliver_device(intu16 type, unsigned long long seq,
+				       const intu8 *data, intu32 length,
+				       void *arg)
+{
+	journal_test_devices *c = arg;
+
+	if (data[0] == 'B' && !c->b_present)
+		return JOURNAL_DEFER;
+
+	strncat(c->seen, (const char *) data,
+		sizeof(c->seen) - strlen(c->seen) - 1);
+	return JOURNAL_DELIVERED;
+}
+
+static void journal_test_append_device(Journal *journal, const char *record)
+{
+	CU_ASSERT_TRUE(journal_append(journal, 1, (const intu8 *) record,
+				      strlen(record) + 1, NULL));
+}
+
+void test_journal_defer(void)
+{
+	char *tmp = ioutil_get_tmp();
+	char *dir = malloc(strlen(tmp) + 16);
+	journal_test_devices c;
+	Journal *journal;
+
+	sprintf(dir, "%sjournalXXXXXX", tmp);
+	free(tmp);
+	CU_ASSERT_PTR_NOT_NULL(mkdtemp(dir));
+
+	journal = journal_open(dir, 256, 8);
+	CU_ASSERT_PTR_NOT_NULL(journal);
+	CU_ASSERT_EQUAL(journal_add_consumer(journal, "c"), 0);
+
+	journal_test_append_device(journal, "A1");
+	journal_test_append_device(journal, "B1");
+	journal_test_append_device(journal, "A2");
+	journal_test_append_device(journal, "B2");
+	journal_test_append_device(journal, "A3");
+
+	// device B has gone, its records do not hold those of A
+	memset(&c, 0, sizeof(c));
+	CU_ASSERT_EQUAL(journal_replay(journal, 0, journal_test_deliver_device,
+				       &c), 3);
+	CU_ASSERT_STRING_EQUAL(c.seen, "A1A2A3");
+
+	memset(&c, 0, sizeof(c));
+	journal_test_append_device(journal, "A4");
+	CU_ASSERT_EQUAL(journal_replay(journal, 0, journal_test_deliver_device,
+				       &c), 1);
+	CU_ASSERT_STRING_EQUAL(c.seen, "A4");
+	CU_ASSERT_EQUAL(journal_pending(journal, 0), 0);
+
+	// deferred records survive reopening, and wait for B
+	journal_close(journal);
+	journal = journal_open(dir, 256, 8);
+	CU_ASSERT_EQUAL(journal_add_consumer(journal, "c"), 0);
+
+	memset(&c, 0, sizeof(c));
+	CU_ASSERT_EQUAL(journal_retry_deferred(journal, 0,
+					       journal_test_deliver_device,
+					       &c), 0);
+	CU_ASSERT_EQUAL(journal_replay(journal, 0, journal_test_deliver_device,
+				       &c), 0);
+	CU_ASSERT_STRING_EQUAL(c.seen, "");
+
+	// B is back, gets its records in order, once
+	c.b_present = 1;
+	CU_ASSERT_EQUAL(journal_retry_deferred(journal, 0,
+					       journal_test_deliver_device,
+					       &c), 2);
+	CU_ASSERT_STRING_EQUAL(c.seen, "B1B2");
+	CU_ASSERT_EQUAL(journal_retry_deferred(journal, 0,
+					       journal_test_deliver_device,
+					       &c), 0);
+	CU_ASSERT_EQUAL(journal_replay(journal, 0, journal_test_deliver_device,
+				       &c), 0);
+	CU_ASSERT_STRING_EQUAL(c.seen, "B1B2");
+
+	journal_close(journal);
+	journal_test_remove(dir);
+}
+
 #endif
@@ -32,6 +32,8 @@
 
 void testioutil_add_suite(void);
 void test_ioutil_get_tmp(void);
+void test_journal_replay(void);
+void test_journal_defer(void);
 
 #endif
 
@@ -30,8 +30,13 @@
 #include "Basic.h"
 #include "src/asn1/phd_types.h"
 #include "src/dim/mds.h"
+#include "src/dim/mds_template.h"
+#include "src/dim/nomenclature.h"
+#include "src/api/data_list.h"
+#include "src/api/xml_encoder.h"
 #include "testmds.h"
 #include <stdlib.h>
+#include <string.h>
 
 int test_mds_init_suite(void)
 {
@@ -51,6 +56,8 @@ void testmds_add_suite()
 	/* Add tests here - Start */
 	CU_add_test(suite, "test_mds_is_supported_data_request",
 		    test_mds_is_supported_data_request);
+	CU_add_test(suite, "test_mds_template", test_mds_template);
+	CU_add_test(suite, "test_mds_attribute_cache", test_mds_attribute_cache);
 	/* Add tests here - End */
 
 }
@@ -89,4 +96,142 @@ void test_mds_is_supported_data_request(void)
 	mds_destroy(mds);
 }
 
+void test_mds_template(void)
+{
+	struct MDS_object objects[2];
+	octet_string system_id = {8, (intu8 *) "\0\0\0\0\0\0\0\x42"};
+	MDS *mds1 = mds_create();
+	MDS *mds2 = mds_create();
+
+	mds_template_clear();
+	memset(objects, 0, sizeof(objects));
+
+	objects[0].choice = MDS_OBJ_METRIC;
+	objects[0].obj_handle = 1;
+	objects[0].u.metric.choice = METRIC_NUMERIC;
+	struct Numeric *numeric = &objects[0].u.metric.u.numeric;
+	numeric->metric.label_string.length = 4;
+	numeric->metric.label_string.value = malloc(4);
+	memcpy(numeric->metric.label_string.value, "SpO2", 4);
+	numeric->compound_basic_nu_observed_value.count = 2;
+	numeric->compound_basic_nu_observed_value.value = calloc(2, sizeof(BasicNuObsValue));
+	numeric->compound_basic_nu_observed_value.value[1] = 97;
+
+	objects[1].choice = MDS_OBJ_SCANNER;
+	objects[1].obj_handle = 2;
+	objects[1].u.scanner.choice = PERI_CFG_SCANNER;
+	struct Scanner *scanner = &objects[1].u.scanner.u.peri_cfg_scanner.scanner.scanner;
+	scanner->scan_handle_attr_val_map.count = 1;
+	scanner->scan_handle_attr_val_map.value = calloc(1, sizeof(HandleAttrValMapEntry));
+	scanner->scan_handle_attr_val_map.value[0].attr_val_map.count = 1;
+	scanner->scan_handle_attr_val_map.value[0].attr_val_map.value =
+		calloc(1, sizeof(AttrValMapEntry));
+
+	CU_ASSERT_FALSE(mds_template_apply(mds1, 0x4000, &system_id));
+
+	mds_template_store(0x4000, &system_id, objects, 2);
+	mds_destroy_object(&objects[0]);
+	mds_destroy_object(&objects[1]);
+	CU_ASSERT_EQUAL(mds_template_count(), 1);
+
+	// standard configuration with same id is another template
+	CU_ASSERT_FALSE(mds_template_apply(mds1, 0x4000, NULL));
+
+	CU_ASSERT_TRUE(mds_template_apply(mds1, 0x4000, &system_id));
+	CU_ASSERT_TRUE(mds_template_apply(mds2, 0x4000, &system_id));
+	CU_ASSERT_EQUAL(mds1->objects_list_count, 2);
+	CU_ASSERT_EQUAL(mds2->objects_list_count, 2);
+
+	struct MDS_object *obj1 = mds_get_object_by_handle(mds1, 1);
+	struct MDS_object *obj2 = mds_get_object_by_handle(mds2, 1);
+	CU_ASSERT_PTR_NOT_NULL(obj1);
+	CU_ASSERT_PTR_NOT_NULL(obj2);
+
+	if (obj1 && obj2) {
+		struct Numeric *n1 = &obj1->u.metric.u.numeric;
+		struct Numeric *n2 = &obj2->u.metric.u.numeric;
+		CU_ASSERT_EQUAL(memcmp(n1->metric.label_string.value, "SpO2", 4), 0);
+		CU_ASSERT_EQUAL(n2->compound_basic_nu_observed_value.value[1], 97);
+		// deep copies, not shared
+		CU_ASSERT_NOT_EQUAL(n1->metric.label_string.value,
+				    n2->metric.label_string.value);
+		CU_ASSERT_NOT_EQUAL(n1->compound_basic_nu_observed_value.value,
+				    n2->compound_basic_nu_observed_value.value);
+	}
+
+	mds_template_invalidate(0x4000, &system_id);
+	CU_ASSERT_EQUAL(mds_template_count(), 0);
+	CU_ASSERT_FALSE(mds_template_apply(mds1, 0x4000, &system_id));
+
+	mds_destroy(mds1);
+	mds_destroy(mds2);
+	mds_template_clear();
+}
+
+void test_mds_attribute_cache(void)
+{
+	MDS *mds = mds_create();
+	intu8 timeout[4] = {0, 0, 0, 7};
+	AVA_Type attribute;
+	intu16 count = 0;
+	intu16 length = 0;
+	intu16 copy_count = 0;
+	intu16 copy_length = 0;
+	int i;
+
+	mds->confirm_timeout = 3;
+
+	const AVA_Type *cached = mds_get_cached_attributes(mds, &count, &length);
+	CU_ASSERT_PTR_NOT_NULL(cached);
+	CU_ASSERT_EQUAL(count, 17);
+
+	// encoded once, length still added to caller total
+	CU_ASSERT_PTR_EQUAL(mds_get_cached_attributes(mds, &count, &length),
+			    cached);
+	CU_ASSERT_EQUAL(length % 2, 0);
+
+	AVA_Type *copy = mds_get_attributes(mds, &copy_count, &copy_length);
+	CU_ASSERT_EQUAL(copy_count, count);
+	CU_ASSERT_EQUAL(copy_length * 2, length);
+	CU_ASSERT_NOT_EQUAL(copy[16].attribute_value.value,
+			    cached[16].attribute_value.value);
+	CU_ASSERT_EQUAL(memcmp(copy[16].attribute_value.value, "\0\0\0\3", 4), 0);
+
+	for (i = 0; i < copy_count; ++i) {
+		free(copy[i].attribute_value.value);
+	}
+
+	free(copy);
+
+	DataList *snapshot = mds_get_attributes_snapshot(mds);
+	const char *xml = mds_get_attributes_xml(mds);
+	CU_ASSERT_PTR_NOT_NULL(xml);
+	CU_ASSERT_PTR_EQUAL(mds_get_attributes_snapshot(mds), snapshot);
+	CU_ASSERT_PTR_EQUAL(mds_get_attributes_xml(mds), xml);
+
+	// clones are independent, but encode the same
+	DataList *clone = data_list_clone(snapshot);
+	char *clone_xml = xml_encode_data_list(clone);
+	CU_ASSERT_NOT_EQUAL(clone->values, snapshot->values);
+	CU_ASSERT_STRING_EQUAL(clone_xml, xml);
+	free(clone_xml);
+	data_list_del(clone);
+
+	// setting an attribute invalidates encodings
+	attribute.attribute_id = MDC_ATTR_CONFIRM_TIMEOUT;
+	attribute.attribute_value.length = 4;
+	attribute.attribute_value.value = timeout;
+	mds_set_attribute(mds, &attribute);
+	CU_ASSERT_EQUAL(mds->confirm_timeout, 7);
+
+	length = 0;
+	cached = mds_get_cached_attributes(mds, &count, &length);
+	CU_ASSERT_EQUAL(cached[16].attribute_id, MDC_ATTR_CONFIRM_TIMEOUT);
+	CU_ASSERT_EQUAL(memcmp(cached[16].attribute_value.value, timeout, 4), 0);
+	CU_ASSERT_EQUAL(length, copy_length);
+	CU_ASSERT_PTR_NOT_NULL(mds_get_attributes_xml(mds));
+
+	mds_destroy(mds);
+}
+
 #endif
@@ -31,4 +31,8 @@ void testmds_add_suite(void);
 
 void test_mds_is_supported_data_request(void);
 
+void test_mds_template(void);
+
+void test_mds_attribute_cache(void);
+
 #endif
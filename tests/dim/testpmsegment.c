@@ -29,8 +29,11 @@
 #ifdef TEST_ENABLED
 
 #include "testpmsegment.h"
+#include "src/dim/pmsegment.h"
+#include "src/util/spillbuff.h"
 #include "Basic.h"
 #include <stdio.h>
+#include <stdlib.h>
 
 int testpmsegment_init_suite(void)
 {
@@ -48,6 +51,7 @@ void testpmsegment_add_suite()
 
 	/* Add tests here - Start */
 	CU_add_test(suite, "test_pmsegment_test1", test_pmsegment_test1);
+	CU_add_test(suite, "test_pmsegment_spill", test_pmsegment_spill);
 
 	/* Add tests here - End */
 }
@@ -56,4 +60,53 @@ void test_pmsegment_test1(void)
 {
 }
 
+void test_pmsegment_spill(void)
+{
+	struct PMSegment *segment = pmsegment_instance(0);
+	intu32 threshold = spillbuff_get_threshold();
+	intu8 part[100];
+	int i, j;
+
+	spillbuff_set_threshold(1024);
+
+	for (i = 0; i < 300; ++i) {
+		for (j = 0; j < 100; ++j) {
+			part[j] = i + j;
+		}
+
+		CU_ASSERT(spillbuff_append(&segment->fixed_segment_data, part, 100));
+		CU_ASSERT_EQUAL(segment->fixed_segment_data.spilled, i >= 10);
+	}
+
+	// beyond 64k, contents read back through the mapping
+	CU_ASSERT_EQUAL(segment->fixed_segment_data.length, 30000);
+
+	int ok = 1;
+
+	for (i = 0; i < 300; ++i) {
+		for (j = 0; j < 100; ++j) {
+			ok = ok && segment->fixed_segment_data.data[i * 100 + j]
+			     == (intu8) (i + j);
+		}
+	}
+
+	CU_ASSERT(ok);
+
+	spillbuff_release_pages(&segment->fixed_segment_data);
+	CU_ASSERT_EQUAL(segment->fixed_segment_data.data[29999], (intu8) (299 + 99));
+
+	pmsegment_remove_all_entries(segment);
+	CU_ASSERT_EQUAL(segment->fixed_segment_data.length, 0);
+	CU_ASSERT_EQUAL(segment->fixed_segment_data.spilled, 0);
+
+	// small segments stay in memory
+	CU_ASSERT(spillbuff_append(&segment->fixed_segment_data, part, 100));
+	CU_ASSERT_EQUAL(segment->fixed_segment_data.spilled, 0);
+
+	pmsegment_destroy(segment);
+	free(segment);
+
+	spillbuff_set_threshold(threshold);
+}
+
 #endif
@@ -31,11 +31,18 @@
 #ifdef TEST_ENABLED
 
 #include <stdlib.h>
+#include <string.h>
 #include "testpmstore.h"
 #include "Basic.h"
 #include "src/dim/pmstore.h"
 #include "src/dim/pmstore.h"
 #include "src/dim/pmsegment.h"
+#include "src/dim/pmsegment_export.h"
+#include "src/dim/pmstore_cache.h"
+#include "src/dim/pmstore_delivery.h"
+#include "src/dim/mds.h"
+#include "src/api/data_list.h"
+#include "src/dim/nomenclature.h"
 #include "testdateutil.h"
 #include "src/util/dateutil.h"
 
@@ -61,6 +68,15 @@ void testpmstore_add_suite()
 	CU_add_test(suite, "test_pmstore_date_selection",
 		    test_pmstore_date_selection);
 
+	CU_add_test(suite, "test_pmstore_columnar_export",
+		    test_pmstore_columnar_export);
+
+	CU_add_test(suite, "test_pmstore_cache_range_query",
+		    test_pmstore_cache_range_query);
+
+	CU_add_test(suite, "test_pmstore_delta_delivery",
+		    test_pmstore_delta_delivery);
+
 	/* Add tests here - End */
 
 }
@@ -259,4 +275,232 @@ void test_pmstore_date_selection(void)
 
 }
 
+static unsigned long long read_be(intu8 *p, int len)
+{
+	unsigned long long value = 0;
+
+	while (len-- > 0) {
+		value = (value << 8) | *p++;
+	}
+
+	return value;
+}
+
+void test_pmstore_columnar_export(void)
+{
+	struct PMSegment *segment = pmsegment_instance(7);
+	SegmEntryElem *elem = calloc(1, sizeof(SegmEntryElem));
+	int i;
+
+	// entries: absolute time, then FLOAT value and 2-byte status
+	segment->pm_segment_entry_map.segm_entry_header = SEG_ELEM_HDR_ABSOLUTE_TIME;
+	segment->pm_segment_entry_map.segm_entry_elem_list.count = 1;
+	segment->pm_segment_entry_map.segm_entry_elem_list.value = elem;
+	elem->handle = 1;
+	elem->metric_type.partition = MDC_PART_SCADA;
+	elem->metric_type.code = 0x4a04;
+	elem->attr_val_map.count = 2;
+	elem->attr_val_map.value = calloc(2, sizeof(AttrValMapEntry));
+	elem->attr_val_map.value[0].attribute_id = MDC_ATTR_NU_VAL_OBS_SIMP;
+	elem->attr_val_map.value[0].attribute_len = 4;
+	elem->attr_val_map.value[1].attribute_id = MDC_ATTR_MSMT_STAT;
+	elem->attr_val_map.value[1].attribute_len = 2;
+
+	for (i = 0; i < 3; ++i) {
+		AbsoluteTime time = date_util_create_absolute_time(2010, 7, 15,
+								   10, 30, i, 50);
+		intu8 value[6] = {0xff, 0x00, 0x00, 100 + i, 0xab, i};
+
+		spillbuff_append(&segment->fixed_segment_data, (intu8 *) &time, 8);
+		spillbuff_append(&segment->fixed_segment_data, value, 6);
+	}
+
+	segment->empiric_usage_count = 3;
+
+	ByteStreamWriter *stream = pmsegment_export_columnar(NULL, segment);
+	CU_ASSERT_PTR_NOT_NULL(stream);
+
+	if (stream == NULL) {
+		return;
+	}
+
+	intu8 *out = stream->buffer;
+	CU_ASSERT_EQUAL(stream->size, 16 + 3 * 16 + 24 + 24 + 8);
+	CU_ASSERT_EQUAL(read_be(out, 4), PMSEGMENT_EXPORT_MAGIC);
+	CU_ASSERT_EQUAL(read_be(out + 6, 2), 3);
+	CU_ASSERT_EQUAL(read_be(out + 8, 4), 3);
+	CU_ASSERT_EQUAL(read_be(out + 14, 2), 7);
+
+	// descriptors
+	CU_ASSERT_EQUAL(out[16], PMSEGMENT_EXPORT_ABS_TIME);
+	CU_ASSERT_EQUAL(out[17], PMSEGMENT_EXPORT_TIME);
+	CU_ASSERT_EQUAL(out[32], PMSEGMENT_EXPORT_ATTRIBUTE);
+	CU_ASSERT_EQUAL(out[33], PMSEGMENT_EXPORT_F64);
+	CU_ASSERT_EQUAL(read_be(out + 36, 2), 1);
+	CU_ASSERT_EQUAL(read_be(out + 38, 2), MDC_ATTR_NU_VAL_OBS_SIMP);
+	CU_ASSERT_EQUAL(read_be(out + 44, 2), 0x4a04);
+	CU_ASSERT_EQUAL(out[49], PMSEGMENT_EXPORT_RAW);
+	CU_ASSERT_EQUAL(read_be(out + 50, 2), 2);
+
+	// columns
+	for (i = 0; i < 3; ++i) {
+		unsigned long long bits = read_be(out + 88 + 8 * i, 8);
+		double value;
+		memcpy(&value, &bits, sizeof(value));
+
+		CU_ASSERT_EQUAL(read_be(out + 64 + 8 * i, 8),
+				(1279189800ULL + i) * 1000000 + 500000);
+		CU_ASSERT_DOUBLE_EQUAL(value, 10.0 + i / 10.0, 0.0001);
+		CU_ASSERT_EQUAL(read_be(out + 112 + 2 * i, 2), 0xab00 + i);
+	}
+
+	del_byte_stream_writer(stream, 1);
+	pmsegment_destroy(segment);
+	free(segment);
+}
+
+static struct PMSegment *cache_test_segment(InstNumber inst, int first_second)
+{
+	struct PMSegment *segment = pmsegment_instance(inst);
+	SegmEntryElem *elem = calloc(1, sizeof(SegmEntryElem));
+	int i;
+
+	segment->pm_segment_entry_map.segm_entry_header = SEG_ELEM_HDR_ABSOLUTE_TIME;
+	segment->pm_segment_entry_map.segm_entry_elem_list.count = 1;
+	segment->pm_segment_entry_map.segm_entry_elem_list.value = elem;
+	elem->handle = 1;
+	elem->attr_val_map.count = 1;
+	elem->attr_val_map.value = calloc(1, sizeof(AttrValMapEntry));
+	elem->attr_val_map.value[0].attribute_id = MDC_ATTR_NU_VAL_OBS_SIMP;
+	elem->attr_val_map.value[0].attribute_len = 4;
+
+	// out of order, cache must sort them
+	for (i = 2; i >= 0; --i) {
+		AbsoluteTime time = date_util_create_absolute_time(2010, 7, 15, 10, 30,
+								   first_second + i, 0);
+		intu8 value[4] = {0xff, 0x00, 0x00, i};
+
+		spillbuff_append(&segment->fixed_segment_data, (intu8 *) &time, 8);
+		spillbuff_append(&segment->fixed_segment_data, value, 4);
+	}
+
+	segment->empiric_usage_count = 3;
+
+	return segment;
+}
+
+void test_pmstore_cache_range_query(void)
+{
+	MDS *mds = mds_create();
+	intu8 system_id[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+	struct PMSegment *segm1 = cache_test_segment(1, 0);
+	struct PMSegment *segm2 = cache_test_segment(2, 10);
+	long long base = 1279189800LL * 1000000;
+	DataList *list = NULL;
+
+	CU_ASSERT_EQUAL(date_util_absolute_time_to_epoch_us(
+				date_util_create_absolute_time(2010, 7, 15, 10, 30, 0, 50)),
+			base + 500000);
+
+	struct MDS_object object;
+	memset(&object, 0, sizeof(object));
+	object.choice = MDS_OBJ_METRIC;
+	object.obj_handle = 1;
+	object.u.metric.choice = METRIC_NUMERIC;
+	mds_add_object(mds, object);
+
+	mds->system_id.value = system_id;
+	mds->system_id.length = 8;
+
+	pmstore_cache_clear();
+	pmstore_cache_add(&mds->system_id, 10, segm1);
+	pmstore_cache_add(&mds->system_id, 10, segm2);
+	CU_ASSERT_EQUAL(pmstore_cache_count(), 6);
+
+	// again, replaces entries of the first transfer
+	pmstore_cache_add(&mds->system_id, 10, segm1);
+	CU_ASSERT_EQUAL(pmstore_cache_count(), 6);
+
+	CU_ASSERT_EQUAL(pmstore_cache_query(mds, 10, base + 1000000,
+					    base + 2000000, &list), 1);
+	CU_ASSERT_PTR_NOT_NULL(list);
+
+	if (list) {
+		CU_ASSERT_EQUAL(list->size, 1);
+		CU_ASSERT_EQUAL(list->values[0].u.compound.entries_count, 2);
+		data_list_del(list);
+		list = NULL;
+	}
+
+	// gap between segments, other store, other agent
+	CU_ASSERT_EQUAL(pmstore_cache_query(mds, 10, base, base + 11000000,
+					    &list), 0);
+	CU_ASSERT_EQUAL(pmstore_cache_query(mds, 11, base, base, &list), 0);
+	system_id[0] = 9;
+	CU_ASSERT_EQUAL(pmstore_cache_query(mds, 10, base, base, &list), 0);
+	system_id[0] = 1;
+	CU_ASSERT_PTR_NULL(list);
+
+	// segment 2 is now the least recently transferred, dropped first
+	pmstore_cache_set_limit(3);
+	CU_ASSERT_EQUAL(pmstore_cache_count(), 3);
+	CU_ASSERT_EQUAL(pmstore_cache_query(mds, 10, base + 10000000,
+					    base + 12000000, &list), 0);
+	CU_ASSERT_EQUAL(pmstore_cache_query(mds, 10, base, base + 2000000,
+					    &list), 1);
+
+	if (list) {
+		CU_ASSERT_EQUAL(list->values[0].u.compound.entries_count, 3);
+		data_list_del(list);
+	}
+
+	pmstore_cache_set_limit(PMSTORE_CACHE_DEFAULT_LIMIT);
+	pmstore_cache_clear();
+	CU_ASSERT_EQUAL(pmstore_cache_count(), 0);
+
+	mds->system_id.value = NULL;
+	mds->system_id.length = 0;
+	mds_destroy(mds);
+	pmsegment_destroy(segm1);
+	free(segm1);
+	pmsegment_destroy(segm2);
+	free(segm2);
+}
+
+
+void test_pmstore_delta_delivery(void)
+{
+	octet_string system_id = {8, (intu8 *) "\0\0\0\0\0\0\0\x42"};
+	struct PMSegment *segment = cache_test_segment(1, 0);
+	AbsoluteTime time = date_util_create_absolute_time(2010, 7, 15, 10, 30, 3, 0);
+	intu8 value[4] = {0xff, 0x00, 0x00, 3};
+
+	// disabled: everything is delivered
+	CU_ASSERT_EQUAL(pmstore_delivery_update(&system_id, 10, segment), 0);
+
+	pmstore_delivery_set_enabled(1);
+	CU_ASSERT_EQUAL(pmstore_delivery_update(&system_id, 10, segment), 0);
+	CU_ASSERT_EQUAL(pmstore_delivery_update(&system_id, 10, segment), 3);
+
+	// segment grew
+	spillbuff_append(&segment->fixed_segment_data, (intu8 *) &time, 8);
+	spillbuff_append(&segment->fixed_segment_data, value, 4);
+	segment->empiric_usage_count = 4;
+	CU_ASSERT_EQUAL(pmstore_delivery_update(&system_id, 10, segment), 3);
+
+	// other store
+	CU_ASSERT_EQUAL(pmstore_delivery_update(&system_id, 11, segment), 0);
+
+	// segment was cleared and filled again
+	segment->fixed_segment_data.data[11] = 7;
+	CU_ASSERT_EQUAL(pmstore_delivery_update(&system_id, 10, segment), 0);
+	CU_ASSERT_EQUAL(pmstore_delivery_update(&system_id, 10, segment), 4);
+
+	pmstore_delivery_set_enabled(0);
+	CU_ASSERT_EQUAL(pmstore_delivery_update(&system_id, 10, segment), 0);
+
+	pmsegment_destroy(segment);
+	free(segment);
+}
+
 #endif /* PMSTORE_C_ */
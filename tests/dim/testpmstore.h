@@ -31,6 +31,9 @@
 void testpmstore_add_suite(void);
 void test_pmstore_add_and_clear_segment(void);
 void test_pmstore_date_selection(void);
+void test_pmstore_columnar_export(void);
+void test_pmstore_cache_range_query(void);
+void test_pmstore_delta_delivery(void);
 
 
 #endif /* PMSTORE_H_ */
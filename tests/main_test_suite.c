@@ -39,6 +39,7 @@
 
 #include "testtimer.h"
 #include "testlinkedlist.h"
+#include "testpool.h"
 #include "communication/parser/testparser.h"
 #include "communication/parser/testbytelib.h"
 #include "communication/encoder/testencoder.h"
@@ -47,6 +48,10 @@
 #include "communication/testfsm.h"
 #include "communication/testservice.h"
 #include "communication/testextconfiguration.h"
+#include "communication/testloopback.h"
+#include "communication/testcapture.h"
+#include "communication/testuring.h"
+#include "communication/teststats.h"
 #include "dim/testpmstore.h"
 #include "dim/testpmsegment.h"
 #include "dim/testdateutil.h"
@@ -92,6 +97,11 @@ void add_test_suites()
 	testextconfiguration_add_suite();
 	testctxmanager_add_suite();
 	testllist_add_suite();
+	testpool_add_suite();
+	testloopback_add_suite();
+	testcapture_add_suite();
+	testuring_add_suite();
+	teststats_add_suite();
 
 	// Functional tests
 	functionaltest_association_add_suite();
@@ -0,0 +1,107 @@
+/**********************************************************************
+ * Copyright (C) 2010 Signove Tecnologia Corporation.
+ * All rights reserved.
+ * Contact: Signove Tecnologia Corporation (contact@signove.com)
+ *
+ * $LICENSE_TEXT:BEGIN$
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation and appearing
+ * in the file LICENSE included in the packaging of this file; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+ * $LICENSE_TEXT:END$
+ *
+ * testpool.c
+ *
+ * Created on: Oct 18, 2026
+ **********************************************************************/
+#ifdef TEST_ENABLED
+
+#include "testpool.h"
+#include "src/util/pool.h"
+#include "Basic.h"
+#include <string.h>
+
+typedef struct {
+	int a;
+	char b[40];
+} PoolItem;
+
+static ObjectPool pool = OBJECT_POOL_INITIALIZER(PoolItem, 4);
+
+static int test_init_suite(void)
+{
+	return 0;
+}
+
+static int test_finish_suite(void)
+{
+	return 0;
+}
+
+void testpool_add_suite()
+{
+	CU_pSuite suite = CU_add_suite("Object Pool Test Suite",
+				       test_init_suite, test_finish_suite);
+
+	/* Add tests here - Start */
+	CU_add_test(suite, "testpool_test", testpool_test);
+
+	/* Add tests here - End */
+}
+
+void testpool_test()
+{
+	PoolItem *items[10];
+	int i;
+
+	for (i = 0; i < 10; ++i) {
+		items[i] = pool_alloc(&pool);
+		CU_ASSERT_PTR_NOT_NULL(items[i]);
+		CU_ASSERT_EQUAL(items[i]->a, 0);
+		memset(items[i], 0xAA, sizeof(PoolItem));
+	}
+
+	CU_ASSERT_NOT_EQUAL(items[0], items[9]);
+
+	pool_free(&pool, items[3]);
+	PoolItem *again = pool_alloc(&pool);
+	// given back zeroed
+	CU_ASSERT_EQUAL(again->a, 0);
+	CU_ASSERT_EQUAL(again->b[39], 0);
+#ifndef POOLS_DISABLED
+	CU_ASSERT_EQUAL(again, items[3]);
+	CU_ASSERT_EQUAL(pool.in_use, 10);
+#endif
+	items[3] = again;
+
+	// in use, nothing is released
+	pool_trim(&pool);
+
+	for (i = 0; i < 10; ++i) {
+		pool_free(&pool, items[i]);
+	}
+
+	CU_ASSERT_TRUE(pool_reserve(&pool, 20));
+#ifndef POOLS_DISABLED
+	CU_ASSERT_EQUAL(pool.in_use, 0);
+	CU_ASSERT(pool.free_count >= 20);
+#endif
+
+	pool_trim(&pool);
+#ifndef POOLS_DISABLED
+	CU_ASSERT_EQUAL(pool.free_count, 0);
+	CU_ASSERT_PTR_NULL(pool.slabs);
+#endif
+}
+
+#endif